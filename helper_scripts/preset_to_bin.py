@@ -0,0 +1,86 @@
+"""Converts a JSON preset file to the binary preset format of include/presetBinary.h.
+
+Usage: python preset_to_bin.py preset.json preset.bin
+The binary file goes to the /presets directory of the device filesystem.
+"""
+import json
+import struct
+import sys
+import zlib
+
+MAGIC = b'RSPB'
+VERSION = 1
+
+# limits of the commands, as PRESET_COMMAND_COUNT and PRESET_ARENA_SIZE in include/configuration.h
+COMMAND_COUNT = 64
+ARENA_SIZE = 1024
+
+# maximum string lengths, without the null terminator, as in cfg::PresetFile
+EOL_LENGTH = 2
+URL_LENGTH = 127
+EXPERIMENT_ID_LENGTH = 31
+DESCRIPTION_LENGTH = 127
+TOKEN_LENGTH = 31
+COMMAND_LENGTH = 79
+
+
+def string(text, max_length, name):
+	data = text.encode('ascii')
+	if len(data) > max_length:
+		raise ValueError(f'{name} is longer than {max_length} characters')
+	return struct.pack('<B', len(data)) + data
+
+
+def commands(items, name):
+	data = struct.pack('<B', len(items))
+	for item in items:
+		data += struct.pack('<B', 1 if item['expect_response'] else 0)
+		data += string(item['command'], COMMAND_LENGTH, name + ' command')
+	return data
+
+
+def convert(preset):
+	serial = preset['serial']
+	schedule = preset['task_schedule']
+	http = preset['http_client']
+	flags = 0
+	if preset.get('batch_once', False):
+		flags |= 0x01
+	if preset.get('batch_scheduled', False):
+		flags |= 0x02
+	if http['check_certs']:
+		flags |= 0x04
+	if http.get('binary', False):
+		flags |= 0x08
+
+	payload = struct.pack('<IBBB', serial['baud_rate'], serial['byte_size'], serial['parity'], serial['stop_bits'])
+	payload += string(serial['EOL'], EOL_LENGTH, 'EOL')
+	payload += struct.pack('<IIB', schedule['period'], schedule['offset'], flags)
+	payload += string(http['url'], URL_LENGTH, 'url')
+	payload += string(http['experiment_id'], EXPERIMENT_ID_LENGTH, 'experiment_id')
+	payload += string(http['experiment_description'], DESCRIPTION_LENGTH, 'experiment_description')
+	payload += string(http['access_token'], TOKEN_LENGTH, 'access_token')
+	all_commands = preset['run_once'] + preset['run_scheduled']
+	if len(all_commands) > COMMAND_COUNT:
+		raise ValueError(f'the preset has more than {COMMAND_COUNT} commands')
+	# every command text takes its length and a null terminator in the arena
+	arena = sum(len(item['command'].encode('ascii')) + 1 for item in all_commands)
+	if arena > ARENA_SIZE:
+		raise ValueError(f'the command texts take {arena} bytes, more than {ARENA_SIZE}')
+	payload += commands(preset['run_once'], 'run_once')
+	payload += commands(preset['run_scheduled'], 'run_scheduled')
+
+	data = MAGIC + struct.pack('<BH', VERSION, len(payload)) + payload
+	return data + struct.pack('<I', zlib.crc32(data))
+
+
+if __name__ == '__main__':
+	if len(sys.argv) != 3:
+		print(__doc__)
+		sys.exit(1)
+	with open(sys.argv[1], 'r') as file:
+		preset = json.load(file)
+	data = convert(preset)
+	with open(sys.argv[2], 'wb') as file:
+		file.write(data)
+	print(f'{len(data)} bytes written to {sys.argv[2]}')
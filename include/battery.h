@@ -16,30 +16,48 @@
 */
 class Battery {
 	LTC2942 ltc;
-	cfg::BatterySettings battery;
+	/// @brief The settings, kept in RAM and written to the file behind, see update.
+	loc::ConfigCache<cfg::BatterySettings, fs::FS> settings;
+
+	/// @brief Changes a setting in RAM, the file is written by update.
+	template <typename F>
+	void change(F edit) {
+		cfg::BatterySettings battery = settings.get();
+		edit(battery);
+		settings.set(battery);
+	}
 public:
-	Battery(TwoWire& wire) : ltc() {
+	Battery(TwoWire& wire) : ltc(), settings(LittleFS, loc::battery, cfg::batteryFields) {
 		ltc.begin(wire);
 		ltc.configureALCC(0b10);
 		this->loadState();
 	}
 	void loadState() {
-		
-		StaticJsonDocument<1000> jsonDocument;
-		loc::loadData(loc::battery, jsonDocument);
-		cfg::loadBatterySettingsFromJSON(battery, jsonDocument);
+		// streamed into the settings, a JsonDocument for the file would take a kilobyte of stack
+		settings.load();
+		const cfg::BatterySettings& battery = settings.get();
 		ltc.setVoltageThresholds(battery.voltage_high, battery.voltage_low);
 		ltc.setTemperatureThresholds(battery.temperature_high, battery.temperature_low);
 		ltc.setBatteryCapacity(battery.capacity);
 		ltc.setRawAccumulatedCharge(battery.charge);
 	}
 
+	/// @brief Notes the accumulated charge in the settings. Nothing is written if it has not changed.
 	void saveState() {
-		cfg::BatterySettings battery;
-		battery.charge = ltc.getRawAccumulatedCharge();
-		StaticJsonDocument<1000> jsonDocument;
-		cfg::saveBatterySettingsToJSON(battery, jsonDocument);
-		loc::saveData(loc::battery, jsonDocument);
+		const uint16_t charge = ltc.getRawAccumulatedCharge();
+		change([charge](cfg::BatterySettings& battery) { battery.charge = charge; });
+	}
+
+	/// @brief Writes the changed settings once they are CONFIG_FLUSH_MS old. Called from the main loop.
+	/// @param now The current time in milliseconds.
+	int update(unsigned long long now) {
+		return settings.update(now);
+	}
+
+	/// @brief Writes the changed settings right away, e.g. before a restart or a deep sleep.
+	int flush() {
+		saveState();
+		return settings.flush();
 	}
 
 
@@ -66,6 +84,7 @@ public:
 
 	void setCapacity(uint16_t capacity) {
 		ltc.setBatteryCapacity(capacity);
+		change([capacity](cfg::BatterySettings& battery) { battery.capacity = capacity; });
 	}
 
 	void setToFull() {
@@ -74,10 +93,18 @@ public:
 
 	void setVoltageThresholds(float high, float low) {
 		ltc.setVoltageThresholds(high, low);
+		change([high, low](cfg::BatterySettings& battery) {
+			battery.voltage_high = high;
+			battery.voltage_low = low;
+		});
 	}
 
 	void setTemperatureThresholds(float high, float low) {
 		ltc.setTemperatureThresholds(high, low);
+		change([high, low](cfg::BatterySettings& battery) {
+			battery.temperature_high = high;
+			battery.temperature_low = low;
+		});
 	}
 
 
@@ -0,0 +1,211 @@
+/**
+ * @file blockParser.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the BlockParser class, a streaming parser for IEEE 488.2 binary block responses.
+ *
+ * A definite length block is `#<n><length><payload>`, where n is the number of length digits,
+ * followed by the response EOL. An indefinite length block is `#0<payload>`, ended by the EOL.
+ * The payload is handed to a sink in chunks as it arrives, so it is never buffered as a whole.
+ * The same parser can stream a plain text line, which is read like an indefinite length block without the header.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace transport {
+
+	/// @brief Receives the payload of a block.
+	/// @param data The next payload bytes.
+	/// @param length The number of bytes.
+	/// @param context The context given together with the sink.
+	typedef void (*BlockSink)(const uint8_t* data, size_t length, void* context);
+
+	/// @brief Streaming parser for IEEE 488.2 definite and indefinite length blocks.
+	class BlockParser {
+	public:
+		enum class State : uint8_t {
+			/// @brief Waiting for '#', anything before it (e.g. a response header) is skipped.
+			Hash,
+			/// @brief Waiting for the number of length digits.
+			DigitCount,
+			/// @brief Reading the length digits.
+			Length,
+			/// @brief Reading the payload of a definite length block.
+			Payload,
+			/// @brief Reading the payload of an indefinite length block.
+			Indefinite,
+			/// @brief Reading the EOL after a definite length block.
+			Trailer,
+			/// @brief The block has been read.
+			Done,
+			/// @brief The block header or trailer is malformed.
+			Error
+		};
+	private:
+		/// @brief The EOL sequence, null terminated, as in cfg::PresetFile::Serial::EOL.
+		char EOL[3] = "\n";
+		State state = State::Hash;
+		/// @brief The number of length digits still to read.
+		uint8_t digits = 0;
+		/// @brief The number of EOL characters matched, in the trailer or at the end of an indefinite block.
+		uint8_t matched = 0;
+		/// @brief The number of payload bytes still to read of a definite length block.
+		/// At most 9 digits, so it always fits.
+		uint32_t remaining = 0;
+		/// @brief The number of payload bytes handed to the sink.
+		uint32_t received = 0;
+		/// @brief The response is a plain line without the block header.
+		bool line = false;
+
+		/// @brief The sequence ending an indefinite length block, "\n" if the EOL is empty.
+		const char* terminator() const {
+			return EOL[0] == '\0' ? "\n" : EOL;
+		}
+
+		void emit(const uint8_t* data, size_t length, BlockSink sink, void* context) {
+			if(length == 0) return;
+			received += length;
+			if(sink != nullptr) sink(data, length, context);
+		}
+
+		/// @brief Moves on after the last payload byte of a definite length block.
+		void endPayload() {
+			matched = 0;
+			state = EOL[0] == '\0' ? State::Done : State::Trailer;
+		}
+	public:
+		BlockParser() {}
+
+		/// @param EOL The response EOL, up to 2 characters. An empty EOL means definite length blocks have no trailer.
+		explicit BlockParser(const char* EOL) {
+			if(EOL == nullptr) EOL = "";
+			strncpy(this->EOL, EOL, sizeof(this->EOL) - 1);
+			this->EOL[sizeof(this->EOL) - 1] = '\0';
+		}
+
+		/// @brief Creates a parser for a plain text line, the whole line without the EOL is the payload.
+		/// @param EOL The response EOL, up to 2 characters, "\n" if empty.
+		static BlockParser forLine(const char* EOL) {
+			BlockParser parser(EOL);
+			parser.line = true;
+			parser.reset();
+			return parser;
+		}
+
+		/// @brief Starts over with a new block.
+		void reset() {
+			state = line ? State::Indefinite : State::Hash;
+			digits = 0;
+			matched = 0;
+			remaining = 0;
+			received = 0;
+		}
+
+		State getState() const {
+			return state;
+		}
+
+		/// @brief Checks if the block has been read or has turned out to be malformed.
+		bool isFinished() const {
+			return state == State::Done || state == State::Error;
+		}
+
+		/// @brief The number of payload bytes handed to the sink so far.
+		uint32_t getReceived() const {
+			return received;
+		}
+
+		/// @brief The number of bytes that can be fed without reading past the end of the block.
+		/// Bytes after the block belong to the next response, so the caller should not read more than this.
+		size_t wants() const {
+			if(isFinished()) return 0;
+			return state == State::Payload ? remaining : 1;
+		}
+
+		/**
+		 * @brief Feeds received bytes. Stops at the end of the block.
+		 * @param data The received bytes.
+		 * @param length The number of bytes.
+		 * @param sink Receives the payload, can be nullptr to discard it.
+		 * @param context Passed to the sink.
+		 * @return The number of bytes consumed.
+		 */
+		size_t feed(const uint8_t* data, size_t length, BlockSink sink, void* context) {
+			size_t i = 0;
+			while(i < length && !isFinished()) {
+				if(state == State::Payload) {
+					const size_t count = remaining < length - i ? remaining : length - i;
+					emit(data + i, count, sink, context);
+					i += count;
+					remaining -= count;
+					if(remaining == 0) endPayload();
+					continue;
+				}
+				if(state == State::Indefinite) {
+					const char* end = terminator();
+					if(matched == 1) {
+						if(data[i] == (uint8_t)end[1]) {
+							i++;
+							state = State::Done;
+							continue;
+						}
+						// the held back byte was not part of the EOL after all
+						emit((const uint8_t*)end, 1, sink, context);
+						matched = 0;
+					}
+					const size_t start = i;
+					while(i < length && data[i] != (uint8_t)end[0]) i++;
+					emit(data + start, i - start, sink, context);
+					if(i < length) {
+						i++;
+						if(end[1] == '\0') state = State::Done;
+						else matched = 1;
+					}
+					continue;
+				}
+
+				const char c = (char)data[i++];
+				switch(state) {
+					case State::Hash:
+						if(c == '#') state = State::DigitCount;
+						break;
+					case State::DigitCount:
+						if(c == '0') {
+							matched = 0;
+							state = State::Indefinite;
+						} else if(c > '0' && c <= '9') {
+							digits = c - '0';
+							remaining = 0;
+							state = State::Length;
+						} else {
+							state = State::Error;
+						}
+						break;
+					case State::Length:
+						if(c < '0' || c > '9') {
+							state = State::Error;
+							break;
+						}
+						remaining = remaining * 10 + (c - '0');
+						if(--digits > 0) break;
+						if(remaining == 0) endPayload();
+						else state = State::Payload;
+						break;
+					case State::Trailer:
+						if(c != EOL[matched]) {
+							state = State::Error;
+							break;
+						}
+						if(EOL[++matched] == '\0') state = State::Done;
+						break;
+					default:
+						break;
+				}
+			}
+			return i;
+		}
+	};
+}
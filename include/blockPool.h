@@ -0,0 +1,247 @@
+/**
+ * @file blockPool.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the BlockPool and BlockAllocator classes, fixed-block allocators in static memory.
+ *
+ * A BlockPool hands out blocks of one size from a free list threaded through the free blocks themselves,
+ * so allocating and freeing is O(1) and never fragments the heap.
+ * The BlockAllocator combines a few pools of different sizes, the size classes, configured at compile time.
+ * A request goes to the smallest class it fits, or to a larger one if that is full.
+ * Every pool counts its used blocks, the most ever used at once and the requests of its size that no class
+ * could serve, so the sizes can be tuned from the counters of a device that has been running for a while.
+ *
+ * The size classes have no blocks unless their BLOCK_POOL_*_COUNT is set, so the allocator takes no RAM
+ * in a build whose task data all fits into the scheduler's buffers.
+ *
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// The alignment of every block.
+#ifndef BLOCK_POOL_ALIGN
+#define BLOCK_POOL_ALIGN 8
+#endif
+
+// The size classes of the BlockAllocator, block size in bytes and number of blocks.
+#ifndef BLOCK_POOL_SMALL_SIZE
+#define BLOCK_POOL_SMALL_SIZE 64
+#endif
+
+#ifndef BLOCK_POOL_SMALL_COUNT
+#define BLOCK_POOL_SMALL_COUNT 0
+#endif
+
+#ifndef BLOCK_POOL_MEDIUM_SIZE
+#define BLOCK_POOL_MEDIUM_SIZE 256
+#endif
+
+#ifndef BLOCK_POOL_MEDIUM_COUNT
+#define BLOCK_POOL_MEDIUM_COUNT 0
+#endif
+
+// Large enough for a cfg::PresetFile.
+#ifndef BLOCK_POOL_LARGE_SIZE
+#define BLOCK_POOL_LARGE_SIZE 1792
+#endif
+
+#ifndef BLOCK_POOL_LARGE_COUNT
+#define BLOCK_POOL_LARGE_COUNT 0
+#endif
+
+/// @brief The counters of a pool.
+struct BlockPoolStats {
+	/// @brief The size of every block.
+	size_t blockSize;
+	/// @brief The number of blocks.
+	unsigned int count;
+	/// @brief The number of blocks in use.
+	unsigned int used;
+	/// @brief The most blocks that were in use at once.
+	unsigned int highWater;
+	/// @brief The number of allocations of this size that failed because every block was in use.
+	unsigned long failures;
+};
+
+/**
+ * @brief A fixed number of blocks of the same size.
+ * @tparam BLOCK_SIZE The usable size of a block, rounded up to BLOCK_POOL_ALIGN.
+ * @tparam COUNT The number of blocks, 0 for a pool that never has a free block.
+ */
+template <size_t BLOCK_SIZE, unsigned int COUNT>
+class BlockPool {
+public:
+	/// @brief The size of a block, with room for the free list link and rounded up to the alignment.
+	static const size_t SIZE = ((BLOCK_SIZE < sizeof(void*) ? sizeof(void*) : BLOCK_SIZE) + BLOCK_POOL_ALIGN - 1)
+		/ BLOCK_POOL_ALIGN * BLOCK_POOL_ALIGN;
+	static const unsigned int BLOCK_COUNT = COUNT;
+private:
+	alignas(BLOCK_POOL_ALIGN) uint8_t blocks[COUNT][SIZE];
+
+	/// @brief The first free block, its first bytes hold the next free block, nullptr at the end.
+	void* freeHead;
+
+	unsigned int used;
+	unsigned int highWater;
+	unsigned long failures;
+public:
+	BlockPool() {
+		reset();
+	}
+
+	/// @brief Marks every block as free and resets the counters.
+	void reset() {
+		for(unsigned int i = 0; i < COUNT; i++) {
+			*reinterpret_cast<void**>(blocks[i]) = i + 1 < COUNT ? blocks[i + 1] : nullptr;
+		}
+		freeHead = blocks[0];
+		used = 0;
+		highWater = 0;
+		failures = 0;
+	}
+
+	/// @brief Takes a free block, counting a failure if there is none.
+	/// @return The block, or nullptr if every block is in use.
+	void* allocate() {
+		void* block = take();
+		if(block == nullptr) countFailure();
+		return block;
+	}
+
+	/// @brief Takes a free block without counting a failure, for an allocator that can try another pool.
+	/// @return The block, or nullptr if every block is in use.
+	void* take() {
+		if(freeHead == nullptr) return nullptr;
+		void* block = freeHead;
+		freeHead = *reinterpret_cast<void**>(block);
+		used++;
+		if(used > highWater) highWater = used;
+		return block;
+	}
+
+	/// @brief Counts an allocation of this size that failed.
+	void countFailure() {
+		failures++;
+	}
+
+	/// @brief Checks if the pointer is the start of a block of this pool.
+	bool owns(const void* pointer) const {
+		const uint8_t* byte = static_cast<const uint8_t*>(pointer);
+		return byte >= blocks[0] && byte < blocks[0] + COUNT * SIZE && (size_t)(byte - blocks[0]) % SIZE == 0;
+	}
+
+	/// @brief Returns a block to the pool.
+	/// @return false if the block does not belong to this pool.
+	bool free(void* block) {
+		if(!owns(block)) return false;
+		*reinterpret_cast<void**>(block) = freeHead;
+		freeHead = block;
+		used--;
+		return true;
+	}
+
+	BlockPoolStats getStats() const {
+		return BlockPoolStats{SIZE, COUNT, used, highWater, failures};
+	}
+};
+
+/// @brief A pool without blocks, for a disabled size class.
+template <size_t BLOCK_SIZE>
+class BlockPool<BLOCK_SIZE, 0> {
+	unsigned long failures = 0;
+public:
+	static const size_t SIZE = BlockPool<BLOCK_SIZE, 1>::SIZE;
+	static const unsigned int BLOCK_COUNT = 0;
+
+	void reset() {
+		failures = 0;
+	}
+
+	void* allocate() {
+		countFailure();
+		return nullptr;
+	}
+
+	void* take() {
+		return nullptr;
+	}
+
+	void countFailure() {
+		failures++;
+	}
+
+	bool owns(const void*) const {
+		return false;
+	}
+
+	bool free(void*) {
+		return false;
+	}
+
+	BlockPoolStats getStats() const {
+		return BlockPoolStats{SIZE, 0, 0, 0, failures};
+	}
+};
+
+/**
+ * @brief Allocates blocks from the size classes BLOCK_POOL_SMALL, BLOCK_POOL_MEDIUM and BLOCK_POOL_LARGE.
+ */
+class BlockAllocator {
+	BlockPool<BLOCK_POOL_SMALL_SIZE, BLOCK_POOL_SMALL_COUNT> small;
+	BlockPool<BLOCK_POOL_MEDIUM_SIZE, BLOCK_POOL_MEDIUM_COUNT> medium;
+	BlockPool<BLOCK_POOL_LARGE_SIZE, BLOCK_POOL_LARGE_COUNT> large;
+public:
+	/// @brief The number of size classes, for getStats.
+	static const unsigned int SIZE_CLASSES = 3;
+
+	/// @brief The largest size that can be allocated, 0 if every size class is disabled.
+	static const size_t MAX_SIZE = decltype(large)::BLOCK_COUNT > 0 ? decltype(large)::SIZE
+		: decltype(medium)::BLOCK_COUNT > 0 ? decltype(medium)::SIZE
+		: decltype(small)::BLOCK_COUNT > 0 ? decltype(small)::SIZE : 0;
+
+	/// @brief Whether an object of type T can be allocated.
+	template <typename T>
+	static constexpr bool fits() {
+		return sizeof(T) <= MAX_SIZE && alignof(T) <= BLOCK_POOL_ALIGN;
+	}
+
+	/**
+	 * @brief Allocates a block from the smallest size class that fits and has a free block.
+	 * A failed allocation is counted once, by the smallest enabled class it fits.
+	 * @param size The number of bytes needed.
+	 * @return The block, or nullptr if there is none.
+	 */
+	void* allocate(size_t size) {
+		void* block = nullptr;
+		if(size <= decltype(small)::SIZE) block = small.take();
+		if(block == nullptr && size <= decltype(medium)::SIZE) block = medium.take();
+		if(block == nullptr && size <= decltype(large)::SIZE) block = large.take();
+		if(block != nullptr) return block;
+		if(size <= decltype(small)::SIZE && decltype(small)::BLOCK_COUNT > 0) small.countFailure();
+		else if(size <= decltype(medium)::SIZE && decltype(medium)::BLOCK_COUNT > 0) medium.countFailure();
+		else if(size <= decltype(large)::SIZE && decltype(large)::BLOCK_COUNT > 0) large.countFailure();
+		return nullptr;
+	}
+
+	/// @brief Returns a block to its size class.
+	/// @return false if the block was not allocated here.
+	bool free(void* block) {
+		return small.free(block) || medium.free(block) || large.free(block);
+	}
+
+	/// @brief Marks every block as free and resets the counters.
+	void reset() {
+		small.reset();
+		medium.reset();
+		large.reset();
+	}
+
+	/// @brief The counters of a size class, 0 for the smallest.
+	BlockPoolStats getStats(unsigned int sizeClass) const {
+		if(sizeClass == 0) return small.getStats();
+		if(sizeClass == 1) return medium.getStats();
+		return large.getStats();
+	}
+};
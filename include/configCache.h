@@ -0,0 +1,161 @@
+/**
+ * @file configCache.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the ConfigCache class, which keeps a configuration struct in RAM and writes it behind.
+ *
+ * The struct is loaded from its file once. Changes go to the copy in RAM, and only the fields that really
+ * changed are marked dirty, so setting a value to what it already is costs nothing. The dirty struct is
+ * written in one go once it has been dirty for CONFIG_FLUSH_MS, so a burst of changes costs one file write,
+ * and flush writes it right away, e.g. before a restart.
+ * The files are JSON, read and written through the tables of configSchema.h,
+ * and kept in two slots, so a reset during a write leaves the previous copy, see slotFile.h.
+ *
+ * The filesystem is a template parameter with the interface of LittleFS
+ * (open, remove), so a fake filesystem can be used in a native environment.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+#include "configSchema.h"
+#include "slotFile.h"
+
+// The longest time in milliseconds a change stays in RAM only.
+#ifndef CONFIG_FLUSH_MS
+#define CONFIG_FLUSH_MS 30000
+#endif
+
+namespace loc {
+
+	/**
+	 * @brief A configuration struct cached in RAM, with dirty tracking and delayed writes.
+	 * @tparam T The configuration struct.
+	 * @tparam FS The filesystem type, with the LittleFS interface.
+	 */
+	template <typename T, typename FS>
+	class ConfigCache {
+		FS& fs;
+		const char* path;
+		const cfg::Field* fields;
+		uint8_t fieldCount;
+
+		T value;
+
+		/// @brief The bits of the fields changed since the last write, by their index in the table.
+		uint32_t dirty = 0;
+		/// @brief The time at which update first saw the changes, 0 if not yet.
+		unsigned long long dirtySince = 0;
+
+		unsigned long writes = 0;
+		unsigned long changes = 0;
+	public:
+		/**
+		 * @param fs The filesystem.
+		 * @param path The path of the file, has to outlive the cache.
+		 * @param fields The table of the fields of the struct, at most 32.
+		 * @param defaults The value until a file is loaded.
+		 */
+		template <size_t N>
+		ConfigCache(FS& fs, const char* path, const cfg::Field (&fields)[N], const T& defaults = T())
+			: fs(fs), path(path), fields(fields), fieldCount(N), value(defaults) {
+			static_assert(N <= 32, "A struct can have at most 32 fields");
+		}
+
+		/**
+		 * @brief Loads the struct from the newest valid copy of its file, dropping the changes not yet written.
+		 * @param error Set to the reason the last copy tried was not loaded. Can be nullptr.
+		 * @return 0 on success, -1 if there is no valid copy of the file, the value is kept then.
+		 */
+		int load(cfg::ConfigError* error = nullptr) {
+			T loaded = value;
+			const int result = loadSlots(fs, path, [&](auto& source) {
+				cfg::ConfigReader<typename std::remove_reference<decltype(source)>::type> reader(source);
+				loaded = value;
+				const int read = reader.readObject(fields, fieldCount, (uint8_t*)&loaded);
+				if(error != nullptr) *error = reader.error;
+				return read;
+			});
+			if(result != 0) return -1;
+			value = loaded;
+			dirty = 0;
+			dirtySince = 0;
+			return 0;
+		}
+
+		/// @brief The cached value, with the changes not yet written.
+		const T& get() const {
+			return value;
+		}
+
+		/**
+		 * @brief Changes the cached value. Only the fields that differ from the cached ones are marked dirty.
+		 * @param next The new value.
+		 * @return The bits of the fields that changed, 0 if nothing did.
+		 */
+		uint32_t set(const T& next) {
+			uint32_t changed = 0;
+			for(uint8_t i = 0; i < fieldCount; i++) {
+				const cfg::Field& field = fields[i];
+				if(!cfg::fieldEqual(field, (const uint8_t*)&value + field.offset, (const uint8_t*)&next + field.offset)) {
+					changed |= 1UL << i;
+				}
+			}
+			if(changed == 0) return 0;
+			value = next;
+			dirty |= changed;
+			changes++;
+			return changed;
+		}
+
+		/**
+		 * @brief Writes the struct to its file if it has changed.
+		 * @return 0 on success, -1 on failure, the changes stay dirty then, and the file keeps its previous copy.
+		 */
+		int flush() {
+			if(dirty == 0) return 0;
+			const int result = saveSlots(fs, path, [&](auto& sink) {
+				cfg::ConfigWriter<typename std::remove_reference<decltype(sink)>::type> writer(sink);
+				writer.object(fields, fieldCount, (const uint8_t*)&value);
+			});
+			if(result != 0) return -1;
+			writes++;
+			dirty = 0;
+			dirtySince = 0;
+			return 0;
+		}
+
+		/**
+		 * @brief Writes the changes out once they are CONFIG_FLUSH_MS old. Called from the main loop.
+		 * @param now The current time in milliseconds.
+		 * @return 0 on success, -1 if writing failed, it is tried again CONFIG_FLUSH_MS later.
+		 */
+		int update(unsigned long long now) {
+			if(dirty == 0) return 0;
+			if(dirtySince == 0) {
+				dirtySince = now == 0 ? 1 : now;
+				return 0;
+			}
+			if(now - dirtySince < CONFIG_FLUSH_MS) return 0;
+			if(flush() == 0) return 0;
+			dirtySince = now == 0 ? 1 : now;
+			return -1;
+		}
+
+		/// @brief The bits of the fields changed since the last write, by their index in the table.
+		uint32_t getDirty() const {
+			return dirty;
+		}
+
+		/// @brief The number of times the file has been written.
+		unsigned long getWrites() const {
+			return writes;
+		}
+
+		/// @brief The number of set calls that changed something.
+		unsigned long getChanges() const {
+			return changes;
+		}
+	};
+}
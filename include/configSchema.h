@@ -0,0 +1,718 @@
+/**
+ * @file configSchema.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains a streaming JSON reader, which loads configuration files straight into their structs.
+ *
+ * The loaders in configuration.h parse a whole file into a JsonDocument first, and then look up every key in it.
+ * Here every struct is described by a table of fields instead: the key, the type and the position of the member.
+ * The reader goes through the JSON once and stores every value as soon as its key is known,
+ * so it needs a few dozen bytes of state however long the file is, and no JsonDocument at all.
+ * Unknown keys are skipped. A failure is reported with its reason, its position in the file and the key being read.
+ * The same tables write the structs back as JSON, and tell which fields differ between two copies.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdio.h>
+#include <math.h>
+#include "configuration.h"
+
+// Maximum length of a key or an enum name, including the null terminator. Longer keys are skipped as unknown.
+#ifndef CONFIG_KEY_SIZE
+#define CONFIG_KEY_SIZE 32
+#endif
+
+// Maximum nesting of objects and arrays, also in skipped values.
+#ifndef CONFIG_NESTING_LIMIT
+#define CONFIG_NESTING_LIMIT 10
+#endif
+
+// Number of bytes read from the source at once.
+#ifndef CONFIG_READ_SIZE
+#define CONFIG_READ_SIZE 32
+#endif
+
+// Describes a member of a struct as a field of the given type.
+#define CFG_FIELD(Struct, member, key, type, required) \
+	{key, type, required, offsetof(Struct, member), sizeof(Struct::member), 0, nullptr}
+
+// Describes an array of strings, e.g. char member[3][64]. Extra elements in the file are skipped.
+#define CFG_STRING_ARRAY(Struct, member, key, required) \
+	{key, cfg::FieldType::STRING_ARRAY, required, offsetof(Struct, member), sizeof(Struct::member[0]), \
+	sizeof(Struct::member) / sizeof(Struct::member[0]), nullptr}
+
+// Describes an enum stored as a string, the value is the index of the name in names, compared ignoring case.
+#define CFG_ENUM(Struct, member, key, required, names) \
+	{key, cfg::FieldType::ENUM, required, offsetof(Struct, member), sizeof(Struct::member), \
+	sizeof(names) / sizeof(names[0]), names}
+
+// Describes a nested struct stored as an object, with its own table of fields.
+#define CFG_OBJECT(Struct, member, key, required, fields) \
+	{key, cfg::FieldType::OBJECT, required, offsetof(Struct, member), sizeof(Struct::member), \
+	sizeof(fields) / sizeof(fields[0]), fields}
+
+namespace cfg {
+
+	/// @brief The JSON types of the fields, and how they are stored.
+	enum class FieldType : uint8_t {
+		BOOL, // true or false, into a bool
+		UNSIGNED, // an integer, into an unsigned integer of 1, 2, 4 or 8 bytes, checked for range
+		SIGNED, // an integer, into a signed integer of 1, 2, 4 or 8 bytes, checked for range
+		FLOAT, // a number, into a float or a double
+		STRING, // a string, into a char array, truncated to fit
+		STRING_ARRAY, // an array of strings, into a two dimensional char array
+		ENUM, // a string out of a list of names, into an integer or an enum
+		OBJECT // an object, into a nested struct
+	};
+
+	/// @brief Describes a member of a struct and its key in the JSON. Use the CFG_ macros to fill it in.
+	struct Field {
+		const char* key;
+		FieldType type;
+		/// @brief Loading fails without the field.
+		bool required;
+		/// @brief Position of the member in the struct.
+		uint16_t offset;
+		/// @brief Size of the member, of one element for STRING_ARRAY.
+		uint16_t size;
+		/// @brief Number of the elements of STRING_ARRAY, the names of ENUM or the fields of OBJECT.
+		uint8_t count;
+		/// @brief The names of ENUM, as const char* const[], or the fields of OBJECT, as const Field[].
+		const void* table;
+	};
+
+	/// @brief Why loading a configuration failed, and where.
+	struct ConfigError {
+		enum Code : uint8_t {
+			NONE,
+			SYNTAX, // not valid JSON
+			INCOMPLETE, // the file ended in the middle
+			TOO_DEEP, // nested deeper than CONFIG_NESTING_LIMIT
+			WRONG_TYPE, // the value does not have the type of its field
+			OUT_OF_RANGE, // the number does not fit into its field
+			UNKNOWN_VALUE, // the string is not one of the names of its enum
+			MISSING_FIELD // a required field is not there
+		};
+		Code code = NONE;
+		/// @brief Number of bytes read before the error, the position of the offending character.
+		uint32_t position = 0;
+		/// @brief Key of the field being read, or missing. nullptr if the error is not in a known field.
+		const char* key = nullptr;
+
+		const char* c_str() const {
+			static const char* const names[] = {
+				"None", "Syntax", "Incomplete", "TooDeep", "WrongType", "OutOfRange", "UnknownValue", "MissingField"
+			};
+			return names[code];
+		}
+	};
+
+	/**
+	 * @brief Single pass JSON reader, which stores the values into a struct according to its fields.
+	 * @tparam Source Type with `size_t read(uint8_t*, size_t)`, e.g. a File.
+	 */
+	template <typename Source>
+	class ConfigReader {
+		Source& source;
+		uint8_t buffer[CONFIG_READ_SIZE];
+		uint8_t buffered = 0;
+		uint8_t index = 0;
+		/// @brief The current character, -1 at the end.
+		int current = -1;
+		/// @brief Number of characters before the current one.
+		uint32_t position = 0;
+		uint8_t depth = 0;
+		/// @brief The key of the field being read.
+		const char* key = nullptr;
+
+		void advance() {
+			if(current >= 0) position++;
+			if(index == buffered) {
+				buffered = source.read(buffer, sizeof(buffer));
+				index = 0;
+				if(buffered == 0) {
+					current = -1;
+					return;
+				}
+			}
+			current = buffer[index++];
+		}
+
+		int fail(ConfigError::Code code) {
+			if(error.code == ConfigError::NONE) {
+				error.code = code;
+				error.position = position;
+				error.key = key;
+			}
+			return -1;
+		}
+
+		/// @brief Fails as SYNTAX, or as INCOMPLETE at the end.
+		int failSyntax() {
+			return fail(current < 0 ? ConfigError::INCOMPLETE : ConfigError::SYNTAX);
+		}
+
+		void skipSpace() {
+			while(current == ' ' || current == '\t' || current == '\n' || current == '\r') advance();
+		}
+
+		int expect(char c) {
+			skipSpace();
+			if(current != c) return failSyntax();
+			advance();
+			return 0;
+		}
+
+		int hexDigit() {
+			const int c = current;
+			advance();
+			if(c >= '0' && c <= '9') return c - '0';
+			if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+			if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+			return -1;
+		}
+
+		/**
+		 * @brief Reads a string, at the opening quote.
+		 * @param out The buffer for the string, null terminated and truncated to fit. Can be nullptr to skip the string.
+		 * @param size The size of the buffer.
+		 * @return The full length of the string, -1 on error.
+		 */
+		long readString(char* out, size_t size) {
+			advance();
+			size_t length = 0;
+			while(current != '"') {
+				if(current < 0x20) return failSyntax();
+				char utf8[3];
+				uint8_t count = 1;
+				if(current == '\\') {
+					advance();
+					switch(current) {
+						case '"': case '\\': case '/': utf8[0] = current; break;
+						case 'b': utf8[0] = '\b'; break;
+						case 'f': utf8[0] = '\f'; break;
+						case 'n': utf8[0] = '\n'; break;
+						case 'r': utf8[0] = '\r'; break;
+						case 't': utf8[0] = '\t'; break;
+						case 'u': {
+							advance();
+							unsigned int code = 0;
+							for(int i = 0; i < 4; i++) {
+								const int digit = hexDigit();
+								if(digit < 0) return failSyntax();
+								code = code << 4 | digit;
+							}
+							// characters outside the basic multilingual plane are kept as their two surrogates
+							if(code < 0x80) {
+								utf8[0] = code;
+							} else if(code < 0x800) {
+								utf8[0] = 0xC0 | code >> 6;
+								utf8[1] = 0x80 | (code & 0x3F);
+								count = 2;
+							} else {
+								utf8[0] = 0xE0 | code >> 12;
+								utf8[1] = 0x80 | (code >> 6 & 0x3F);
+								utf8[2] = 0x80 | (code & 0x3F);
+								count = 3;
+							}
+							// the hex digits have been consumed already
+							for(uint8_t i = 0; i < count; i++, length++) {
+								if(out != nullptr && length + 1 < size) out[length] = utf8[i];
+							}
+							continue;
+						}
+						default: return failSyntax();
+					}
+				} else {
+					utf8[0] = current;
+				}
+				advance();
+				for(uint8_t i = 0; i < count; i++, length++) {
+					if(out != nullptr && length + 1 < size) out[length] = utf8[i];
+				}
+			}
+			advance();
+			if(out != nullptr && size > 0) out[length < size ? length : size - 1] = '\0';
+			return length;
+		}
+
+		/// @brief Reads a number into a buffer, null terminated. @return Whether it is an integer, -1 on error.
+		int readNumber(char* out, size_t size) {
+			size_t length = 0;
+			bool integer = true;
+			while((current >= '0' && current <= '9') || current == '-' || current == '+'
+				|| current == '.' || current == 'e' || current == 'E') {
+				if(current == '.' || current == 'e' || current == 'E') integer = false;
+				if(length + 1 >= size) return fail(ConfigError::OUT_OF_RANGE);
+				out[length++] = current;
+				advance();
+			}
+			out[length] = '\0';
+			if(length == 0) return failSyntax();
+			return integer;
+		}
+
+		int readLiteral(const char* word) {
+			for(; *word != '\0'; word++) {
+				if(current != *word) return failSyntax();
+				advance();
+			}
+			return 0;
+		}
+
+		/// @brief Skips a value of any type.
+		int skipValue() {
+			skipSpace();
+			if(current == '"') return readString(nullptr, 0) < 0 ? -1 : 0;
+			if(current == 't') return readLiteral("true");
+			if(current == 'f') return readLiteral("false");
+			if(current == 'n') return readLiteral("null");
+			if(current == '{' || current == '[') {
+				const char close = current == '{' ? '}' : ']';
+				if(++depth > CONFIG_NESTING_LIMIT) return fail(ConfigError::TOO_DEEP);
+				advance();
+				skipSpace();
+				if(current == close) {
+					advance();
+					depth--;
+					return 0;
+				}
+				while(true) {
+					if(close == '}') {
+						skipSpace();
+						if(current != '"' || readString(nullptr, 0) < 0 || expect(':') != 0) return failSyntax();
+					}
+					if(skipValue() != 0) return -1;
+					skipSpace();
+					if(current == ',') {
+						advance();
+						continue;
+					}
+					if(current != close) return failSyntax();
+					advance();
+					depth--;
+					return 0;
+				}
+			}
+			char number[24];
+			return readNumber(number, sizeof(number)) < 0 ? -1 : 0;
+		}
+
+		static void storeInteger(uint8_t* member, uint16_t size, uint64_t value) {
+			switch(size) {
+				case 1: { const uint8_t v = value; memcpy(member, &v, 1); break; }
+				case 2: { const uint16_t v = value; memcpy(member, &v, 2); break; }
+				case 4: { const uint32_t v = value; memcpy(member, &v, 4); break; }
+				default: memcpy(member, &value, 8); break;
+			}
+		}
+
+		int readInteger(const Field& field, uint8_t* member) {
+			if(current != '-' && (current < '0' || current > '9')) return fail(ConfigError::WRONG_TYPE);
+			char number[24];
+			const int integer = readNumber(number, sizeof(number));
+			if(integer < 0) return -1;
+			if(integer == 0) return fail(ConfigError::WRONG_TYPE);
+			char* end;
+			errno = 0;
+			const int bits = field.size * 8;
+			if(field.type == FieldType::UNSIGNED) {
+				if(number[0] == '-') return fail(ConfigError::OUT_OF_RANGE);
+				const unsigned long long value = strtoull(number, &end, 10);
+				if(*end != '\0') return failSyntax();
+				if(errno == ERANGE || (bits < 64 && value >> bits != 0)) return fail(ConfigError::OUT_OF_RANGE);
+				storeInteger(member, field.size, value);
+			} else {
+				const long long value = strtoll(number, &end, 10);
+				if(*end != '\0') return failSyntax();
+				if(errno == ERANGE || (bits < 64 && (value < -(1LL << (bits - 1)) || value >= (1LL << (bits - 1))))) {
+					return fail(ConfigError::OUT_OF_RANGE);
+				}
+				storeInteger(member, field.size, value);
+			}
+			return 0;
+		}
+
+		int readValue(const Field& field, uint8_t* member) {
+			skipSpace();
+			switch(field.type) {
+				case FieldType::BOOL: {
+					if(current != 't' && current != 'f') return fail(ConfigError::WRONG_TYPE);
+					const bool value = current == 't';
+					if(readLiteral(value ? "true" : "false") != 0) return -1;
+					*(bool*)member = value;
+					return 0;
+				}
+				case FieldType::UNSIGNED:
+				case FieldType::SIGNED:
+					return readInteger(field, member);
+				case FieldType::FLOAT: {
+					if(current != '-' && (current < '0' || current > '9')) return fail(ConfigError::WRONG_TYPE);
+					char number[32];
+					if(readNumber(number, sizeof(number)) < 0) return -1;
+					char* end;
+					const double value = strtod(number, &end);
+					if(*end != '\0') return failSyntax();
+					if(field.size == sizeof(float)) {
+						const float f = value;
+						memcpy(member, &f, sizeof(f));
+					} else {
+						memcpy(member, &value, sizeof(value));
+					}
+					return 0;
+				}
+				case FieldType::STRING:
+					if(current != '"') return fail(ConfigError::WRONG_TYPE);
+					return readString((char*)member, field.size) < 0 ? -1 : 0;
+				case FieldType::STRING_ARRAY: {
+					if(current != '[') return fail(ConfigError::WRONG_TYPE);
+					advance();
+					skipSpace();
+					if(current == ']') {
+						advance();
+						return 0;
+					}
+					for(unsigned int i = 0; ; i++) {
+						skipSpace();
+						if(current != '"') return fail(ConfigError::WRONG_TYPE);
+						char* element = i < field.count ? (char*)member + i * field.size : nullptr;
+						if(readString(element, field.size) < 0) return -1;
+						skipSpace();
+						if(current == ',') {
+							advance();
+							continue;
+						}
+						if(current != ']') return failSyntax();
+						advance();
+						return 0;
+					}
+				}
+				case FieldType::ENUM: {
+					if(current != '"') return fail(ConfigError::WRONG_TYPE);
+					char name[CONFIG_KEY_SIZE];
+					const long length = readString(name, sizeof(name));
+					if(length < 0) return -1;
+					const char* const* names = (const char* const*)field.table;
+					for(uint8_t i = 0; i < field.count && length < (long)sizeof(name); i++) {
+						if(strcasecmp(name, names[i]) == 0) {
+							storeInteger(member, field.size, i);
+							return 0;
+						}
+					}
+					return fail(ConfigError::UNKNOWN_VALUE);
+				}
+				case FieldType::OBJECT:
+					if(current != '{') return fail(ConfigError::WRONG_TYPE);
+					return readObject((const Field*)field.table, field.count, member);
+			}
+			return fail(ConfigError::WRONG_TYPE);
+		}
+	public:
+		ConfigError error;
+
+		explicit ConfigReader(Source& source) : source(source) {
+			advance();
+		}
+
+		/**
+		 * @brief Reads an object into a struct.
+		 * @param fields The fields of the struct, at most 32.
+		 * @param count The number of fields.
+		 * @param target The struct.
+		 * @param seen Set to the bits of the fields that were in the object, by their index. Can be nullptr.
+		 * @return 0 on success, -1 on failure, see error.
+		 */
+		int readObject(const Field* fields, uint8_t count, uint8_t* target, uint32_t* seen = nullptr) {
+			const char* outerKey = key;
+			key = nullptr;
+			if(expect('{') != 0) return -1;
+			if(++depth > CONFIG_NESTING_LIMIT) return fail(ConfigError::TOO_DEEP);
+			uint32_t found = 0;
+			skipSpace();
+			if(current == '}') {
+				advance();
+			} else {
+				while(true) {
+					skipSpace();
+					if(current != '"') return failSyntax();
+					char name[CONFIG_KEY_SIZE];
+					const long length = readString(name, sizeof(name));
+					if(length < 0 || expect(':') != 0) return -1;
+					const Field* field = nullptr;
+					for(uint8_t i = 0; i < count && length < (long)sizeof(name); i++) {
+						if(strcmp(name, fields[i].key) == 0) {
+							field = &fields[i];
+							found |= 1UL << i;
+							break;
+						}
+					}
+					if(field != nullptr) {
+						key = field->key;
+						if(readValue(*field, target + field->offset) != 0) return -1;
+						key = nullptr;
+					} else if(skipValue() != 0) {
+						return -1;
+					}
+					skipSpace();
+					if(current == ',') {
+						advance();
+						continue;
+					}
+					if(current != '}') return failSyntax();
+					advance();
+					break;
+				}
+			}
+			for(uint8_t i = 0; i < count; i++) {
+				if(fields[i].required && (found & 1UL << i) == 0) {
+					key = fields[i].key;
+					return fail(ConfigError::MISSING_FIELD);
+				}
+			}
+			depth--;
+			key = outerKey;
+			if(seen != nullptr) *seen = found;
+			return 0;
+		}
+	};
+
+	/**
+	 * @brief Loads a configuration from JSON into a struct, in a single pass.
+	 * The values are read into a copy, so the struct is only changed if the whole file is valid.
+	 * @param source Where to read the JSON from, with `size_t read(uint8_t*, size_t)`, e.g. a File.
+	 * @param fields The table of the fields of the struct, at most 32.
+	 * @param target The struct to load into.
+	 * @param error Set to the reason of a failure. Can be nullptr.
+	 * @param seen Set to the bits of the fields that were in the file, by their index. Can be nullptr.
+	 * @return 0 on success, -1 on failure.
+	 */
+	template <typename T, typename Source, size_t N>
+	int readConfig(Source& source, const Field (&fields)[N], T& target, ConfigError* error = nullptr, uint32_t* seen = nullptr) {
+		static_assert(N <= 32, "A struct can have at most 32 fields");
+		ConfigReader<Source> reader(source);
+		T loaded = target;
+		const int result = reader.readObject(fields, N, (uint8_t*)&loaded, seen);
+		if(error != nullptr) *error = reader.error;
+		if(result != 0) return -1;
+		target = loaded;
+		return 0;
+	}
+
+	/// @brief Writes a struct as JSON according to its fields, counting the bytes on the way.
+	/// @tparam Sink Type with `size_t write(const uint8_t*, size_t)`, e.g. a File.
+	template <typename Sink>
+	class ConfigWriter {
+		Sink& sink;
+
+		void text(const char* data, size_t count) {
+			if(sink.write((const uint8_t*)data, count) != count) failed = true;
+			length += count;
+		}
+
+		void text(const char* data) {
+			text(data, strlen(data));
+		}
+
+		void string(const char* value, size_t size) {
+			text("\"", 1);
+			for(size_t i = 0; i < size && value[i] != '\0'; i++) {
+				const char c = value[i];
+				if(c == '"' || c == '\\') {
+					const char escaped[2] = {'\\', c};
+					text(escaped, 2);
+				} else if((uint8_t)c < 0x20) {
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					text(escaped);
+				} else {
+					text(&c, 1);
+				}
+			}
+			text("\"", 1);
+		}
+
+		static uint64_t loadInteger(const uint8_t* member, uint16_t size) {
+			switch(size) {
+				case 1: { uint8_t v; memcpy(&v, member, 1); return v; }
+				case 2: { uint16_t v; memcpy(&v, member, 2); return v; }
+				case 4: { uint32_t v; memcpy(&v, member, 4); return v; }
+				default: { uint64_t v; memcpy(&v, member, 8); return v; }
+			}
+		}
+
+		void value(const Field& field, const uint8_t* member) {
+			char number[32];
+			switch(field.type) {
+				case FieldType::BOOL:
+					text(*(const bool*)member ? "true" : "false");
+					break;
+				case FieldType::UNSIGNED:
+					snprintf(number, sizeof(number), "%llu", (unsigned long long)loadInteger(member, field.size));
+					text(number);
+					break;
+				case FieldType::SIGNED: {
+					// sign extended from the size of the member
+					const int shift = 64 - field.size * 8;
+					const long long value = (long long)(loadInteger(member, field.size) << shift) >> shift;
+					snprintf(number, sizeof(number), "%lld", value);
+					text(number);
+					break;
+				}
+				case FieldType::FLOAT: {
+					double value;
+					if(field.size == sizeof(float)) {
+						float f;
+						memcpy(&f, member, sizeof(f));
+						value = f;
+					} else {
+						memcpy(&value, member, sizeof(value));
+					}
+					// JSON has no infinity or NaN
+					if(!isfinite(value)) value = 0;
+					snprintf(number, sizeof(number), field.size == sizeof(float) ? "%.9g" : "%.17g", value);
+					text(number);
+					break;
+				}
+				case FieldType::STRING:
+					string((const char*)member, field.size);
+					break;
+				case FieldType::STRING_ARRAY:
+					text("[", 1);
+					for(uint8_t i = 0; i < field.count; i++) {
+						if(i > 0) text(",", 1);
+						string((const char*)member + i * field.size, field.size);
+					}
+					text("]", 1);
+					break;
+				case FieldType::ENUM: {
+					const uint64_t index = loadInteger(member, field.size);
+					const char* const* names = (const char* const*)field.table;
+					string(index < field.count ? names[index] : "", CONFIG_KEY_SIZE);
+					break;
+				}
+				case FieldType::OBJECT:
+					object((const Field*)field.table, field.count, member);
+					break;
+			}
+		}
+	public:
+		size_t length = 0;
+		bool failed = false;
+
+		explicit ConfigWriter(Sink& sink) : sink(sink) {}
+
+		/// @brief Writes a struct as an object with all of its fields.
+		void object(const Field* fields, uint8_t count, const uint8_t* source) {
+			text("{", 1);
+			for(uint8_t i = 0; i < count; i++) {
+				if(i > 0) text(",", 1);
+				string(fields[i].key, CONFIG_KEY_SIZE);
+				text(":", 1);
+				value(fields[i], source + fields[i].offset);
+			}
+			text("}", 1);
+		}
+	};
+
+	/**
+	 * @brief Writes a struct as JSON, which readConfig reads back.
+	 * @param sink Where to write, with `size_t write(const uint8_t*, size_t)`, e.g. a File.
+	 * @param fields The table of the fields of the struct.
+	 * @param source The struct.
+	 * @return The number of bytes written, 0 on a write error.
+	 */
+	template <typename T, typename Sink, size_t N>
+	size_t writeConfig(Sink& sink, const Field (&fields)[N], const T& source) {
+		ConfigWriter<Sink> writer(sink);
+		writer.object(fields, N, (const uint8_t*)&source);
+		return writer.failed ? 0 : writer.length;
+	}
+
+	/// @brief Compares a member of two structs, strings only up to their null terminators.
+	inline bool fieldEqual(const Field& field, const uint8_t* a, const uint8_t* b) {
+		switch(field.type) {
+			case FieldType::STRING:
+				return strncmp((const char*)a, (const char*)b, field.size) == 0;
+			case FieldType::STRING_ARRAY:
+				for(uint8_t i = 0; i < field.count; i++) {
+					if(strncmp((const char*)a + i * field.size, (const char*)b + i * field.size, field.size) != 0) return false;
+				}
+				return true;
+			case FieldType::OBJECT: {
+				const Field* children = (const Field*)field.table;
+				for(uint8_t i = 0; i < field.count; i++) {
+					if(!fieldEqual(children[i], a + children[i].offset, b + children[i].offset)) return false;
+				}
+				return true;
+			}
+			default:
+				return memcmp(a, b, field.size) == 0;
+		}
+	}
+
+	static const char* const networkTypeNames[] = {"dhcp", "static"};
+
+	static const Field networkStaticFields[] = {
+		CFG_FIELD(NetworkConfigFile::Static, ip, "ip", FieldType::STRING, true),
+		CFG_FIELD(NetworkConfigFile::Static, mask, "mask", FieldType::STRING, true),
+		CFG_FIELD(NetworkConfigFile::Static, gateway, "gateway", FieldType::STRING, true),
+		CFG_STRING_ARRAY(NetworkConfigFile::Static, sntp, "sntp", true)
+	};
+
+	/// @brief The fields of NetworkConfigFile. The "static" object is required with the static type, see readNetworkConfig.
+	static const Field networkFields[] = {
+		CFG_FIELD(NetworkConfigFile, mdns, "mdns", FieldType::STRING, true),
+		CFG_ENUM(NetworkConfigFile, type, "type", true, networkTypeNames),
+		CFG_OBJECT(NetworkConfigFile, static_config, "static", false, networkStaticFields)
+	};
+
+	/// @brief The fields of ServerConfigFile.
+	static const Field serverFields[] = {
+		CFG_FIELD(ServerConfigFile, https_enabled, "https_enabled", FieldType::BOOL, true),
+		CFG_FIELD(ServerConfigFile, username, "username", FieldType::STRING, true),
+		CFG_FIELD(ServerConfigFile, pass, "pass", FieldType::STRING, true)
+	};
+
+	/// @brief The fields of UserConfigFile.
+	static const Field userFields[] = {
+		CFG_FIELD(UserConfigFile, username, "username", FieldType::STRING, true),
+		CFG_FIELD(UserConfigFile, pass, "pass", FieldType::STRING, true)
+	};
+
+	/// @brief The fields of BatterySettings.
+	static const Field batteryFields[] = {
+		CFG_FIELD(BatterySettings, voltage_high, "voltage_high", FieldType::FLOAT, true),
+		CFG_FIELD(BatterySettings, voltage_low, "voltage_low", FieldType::FLOAT, true),
+		CFG_FIELD(BatterySettings, capacity, "capacity", FieldType::UNSIGNED, true),
+		CFG_FIELD(BatterySettings, charge, "charge", FieldType::UNSIGNED, true),
+		CFG_FIELD(BatterySettings, temperature_high, "temperature_high", FieldType::FLOAT, true),
+		CFG_FIELD(BatterySettings, temperature_low, "temperature_low", FieldType::FLOAT, true)
+	};
+
+	/**
+	 * @brief Loads a network configuration, as loadNetworkConfigFileFromJSON but in a single pass.
+	 * @return 0 on success, -1 on failure, see readConfig.
+	 */
+	template <typename Source>
+	int readNetworkConfig(Source& source, NetworkConfigFile& network_config_file, ConfigError* error = nullptr) {
+		NetworkConfigFile loaded = network_config_file;
+		uint32_t seen = 0;
+		if(readConfig(source, networkFields, loaded, error, &seen) != 0) return -1;
+		// the static addresses are only needed, and only checked, with the static type
+		if(loaded.type == NetworkType::STATIC && (seen & 1UL << 2) == 0) {
+			if(error != nullptr) {
+				error->code = ConfigError::MISSING_FIELD;
+				error->key = networkFields[2].key;
+			}
+			return -1;
+		}
+		network_config_file = loaded;
+		return 0;
+	}
+}
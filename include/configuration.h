@@ -9,6 +9,8 @@
 
 #pragma once
 #include <ArduinoJson.h>
+#include <string.h>
+#include <new>
 #ifdef NATIVE_TEST
 #include <stdio.h>
 #endif
@@ -29,6 +31,8 @@ Preset file format:
 	“run_scheduled”:[
 		{“command”: “READ?\r”, “expect_response”: true}
 	],
+	“batch_once”: false,
+	“batch_scheduled”: true,
 	“task_schedule”:{
 		“period”: 5,
 		“offset”: 1699867392,
@@ -38,18 +42,33 @@ Preset file format:
 		“experiment_id”: “EX2023-12-5”,
 		“experiment_description”: ”Test experiment”,
 		“access_token”: “password123”,
-		“check_certs”: false
+		“check_certs”: false,
+		“binary”: false
 	},
 }
 */
+// Maximum number of commands of a preset, run_once and run_scheduled together.
+#ifndef PRESET_COMMAND_COUNT
+#define PRESET_COMMAND_COUNT 64
+#endif
+
+// Size of the arena holding the texts of all commands of a preset, each with its null terminator.
+#ifndef PRESET_ARENA_SIZE
+#define PRESET_ARENA_SIZE 1024
+#endif
+
 namespace cfg {
-	const int COMMAND_LENGTH = 80;
+	const int COMMAND_LENGTH = 80; // longest command, 79 chars + null terminator
+	static_assert(PRESET_ARENA_SIZE <= 0xFFFF, "Preset arena offsets are 16 bit");
+	static_assert(PRESET_COMMAND_COUNT <= 0xFF, "Preset command counts are 8 bit");
+
+	/// @brief A command of a preset, a view of its text in PresetFile::arena.
 	struct Command {
-		char command[COMMAND_LENGTH] = ""; // 79 chars + null terminator
-		bool expect_response;
+		uint16_t offset = 0; // position of the text in the arena
+		uint8_t length = 0; // length of the text, without the null terminator
+		bool expect_response = false;
 	};
-	const int PRESET_ONCE_COUNT = 10;
-	const int PRESET_SCHEDULED_COUNT = 5;
+
 	struct PresetFile {
 		struct Serial {
 			uint32_t baud_rate = 9600;
@@ -59,9 +78,12 @@ namespace cfg {
 			char EOL[3] = ""; // up to 2 chars + null terminator
 		} serial;
 		uint8_t run_once_count = 0;
-		Command run_once[PRESET_ONCE_COUNT]; // up to 20 commands to run once
 		uint8_t run_scheduled_count = 0;
-		Command run_scheduled[PRESET_SCHEDULED_COUNT]; // up to 20 commands to run periodically
+		Command commands[PRESET_COMMAND_COUNT]; // the run_once commands, followed by the run_scheduled ones
+		uint16_t arena_used = 0; // bytes of the arena taken by the command texts
+		char arena[PRESET_ARENA_SIZE]; // the command texts, packed one after another
+		bool batch_once = false; // send the run_once commands joined with ';' in one round trip
+		bool batch_scheduled = false; // send the run_scheduled commands joined with ';' in one round trip
 		struct TaskSchedule {
 			uint32_t period = 1; // in seconds
 			uint32_t offset = 1; // in seconds, since 1970-01-01 00:00:00
@@ -72,7 +94,124 @@ namespace cfg {
 			char experiment_description[128] = ""; // up to 127 chars + null terminator
 			char access_token[32] = "";// up to 31 chars + null terminator
 			bool check_certs = false; // weather to check server certificates
+			bool binary = false; // upload delta encoded binary batches instead of JSON
 		} http_client;
+
+		/// @brief The commands to run once, run_once_count of them.
+		const Command* run_once() const {
+			return commands;
+		}
+
+		/// @brief The commands to run periodically, run_scheduled_count of them.
+		const Command* run_scheduled() const {
+			return commands + run_once_count;
+		}
+
+		/// @brief The null terminated text of a command of this preset.
+		const char* text(const Command& command) const {
+			return arena + command.offset;
+		}
+
+		/// @brief Removes all commands.
+		void clearCommands() {
+			run_once_count = 0;
+			run_scheduled_count = 0;
+			arena_used = 0;
+		}
+
+		/**
+		 * @brief Adds a command, copying its text into the arena.
+		 * @param text The command, truncated to COMMAND_LENGTH - 1 chars.
+		 * @param expect_response Whether the command is answered.
+		 * @param scheduled Whether the command is run periodically, or once.
+		 * @return 0 on success, -1 if there is no space for the command or its text.
+		 */
+		int addCommand(const char* text, bool expect_response, bool scheduled) {
+			size_t length = strlen(text);
+			if(length > COMMAND_LENGTH - 1) length = COMMAND_LENGTH - 1;
+			if(run_once_count + run_scheduled_count >= PRESET_COMMAND_COUNT) return -1;
+			if(length + 1 > PRESET_ARENA_SIZE - (size_t)arena_used) return -1;
+			Command command;
+			command.offset = arena_used;
+			command.length = length;
+			command.expect_response = expect_response;
+			memcpy(arena + arena_used, text, length);
+			arena[arena_used + length] = '\0';
+			arena_used += length + 1;
+			if(scheduled) {
+				commands[run_once_count + run_scheduled_count++] = command;
+			} else {
+				// the run_scheduled commands move up to make space
+				memmove(commands + run_once_count + 1, commands + run_once_count, run_scheduled_count * sizeof(Command));
+				commands[run_once_count++] = command;
+			}
+			return 0;
+		}
+	};
+
+	/**
+	 * @brief Reference counted handle to a preset on the heap.
+	 * The tasks running a preset each keep a handle, so the preset lives until the last of them ends.
+	 * A handle is the size of a pointer, so it fits into the storage of a task's DataBuffer, and the tasks share one PresetFile.
+	 */
+	class PresetHandle {
+		struct Shared {
+			PresetFile preset;
+			uint16_t references = 1;
+		};
+		Shared* shared = nullptr;
+
+		void release() {
+			if(shared != nullptr && --shared->references == 0) delete shared;
+			shared = nullptr;
+		}
+	public:
+		PresetHandle() {}
+
+		/// @brief Allocates a preset with the default settings and no commands.
+		/// @return The handle, empty if there is not enough memory.
+		static PresetHandle create() {
+			PresetHandle handle;
+			handle.shared = new (std::nothrow) Shared();
+			return handle;
+		}
+
+		PresetHandle(const PresetHandle& other) : shared(other.shared) {
+			if(shared != nullptr) shared->references++;
+		}
+
+		PresetHandle(PresetHandle&& other) : shared(other.shared) {
+			other.shared = nullptr;
+		}
+
+		PresetHandle& operator=(const PresetHandle& other) {
+			if(other.shared != nullptr) other.shared->references++;
+			release();
+			shared = other.shared;
+			return *this;
+		}
+
+		~PresetHandle() {
+			release();
+		}
+
+		/// @brief Whether the handle refers to a preset.
+		explicit operator bool() const {
+			return shared != nullptr;
+		}
+
+		PresetFile& operator*() const {
+			return shared->preset;
+		}
+
+		PresetFile* operator->() const {
+			return &shared->preset;
+		}
+
+		/// @brief The number of handles to the preset, 0 for an empty handle.
+		uint16_t references() const {
+			return shared != nullptr ? shared->references : 0;
+		}
 	};
 
 	int loadPresetFileFromJSON(PresetFile &preset_file, const JsonDocument &jsonDocument);
@@ -191,41 +330,27 @@ namespace cfg {
 			preset_file.http_client.access_token[sizeof(preset_file.http_client.access_token) - 1] = '\0';
 			if(httpc.containsKey("access_token")) preset_file.http_client.check_certs = httpc["check_certs"];
 				else return -1;
+			preset_file.http_client.binary = httpc.containsKey("binary") ? httpc["binary"].as<bool>() : false;
 		} else return -1;
 		
-		// run once
-		if(jsonDocument.containsKey("run_once")) {
-			JsonArrayConst run_once = jsonDocument["run_once"].as<JsonArrayConst>();
-			preset_file.run_once_count = run_once.size() > PRESET_ONCE_COUNT ? PRESET_ONCE_COUNT : run_once.size();
-			unsigned int i;
-			for(i=0;i<preset_file.run_once_count;i++) {
-				auto cmd = run_once[i];
-				if(cmd.containsKey("command")) strncpy(preset_file.run_once[i].command, cmd["command"].as<const char*>(), sizeof(preset_file.run_once[i].command)-1);
-					else return -1;
-				preset_file.run_once[i].command[sizeof(preset_file.run_once[i].command) - 1] = '\0';
-				
-				if(cmd.containsKey("expect_response")) preset_file.run_once[i].expect_response = cmd["expect_response"];
-					else return -1;
+		// run once, then run scheduled
+		preset_file.clearCommands();
+		if(!jsonDocument.containsKey("run_once")) return -1;
+		if(!jsonDocument.containsKey("run_scheduled")) return -1;
+		const char* lists[2] = {"run_once", "run_scheduled"};
+		for(unsigned int list=0;list<2;list++) {
+			JsonArrayConst commands = jsonDocument[lists[list]].as<JsonArrayConst>();
+			for(unsigned int i=0;i<commands.size();i++) {
+				auto cmd = commands[i];
+				const char* text = cmd["command"].as<const char*>();
+				if(text == nullptr || !cmd.containsKey("expect_response")) return -1;
+				if(preset_file.addCommand(text, cmd["expect_response"], list == 1) != 0) return -1;
 			}
-			if(i < PRESET_ONCE_COUNT) preset_file.run_once[i].command[0] = '\0';
-
-		} else return -1;
+		}
 
-		// run scheduled
-		if(jsonDocument.containsKey("run_scheduled")) {
-			JsonArrayConst run_scheduled = jsonDocument["run_scheduled"].as<JsonArrayConst>();
-			preset_file.run_scheduled_count = run_scheduled.size() > PRESET_SCHEDULED_COUNT ? PRESET_SCHEDULED_COUNT : run_scheduled.size();
-			unsigned int i;
-			for(i=0;i<preset_file.run_scheduled_count;i++) {
-				auto cmd = run_scheduled[i];
-				if(cmd.containsKey("command")) strncpy(preset_file.run_scheduled[i].command, run_scheduled[i]["command"], sizeof(preset_file.run_scheduled[i].command)-1);
-					else return -1;
-				preset_file.run_scheduled[i].command[sizeof(preset_file.run_scheduled[i].command) - 1] = '\0';
-				if(cmd.containsKey("expect_response")) preset_file.run_scheduled[i].expect_response = run_scheduled[i]["expect_response"];
-					else return -1;
-			}
-			if(i < PRESET_SCHEDULED_COUNT) preset_file.run_scheduled[i].command[0] = '\0';
-		} else return -1;
+		// batching is optional, older presets send the commands one by one
+		preset_file.batch_once = jsonDocument.containsKey("batch_once") ? jsonDocument["batch_once"].as<bool>() : false;
+		preset_file.batch_scheduled = jsonDocument.containsKey("batch_scheduled") ? jsonDocument["batch_scheduled"].as<bool>() : false;
 		return 0;
 	}
 
@@ -251,24 +376,25 @@ namespace cfg {
 		http_client["experiment_description"] = preset_file.http_client.experiment_description;
 		http_client["access_token"] = preset_file.http_client.access_token;
 		http_client["check_certs"] = preset_file.http_client.check_certs;
+		http_client["binary"] = preset_file.http_client.binary;
 
 		// run once
 		JsonArray run_once = jsonDocument.createNestedArray("run_once");
-		
-		for(unsigned int i=0;i<preset_file.run_once_count && preset_file.run_once[i].command[0]!='\0';i++) {
+		for(unsigned int i=0;i<preset_file.run_once_count;i++) {
 			auto new_cmd = run_once.add();
-			new_cmd["command"] = preset_file.run_once[i].command;
-			new_cmd["expect_response"] = preset_file.run_once[i].expect_response;
+			new_cmd["command"] = preset_file.text(preset_file.run_once()[i]);
+			new_cmd["expect_response"] = preset_file.run_once()[i].expect_response;
 		}
-		
 
 		// run scheduled
 		JsonArray run_scheduled = jsonDocument.createNestedArray("run_scheduled");
-		for(unsigned int i=0;i<preset_file.run_scheduled_count && preset_file.run_scheduled[i].command[0]!='\0';i++) {
+		for(unsigned int i=0;i<preset_file.run_scheduled_count;i++) {
 			auto new_cmd = run_scheduled.add();
-			new_cmd["command"] = preset_file.run_scheduled[i].command;
-			new_cmd["expect_response"] = preset_file.run_scheduled[i].expect_response;
+			new_cmd["command"] = preset_file.text(preset_file.run_scheduled()[i]);
+			new_cmd["expect_response"] = preset_file.run_scheduled()[i].expect_response;
 		}
+		jsonDocument["batch_once"] = preset_file.batch_once;
+		jsonDocument["batch_scheduled"] = preset_file.batch_scheduled;
 		return 0;
 	}
 
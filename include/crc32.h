@@ -0,0 +1,27 @@
+/**
+ * @file crc32.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the CRC-32 used to check the files written by the device.
+ *
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace cfg {
+
+	/// @brief Updates a CRC-32 (reflected, polynomial 0xEDB88320, as in zlib) with more data.
+	/// @param crc The CRC of the data so far, 0 at the start.
+	inline uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length) {
+		crc = ~crc;
+		for(size_t i = 0; i < length; i++) {
+			crc ^= data[i];
+			for(int bit = 0; bit < 8; bit++) {
+				crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+			}
+		}
+		return ~crc;
+	}
+}
@@ -2,32 +2,46 @@
  * @file dataBuffer.h
  * This file contains the DataBuffer class, which is used to store data in a statically allocated buffer.
  * The DataBuffer class can be used to store data of any type, as long as the type is not larger than the buffer.
- * 
+ * The storage itself is in StaticDataBuffer<N, ALIGN>, so buffers of different sizes can be passed around as DataBuffer&,
+ * and DataBufferPool keeps a fixed number of them.
+ * Data too large for the storage of a buffer spills into a block of the BlockAllocator, see blockPool.h,
+ * and the storage holds the pointer to it. The block is freed when the data is torn down.
+ *
  * This header file is microcontroller independent, so it can be used in a native environment.
 */
 
 #include <utility>
 #include <cstdint>
+#include <cstddef>
 #include <type_traits>
 #include <memory>
-
+#include <cstring>
+#include "blockPool.h"
 
 
 #ifndef DATA_BUFFER_H
 #define DATA_BUFFER_H
 
+// The default size of a StaticDataBuffer.
 #ifndef DATA_BUFFER_SIZE
 #define DATA_BUFFER_SIZE 40
 #endif
 
+// The default alignment of the storage of a StaticDataBuffer.
+// Types with a larger alignment still fit, if the buffer has room for the padding.
+#ifndef DATA_BUFFER_ALIGN
+#define DATA_BUFFER_ALIGN 8
+#endif
+
 /**
  * @brief The DataBuffer class is used to store data in a statically allocated buffer.
  * The DataBuffer class can be used to store data of any type, as long as the type is not larger than the buffer.
- * The buffer size is defined by the DATA_BUFFER_SIZE macro.
+ * The storage is provided by StaticDataBuffer, a default constructed DataBuffer has none and can not hold anything.
+ * Data larger than the storage is kept in a block of the shared BlockAllocator instead.
  * When setting the data, a tearDown function will be automatically generated.
  * This function will call the destructor of the data.
  * This function will be called when the buffer is cleared, overriden or deleted.
- * 
+ *
 */
 class DataBuffer {
 public:
@@ -46,7 +60,9 @@ public:
 		DOUBLE_CLEAR_ERR = 2,
 		DESTRUCTOR_WITHOUT_CLEAR_ERR = 4,
 		UNSET_GET_ERR = 8,
-		ALLIGNMENT_ERR = 16
+		ALLIGNMENT_ERR = 16,
+		SIZE_ERR = 32,
+		POOL_ERR = 64
 
 	};
 private:
@@ -55,23 +71,95 @@ private:
 	 */
 	static uint8_t errFlags;
 
+	/// @brief The blocks for data that is too large for the storage of its buffer.
+	static BlockAllocator blocks;
+
 	/// @brief The function to call when the buffer is deleted.
-	void (*tearDown)(DataBuffer& data);
+	void (*tearDown)(DataBuffer& data) = nullptr;
+
+	/// @brief The size of the storage.
+	uint16_t capacity = 0;
+
+	/// @brief The offset of the storage from the start of this object.
+	/// Offsets are used instead of pointers, so the header of a buffer stays small.
+	uint16_t storageOffset = 0;
+
+	/// @brief The offset of the data from the start of this object.
+	/// @warning This offset is not initialized until the buffer is set.
+	/// If the storage has the same alignment as the data type,
+	/// this offset will be equal to the storage offset.
+	/// Otherwise, this offset will be larger than the storage offset,
+	/// but within the bounds of the storage.
+	uint16_t alignedOffset = 0;
 
 	/// @brief Indicates if the buffer is set.
 	bool isSet = false;
 
-	/// @brief The buffer to store the data in.
-	alignas(64) uint8_t data[DATA_BUFFER_SIZE];
-
-	/// @brief The pointer to the data in the buffer.
-	/// @warning This pointer is not initialized until the buffer is set.
-	/// If the data buffer has the same alignment as the data type,
-	/// this pointer will be equal to the data pointer.
-	/// Otherwise, this pointer will be larger than the data pointer,
-	/// but within the bounds of the data buffer.
-	void* aligned;
+	/// @brief Indicates if the data is in a block, and the storage holds the pointer to it.
+	bool spilled = false;
+
+	uint8_t* base() {
+		return reinterpret_cast<uint8_t*>(this);
+	}
+
+	/// @brief The data, in the storage or in its block.
+	void* data() {
+		if(spilled) {
+			void* block;
+			memcpy(&block, base() + storageOffset, sizeof(block));
+			return block;
+		}
+		return base() + alignedOffset;
+	}
+
+	/// @brief Finds where data of type T goes, in the storage or else in a block.
+	/// @return The place, or nullptr if there is none, with the error flag set.
+	template <typename T>
+	void* place() {
+		void* tmp_ptr = base() + storageOffset;
+		size_t remaining_size = capacity;
+		void* aligned = std::align(alignof(T), sizeof(T), tmp_ptr, remaining_size);
+		spilled = false;
+		if(aligned != nullptr) {
+			alignedOffset = static_cast<uint8_t*>(aligned) - base();
+			return aligned;
+		}
+		if(capacity < sizeof(void*) || !BlockAllocator::fits<T>()) {
+			errFlags |= sizeof(T) > capacity ? SIZE_ERR : ALLIGNMENT_ERR;
+			return nullptr;
+		}
+		void* block = blocks.allocate(sizeof(T));
+		if(block == nullptr) {
+			errFlags |= POOL_ERR;
+			return nullptr;
+		}
+		memcpy(base() + storageOffset, &block, sizeof(block));
+		spilled = true;
+		return block;
+	}
+protected:
+	/// @brief Sets the storage, called by the constructors of StaticDataBuffer.
+	void setStorage(uint8_t* storage, uint16_t capacity) {
+		storageOffset = storage - base();
+		this->capacity = capacity;
+	}
+
+	/// @brief Tears down data that was never cleared, called by the destructor of StaticDataBuffer.
+	void tearDownLeftover() {
+		if(isSet) {
+			if(tearDown != nullptr) {
+				tearDown(*this);
+			}
+			errFlags |= DESTRUCTOR_WITHOUT_CLEAR_ERR;
+		}
+	}
 public:
+	DataBuffer() = default;
+
+	/// @brief A buffer owns its data, which can be in a block, so it cannot be copied, set a copy of the data instead.
+	DataBuffer(const DataBuffer&) = delete;
+	DataBuffer& operator=(const DataBuffer&) = delete;
+
 	/**
 	 * @brief Function to get the error flags.
 	 * @return The error flags, according to DataBuffer::Error
@@ -87,15 +175,6 @@ public:
 		errFlags = 0;
 	}
 
-	~DataBuffer() {
-		if(isSet) {
-			if(tearDown != nullptr) {
-				tearDown(*this);
-			}
-			errFlags |= DESTRUCTOR_WITHOUT_CLEAR_ERR;
-		}
-	}
-
 	/**
 	 * @brief Function to check if the buffer is set.
 	 * @return True if the buffer is set, false otherwise.
@@ -104,6 +183,21 @@ public:
 		return isSet;
 	}
 
+	/// @brief The size of the storage in bytes.
+	size_t getCapacity() const {
+		return capacity;
+	}
+
+	/// @brief Checks if the data is kept in a block of the BlockAllocator.
+	bool isSpilled() const {
+		return isSet && spilled;
+	}
+
+	/// @brief The blocks shared by all buffers for data too large for their storage, e.g. to read its counters.
+	static BlockAllocator& getBlocks() {
+		return blocks;
+	}
+
 	/**
 	 * @brief Function to get the data in the buffer.
 	 * @tparam T The type of the data to get.
@@ -113,78 +207,52 @@ public:
 	*/
 	template <typename T>
 	T& get() {
-		static_assert(sizeof(T) <= DATA_BUFFER_SIZE, "DataBuffer size is too small");
 		if(!isSet) {
 			errFlags |= UNSET_GET_ERR;
 		}
-		return *reinterpret_cast<T*>(aligned);
+		return *reinterpret_cast<T*>(data());
 	}
 
 	/**
 	 * @brief Function to set the data in the buffer.
 	 * @tparam T The type of the data to set.
-	 * @return A reference to the data in the buffer.
-	 * @warning This function does not check if the buffer is set.
 	 * @warning This function does not check if the type of the data is correct.
+	 * If the data does not fit into the storage, it is kept in a block, and if there is none,
+	 * the buffer stays empty and SIZE_ERR, ALLIGNMENT_ERR or POOL_ERR is set.
 	*/
 	template <typename T>
 	void set(const typename std::remove_reference<T>::type& value) {
 		typedef typename std::remove_reference<T>::type TRaw;
-		//Serial.println("set with copied data");
 		if(isSet) {
 			clear();
 			errFlags |= DOUBLE_SET_ERR;
 		}
-		
-		tearDown = [](DataBuffer& data) {data.unset<T>();};
-		
-		{
-			void* tmp_ptr = data;
-			unsigned int remaining_size = DATA_BUFFER_SIZE;
-			aligned = std::align(alignof(TRaw), sizeof(TRaw), tmp_ptr, remaining_size);
-			if(aligned == nullptr) {
-				errFlags |= ALLIGNMENT_ERR;
-				return;
-			}
-			new (aligned) TRaw(value);
-		}
+		void* target = place<TRaw>();
+		if(target == nullptr) return;
+		tearDown = [](DataBuffer& data) {data.unset<TRaw>();};
+		new (target) TRaw(value);
 		isSet = true;
 	}
 
 	/**
 	 * @brief Function to set the data in the buffer.
 	 * @tparam T The type of the data to set.
-	 * @return A reference to the data in the buffer.
-	 * @warning This function does not check if the buffer is set.
 	 * @warning This function does not check if the type of the data is correct.
+	 * If the data does not fit into the storage, it is kept in a block, and if there is none,
+	 * the buffer stays empty and SIZE_ERR, ALLIGNMENT_ERR or POOL_ERR is set.
 	*/
 	template <typename T>
 	void set(typename std::remove_reference<T>::type&& value) {
-		//Serial.println("set with moved data");
+		typedef typename std::remove_reference<T>::type TRaw;
 		if(isSet) {
 			clear();
 			errFlags |= DOUBLE_SET_ERR;
 		}
-		tearDown = [](DataBuffer& data) {data.unset<T>();};
-		//Serial.println("set with moved data after tearDown");
-		typedef typename std::remove_reference<T>::type TRaw;
-		static_assert(sizeof(T) <= DATA_BUFFER_SIZE, "DataBuffer size is too small");
-		
-		//Serial.println("set with moved data before init");
-		{
-			void* tmp_ptr = data;
-			size_t remaining_size = DATA_BUFFER_SIZE;
-			aligned = std::align(alignof(TRaw), sizeof(TRaw), tmp_ptr, remaining_size);
-			if(aligned == nullptr) {
-				errFlags |= ALLIGNMENT_ERR;
-				return;
-			}
-			new (aligned) TRaw(std::move(value));
-		}
-		
-		//Serial.println("set with moved data after init");
+		void* target = place<TRaw>();
+		if(target == nullptr) return;
+		tearDown = [](DataBuffer& data) {data.unset<TRaw>();};
+		new (target) TRaw(std::move(value));
 		isSet = true;
-		//Serial.println("set with moved data end");
 	}
 
 	/**
@@ -195,7 +263,7 @@ public:
 		if(!isSet) {
 			errFlags |= DOUBLE_CLEAR_ERR;
 		}
-		if(tearDown != nullptr) {
+		if(isSet && tearDown != nullptr) {
 			tearDown(*this);
 		}
 		isSet = false;
@@ -207,7 +275,7 @@ private:
 	 * @tparam T The type of the data to unset.
 	 * @warning This function does not check if the buffer is set.
 	 * @warning This function does not check if the type of the data is correct.
-	 * This function will call the destructor of the data.
+	 * This function will call the destructor of the data, and free its block if it has one.
 	 * It is used by the auto-generated tearDown function.
 	*/
 	template <typename T>
@@ -215,12 +283,148 @@ private:
 		if(!isSet) {
 			errFlags |= DOUBLE_CLEAR_ERR;
 		}
-		static_assert(sizeof(T) <= DATA_BUFFER_SIZE, "DataBuffer size is too small");
-		reinterpret_cast<T*>(aligned)->~T();
+		T* value = reinterpret_cast<T*>(data());
+		value->~T();
+		if(spilled) blocks.free(value);
+		spilled = false;
 		isSet = false;
 	}
 };
 
 inline uint8_t DataBuffer::errFlags = DataBuffer::NO_ERR;
+inline BlockAllocator DataBuffer::blocks;
 
-#endif
\ No newline at end of file
+/**
+ * @brief A DataBuffer with N bytes of storage.
+ * @tparam N The size of the storage.
+ * @tparam ALIGN The alignment of the storage.
+ */
+template <size_t N = DATA_BUFFER_SIZE, size_t ALIGN = DATA_BUFFER_ALIGN>
+class StaticDataBuffer : public DataBuffer {
+	static_assert(N > 0 && N <= 0xFFFF, "A StaticDataBuffer holds 1 to 65535 bytes");
+
+	/// @brief The buffer to store the data in.
+	alignas(ALIGN) uint8_t storage[N];
+public:
+	/// @brief Whether data of type T always fits into the storage, including the padding for its alignment.
+	template <typename T>
+	static constexpr bool fits() {
+		return sizeof(T) + (alignof(T) > ALIGN ? alignof(T) - ALIGN : 0) <= N;
+	}
+
+	/// @brief Whether data of type T can be set, in the storage or in a block.
+	template <typename T>
+	static constexpr bool canHold() {
+		return fits<T>() || (N >= sizeof(void*) && BlockAllocator::fits<T>());
+	}
+
+	StaticDataBuffer() {
+		setStorage(storage, N);
+	}
+
+	StaticDataBuffer(const StaticDataBuffer&) = delete;
+	StaticDataBuffer& operator=(const StaticDataBuffer&) = delete;
+
+	~StaticDataBuffer() {
+		tearDownLeftover();
+	}
+
+	template <typename T>
+	void set(const typename std::remove_reference<T>::type& value) {
+		static_assert(canHold<typename std::remove_reference<T>::type>(), "DataBuffer size is too small, and the data does not fit into a block either");
+		DataBuffer::set<T>(value);
+	}
+
+	template <typename T>
+	void set(typename std::remove_reference<T>::type&& value) {
+		static_assert(canHold<typename std::remove_reference<T>::type>(), "DataBuffer size is too small, and the data does not fit into a block either");
+		DataBuffer::set<T>(std::move(value));
+	}
+};
+
+/**
+ * @brief A fixed number of StaticDataBuffers of the same size, handed out from a free list.
+ * @tparam N The size of every buffer.
+ * @tparam COUNT The number of buffers.
+ */
+template <size_t N, unsigned int COUNT>
+class DataBufferPool {
+	static_assert(COUNT > 0 && COUNT < 0xFFFF, "A DataBufferPool holds 1 to 65534 buffers");
+
+	/// @brief Value of freeHead and nextFree marking the end of the free list.
+	static const uint16_t FREE_LIST_END = 0xFFFF;
+
+	StaticDataBuffer<N> buffers[COUNT];
+
+	/// @brief The free buffer following each free buffer in the free list.
+	uint16_t nextFree[COUNT];
+
+	/// @brief The first free buffer, or FREE_LIST_END if all are taken.
+	uint16_t freeHead;
+
+	/// @brief The number of taken buffers.
+	unsigned int used;
+public:
+	/// @brief Whether data of type T fits into the storage of the buffers of this pool.
+	template <typename T>
+	static constexpr bool fits() {
+		return StaticDataBuffer<N>::template fits<T>();
+	}
+
+	/// @brief Whether data of type T can be set in the buffers of this pool, in their storage or in a block.
+	template <typename T>
+	static constexpr bool canHold() {
+		return StaticDataBuffer<N>::template canHold<T>();
+	}
+
+	DataBufferPool() {
+		reset();
+	}
+
+	/// @brief Marks every buffer as free. The buffers have to be cleared already.
+	void reset() {
+		for(unsigned int i = 0; i < COUNT; i++) {
+			nextFree[i] = i + 1 < COUNT ? i + 1 : FREE_LIST_END;
+		}
+		freeHead = 0;
+		used = 0;
+	}
+
+	/// @brief Takes a free buffer.
+	/// @return The buffer, or nullptr if all are taken.
+	DataBuffer* take() {
+		if(freeHead == FREE_LIST_END) return nullptr;
+		const unsigned int i = freeHead;
+		freeHead = nextFree[i];
+		used++;
+		return &buffers[i];
+	}
+
+	/// @brief Checks if the buffer belongs to this pool.
+	bool owns(const DataBuffer* buffer) const {
+		return buffer >= &buffers[0] && buffer < &buffers[COUNT];
+	}
+
+	/// @brief Returns a buffer taken from this pool. It should be cleared already.
+	/// @return false if the buffer does not belong to this pool.
+	bool give(DataBuffer* buffer) {
+		if(!owns(buffer)) return false;
+		const unsigned int i = static_cast<StaticDataBuffer<N>*>(buffer) - buffers;
+		nextFree[i] = freeHead;
+		freeHead = i;
+		used--;
+		return true;
+	}
+
+	/// @brief The number of taken buffers.
+	unsigned int getUsed() const {
+		return used;
+	}
+
+	/// @brief The number of buffers.
+	static constexpr unsigned int size() {
+		return COUNT;
+	}
+};
+
+#endif
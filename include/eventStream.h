@@ -0,0 +1,153 @@
+/**
+ * @file eventStream.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the EventStream class, which pushes Server-Sent Events to subscribed clients.
+ *
+ * An event is formatted once, and the same buffer is written to every subscribed client.
+ * The client is a template parameter with the Arduino Client interface
+ * (connected, availableForWrite, write, stop), so WiFiClient and WiFiClientSecure
+ * can be used on the microcontroller, and a mock client in a native environment.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// Maximum number of subscribed clients per server.
+#ifndef EVENT_STREAM_CLIENTS
+#define EVENT_STREAM_CLIENTS 4
+#endif
+
+// Maximum length of a formatted event.
+#ifndef EVENT_SIZE
+#define EVENT_SIZE 256
+#endif
+
+namespace events {
+
+	/// @brief Response headers of an event stream, written to the client when it subscribes.
+	static const char HEADERS[] =
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/event-stream\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Connection: keep-alive\r\n"
+		"Access-Control-Allow-Origin: *\r\n"
+		"\r\n";
+
+	/// @brief Appends a string to a JSON string literal, escaping it.
+	/// @return The new length, or size if it does not fit.
+	inline size_t appendEscaped(char* out, size_t size, size_t length, const char* text) {
+		for(; *text != '\0'; text++) {
+			const char c = *text;
+			// control characters, like a stray EOL, are dropped
+			if((uint8_t)c < 0x20) continue;
+			const bool escape = c == '"' || c == '\\';
+			if(length + (escape ? 2 : 1) >= size) return size;
+			if(escape) out[length++] = '\\';
+			out[length++] = c;
+		}
+		return length;
+	}
+
+	/**
+	 * @brief Formats a measurement result as an event.
+	 * The data is a JSON object: {"time":<ms since 1970>,"source":"...","response":"..."}.
+	 * @param out The buffer to write the event to.
+	 * @param size The size of the buffer.
+	 * @param time The time of the result, in milliseconds since 1970-01-01 00:00:00.
+	 * @param source The source of the result, e.g. the experiment id of the preset.
+	 * @param response The response of the instrument.
+	 * @return The length of the event, or 0 if it does not fit into the buffer.
+	 */
+	inline size_t formatSample(char* out, size_t size, unsigned long long time, const char* source, const char* response) {
+		int written = snprintf(out, size, "event: sample\ndata: {\"time\":%llu,\"source\":\"", time);
+		if(written < 0 || (size_t)written >= size) return 0;
+		size_t length = appendEscaped(out, size, written, source);
+		if(length >= size) return 0;
+		written = snprintf(out + length, size - length, "\",\"response\":\"");
+		if(written < 0 || (size_t)written >= size - length) return 0;
+		length = appendEscaped(out, size, length + written, response);
+		if(length >= size) return 0;
+		written = snprintf(out + length, size - length, "\"}\n\n");
+		if(written < 0 || (size_t)written >= size - length) return 0;
+		return length + written;
+	}
+
+	/**
+	 * @brief Set of clients subscribed to Server-Sent Events.
+	 * @tparam Client Type with the Arduino Client interface:
+	 * `uint8_t connected()`, `int availableForWrite()`, `size_t write(const uint8_t*, size_t)` and `void stop()`.
+	 * @tparam SIZE The maximum number of clients.
+	 */
+	template <typename Client, unsigned int SIZE = EVENT_STREAM_CLIENTS>
+	class EventStream {
+		/// @brief The subscribed clients, a slot is free if its client is not connected.
+		Client clients[SIZE];
+
+		/// @brief The number of events not written to a client because its send buffer was full.
+		unsigned long dropped = 0;
+	public:
+		/**
+		 * @brief Subscribes a client and sends it the response headers.
+		 * The connection is kept open, so the client must not be answered in any other way.
+		 * @param client The client of the request, e.g. server.client().
+		 * @return false if all slots are used.
+		 */
+		bool subscribe(Client& client) {
+			for(unsigned int i = 0; i < SIZE; i++) {
+				if(clients[i].connected()) continue;
+				clients[i] = client;
+				clients[i].write((const uint8_t*)HEADERS, sizeof(HEADERS) - 1);
+				return true;
+			}
+			return false;
+		}
+
+		/// @brief The number of connected clients.
+		unsigned int count() {
+			unsigned int count = 0;
+			for(unsigned int i = 0; i < SIZE; i++) {
+				if(clients[i].connected()) count++;
+			}
+			return count;
+		}
+
+		/// @brief The number of events not written to a slow client so far.
+		unsigned long getDropped() const {
+			return dropped;
+		}
+
+		/**
+		 * @brief Writes an event to every connected client.
+		 * A client whose send buffer can not take the whole event misses it,
+		 * so a slow client does not block the loop or receive half an event.
+		 * @param event The formatted event, e.g. from formatSample.
+		 * @param length The length of the event.
+		 * @return The number of clients the event has been written to.
+		 */
+		unsigned int publish(const char* event, size_t length) {
+			unsigned int sent = 0;
+			for(unsigned int i = 0; i < SIZE; i++) {
+				Client& client = clients[i];
+				if(!client.connected()) continue;
+				if((size_t)client.availableForWrite() < length) {
+					dropped++;
+					continue;
+				}
+				client.write((const uint8_t*)event, length);
+				sent++;
+			}
+			return sent;
+		}
+
+		/// @brief Disconnects all clients.
+		void clear() {
+			for(unsigned int i = 0; i < SIZE; i++) {
+				if(clients[i].connected()) clients[i].stop();
+			}
+		}
+	};
+}
@@ -0,0 +1,121 @@
+/**
+ * @file httpPoster.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the HttpPoster class, the HTTP client used by the Uploader on the microcontroller.
+ *
+ * The request is written to a WiFiClient step by step, as the Uploader calls it from the main loop,
+ * instead of with ESP8266HTTPClient, whose POST blocks until the whole response is read.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <ESP8266HTTPClient.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecureBearSSL.h>
+
+// Longest time in milliseconds a connect, including the TLS handshake, may block the main loop.
+#ifndef HTTP_POSTER_CONNECT_TIMEOUT_MS
+#define HTTP_POSTER_CONNECT_TIMEOUT_MS 2000
+#endif
+
+/// @brief Posts a body to a http:// or https:// url, see the Http parameter of Uploader.
+class HttpPoster {
+	/// @brief Whether server certificates are checked, see cfg::PresetFile::HttpClient::check_certs.
+	bool checkCerts = false;
+
+	WiFiClient plainClient;
+	BearSSL::WiFiClientSecure secureClient;
+	/// @brief The client of the post in progress, nullptr if there is none.
+	WiFiClient* client = nullptr;
+
+	/// @brief The start of the response, up to the end of the status line.
+	char statusLine[32];
+	size_t statusLength = 0;
+public:
+	HttpPoster() {
+		// the uploads are small, the default 16 kB receive buffer would not fit next to the web servers
+		secureClient.setBufferSizes(1024, 1024);
+		plainClient.setTimeout(HTTP_POSTER_CONNECT_TIMEOUT_MS);
+		secureClient.setTimeout(HTTP_POSTER_CONNECT_TIMEOUT_MS);
+	}
+
+	/// @brief Sets whether server certificates are checked.
+	/// Checking needs trust anchors, which are not set up yet, so every https post fails with it.
+	void setCheckCerts(bool checkCerts) {
+		this->checkCerts = checkCerts;
+	}
+
+	/**
+	 * @brief Connects to the server of the url and sends the request line and the headers.
+	 * The connect itself blocks for at most HTTP_POSTER_CONNECT_TIMEOUT_MS.
+	 * @param url The url to post to.
+	 * @param authorization The Authorization header, not sent if empty.
+	 * @param contentType The Content-Type header.
+	 * @param length The length of the body.
+	 * @return 1 when connected, a negative HTTPC_ERROR_* code on failure.
+	 */
+	int connect(const char* url, const char* authorization, const char* contentType, size_t length) {
+		stop();
+		const bool secure = strncmp(url, "https://", 8) == 0;
+		if(!secure && strncmp(url, "http://", 7) != 0) return HTTPC_ERROR_CONNECTION_FAILED;
+		const char* host = url + (secure ? 8 : 7);
+		const char* path = strchr(host, '/');
+		if(path == nullptr) path = host + strlen(host);
+		char hostName[64];
+		const char* colon = (const char*)memchr(host, ':', path - host);
+		const size_t hostLength = (colon != nullptr ? colon : path) - host;
+		if(hostLength == 0 || hostLength >= sizeof(hostName)) return HTTPC_ERROR_CONNECTION_FAILED;
+		memcpy(hostName, host, hostLength);
+		hostName[hostLength] = '\0';
+		const uint16_t port = colon != nullptr ? atoi(colon + 1) : (secure ? 443 : 80);
+
+		if(secure) {
+			if(!checkCerts) secureClient.setInsecure();
+			client = &secureClient;
+		} else {
+			client = &plainClient;
+		}
+		if(!client->connect(hostName, port)) {
+			stop();
+			return HTTPC_ERROR_CONNECTION_FAILED;
+		}
+		client->printf("POST %s HTTP/1.1\r\nHost: %.*s\r\nConnection: close\r\nContent-Type: %s\r\nContent-Length: %u\r\n",
+			path[0] == '\0' ? "/" : path, (int)(path - host), host, contentType, (unsigned int)length);
+		if(authorization[0] != '\0') client->printf("Authorization: %s\r\n", authorization);
+		client->print("\r\n");
+		statusLength = 0;
+		return 1;
+	}
+
+	/// @brief Writes as much of the body as fits into the send buffer.
+	/// @return The number of bytes written.
+	size_t write(const uint8_t* data, size_t length) {
+		if(client == nullptr) return 0;
+		const size_t space = client->availableForWrite();
+		return client->write(data, length < space ? length : space);
+	}
+
+	/// @brief Reads what has arrived of the status line.
+	/// @return The HTTP status code once the status line is complete, 0 until then,
+	/// a negative HTTPC_ERROR_* code if the connection was lost.
+	int poll() {
+		if(client == nullptr) return HTTPC_ERROR_NOT_CONNECTED;
+		while(client->available() > 0) {
+			const int c = client->read();
+			if(c == '\n') {
+				statusLine[statusLength] = '\0';
+				// "HTTP/1.1 200 OK"
+				const char* code = strchr(statusLine, ' ');
+				return code != nullptr && atoi(code + 1) > 0 ? atoi(code + 1) : HTTPC_ERROR_NO_HTTP_SERVER;
+			}
+			if(statusLength < sizeof(statusLine) - 1) statusLine[statusLength++] = c;
+		}
+		return client->connected() ? 0 : HTTPC_ERROR_CONNECTION_LOST;
+	}
+
+	/// @brief Closes the connection.
+	void stop() {
+		if(client != nullptr) client->stop();
+		client = nullptr;
+	}
+};
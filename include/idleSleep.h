@@ -0,0 +1,54 @@
+/**
+ * @file idleSleep.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the functions for sleeping in the main loop while the scheduler has nothing to do.
+ *
+ * The sleep is done through a clock object, so the same code runs on the microcontroller,
+ * where the clock wraps time() and delay(), and in a native environment, where a fake clock can be used.
+ * This file is microcontroller independent, so it can be used in a native environment for testing.
+ */
+
+#pragma once
+#include "scheduler.h"
+
+// The longest time in milliseconds the loop sleeps in one go.
+// The web servers are only polled between sleeps, so this bounds the extra HTTP latency.
+// Set to 0 to busy-poll the scheduler.
+#ifndef IDLE_SLEEP_MAX_MS
+#define IDLE_SLEEP_MAX_MS 0
+#endif
+
+namespace idle {
+
+	/// @brief Calculates how long the loop can sleep before the scheduler has something to do.
+	/// @param deadline The next scheduler deadline, see Scheduler::nextDeadline.
+	/// @param now The current scheduler time.
+	/// @param msPerTick The number of milliseconds in one scheduler time unit.
+	/// @param maxSleep The longest allowed sleep in milliseconds.
+	/// @return The sleep time in milliseconds, 0 if the scheduler has work to do.
+	inline unsigned long sleepTime(unsigned long long deadline, unsigned long long now, unsigned long msPerTick, unsigned long maxSleep) {
+		if(deadline <= now) return 0;
+		const unsigned long long ticks = deadline - now;
+		// avoid overflowing the multiplication for far away deadlines
+		if(ticks >= maxSleep / msPerTick + 1) return maxSleep;
+		return ticks * msPerTick;
+	}
+
+	/**
+	 * @brief Sleeps until the next scheduler deadline, or for at most maxSleep milliseconds.
+	 * @tparam Clock Type providing:
+	 * `unsigned long long now()` returning the scheduler time,
+	 * `void sleep(unsigned long ms)` and
+	 * a `msPerTick` member with the number of milliseconds in one scheduler time unit.
+	 * @param scheduler The scheduler to query.
+	 * @param clock The clock to read the time from and to sleep with.
+	 * @param maxSleep The longest allowed sleep in milliseconds.
+	 * @return The time slept in milliseconds.
+	 */
+	template <typename Clock>
+	unsigned long sleepUntilNextTask(const Scheduler& scheduler, Clock& clock, unsigned long maxSleep) {
+		const unsigned long ms = sleepTime(scheduler.nextDeadline(), clock.now(), clock.msPerTick, maxSleep);
+		if(ms > 0) clock.sleep(ms);
+		return ms;
+	}
+}
@@ -4,8 +4,12 @@
  * @brief This file contains functions for storing and loading data from the LittleFS filesystem.
  */
 
+#pragma once
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include "configSchema.h"
+#include "configCache.h"
+#include "slotFile.h"
 
 namespace loc {
 
@@ -27,48 +31,43 @@ namespace loc {
 	/// @brief The path to the presets directory.
 	const char* preset_dir = "/presets";
 
-	/// @brief Saves the json data to the file.
+	/// @brief Saves the json data to the file, into the older of its two slots, see slotFile.h.
+	/// A reset during the save leaves the previous data.
 	/// @param filename The name of the file to save the data to.
 	/// @param data The json data to save.
 	/// @return 0 on success, -1 on failure.
 	int saveData(const char* filename, const JsonDocument& data) {
-		// Open file for writing
-		File file = LittleFS.open(filename, "w");
-		if (!file) {
-			// Failed to open file for writing
-			//Serial.println(F("Failed to create file"));
-			return -1;
-		}
-		serializeJson(data, file);
-		file.close();
-		return 0;
-		
+		return saveSlots(LittleFS, filename, [&](SlotWriter<File>& writer) {
+			serializeJson(data, writer);
+		});
 	}
 
 	/**
-	 * @brief Loads the json data from the specified file.
+	 * @brief Loads the json data from the newest valid slot of the specified file,
+	 * or from the plain file if it has never been saved into slots.
 	 * 
 	 * @param filename The name of the file to load the data from.
 	 * @param data Reference to the JsonDocument to load the data into.
 	 * @return 0 on success, -1 on failure.
 	 */
 	int loadData(const char* filename, JsonDocument& data) {
-		// Open file for reading
-		File file = LittleFS.open(filename, "r");
-		if (!file) {
-			// Failed to open file for reading
-			//Serial.println(F("Failed to read file"));
-			return -1;
-		}
-		
-		// Deserialize the JSON document
-		DeserializationError error = deserializeJson(data, file);
-		if (error) {
-			//Serial.println(F("Failed to parse file"));
-			return -1;
-		}
-		
-		file.close();
-		return 0;
+		return loadSlots(LittleFS, filename, [&](SlotReader<File>& reader) {
+			return deserializeJson(data, reader) ? -1 : 0;
+		});
+	}
+
+	/**
+	 * @brief Loads a configuration file straight into its struct, without a JsonDocument, see configSchema.h.
+	 * @param filename The name of the file to load the data from, its newest valid slot or the plain file.
+	 * @param fields The table of the fields of the struct, e.g. cfg::batteryFields.
+	 * @param target The struct to load into, only changed if the file is valid.
+	 * @param error Set to the reason of a failure. Can be nullptr.
+	 * @return 0 on success, -1 on failure.
+	 */
+	template <typename T, size_t N>
+	int loadConfig(const char* filename, const cfg::Field (&fields)[N], T& target, cfg::ConfigError* error = nullptr) {
+		return loadSlots(LittleFS, filename, [&](SlotReader<File>& reader) {
+			return cfg::readConfig(reader, fields, target, error);
+		});
 	}
 }
@@ -0,0 +1,278 @@
+/**
+ * @file presetBinary.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains functions for storing a cfg::PresetFile in a compact binary format.
+ *
+ * JSON stays the format presets are edited and imported in, but parsing it at boot
+ * needs a large JsonDocument and a lookup for every key. The binary format is read
+ * field by field straight into the PresetFile, with no intermediate document.
+ * The strings are stored with their lengths, so a preset takes a few hundred bytes instead of a few kilobytes.
+ * The command texts are read into the arena of the PresetFile, so a file is only limited by its
+ * PRESET_COMMAND_COUNT and PRESET_ARENA_SIZE, not by the number of run_once or run_scheduled commands.
+ * helper_scripts/preset_to_bin.py converts a JSON preset on the host.
+ *
+ * Format, all integers little endian:
+ * - header: the magic "RSPB", the version byte PRESET_BINARY_VERSION and the u16 length of the payload
+ * - payload:
+ *   - serial: u32 baud_rate, u8 byte_size, u8 parity, u8 stop_bits, string EOL
+ *   - task_schedule: u32 period, u32 offset
+ *   - u8 flags, see PresetFlags
+ *   - http_client: string url, string experiment_id, string experiment_description, string access_token
+ *   - run_once and run_scheduled: u8 count, and for every command u8 expect_response and string command
+ * - u32 CRC-32 (as in zlib) of the header and the payload
+ *
+ * A string is its u8 length followed by the characters, without a null terminator.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "configuration.h"
+#include "crc32.h"
+#include "slotFile.h"
+
+// Version of the binary preset format, incremented with every incompatible change.
+#define PRESET_BINARY_VERSION 1
+
+namespace cfg {
+
+	/// @brief The first bytes of a binary preset.
+	static const uint8_t PRESET_MAGIC[4] = {'R', 'S', 'P', 'B'};
+
+	/// @brief Size of the header: the magic, the version and the payload length.
+	static const size_t PRESET_HEADER_SIZE = 7;
+
+	/// @brief Bits of the flags byte of a binary preset.
+	enum PresetFlags : uint8_t {
+		PRESET_BATCH_ONCE = 0x01,
+		PRESET_BATCH_SCHEDULED = 0x02,
+		PRESET_CHECK_CERTS = 0x04,
+		PRESET_BINARY_UPLOAD = 0x08
+	};
+
+	/// @brief Writes the fields of a preset, counting the bytes and updating the CRC on the way.
+	/// @tparam Sink Type with `size_t write(const uint8_t*, size_t)`. A writer without a sink only counts.
+	template <typename Sink>
+	class PresetWriter {
+		Sink* sink;
+	public:
+		size_t length = 0;
+		uint32_t crc = 0;
+		bool failed = false;
+
+		explicit PresetWriter(Sink* sink) : sink(sink) {}
+
+		void bytes(const uint8_t* data, size_t count) {
+			if(sink != nullptr && sink->write(data, count) != count) failed = true;
+			crc = crc32(crc, data, count);
+			length += count;
+		}
+
+		void u8(uint8_t value) {
+			bytes(&value, 1);
+		}
+
+		void u16(uint16_t value) {
+			const uint8_t data[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+			bytes(data, sizeof(data));
+		}
+
+		void u32(uint32_t value) {
+			const uint8_t data[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+			bytes(data, sizeof(data));
+		}
+
+		void string(const char* text) {
+			const size_t count = strlen(text);
+			u8(count);
+			bytes((const uint8_t*)text, count);
+		}
+	};
+
+	/// @brief Reads the fields of a preset, updating the CRC on the way.
+	/// @tparam Source Type with `size_t read(uint8_t*, size_t)`.
+	template <typename Source>
+	class PresetReader {
+		Source& source;
+	public:
+		/// @brief The number of payload bytes left, reads past it fail.
+		size_t remaining = 0;
+		uint32_t crc = 0;
+		bool failed = false;
+
+		explicit PresetReader(Source& source) : source(source) {}
+
+		void bytes(uint8_t* data, size_t count) {
+			if(failed || count > remaining || source.read(data, count) != count) {
+				failed = true;
+				memset(data, 0, count);
+				return;
+			}
+			crc = crc32(crc, data, count);
+			remaining -= count;
+		}
+
+		uint8_t u8() {
+			uint8_t value;
+			bytes(&value, 1);
+			return value;
+		}
+
+		uint16_t u16() {
+			uint8_t data[2];
+			bytes(data, sizeof(data));
+			return data[0] | data[1] << 8;
+		}
+
+		uint32_t u32() {
+			uint8_t data[4];
+			bytes(data, sizeof(data));
+			return data[0] | data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+		}
+
+		/// @brief Reads a string into a field, failing if it does not fit.
+		void string(char* out, size_t size) {
+			const uint8_t count = u8();
+			if(count >= size) {
+				failed = true;
+				out[0] = '\0';
+				return;
+			}
+			bytes((uint8_t*)out, count);
+			out[count] = '\0';
+		}
+	};
+
+	/// @brief Writes the payload of a binary preset.
+	template <typename Sink>
+	void writePresetPayload(PresetWriter<Sink>& writer, const PresetFile& preset_file) {
+		writer.u32(preset_file.serial.baud_rate);
+		writer.u8(preset_file.serial.byte_size);
+		writer.u8(preset_file.serial.parity);
+		writer.u8(preset_file.serial.stop_bits);
+		writer.string(preset_file.serial.EOL);
+		writer.u32(preset_file.task_schedule.period);
+		writer.u32(preset_file.task_schedule.offset);
+		uint8_t flags = 0;
+		if(preset_file.batch_once) flags |= PRESET_BATCH_ONCE;
+		if(preset_file.batch_scheduled) flags |= PRESET_BATCH_SCHEDULED;
+		if(preset_file.http_client.check_certs) flags |= PRESET_CHECK_CERTS;
+		if(preset_file.http_client.binary) flags |= PRESET_BINARY_UPLOAD;
+		writer.u8(flags);
+		writer.string(preset_file.http_client.url);
+		writer.string(preset_file.http_client.experiment_id);
+		writer.string(preset_file.http_client.experiment_description);
+		writer.string(preset_file.http_client.access_token);
+		writer.u8(preset_file.run_once_count);
+		for(uint8_t i = 0; i < preset_file.run_once_count; i++) {
+			writer.u8(preset_file.run_once()[i].expect_response);
+			writer.string(preset_file.text(preset_file.run_once()[i]));
+		}
+		writer.u8(preset_file.run_scheduled_count);
+		for(uint8_t i = 0; i < preset_file.run_scheduled_count; i++) {
+			writer.u8(preset_file.run_scheduled()[i].expect_response);
+			writer.string(preset_file.text(preset_file.run_scheduled()[i]));
+		}
+	}
+
+	/**
+	 * @brief Writes a preset in the binary format.
+	 * @param sink Where to write, with `size_t write(const uint8_t*, size_t)`, e.g. a File.
+	 * @param preset_file The preset.
+	 * @return The number of bytes written, 0 on a write error.
+	 */
+	template <typename Sink>
+	size_t writePresetBinary(Sink& sink, const PresetFile& preset_file) {
+		// the payload is written twice, first only to find its length for the header
+		PresetWriter<Sink> counter(nullptr);
+		writePresetPayload(counter, preset_file);
+		PresetWriter<Sink> writer(&sink);
+		writer.bytes(PRESET_MAGIC, sizeof(PRESET_MAGIC));
+		writer.u8(PRESET_BINARY_VERSION);
+		writer.u16(counter.length);
+		writePresetPayload(writer, preset_file);
+		const uint32_t crc = writer.crc;
+		writer.u32(crc);
+		return writer.failed ? 0 : writer.length;
+	}
+
+	/**
+	 * @brief Reads a preset in the binary format.
+	 * The fields are read straight into the preset, which is undefined if the reading fails.
+	 * @param source Where to read from, with `size_t read(uint8_t*, size_t)`, e.g. a File.
+	 * @param preset_file The preset to read into.
+	 * @return 0 on success, -1 if the data is truncated, corrupt, of another version, or its commands do not fit into the preset.
+	 */
+	template <typename Source>
+	int readPresetBinary(Source& source, PresetFile& preset_file) {
+		PresetReader<Source> reader(source);
+		uint8_t magic[sizeof(PRESET_MAGIC)];
+		reader.remaining = PRESET_HEADER_SIZE;
+		reader.bytes(magic, sizeof(magic));
+		const uint8_t version = reader.u8();
+		reader.remaining = reader.u16();
+		if(reader.failed || memcmp(magic, PRESET_MAGIC, sizeof(magic)) != 0 || version != PRESET_BINARY_VERSION) return -1;
+
+		preset_file.serial.baud_rate = reader.u32();
+		preset_file.serial.byte_size = reader.u8();
+		preset_file.serial.parity = reader.u8();
+		preset_file.serial.stop_bits = reader.u8();
+		reader.string(preset_file.serial.EOL, sizeof(preset_file.serial.EOL));
+		preset_file.task_schedule.period = reader.u32();
+		preset_file.task_schedule.offset = reader.u32();
+		const uint8_t flags = reader.u8();
+		preset_file.batch_once = flags & PRESET_BATCH_ONCE;
+		preset_file.batch_scheduled = flags & PRESET_BATCH_SCHEDULED;
+		preset_file.http_client.check_certs = flags & PRESET_CHECK_CERTS;
+		preset_file.http_client.binary = flags & PRESET_BINARY_UPLOAD;
+		reader.string(preset_file.http_client.url, sizeof(preset_file.http_client.url));
+		reader.string(preset_file.http_client.experiment_id, sizeof(preset_file.http_client.experiment_id));
+		reader.string(preset_file.http_client.experiment_description, sizeof(preset_file.http_client.experiment_description));
+		reader.string(preset_file.http_client.access_token, sizeof(preset_file.http_client.access_token));
+		preset_file.clearCommands();
+		for(int scheduled = 0; scheduled < 2; scheduled++) {
+			const uint8_t count = reader.u8();
+			for(uint8_t i = 0; i < count && !reader.failed; i++) {
+				const bool expect_response = reader.u8();
+				char text[COMMAND_LENGTH];
+				reader.string(text, sizeof(text));
+				if(preset_file.addCommand(text, expect_response, scheduled) != 0) return -1;
+			}
+		}
+
+		// the payload has to be used up exactly, then comes the CRC
+		if(reader.failed || reader.remaining != 0) return -1;
+		const uint32_t crc = reader.crc;
+		reader.remaining = 4;
+		if(reader.u32() != crc || reader.failed) return -1;
+		return 0;
+	}
+
+	/**
+	 * @brief Loads a binary preset file, see loc::loadSlots.
+	 * @tparam FS The filesystem type, with the LittleFS interface.
+	 * @return 0 on success, -1 if the file does not exist or is not a valid preset.
+	 */
+	template <typename FS>
+	int loadPresetBinary(FS& fs, const char* path, PresetFile& preset_file) {
+		return loc::loadSlots(fs, path, [&](auto& reader) {
+			return readPresetBinary(reader, preset_file);
+		});
+	}
+
+	/**
+	 * @brief Saves a preset as a binary file, into the slots of slotFile.h,
+	 * so a reset leaves either the old or the new file.
+	 * @tparam FS The filesystem type, with the LittleFS interface.
+	 * @return 0 on success, -1 on failure.
+	 */
+	template <typename FS>
+	int savePresetBinary(FS& fs, const char* path, const PresetFile& preset_file) {
+		return loc::saveSlots(fs, path, [&](auto& writer) {
+			writePresetBinary(writer, preset_file);
+		});
+	}
+}
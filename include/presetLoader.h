@@ -2,62 +2,214 @@
  * @file presetLoader.h
  * @author Oskars Putans (o.putaans@gmail.com)
  * @brief This file contains a function for setting up
- * commands from the preset file. This file is relatively
- * unfinished, as it is not used in the current version.
- * It is left here for future development.
+ * commands from the preset file. main.cpp loads the
+ * STARTUP_PRESET at boot and sets up its commands here.
+ *
+ * The commands are sent as resumable tasks: a task submits a
+ * command to the serial transport, yields while the transaction
+ * is pending, and continues on the next scheduler update.
  */
 
 #include "configuration.h"
+#include "presetBinary.h"
+#include "jsonStorage.h"
 #include "scheduler.h"
+#include "serialTransport.h"
+#include "scpiBatch.h"
+#include "responseCache.h"
+#include "uploader.h"
+#include "httpPoster.h"
+#include <LittleFS.h>
 #include <Arduino.h>
 #pragma once
 
+extern transport::SerialTransport<HardwareSerial> serialTransport; // defined in ../src/main.cpp
+void publishResponse(uint8_t preset, const char* source, const char* response); // defined in ../src/serverHandlers.cpp
+extern cache::ResponseCache<> responseCache; // defined in ../src/serverHandlers.cpp
+extern HttpPoster httpPoster; // defined in ../src/main.cpp
+extern Uploader<fs::FS, HttpPoster> uploader; // defined in ../src/main.cpp
 
-/// @brief Schedule the commands from the preset file.
-/// @param data The reference to the DataBuffer containing the preset file struct.
-static void sendOnceCommand(DataBuffer& data) {
-	cfg::PresetFile& presetFile = data.get<cfg::PresetFile>();
-	//Serial.println("Sending command");
-	Serial.swap();
-	for(int i = 0; i < presetFile.run_once_count; i++) {
-		cfg::Command& command = presetFile.run_once[i];
-		Serial.print(command.command);
-		Serial.print(presetFile.serial.EOL);
-		int k;
-		for(k = 1; k < 3 && presetFile.serial.EOL[k] != 0; k++);
-		char finalEOL = presetFile.serial.EOL[k-1];
-		if(command.expect_response) {
-			String response = Serial.readStringUntil(finalEOL);
+// Size of the JsonDocument for importing a JSON preset.
+#ifndef PRESET_JSON_SIZE
+#define PRESET_JSON_SIZE 4096
+#endif
+
+/**
+ * @brief Loads a preset from the presets directory, from its binary file if there is one.
+ * A JSON preset without a binary file is imported: parsed once and saved as binary, so later loads skip the parsing.
+ * To import a changed JSON preset again, its binary file has to be removed, with its slots <name>.bin.a and <name>.bin.b.
+ * @param name The name of the preset, the file name without the extension.
+ * @param presetFile The preset to load into.
+ * @return 0 on success, -1 if there is no valid preset of that name.
+ */
+int loadPreset(const char* name, cfg::PresetFile& presetFile) {
+	char binaryPath[48];
+	char jsonPath[48];
+	snprintf(binaryPath, sizeof(binaryPath), "%s/%s.bin", loc::preset_dir, name);
+	snprintf(jsonPath, sizeof(jsonPath), "%s/%s.json", loc::preset_dir, name);
+	if(cfg::loadPresetBinary(LittleFS, binaryPath, presetFile) == 0) return 0;
+	DynamicJsonDocument jsonDocument(PRESET_JSON_SIZE);
+	if(loc::loadData(jsonPath, jsonDocument) != 0) return -1;
+	if(cfg::loadPresetFileFromJSON(presetFile, jsonDocument) != 0) return -1;
+	// a failed save only means the next load parses the JSON again
+	cfg::savePresetBinary(LittleFS, binaryPath, presetFile);
+	return 0;
+}
+
+/// @brief State of a preset command list being sent, kept in the task's DataBuffer.
+struct PresetRun {
+	/// @brief The preset file, shared with the other tasks of the preset.
+	cfg::PresetHandle preset;
+	/// @brief Id of the preset, stored with its samples.
+	uint8_t presetId = 0;
+	/// @brief Index of the command being sent.
+	uint8_t command = 0;
+	/// @brief Handle of the serial transaction of the command, -1 if it has not been submitted yet.
+	int handle = -1;
+	/// @brief The scheduler, to start the repeated commands once the run_once commands are done.
+	Scheduler* scheduler = nullptr;
+
+	PresetRun() {}
+	PresetRun(const PresetRun& other) : preset(other.preset), presetId(other.presetId), scheduler(other.scheduler) {}
+
+	~PresetRun() {
+		// a killed task must not leave its transaction behind
+		if(handle >= 0) serialTransport.abandon(handle);
+	}
+};
+
+/// @brief Stores the response of a finished transaction as a sample and pushes it to the event clients, if there is one.
+static void publishTransaction(const PresetRun& run, int handle) {
+	const transport::Transaction* transaction = serialTransport.get(handle);
+	if(transaction == nullptr || transaction->status != transport::Status::Done || transaction->length == 0) return;
+	publishResponse(run.presetId, run.preset->http_client.experiment_id, transaction->response);
+}
+
+/// @brief Splits the response of a joined message and publishes the part of every command that expects a response,
+/// in the order of the commands, see publishTransaction.
+static void publishBatch(const PresetRun& run, int handle, const cfg::Command* commands, uint8_t count) {
+	const transport::Transaction* transaction = serialTransport.get(handle);
+	if(transaction == nullptr || transaction->status != transport::Status::Done || transaction->length == 0) return;
+	// the transaction can be shared with other readers, so it is split in a copy
+	char response[TRANSPORT_RESPONSE_SIZE];
+	memcpy(response, transaction->response, transaction->length + 1);
+	const char* parts[PRESET_COMMAND_COUNT];
+	const size_t partCount = scpi::splitResponses(response, parts, count);
+	size_t part = 0;
+	for(uint8_t i = 0; i < count && part < partCount; i++) {
+		if(!commands[i].expect_response) continue;
+		publishResponse(run.presetId, run.preset->http_client.experiment_id, parts[part++]);
+	}
+}
+
+/// @brief Sends the commands one by one through the serial transport, without blocking for the responses.
+/// @param run The state of the run.
+/// @param commands The commands to send.
+/// @param count The number of commands.
+/// @param publish Whether to store the responses as samples and push them to the event clients.
+/// @return true if all commands have been sent and answered, false if the task has to be resumed.
+static bool stepCommands(PresetRun& run, const cfg::Command* commands, uint8_t count, bool publish) {
+	const cfg::PresetFile& presetFile = *run.preset;
+	while(run.command < count) {
+		const cfg::Command& command = commands[run.command];
+		const char* text = presetFile.text(command);
+		if(run.handle < 0) {
+			responseCache.observe(text);
+			const transport::LineFramer framer(presetFile.serial.EOL);
+			run.handle = command.expect_response && scpi::isQueryOnly(text)
+				? serialTransport.submitShared(text, presetFile.serial.EOL, framer, Serial.getTimeout())
+				: serialTransport.submit(text, presetFile.serial.EOL, framer, command.expect_response, Serial.getTimeout());
+			// the transport is full, try again on the next update
+			if(run.handle < 0) return false;
 		}
+		if(serialTransport.getStatus(run.handle) == transport::Status::Pending) return false;
+		if(publish) publishTransaction(run, run.handle);
+		serialTransport.release(run.handle);
+		run.handle = -1;
+		run.command++;
+	}
+	run.command = 0;
+	return true;
+}
+
+/// @brief Sends the commands joined into one SCPI message, in one serial round trip.
+/// Falls back to sending them one by one if the joined message does not fit into the transport.
+/// @param run The state of the run.
+/// @param commands The commands to send.
+/// @param count The number of commands.
+/// @param publish Whether to store the response of every query as a sample and push it to the event clients.
+/// @return true if the message has been sent and answered, false if the task has to be resumed.
+static bool stepBatch(PresetRun& run, const cfg::Command* commands, uint8_t count, bool publish) {
+	const cfg::PresetFile& presetFile = *run.preset;
+	const char* list[PRESET_COMMAND_COUNT];
+	bool expectResponse = false;
+	for(uint8_t i = 0; i < count; i++) {
+		list[i] = presetFile.text(commands[i]);
+		expectResponse |= commands[i].expect_response;
+	}
+	char message[TRANSPORT_TX_SIZE + 1];
+	// a message that would not fit with its terminator could never be submitted
+	if(scpi::joinCommands(message, transport::maxCommandLength(presetFile.serial.EOL) + 1, list, count) == 0) {
+		return stepCommands(run, commands, count, publish);
+	}
+	if(run.handle < 0) {
+		responseCache.observe(message);
+		const transport::LineFramer framer(presetFile.serial.EOL);
+		run.handle = expectResponse && scpi::isQueryOnly(message)
+			? serialTransport.submitShared(message, presetFile.serial.EOL, framer, Serial.getTimeout())
+			: serialTransport.submit(message, presetFile.serial.EOL, framer, expectResponse, Serial.getTimeout());
+		if(run.handle < 0) return false;
 	}
-	Serial.swap();
+	if(serialTransport.getStatus(run.handle) == transport::Status::Pending) return false;
+	if(publish) publishBatch(run, run.handle, commands, count);
+	serialTransport.release(run.handle);
+	run.handle = -1;
+	return true;
 }
 
-/// @brief Schedule the commands to be repeated from the preset file.
-/// @param data Reference to the DataBuffer containing the preset file struct.
+/// @brief Sends the commands to be repeated from the preset file.
+/// @param data Reference to the DataBuffer containing the PresetRun struct.
 static void sendRepeatCommand(DataBuffer& data) {
-	cfg::PresetFile& presetFile = data.get<cfg::PresetFile>();
-	//Serial.println("Sending command");
-	Serial.swap();
-	for(int i = 0; i < presetFile.run_scheduled_count; i++) {
-		cfg::Command& command = presetFile.run_scheduled[i];
-		Serial.print(command.command);
-		Serial.print(presetFile.serial.EOL);
-		int k;
-		for(k = 1; k < 3 && presetFile.serial.EOL[k] != 0; k++);
-		char finalEOL = presetFile.serial.EOL[k-1];
-		if(command.expect_response) {
-			String response = Serial.readStringUntil(finalEOL);
-		}
+	PresetRun& run = data.get<PresetRun>();
+	const bool finished = run.preset->batch_scheduled
+		? stepBatch(run, run.preset->run_scheduled(), run.preset->run_scheduled_count, true)
+		: stepCommands(run, run.preset->run_scheduled(), run.preset->run_scheduled_count, true);
+	if(!finished) {
+		Scheduler::yield();
+	}
+}
+
+/// @brief Sends the commands to be run once from the preset file, then starts the repeated commands.
+/// The repeated task is only scheduled here, so its queries never reach the instrument
+/// between the setup commands, e.g. before *RST.
+/// @param data The reference to the DataBuffer containing the PresetRun struct.
+static void sendOnceCommand(DataBuffer& data) {
+	PresetRun& run = data.get<PresetRun>();
+	const bool finished = run.preset->batch_once
+		? stepBatch(run, run.preset->run_once(), run.preset->run_once_count, false)
+		: stepCommands(run, run.preset->run_once(), run.preset->run_once_count, false);
+	if(!finished) {
+		Scheduler::yield();
+		return;
 	}
-	Serial.swap();
+	run.scheduler->scheduleRepeat<PresetRun>(sendRepeatCommand, run.preset->task_schedule.period*1000ULL,
+		Scheduler::getUpdateTime(), run);
 }
 
 /// @brief Set up the preset commands.
 /// @param scheduler Reference to the scheduler.
-/// @param presetFile Reference to the preset file struct.
-void setUpPresetCommands(Scheduler& scheduler, cfg::PresetFile& presetFile) {
+/// @param preset Handle to the preset, e.g. from cfg::PresetHandle::create and loadPreset. The tasks keep their own handles.
+/// @param presetId Id of the preset, stored with its samples.
+void setUpPresetCommands(Scheduler& scheduler, const cfg::PresetHandle& preset, uint8_t presetId = 0) {
 	// set up preset commands
-	scheduler.schedule<cfg::PresetFile>(sendOnceCommand, 0, presetFile);
-	scheduler.schedule<cfg::PresetFile>(sendRepeatCommand, 0, presetFile);
-}
\ No newline at end of file
+	const cfg::PresetFile& presetFile = *preset;
+	PresetRun run;
+	run.preset = preset;
+	run.presetId = presetId;
+	run.scheduler = &scheduler;
+	httpPoster.setCheckCerts(presetFile.http_client.check_certs);
+	uploader.setTarget(presetFile.http_client.url, presetFile.http_client.experiment_id,
+		presetFile.http_client.access_token, presetFile.http_client.binary);
+	// the once task schedules the repeated one when it is done
+	scheduler.schedule<PresetRun>(sendOnceCommand, 0, run);
+}
@@ -0,0 +1,143 @@
+/**
+ * @file responseCache.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the ResponseCache class, which keeps the responses of recent SCPI queries.
+ *
+ * Queries like *IDN? are answered the same way until something is written to the instrument,
+ * so a repeated query can be answered from RAM instead of a serial round trip.
+ * Caching is opt-in: a response is only stored with a time to live given by the caller,
+ * and every command that is not a query empties the whole cache, as it may change any setting.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "scpiBatch.h"
+
+// Maximum number of cached responses.
+#ifndef CACHE_ENTRIES
+#define CACHE_ENTRIES 8
+#endif
+
+// Maximum length of a cached command, including the null terminator.
+#ifndef CACHE_COMMAND_SIZE
+#define CACHE_COMMAND_SIZE 32
+#endif
+
+// Maximum length of a cached response, including the null terminator. Longer responses are not cached.
+#ifndef CACHE_RESPONSE_SIZE
+#define CACHE_RESPONSE_SIZE 96
+#endif
+
+namespace cache {
+
+	/**
+	 * @brief Cache of query responses, keyed by the command string.
+	 * The commands are compared as they are, so "*IDN?" and "*idn?" are different entries.
+	 * @tparam SIZE The maximum number of entries.
+	 */
+	template <unsigned int SIZE = CACHE_ENTRIES>
+	class ResponseCache {
+		struct Entry {
+			char command[CACHE_COMMAND_SIZE];
+			char response[CACHE_RESPONSE_SIZE];
+			/// @brief The time after which the entry is stale, 0 if the entry is free.
+			unsigned long long expires = 0;
+		};
+
+		Entry entries[SIZE];
+
+		unsigned long hits = 0;
+		unsigned long misses = 0;
+		unsigned long invalidations = 0;
+
+		/// @return The live entry of the command, or nullptr.
+		Entry* find(const char* command, unsigned long long now) {
+			for(unsigned int i = 0; i < SIZE; i++) {
+				Entry& entry = entries[i];
+				if(entry.expires > now && strcmp(entry.command, command) == 0) return &entry;
+			}
+			return nullptr;
+		}
+	public:
+		/**
+		 * @brief Looks up the response of a query.
+		 * @param command The query.
+		 * @param now The current time in milliseconds.
+		 * @return The cached response, or nullptr if there is none or it is stale.
+		 * The pointer is valid until the cache is next modified.
+		 */
+		const char* get(const char* command, unsigned long long now) {
+			const Entry* entry = find(command, now);
+			if(entry == nullptr) {
+				misses++;
+				return nullptr;
+			}
+			hits++;
+			return entry->response;
+		}
+
+		/**
+		 * @brief Stores the response of a query, replacing the entry of the same command,
+		 * or else a free one, or else the one that goes stale first.
+		 * @param command The query.
+		 * @param response Its response.
+		 * @param ttl The time to live of the entry in milliseconds.
+		 * @param now The current time in milliseconds.
+		 * @return false if the command is not a query, the ttl is 0, or either string is too long to cache.
+		 */
+		bool put(const char* command, const char* response, unsigned long ttl, unsigned long long now) {
+			if(ttl == 0 || !scpi::isQueryOnly(command)) return false;
+			if(strlen(command) >= CACHE_COMMAND_SIZE || strlen(response) >= CACHE_RESPONSE_SIZE) return false;
+			Entry* entry = find(command, now);
+			for(unsigned int i = 0; entry == nullptr && i < SIZE; i++) {
+				if(entries[i].expires <= now) entry = &entries[i];
+			}
+			if(entry == nullptr) {
+				entry = &entries[0];
+				for(unsigned int i = 1; i < SIZE; i++) {
+					if(entries[i].expires < entry->expires) entry = &entries[i];
+				}
+			}
+			strcpy(entry->command, command);
+			strcpy(entry->response, response);
+			entry->expires = now + ttl;
+			return true;
+		}
+
+		/**
+		 * @brief Notes a message sent to the instrument by any path, and empties the cache unless it only has queries.
+		 * Has to be called before the message is sent, so no stale response is served while it is pending.
+		 * @param message The program message. An empty one, which only reads a line, changes nothing.
+		 */
+		void observe(const char* message) {
+			if(message[0] == '\0' || scpi::isQueryOnly(message)) return;
+			clear();
+			invalidations++;
+		}
+
+		/// @brief Removes all entries.
+		void clear() {
+			for(unsigned int i = 0; i < SIZE; i++) {
+				entries[i].expires = 0;
+			}
+		}
+
+		/// @brief The number of lookups answered from the cache.
+		unsigned long getHits() const {
+			return hits;
+		}
+
+		/// @brief The number of lookups that missed.
+		unsigned long getMisses() const {
+			return misses;
+		}
+
+		/// @brief The number of times the cache was emptied by a write.
+		unsigned long getInvalidations() const {
+			return invalidations;
+		}
+	};
+}
@@ -0,0 +1,90 @@
+/**
+ * @file ringBuffer.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the RingBuffer class, a statically allocated FIFO buffer.
+ *
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Fixed-size FIFO buffer.
+ * The read and write counters run freely and are masked on access,
+ * so the whole buffer can be used and no element is wasted.
+ * @tparam T The element type.
+ * @tparam SIZE The capacity, has to be a power of two.
+ */
+template <typename T, unsigned int SIZE>
+class RingBuffer {
+	static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "RingBuffer size has to be a power of two");
+	static_assert(SIZE <= 0x8000, "RingBuffer size is too large");
+
+	/// @brief The buffered elements.
+	T buffer[SIZE];
+
+	/// @brief The number of elements ever pushed, modulo 2^16.
+	uint16_t writeCount = 0;
+
+	/// @brief The number of elements ever popped, modulo 2^16.
+	uint16_t readCount = 0;
+public:
+	/// @brief The number of buffered elements.
+	unsigned int size() const {
+		return (uint16_t)(writeCount - readCount);
+	}
+
+	/// @brief The number of elements that can still be pushed.
+	unsigned int space() const {
+		return SIZE - size();
+	}
+
+	bool isEmpty() const {
+		return writeCount == readCount;
+	}
+
+	bool isFull() const {
+		return size() == SIZE;
+	}
+
+	/// @brief Removes all elements.
+	void clear() {
+		readCount = writeCount;
+	}
+
+	/// @brief Adds an element to the end of the buffer.
+	/// @return false if the buffer is full.
+	bool push(const T& value) {
+		if(isFull()) return false;
+		buffer[writeCount & (SIZE - 1)] = value;
+		writeCount++;
+		return true;
+	}
+
+	/// @brief Adds several elements to the end of the buffer, only if all of them fit.
+	/// @return false if there is not enough space.
+	bool push(const T* values, size_t count) {
+		if(count > space()) return false;
+		for(size_t i = 0; i < count; i++) {
+			buffer[(uint16_t)(writeCount + i) & (SIZE - 1)] = values[i];
+		}
+		writeCount += count;
+		return true;
+	}
+
+	/// @brief The element at the start of the buffer.
+	/// @warning The buffer must not be empty.
+	const T& peek() const {
+		return buffer[readCount & (SIZE - 1)];
+	}
+
+	/// @brief Removes the element at the start of the buffer.
+	/// @warning The buffer must not be empty.
+	T pop() {
+		const T value = buffer[readCount & (SIZE - 1)];
+		readCount++;
+		return value;
+	}
+};
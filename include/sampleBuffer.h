@@ -0,0 +1,157 @@
+/**
+ * @file sampleBuffer.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the SampleBuffer class, a preallocated ring buffer of timestamped measurement results.
+ *
+ * Every sample gets a sequence number, so a client can fetch everything newer than the last sample it has seen.
+ * The records are fixed size, and the response texts are kept in a separate ring of bytes,
+ * so short responses do not waste space. Numeric responses are packed, see sampleCodec.h.
+ * The oldest samples are overwritten when either ring is full.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "sampleCodec.h"
+
+// Maximum number of samples kept, has to be a power of two.
+#ifndef SAMPLE_CAPACITY
+#define SAMPLE_CAPACITY 128
+#endif
+
+// Size of the ring for the response texts, has to be a power of two.
+#ifndef SAMPLE_TEXT_SIZE
+#define SAMPLE_TEXT_SIZE 2048
+#endif
+
+/// @brief A measurement result.
+struct Sample {
+	/// @brief Time of the result, in milliseconds since 1970-01-01 00:00:00.
+	uint64_t time;
+	/// @brief Sequence number, starting from 1.
+	uint32_t sequence;
+	/// @brief Position of the response text, as the number of text bytes written before it.
+	uint32_t textStart;
+	/// @brief Length of the stored response.
+	uint16_t length;
+	/// @brief Id of the preset that produced the result.
+	uint8_t preset;
+	/// @brief The response is stored packed by codec::pack.
+	bool packed;
+};
+
+/**
+ * @brief Fixed-size ring buffer of samples.
+ * @tparam CAPACITY The maximum number of samples, has to be a power of two.
+ * @tparam TEXT_SIZE The size of the text ring, has to be a power of two.
+ */
+template <unsigned int CAPACITY = SAMPLE_CAPACITY, unsigned int TEXT_SIZE = SAMPLE_TEXT_SIZE>
+class SampleBuffer {
+	static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "SampleBuffer capacity has to be a power of two");
+	static_assert(TEXT_SIZE > 0 && (TEXT_SIZE & (TEXT_SIZE - 1)) == 0, "SampleBuffer text size has to be a power of two");
+	static_assert(TEXT_SIZE <= 0xFFFF, "SampleBuffer text size is too large");
+
+	Sample samples[CAPACITY];
+	char text[TEXT_SIZE];
+
+	/// @brief The number of text bytes ever written, modulo 2^32.
+	uint32_t textWritten = 0;
+
+	/// @brief Sequence number of the oldest kept sample.
+	uint32_t first = 1;
+
+	/// @brief Sequence number the next sample gets.
+	uint32_t next = 1;
+public:
+	/**
+	 * @brief Adds a sample, overwriting the oldest ones if there is no space.
+	 * @param time Time of the result, in milliseconds since 1970-01-01 00:00:00.
+	 * @param preset Id of the preset that produced the result.
+	 * @param response The response text, truncated to the size of the text ring.
+	 * @return The sequence number of the sample.
+	 */
+	uint32_t add(uint64_t time, uint8_t preset, const char* response) {
+		uint8_t packed[codec::PACKED_SIZE];
+		size_t length = codec::pack(response, packed);
+		const char* stored = length > 0 ? (const char*)packed : response;
+		if(length == 0) length = strlen(response);
+		if(length > TEXT_SIZE) length = TEXT_SIZE;
+		for(size_t i = 0; i < length; i++) {
+			text[(textWritten + i) & (TEXT_SIZE - 1)] = stored[i];
+		}
+
+		Sample& sample = samples[next & (CAPACITY - 1)];
+		sample.time = time;
+		sample.sequence = next;
+		sample.textStart = textWritten;
+		sample.length = length;
+		sample.preset = preset;
+		sample.packed = stored == (const char*)packed;
+		textWritten += length;
+		next++;
+
+		// drop the samples that have been overwritten, or whose text has been
+		if(next - first > CAPACITY) first = next - CAPACITY;
+		while(first != next) {
+			const Sample& oldest = samples[first & (CAPACITY - 1)];
+			if(textWritten - oldest.textStart <= TEXT_SIZE) break;
+			first++;
+		}
+		return sample.sequence;
+	}
+
+	/// @brief Removes all samples. The sequence numbers keep counting.
+	void clear() {
+		first = next;
+	}
+
+	/// @brief The number of kept samples.
+	unsigned int size() const {
+		return next - first;
+	}
+
+	/// @brief Sequence number of the oldest kept sample, or of the next sample if there are none.
+	uint32_t oldest() const {
+		return first;
+	}
+
+	/// @brief Sequence number of the newest sample, 0 if no sample has ever been added.
+	uint32_t newest() const {
+		return next - 1;
+	}
+
+	/// @brief Fetches a sample by its sequence number.
+	/// @return The sample, or nullptr if it has been overwritten or does not exist yet.
+	const Sample* get(uint32_t sequence) const {
+		if(sequence - first >= next - first) return nullptr;
+		return &samples[sequence & (CAPACITY - 1)];
+	}
+
+	/**
+	 * @brief Copies the response text of a sample.
+	 * @param sample The sample, from get.
+	 * @param out The buffer to copy to, null terminated.
+	 * @param size The size of the buffer.
+	 * @return The length of the copied text, truncated to fit. A packed response is not truncated, 0 if it does not fit.
+	 */
+	size_t copyText(const Sample& sample, char* out, size_t size) const {
+		if(size == 0) return 0;
+		if(sample.packed) {
+			uint8_t packed[codec::PACKED_SIZE];
+			for(size_t i = 0; i < sample.length; i++) {
+				packed[i] = text[(sample.textStart + i) & (TEXT_SIZE - 1)];
+			}
+			const size_t length = codec::unpack(packed, sample.length, out, size);
+			if(length == 0) out[0] = '\0';
+			return length;
+		}
+		size_t length = sample.length < size - 1 ? sample.length : size - 1;
+		for(size_t i = 0; i < length; i++) {
+			out[i] = text[(sample.textStart + i) & (TEXT_SIZE - 1)];
+		}
+		out[length] = '\0';
+		return length;
+	}
+};
@@ -0,0 +1,338 @@
+/**
+ * @file sampleCodec.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains functions for storing numeric SCPI responses in a compact binary form.
+ *
+ * A response like "+1.23456E+00" is parsed into a decimal mantissa and exponent, 123456 and -5,
+ * and stored as the exponent byte and the zigzag varint of the mantissa, 4 bytes instead of 12.
+ * A response is only packed if it is formatted back to exactly the same text, so packing is lossless,
+ * and anything else is kept as text.
+ *
+ * For sequential streams, like upload batches, the DeltaEncoder stores every sample
+ * as the difference to the previous one, so a steady reading costs a few bytes with its timestamp.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace codec {
+
+	/// @brief Maximum length of a packed number: the exponent byte and a 10 byte varint.
+	static const size_t PACKED_SIZE = 11;
+
+	/// @brief A decimal number, mantissa * 10^exponent.
+	struct Number {
+		int64_t mantissa = 0;
+		int8_t exponent = 0;
+	};
+
+	/// @brief Maps signed integers to unsigned ones, so small magnitudes get short varints.
+	inline uint64_t zigzag(int64_t value) {
+		return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	}
+
+	inline int64_t unzigzag(uint64_t value) {
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+
+	/// @brief Writes a varint, 7 bits per byte, least significant first.
+	/// @return The number of bytes written, 0 if it does not fit.
+	inline size_t putVarint(uint8_t* out, size_t size, uint64_t value) {
+		size_t length = 0;
+		do {
+			if(length == size) return 0;
+			uint8_t byte = value & 0x7F;
+			value >>= 7;
+			if(value != 0) byte |= 0x80;
+			out[length++] = byte;
+		} while(value != 0);
+		return length;
+	}
+
+	/// @brief Reads a varint.
+	/// @return The number of bytes read, 0 if it is truncated or too long.
+	inline size_t getVarint(const uint8_t* in, size_t size, uint64_t& value) {
+		value = 0;
+		for(size_t i = 0; i < size && i < 10; i++) {
+			value |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+			if((in[i] & 0x80) == 0) return i + 1;
+		}
+		return 0;
+	}
+
+	/**
+	 * @brief Parses a decimal number, e.g. "+1.23456E+00", "-12.5" or "42".
+	 * @param text The text, without surrounding whitespace.
+	 * @param number Set to the parsed number.
+	 * @return false if the text is not a number, or has more than 18 digits.
+	 */
+	inline bool parse(const char* text, Number& number) {
+		const char* c = text;
+		const bool negative = *c == '-';
+		if(*c == '+' || *c == '-') c++;
+		int64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		bool point = false;
+		for(; (*c >= '0' && *c <= '9') || (*c == '.' && !point); c++) {
+			if(*c == '.') {
+				point = true;
+				continue;
+			}
+			if(++digits > 18) return false;
+			mantissa = mantissa * 10 + (*c - '0');
+			if(point) exponent--;
+		}
+		if(digits == 0) return false;
+		if(*c == 'E' || *c == 'e') {
+			c++;
+			const bool negativeExponent = *c == '-';
+			if(*c == '+' || *c == '-') c++;
+			if(*c < '0' || *c > '9') return false;
+			int value = 0;
+			for(; *c >= '0' && *c <= '9'; c++) {
+				value = value * 10 + (*c - '0');
+				if(value > 1000) return false;
+			}
+			exponent += negativeExponent ? -value : value;
+		}
+		if(*c != '\0' || exponent < -128 || exponent > 127) return false;
+		number.mantissa = negative ? -mantissa : mantissa;
+		number.exponent = exponent;
+		return true;
+	}
+
+	/**
+	 * @brief Formats a number in the SCPI NR3 form, with as many digits as the mantissa has, e.g. "+1.23456E+00".
+	 * @param number The number.
+	 * @param out The buffer to write to, null terminated.
+	 * @param size The size of the buffer.
+	 * @return The length of the text, 0 if it does not fit.
+	 */
+	inline size_t format(const Number& number, char* out, size_t size) {
+		char digits[20];
+		int count = 0;
+		uint64_t magnitude = number.mantissa < 0 ? -(uint64_t)number.mantissa : number.mantissa;
+		do {
+			digits[count++] = '0' + magnitude % 10;
+			magnitude /= 10;
+		} while(magnitude != 0);
+		const int exponent = number.exponent + count - 1;
+		const unsigned int exponentMagnitude = exponent < 0 ? -exponent : exponent;
+		// sign, digits, point, 'E', exponent sign, up to 3 exponent digits, null terminator
+		if(size < (size_t)count + 8) return 0;
+		size_t length = 0;
+		out[length++] = number.mantissa < 0 ? '-' : '+';
+		out[length++] = digits[--count];
+		if(count > 0) out[length++] = '.';
+		while(count > 0) out[length++] = digits[--count];
+		out[length++] = 'E';
+		out[length++] = exponent < 0 ? '-' : '+';
+		if(exponentMagnitude >= 100) out[length++] = '0' + exponentMagnitude / 100;
+		out[length++] = '0' + exponentMagnitude / 10 % 10;
+		out[length++] = '0' + exponentMagnitude % 10;
+		out[length] = '\0';
+		return length;
+	}
+
+	/// @brief Parses a response as a number, only if formatting it gives back exactly the same text.
+	inline bool parseExact(const char* text, Number& number) {
+		char formatted[32];
+		return parse(text, number) && format(number, formatted, sizeof(formatted)) != 0 && strcmp(formatted, text) == 0;
+	}
+
+	/**
+	 * @brief Packs a numeric response.
+	 * @param text The response.
+	 * @param out The buffer to write to, at least PACKED_SIZE bytes.
+	 * @return The length of the packed number, 0 if the response can not be packed losslessly.
+	 */
+	inline size_t pack(const char* text, uint8_t* out) {
+		Number number;
+		if(!parseExact(text, number)) return 0;
+		out[0] = (uint8_t)number.exponent;
+		return 1 + putVarint(out + 1, PACKED_SIZE - 1, zigzag(number.mantissa));
+	}
+
+	/**
+	 * @brief Unpacks a packed response.
+	 * @param in The packed number.
+	 * @param length The length of the packed number.
+	 * @param out The buffer for the text, null terminated.
+	 * @param size The size of the buffer.
+	 * @return The length of the text, 0 if the packed number is malformed or the text does not fit.
+	 */
+	inline size_t unpack(const uint8_t* in, size_t length, char* out, size_t size) {
+		if(length < 2) return 0;
+		Number number;
+		uint64_t value;
+		if(getVarint(in + 1, length - 1, value) != length - 1) return 0;
+		number.exponent = (int8_t)in[0];
+		number.mantissa = unzigzag(value);
+		return format(number, out, size);
+	}
+
+	/// @brief Flags of a delta encoded sample.
+	enum DeltaFlags : uint8_t {
+		/// @brief The response is a number, stored as the difference to the previous number.
+		DELTA_NUMBER = 0x01,
+		/// @brief The exponent of the number differs from the previous one, and follows.
+		DELTA_EXPONENT = 0x02,
+		/// @brief The preset differs from the previous one, and follows.
+		DELTA_PRESET = 0x04,
+		/// @brief The sequence number is not the previous one + 1, the difference follows.
+		DELTA_SEQUENCE = 0x08
+	};
+
+	/// @brief State shared by the DeltaEncoder and the DeltaDecoder: the previous sample.
+	struct DeltaState {
+		uint64_t time = 0;
+		uint32_t sequence = 0;
+		uint8_t preset = 0;
+		Number number;
+	};
+
+	/**
+	 * @brief Encodes a stream of samples as differences to the previous sample.
+	 * A sample is a flags byte, the zigzag varint of the time difference, the optional fields
+	 * given by the flags, and either the zigzag varint of the mantissa difference or the text length and text.
+	 * The stream has to be decoded from its start by a DeltaDecoder.
+	 */
+	class DeltaEncoder {
+		DeltaState previous;
+	public:
+		/// @brief Starts a new stream.
+		void reset() {
+			previous = DeltaState();
+		}
+
+		/**
+		 * @brief Encodes a sample.
+		 * @param time Time of the sample, in milliseconds.
+		 * @param sequence Sequence number of the sample.
+		 * @param preset Id of the preset of the sample.
+		 * @param text The response.
+		 * @param out The buffer to write to.
+		 * @param size The size of the buffer.
+		 * @return The length of the encoded sample, 0 if it does not fit. The state is unchanged then.
+		 */
+		size_t encode(uint64_t time, uint32_t sequence, uint8_t preset, const char* text, uint8_t* out, size_t size) {
+			if(size == 0) return 0;
+			Number number;
+			const bool numeric = parseExact(text, number);
+			uint8_t flags = 0;
+			if(numeric) flags |= DELTA_NUMBER;
+			if(numeric && number.exponent != previous.number.exponent) flags |= DELTA_EXPONENT;
+			if(preset != previous.preset) flags |= DELTA_PRESET;
+			if(sequence != previous.sequence + 1) flags |= DELTA_SEQUENCE;
+
+			size_t length = 0;
+			out[length++] = flags;
+			size_t written = putVarint(out + length, size - length, zigzag((int64_t)(time - previous.time)));
+			if(written == 0) return 0;
+			length += written;
+			if(flags & DELTA_SEQUENCE) {
+				written = putVarint(out + length, size - length, zigzag((int32_t)(sequence - previous.sequence)));
+				if(written == 0) return 0;
+				length += written;
+			}
+			if(flags & DELTA_PRESET) {
+				if(length == size) return 0;
+				out[length++] = preset;
+			}
+			if(numeric) {
+				if(flags & DELTA_EXPONENT) {
+					if(length == size) return 0;
+					out[length++] = (uint8_t)number.exponent;
+				}
+				written = putVarint(out + length, size - length, zigzag(number.mantissa - previous.number.mantissa));
+				if(written == 0) return 0;
+				length += written;
+			} else {
+				const size_t textLength = strlen(text);
+				written = putVarint(out + length, size - length, textLength);
+				if(written == 0 || length + written + textLength > size) return 0;
+				length += written;
+				memcpy(out + length, text, textLength);
+				length += textLength;
+			}
+
+			previous.time = time;
+			previous.sequence = sequence;
+			previous.preset = preset;
+			if(numeric) previous.number = number;
+			return length;
+		}
+	};
+
+	/// @brief Decodes a stream written by a DeltaEncoder.
+	class DeltaDecoder {
+		DeltaState previous;
+	public:
+		/// @brief Starts a new stream.
+		void reset() {
+			previous = DeltaState();
+		}
+
+		/**
+		 * @brief Decodes a sample.
+		 * @param in The encoded stream at the sample.
+		 * @param size The number of bytes left in the stream.
+		 * @param time Set to the time of the sample.
+		 * @param sequence Set to the sequence number of the sample.
+		 * @param preset Set to the preset id of the sample.
+		 * @param text Set to the response, null terminated.
+		 * @param textSize The size of the text buffer.
+		 * @return The length of the encoded sample, 0 if it is malformed or the text does not fit.
+		 */
+		size_t decode(const uint8_t* in, size_t size, uint64_t& time, uint32_t& sequence, uint8_t& preset,
+				char* text, size_t textSize) {
+			if(size == 0) return 0;
+			const uint8_t flags = in[0];
+			size_t length = 1;
+			uint64_t value;
+			size_t read = getVarint(in + length, size - length, value);
+			if(read == 0) return 0;
+			length += read;
+			DeltaState next = previous;
+			next.time += unzigzag(value);
+			next.sequence++;
+			if(flags & DELTA_SEQUENCE) {
+				read = getVarint(in + length, size - length, value);
+				if(read == 0) return 0;
+				length += read;
+				next.sequence = previous.sequence + (int32_t)unzigzag(value);
+			}
+			if(flags & DELTA_PRESET) {
+				if(length == size) return 0;
+				next.preset = in[length++];
+			}
+			if(flags & DELTA_NUMBER) {
+				if(flags & DELTA_EXPONENT) {
+					if(length == size) return 0;
+					next.number.exponent = (int8_t)in[length++];
+				}
+				read = getVarint(in + length, size - length, value);
+				if(read == 0) return 0;
+				length += read;
+				next.number.mantissa += unzigzag(value);
+				if(format(next.number, text, textSize) == 0) return 0;
+			} else {
+				read = getVarint(in + length, size - length, value);
+				if(read == 0 || value >= textSize || length + read + value > size) return 0;
+				length += read;
+				memcpy(text, in + length, value);
+				text[value] = '\0';
+				length += value;
+			}
+			previous = next;
+			time = next.time;
+			sequence = next.sequence;
+			preset = next.preset;
+			return length;
+		}
+	};
+}
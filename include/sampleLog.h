@@ -0,0 +1,447 @@
+/**
+ * @file sampleLog.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the SampleLog class, an append-only log of samples on the filesystem.
+ *
+ * The samples are written as binary records into segment files of limited size, LOG_DIR/<n>.bin.
+ * Appends are collected in RAM and written in one go when the buffer is full or old enough,
+ * which keeps the number of flash writes low. When a segment is full, a new one is started,
+ * and the oldest segments are removed to keep at most LOG_MAX_SEGMENTS of them.
+ * An index file maps the time and sequence ranges of the closed segments to their numbers.
+ * It is only rewritten when a segment is closed, into the slots of slotFile.h, so a reset leaves the old or the new one.
+ * Numeric responses are stored packed, see sampleCodec.h, and read back as the same text.
+ *
+ * The filesystem is a template parameter with the interface of LittleFS
+ * (open, remove), so a fake filesystem can be used in a native environment.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "sampleCodec.h"
+#include "slotFile.h"
+
+// Directory of the log files.
+#ifndef LOG_DIR
+#define LOG_DIR "/log"
+#endif
+
+// Maximum size of a segment file in bytes.
+#ifndef LOG_SEGMENT_SIZE
+#define LOG_SEGMENT_SIZE 16384
+#endif
+
+// Maximum number of closed segments kept, older ones are removed.
+#ifndef LOG_MAX_SEGMENTS
+#define LOG_MAX_SEGMENTS 16
+#endif
+
+// Size of the RAM buffer for appends not yet written to the segment.
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 512
+#endif
+static_assert(LOG_BUFFER_SIZE > 15 && LOG_BUFFER_SIZE <= LOG_SEGMENT_SIZE, "LOG_BUFFER_SIZE has to fit a record and into a segment");
+
+// The longest time in milliseconds an append stays in the RAM buffer.
+#ifndef LOG_FLUSH_MS
+#define LOG_FLUSH_MS 10000
+#endif
+
+/// @brief A sample as stored in the log, followed by its response text.
+struct LogRecord {
+	/// @brief Size of a record header in a segment file.
+	static const size_t HEADER_SIZE = 15;
+
+	/// @brief Flag of a record whose text is packed by codec::pack.
+	static const uint8_t PACKED = 1;
+
+	/// @brief Time of the result, in milliseconds since 1970-01-01 00:00:00.
+	uint64_t time = 0;
+	/// @brief Sequence number of the sample.
+	uint32_t sequence = 0;
+	/// @brief Id of the preset that produced the result.
+	uint8_t preset = 0;
+	/// @brief Length of the stored response text.
+	uint8_t length = 0;
+	/// @brief Combination of the flags above.
+	uint8_t flags = 0;
+};
+
+/// @brief Position in the log, the record at offset in segment.
+struct LogCursor {
+	uint32_t segment = 0;
+	uint32_t offset = 0;
+};
+
+/// @brief Index entry of a segment.
+struct LogSegment {
+	/// @brief Size of an index entry in the index file.
+	static const size_t SIZE = 32;
+
+	uint32_t number = 0;
+	/// @brief The number of records in the segment.
+	uint32_t count = 0;
+	uint64_t firstTime = 0;
+	uint64_t lastTime = 0;
+	uint32_t firstSequence = 0;
+	uint32_t lastSequence = 0;
+};
+
+/**
+ * @brief Append-only sample log in segment files.
+ * @tparam FS Type with the LittleFS interface: `File open(const char* path, const char* mode)`
+ * and `bool remove(const char* path)`.
+ * The File type needs `write(const uint8_t*, size_t)`, `read(uint8_t*, size_t)`, `seek(uint32_t)`, `size()`,
+ * `truncate(uint32_t)`, `close()` and a conversion to bool.
+ */
+template <typename FS>
+class SampleLog {
+	FS& fs;
+
+	/// @brief The closed segments, oldest first.
+	LogSegment closed[LOG_MAX_SEGMENTS];
+	uint8_t closedCount = 0;
+
+	/// @brief The segment appends go to.
+	LogSegment current;
+	/// @brief The number of bytes of the current segment written to the file.
+	uint32_t currentSize = 0;
+
+	/// @brief Appends not yet written to the current segment.
+	uint8_t buffer[LOG_BUFFER_SIZE];
+	size_t buffered = 0;
+	/// @brief The time at which update first saw the buffered appends, 0 if not yet.
+	unsigned long long bufferedSince = 0;
+
+	static void putU32(uint8_t* out, uint32_t value) {
+		for(int i = 0; i < 4; i++) out[i] = value >> (8 * i);
+	}
+
+	static void putU64(uint8_t* out, uint64_t value) {
+		for(int i = 0; i < 8; i++) out[i] = value >> (8 * i);
+	}
+
+	static uint32_t getU32(const uint8_t* in) {
+		uint32_t value = 0;
+		for(int i = 3; i >= 0; i--) value = value << 8 | in[i];
+		return value;
+	}
+
+	static uint64_t getU64(const uint8_t* in) {
+		uint64_t value = 0;
+		for(int i = 7; i >= 0; i--) value = value << 8 | in[i];
+		return value;
+	}
+
+	static void encodeHeader(uint8_t* out, const LogRecord& record) {
+		putU64(out, record.time);
+		putU32(out + 8, record.sequence);
+		out[12] = record.preset;
+		out[13] = record.length;
+		out[14] = record.flags;
+	}
+
+	static void decodeHeader(const uint8_t* in, LogRecord& record) {
+		record.time = getU64(in);
+		record.sequence = getU32(in + 8);
+		record.preset = in[12];
+		record.length = in[13];
+		record.flags = in[14];
+	}
+
+	static void segmentPath(char* out, size_t size, uint32_t number) {
+		snprintf(out, size, LOG_DIR "/%u.bin", (unsigned int)number);
+	}
+
+	/// @brief Adds a record to the range of a segment.
+	static void extend(LogSegment& segment, const LogRecord& record) {
+		if(segment.count == 0) {
+			segment.firstTime = record.time;
+			segment.firstSequence = record.sequence;
+		}
+		segment.lastTime = record.time;
+		segment.lastSequence = record.sequence;
+		segment.count++;
+	}
+
+	/// @brief Writes the index of the closed segments.
+	/// @return 0 on success, -1 on failure, the previous index stays valid then.
+	int saveIndex() {
+		return loc::saveSlots(fs, LOG_DIR "/index.bin", [&](auto& writer) {
+			for(uint8_t i = 0; i < closedCount; i++) {
+				uint8_t entry[LogSegment::SIZE];
+				putU32(entry, closed[i].number);
+				putU32(entry + 4, closed[i].count);
+				putU64(entry + 8, closed[i].firstTime);
+				putU64(entry + 16, closed[i].lastTime);
+				putU32(entry + 24, closed[i].firstSequence);
+				putU32(entry + 28, closed[i].lastSequence);
+				writer.write(entry, sizeof(entry));
+			}
+		});
+	}
+
+	/// @brief Closes the current segment and starts the next one, removing the oldest segment if needed.
+	/// @return 0 on success, -1 on failure.
+	int rotate() {
+		if(closedCount == LOG_MAX_SEGMENTS) {
+			char path[32];
+			segmentPath(path, sizeof(path), closed[0].number);
+			fs.remove(path);
+			memmove(closed, closed + 1, sizeof(LogSegment) * (LOG_MAX_SEGMENTS - 1));
+			closedCount--;
+		}
+		closed[closedCount++] = current;
+		const uint32_t next = current.number + 1;
+		current = LogSegment();
+		current.number = next;
+		currentSize = 0;
+		return saveIndex();
+	}
+
+	/// @brief Finds the range of a segment by reading its records.
+	/// @return The number of bytes of complete records, a torn record at the end is ignored.
+	uint32_t scan(LogSegment& segment) {
+		char path[32];
+		segmentPath(path, sizeof(path), segment.number);
+		auto file = fs.open(path, "r");
+		if(!file) return 0;
+		const uint32_t size = file.size();
+		uint32_t offset = 0;
+		uint8_t header[LogRecord::HEADER_SIZE];
+		while(offset + LogRecord::HEADER_SIZE <= size) {
+			file.seek(offset);
+			if(file.read(header, sizeof(header)) != sizeof(header)) break;
+			LogRecord record;
+			decodeHeader(header, record);
+			if(offset + LogRecord::HEADER_SIZE + record.length > size) break;
+			extend(segment, record);
+			offset += LogRecord::HEADER_SIZE + record.length;
+		}
+		file.close();
+		return offset;
+	}
+public:
+	/// @param fs The filesystem, e.g. LittleFS. It has to be mounted before begin is called.
+	explicit SampleLog(FS& fs) : fs(fs) {}
+
+	/**
+	 * @brief Loads the index and finds the end of the current segment.
+	 * @return 0 on success, -1 if the index file is corrupt, in which case the log starts over from it.
+	 */
+	int begin() {
+		closedCount = 0;
+		buffered = 0;
+		bufferedSince = 0;
+		int result = 0;
+		const int loaded = loc::loadSlots(fs, LOG_DIR "/index.bin", [&](auto& reader) {
+			closedCount = 0;
+			const uint32_t size = reader.remaining;
+			if(size % LogSegment::SIZE != 0 || size / LogSegment::SIZE > LOG_MAX_SEGMENTS) return -1;
+			uint8_t entry[LogSegment::SIZE];
+			while(closedCount < size / LogSegment::SIZE && reader.read(entry, sizeof(entry)) == sizeof(entry)) {
+				LogSegment& segment = closed[closedCount++];
+				segment.number = getU32(entry);
+				segment.count = getU32(entry + 4);
+				segment.firstTime = getU64(entry + 8);
+				segment.lastTime = getU64(entry + 16);
+				segment.firstSequence = getU32(entry + 24);
+				segment.lastSequence = getU32(entry + 28);
+			}
+			return closedCount == size / LogSegment::SIZE ? 0 : -1;
+		});
+		if(loaded != 0) {
+			closedCount = 0;
+			// no index at all is a new log
+			if(loc::hasCopy(fs, LOG_DIR "/index.bin")) result = -1;
+		}
+		current = LogSegment();
+		current.number = closedCount > 0 ? closed[closedCount - 1].number + 1 : 0;
+		currentSize = scan(current);
+		return result;
+	}
+
+	/**
+	 * @brief Appends a sample to the RAM buffer, writing the buffer out first if the sample does not fit.
+	 * @param time Time of the result, in milliseconds since 1970-01-01 00:00:00.
+	 * @param sequence Sequence number of the sample.
+	 * @param preset Id of the preset that produced the result.
+	 * @param text The response text, truncated to 255 characters, or to what fits into the RAM buffer.
+	 * @return 0 on success, -1 if writing the buffer out or the index failed.
+	 * If the buffer could not be written out, the sample is dropped.
+	 */
+	int append(uint64_t time, uint32_t sequence, uint8_t preset, const char* text) {
+		LogRecord record;
+		record.time = time;
+		record.sequence = sequence;
+		record.preset = preset;
+		uint8_t packed[codec::PACKED_SIZE];
+		size_t length = codec::pack(text, packed);
+		if(length > 0) {
+			record.flags = LogRecord::PACKED;
+			text = (const char*)packed;
+		} else {
+			length = strlen(text);
+		}
+		const size_t maxLength = LOG_BUFFER_SIZE - LogRecord::HEADER_SIZE < 255 ? LOG_BUFFER_SIZE - LogRecord::HEADER_SIZE : 255;
+		record.length = length > maxLength ? maxLength : length;
+		const size_t size = LogRecord::HEADER_SIZE + record.length;
+
+		int result = 0;
+		if(currentSize + buffered + size > LOG_SEGMENT_SIZE) {
+			if(flush() != 0) return -1;
+			// the segments are still rotated in RAM, the index is written again with the next rotation
+			result = rotate();
+		} else if(buffered + size > LOG_BUFFER_SIZE) {
+			if(flush() != 0) return -1;
+		}
+		encodeHeader(buffer + buffered, record);
+		memcpy(buffer + buffered + LogRecord::HEADER_SIZE, text, record.length);
+		buffered += size;
+		extend(current, record);
+		return result;
+	}
+
+	/**
+	 * @brief Writes the buffered appends to the current segment.
+	 * @return 0 on success, -1 on failure, the appends stay buffered then.
+	 */
+	int flush() {
+		if(buffered == 0) return 0;
+		char path[32];
+		segmentPath(path, sizeof(path), current.number);
+		auto file = fs.open(path, "a");
+		if(!file) return -1;
+		// cut off a torn write of a previous flush or before a reset
+		if(file.size() != currentSize) file.truncate(currentSize);
+		const size_t written = file.write(buffer, buffered);
+		file.close();
+		// the records are written again with the next flush
+		if(written != buffered) return -1;
+		currentSize += buffered;
+		buffered = 0;
+		bufferedSince = 0;
+		return 0;
+	}
+
+	/**
+	 * @brief Writes the buffered appends out once they are LOG_FLUSH_MS old. Called from the main loop.
+	 * @param now The current time in milliseconds.
+	 * @return 0 on success, -1 if writing failed.
+	 */
+	int update(unsigned long long now) {
+		if(buffered == 0) return 0;
+		if(bufferedSince == 0) {
+			bufferedSince = now == 0 ? 1 : now;
+			return 0;
+		}
+		if(now - bufferedSince < LOG_FLUSH_MS) return 0;
+		return flush();
+	}
+
+	/// @brief The number of bytes waiting in the RAM buffer.
+	size_t getBuffered() const {
+		return buffered;
+	}
+
+	/// @brief The number of segments, including the current one.
+	unsigned int getSegmentCount() const {
+		return closedCount + 1;
+	}
+
+	/// @brief The index entry of a segment, the last one is the current segment.
+	/// @param i The position of the segment, 0 is the oldest.
+	const LogSegment& getSegment(unsigned int i) const {
+		return i < closedCount ? closed[i] : current;
+	}
+
+	/// @brief A cursor at the oldest record of the log.
+	LogCursor first() const {
+		LogCursor cursor;
+		cursor.segment = getSegment(0).number;
+		return cursor;
+	}
+
+	/// @brief Checks if a cursor points past the records written to the files,
+	/// e.g. a cursor saved before the log started over.
+	bool isPastEnd(const LogCursor& cursor) const {
+		return cursor.segment > current.number || (cursor.segment == current.number && cursor.offset > currentSize);
+	}
+
+	/**
+	 * @brief Finds the first segment that may hold records at or after a time.
+	 * @param time Time in milliseconds since 1970-01-01 00:00:00.
+	 * @return A cursor at the start of the segment.
+	 */
+	LogCursor find(uint64_t time) const {
+		LogCursor cursor;
+		cursor.segment = current.number;
+		for(uint8_t i = 0; i < closedCount; i++) {
+			if(closed[i].lastTime >= time) {
+				cursor.segment = closed[i].number;
+				break;
+			}
+		}
+		return cursor;
+	}
+
+	/**
+	 * @brief Reads records written to the files, starting at the cursor, and advances the cursor past them.
+	 * Buffered appends are not read, call flush first to include them.
+	 * A cursor in a removed segment is moved to the oldest segment.
+	 * @param cursor The position to read from.
+	 * @param maxRecords The maximum number of records to read.
+	 * @param visit Called with every record and its text, null terminated. A packed text is unpacked first.
+	 * Returns false to stop reading, the cursor then stays at that record.
+	 * @return The number of records read, -1 on a read error.
+	 */
+	template <typename Visitor>
+	int read(LogCursor& cursor, unsigned int maxRecords, Visitor visit) {
+		unsigned int count = 0;
+		if(cursor.segment < getSegment(0).number) {
+			cursor.segment = getSegment(0).number;
+			cursor.offset = 0;
+		}
+		while(count < maxRecords && cursor.segment <= current.number) {
+			char path[32];
+			segmentPath(path, sizeof(path), cursor.segment);
+			auto file = fs.open(path, "r");
+			const uint32_t size = !file ? 0 : cursor.segment == current.number ? currentSize : file.size();
+			if(file) file.seek(cursor.offset);
+			while(count < maxRecords && cursor.offset + LogRecord::HEADER_SIZE <= size) {
+				uint8_t header[LogRecord::HEADER_SIZE];
+				LogRecord record;
+				char text[256];
+				if(file.read(header, sizeof(header)) != sizeof(header)) {
+					file.close();
+					return -1;
+				}
+				decodeHeader(header, record);
+				if(file.read((uint8_t*)text, record.length) != record.length) {
+					file.close();
+					return -1;
+				}
+				text[record.length] = '\0';
+				if(record.flags & LogRecord::PACKED) {
+					uint8_t packed[codec::PACKED_SIZE];
+					memcpy(packed, text, record.length < sizeof(packed) ? record.length : sizeof(packed));
+					if(codec::unpack(packed, record.length, text, sizeof(text)) == 0) text[0] = '\0';
+				}
+				if(!visit(record, text)) {
+					file.close();
+					return count;
+				}
+				cursor.offset += LogRecord::HEADER_SIZE + record.length;
+				count++;
+			}
+			if(file) file.close();
+			if(count == maxRecords || cursor.segment == current.number) break;
+			cursor.segment++;
+			cursor.offset = 0;
+		}
+		return count;
+	}
+};
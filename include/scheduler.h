@@ -12,6 +12,7 @@
 #include <utility>
 #include "dataBuffer.h"
 #include "task.h"
+#include "taskQueue.h"
 // add a define to use this file in a native environment for logging
 #ifdef NATIVE_TEST
 	#include <stdio.h>
@@ -21,6 +22,31 @@
 #define SCHEDULER_SIZE 25
 #endif
 
+// Tasks with data keep it in a buffer from one of two pools, the small one is tried first.
+// Tasks without data take no buffer. Data larger than SCHEDULER_LARGE_DATA_SIZE, or data for a large buffer
+// when they are all taken, is kept in a block of the BlockAllocator of DataBuffer, if its blocks are enabled,
+// see blockPool.h.
+#ifndef SCHEDULER_SMALL_DATA_SIZE
+#define SCHEDULER_SMALL_DATA_SIZE 16
+#endif
+
+#ifndef SCHEDULER_SMALL_DATA_COUNT
+#define SCHEDULER_SMALL_DATA_COUNT SCHEDULER_SIZE
+#endif
+
+#ifndef SCHEDULER_LARGE_DATA_SIZE
+#define SCHEDULER_LARGE_DATA_SIZE 128
+#endif
+
+#ifndef SCHEDULER_LARGE_DATA_COUNT
+#define SCHEDULER_LARGE_DATA_COUNT 4
+#endif
+
+// The time in microseconds one update may spend running tasks, 0 for no limit.
+#ifndef SCHEDULER_BUDGET_US
+#define SCHEDULER_BUDGET_US 0
+#endif
+
 
 
 /// @brief General error codes for the scheduler.
@@ -30,91 +56,331 @@ enum SCH_ERR {
 	SCH_ERR_BAD_TASK_HASH = 0b10000100,
 	SCH_ERR_TASK_ALREADY_KILLED = 0b10001000,
 	SCH_ERR_NO_SPACE = 0b10010000,
-	SCH_ERR_UNRECOGNIZED_TASK_TYPE = 0b10100000
+	SCH_ERR_UNRECOGNIZED_TASK_TYPE = 0b10100000,
+	SCH_ERR_BUDGET_OVERRUN = 0b11000000
 };
 
 /// @brief The Scheduler class is used to schedule tasks.
 /// The Scheduler class is used to schedule tasks.
 /// The Scheduler class is microcontroller independent, so it can be used in a native environment.
+/// Set tasks are kept in a deadline-ordered queue, so an update that has nothing to run
+/// only looks at the earliest deadline instead of the whole task list.
 class Scheduler {
 private:
 	/// @brief The array of tasks.
 	Task taskList[SCHEDULER_SIZE];
+
+	typedef DataBufferPool<SCHEDULER_SMALL_DATA_SIZE, SCHEDULER_SMALL_DATA_COUNT> SmallDataPool;
+	typedef DataBufferPool<SCHEDULER_LARGE_DATA_SIZE, SCHEDULER_LARGE_DATA_COUNT> LargeDataPool;
+
+	/// @brief The buffers for the data of tasks, by size.
+	SmallDataPool smallData;
+	LargeDataPool largeData;
+
+	/// @brief The set tasks, ordered by the time they next have to be looked at.
+	TaskQueue<SCHEDULER_SIZE> queue;
+
+	/// @brief The tasks taken from the queue during the current update.
+	uint16_t dueList[SCHEDULER_SIZE];
+
+	/// @brief Value of freeHead and nextFree marking the end of the free list.
+	static const uint16_t FREE_LIST_END = 0xFFFF;
+
+	/// @brief The first empty task slot, or FREE_LIST_END if the scheduler is full.
+	uint16_t freeHead;
+
+	/// @brief The empty slot following each empty slot in the free list.
+	uint16_t nextFree[SCHEDULER_SIZE];
+
+	/// @brief The number of set tasks.
+	unsigned int taskCount = 0;
+
+	/// @brief Puts every slot in the free list, in index order.
+	void resetFreeList() {
+		for(unsigned int i = 0; i < SCHEDULER_SIZE; i++) {
+			nextFree[i] = i + 1 < SCHEDULER_SIZE ? i + 1 : FREE_LIST_END;
+		}
+		freeHead = 0;
+		taskCount = 0;
+	}
+
+	/// @brief Takes an empty slot from the free list.
+	/// @return index of the slot, or -1 if there are no empty slots.
+	int allocate() {
+		if(freeHead == FREE_LIST_END) return -1;
+		const unsigned int i = freeHead;
+		freeHead = nextFree[i];
+		taskCount++;
+		return i;
+	}
+
+	/// @brief Takes an empty slot from the free list, with a data buffer that fits T.
+	/// @return index of the slot, or -1 if there are no empty slots or data buffers.
+	template <typename T>
+	int allocateWithData() {
+		typedef typename std::remove_reference<T>::type TRaw;
+		static_assert(SmallDataPool::template canHold<TRaw>() || LargeDataPool::template canHold<TRaw>(),
+			"The data does not fit into a task data buffer nor into a block, increase SCHEDULER_LARGE_DATA_SIZE or enable the blocks with BLOCK_POOL_LARGE_COUNT");
+		DataBuffer* buffer = nullptr;
+		// data too large for both pools is kept in a block, and a small buffer only holds the pointer to it
+		if constexpr (SmallDataPool::template fits<TRaw>()
+				|| (!LargeDataPool::template fits<TRaw>() && SmallDataPool::template canHold<TRaw>())) {
+			buffer = smallData.take();
+		}
+		if(buffer == nullptr) buffer = largeData.take();
+		// with the large buffers taken, data for them is kept in a block behind a small buffer
+		if constexpr (!SmallDataPool::template fits<TRaw>() && SmallDataPool::template canHold<TRaw>()) {
+			if(buffer == nullptr) buffer = smallData.take();
+		}
+		if(buffer == nullptr) return -1;
+		const int i = allocate();
+		if(i < 0) {
+			giveBuffer(buffer);
+			return -1;
+		}
+		taskList[i].data = buffer;
+		return i;
+	}
+
+	/// @brief Returns a data buffer to its pool.
+	void giveBuffer(DataBuffer* buffer) {
+		if(!smallData.give(buffer)) largeData.give(buffer);
+	}
+
+	/// @brief Clears the task and returns its slot and its data buffer to the free lists.
+	/// @param i index of the task.
+	/// @return false if the teardown function was not formed correctly.
+	bool release(unsigned int i) {
+		queue.remove(i);
+		const bool cleared = taskList[i].clear();
+		if(taskList[i].data != nullptr) {
+			giveBuffer(taskList[i].data);
+			taskList[i].data = nullptr;
+		}
+		nextFree[i] = freeHead;
+		freeHead = i;
+		taskCount--;
+		return cleared;
+	}
+
+	/// @brief The time in microseconds one update may spend running tasks, 0 for no limit.
+	unsigned long budget = SCHEDULER_BUDGET_US;
+
+	/// @brief The microsecond clock the budget is measured with.
+	unsigned long (*budgetClock)(void) = nullptr;
+
+	/// @brief The task that is currently being run, used by yield.
+	static inline Task* runningTask = nullptr;
+
+	/// @brief The time of the current or the last update, see getUpdateTime.
+	static inline unsigned long long updateTime = 0;
+
+	/// @brief Runs one step of the task.
+	/// @param task The task to run.
+	/// @return true if the task called yield, and has to be resumed on the next update.
+	bool runStep(Task& task) {
+		task.inProgress = false;
+		Task* const previous = runningTask;
+		runningTask = &task;
+		task.run();
+		runningTask = previous;
+		return task.isSet() && task.inProgress;
+	}
+
+	/// @brief Runs a task taken from the queue, and queues it again if it is not finished.
+	/// @param i index of the task.
+	/// @param time The current time.
+	/// @return Error code.
+	uint16_t runDueTask(unsigned int i, unsigned long long time) {
+		Task& task = taskList[i];
+
+		// Tasks to be run once
+		if (task.type == TaskType::Once) {
+			if(runStep(task)) {
+				queue.push(i, task.nextDeadline());
+				return 0;
+			}
+			// the task killed itself, and its slot might already be reused
+			if(!task.isSet() || queue.contains(i)) return 0;
+			// handle teardown and clearing of data
+			if(!release(i)) {
+				// if the data is not cleared, the teardown function was not formed correctly
+				#ifdef NATIVE_TEST
+					printf("Tear down function was not formed correctly\n");
+				#endif
+				return SCH_ERR_BAD_TEARDOWN;
+			}
+			return 0;
+		}
+
+		// Tasks to be run repeatedly
+		if(task.type == TaskType::Repeat) {
+			if(task.inProgress || task.advance(time)) runStep(task);
+			if(task.isSet() && !queue.contains(i)) queue.push(i, task.nextDeadline());
+			return 0;
+		}
+
+		// Tasks to be run until a certain time
+		if(task.type == TaskType::RepeatUntil) {
+			// check if the task should be removed before executing it,
+			// a run that yielded is finished first
+			if (!task.inProgress && task.endTimestamp < time) {
+				if(!release(i)){
+					// if the data is not cleared, the teardown function was not formed correctly
+					#ifdef NATIVE_TEST
+						printf("Tear down function was not formed correctly\n");
+					#endif
+					return SCH_ERR_BAD_TEARDOWN;
+				}
+				return 0;
+			}
+			if(task.inProgress || task.advance(time)) runStep(task);
+			if(task.isSet() && !queue.contains(i)) queue.push(i, task.nextDeadline());
+			return 0;
+		}
+
+		// if the task type is not recognized, return an error
+		return SCH_ERR_UNRECOGNIZED_TASK_TYPE;
+	}
+
+	/// @brief Checks that the task hash belongs to a task that is still set.
+	/// @param taskHash The task hash returned when scheduling the task.
+	/// @return 0 if the task exists, error code otherwise.
+	int checkTaskHash(int taskHash) {
+		const int index = taskHash % SCHEDULER_SIZE;
+		if (!taskList[index].isSet()) {
+			return SCH_ERR_TASK_ALREADY_KILLED;
+		}
+		// check if the task hash is correct, if not, the task was already killed
+		if(getTaskHash(index) != taskHash) {
+			return SCH_ERR_BAD_TASK_HASH;
+		}
+		return 0;
+	}
+
+	/// @brief Queues a freshly set task, or releases it if it got no function, e.g. from a null function pointer.
+	/// @param i index of the task.
+	/// @return The task hash, or -1.
+	int enqueue(unsigned int i) {
+		if(!taskList[i].isSet()) {
+			release(i);
+			return -1;
+		}
+		queue.push(i, taskList[i].nextDeadline());
+		return getTaskHash(i);
+	}
+
+	/// @brief Queues a freshly set task with data, or releases it if its data could not be set,
+	/// because there was no free block for it.
+	/// @param i index of the task.
+	/// @return The task hash, or -1.
+	int enqueueWithData(unsigned int i) {
+		if(!taskList[i].data->isDataSet()) {
+			release(i);
+			return -1;
+		}
+		return enqueue(i);
+	}
 public:
 	Scheduler() {
 		for(unsigned int i = 0; i < SCHEDULER_SIZE; i++) {
-			taskList[i].functionWithBuffer = nullptr;
 			taskList[i].runCount = 0;
 		}
+		resetFreeList();
+	}
+
+	/// @brief Marks the run of the currently running task as unfinished.
+	/// Called from inside a task function that has to wait for something, e.g. serial data.
+	/// The task function should return right after calling this.
+	/// It is called again on the next update, with the same data, without advancing the task's period,
+	/// so it can continue where it left off, using state kept in its DataBuffer.
+	/// Does nothing if called outside of a task function.
+	static void yield() {
+		if(runningTask != nullptr) runningTask->inProgress = true;
+	}
+
+	/// @brief The time passed to the current update, e.g. to schedule a follow-up task from inside a task function.
+	static unsigned long long getUpdateTime() {
+		return updateTime;
+	}
+
+	/// @brief Limits the time one update spends running tasks.
+	/// Due tasks that do not fit into the budget are left for the next update.
+	/// At least one task is run per update, so a single slow task is not deferred forever.
+	/// @param budget The budget in microseconds, 0 for no limit.
+	/// @param clock Function returning the current time in microseconds, e.g. micros.
+	void setBudget(unsigned long budget, unsigned long (*clock)(void)) {
+		this->budget = budget;
+		budgetClock = clock;
 	}
 
 	/// @brief Checks if the task should be run, and runs it if necessary.
+	/// Due tasks are run from the highest to the lowest priority,
+	/// and in deadline order within the same priority.
 	/// @param time The current time.
 	/// @return Error code.
 	uint16_t update(unsigned long long time) {
 		uint16_t errCode = 0;
-		// check scheduled tasks
-		for(unsigned int i = 0; i < SCHEDULER_SIZE; i++) {
-			Task& task = taskList[i];
-			if (!task.isSet()) continue;
-
-			// Tasks to be run once
-			if (task.type == TaskType::Once) {
-				if (task.startTimestamp + task.period < time) {
-					task.run();
-					// handle teardown and clearing of data
-					if(!task.clear()) {
-						// if the data is not cleared, the teardown function was not formed correctly
-						#ifdef NATIVE_TEST
-							printf("Tear down function was not formed correctly\n");
-						#endif
-						errCode |= SCH_ERR_BAD_TEARDOWN;
-					}
-				}
-				continue;
+		updateTime = time;
+		// take every task that has to be looked at from the queue first,
+		// so a task that is still behind schedule after running only runs once per update
+		unsigned int dueCount = 0;
+		while(!queue.isEmpty() && queue.topDeadline() <= time) {
+			dueList[dueCount++] = queue.top();
+			queue.pop();
+		}
+
+		// stable insertion sort by priority, usually there is only one due task
+		// or all of them have the same priority, so this does not move anything
+		for(unsigned int d = 1; d < dueCount; d++) {
+			const uint16_t i = dueList[d];
+			unsigned int k = d;
+			while(k > 0 && taskList[dueList[k - 1]].priority < taskList[i].priority) {
+				dueList[k] = dueList[k - 1];
+				k--;
 			}
+			dueList[k] = i;
+		}
 
-			// Tasks to be run repeatedly
-			if(task.type == TaskType::Repeat) {
-				const long timeSinceStart = ((long long)(time) - (long long)task.startTimestamp);
-				const long repeatIndex = timeSinceStart/(long long)task.period;
-				if (repeatIndex > task.lastIndex) {
-					task.lastIndex++;
-					task.run();
-				}
-				continue;
-			} 
-			
-			// Tasks to be run until a certain time
-			if(task.type == TaskType::RepeatUntil) {
-				const long timeSinceStart = ((long long)(time) - (long long)task.startTimestamp);
-				const long repeatIndex = timeSinceStart/(long long)task.period;
-				// check if the task should be removed before executing it
-				if (task.endTimestamp < time) {
-					if(!task.clear()){
-						// if the data is not cleared, the teardown function was not formed correctly
-						#ifdef NATIVE_TEST
-							printf("Tear down function was not formed correctly\n");
-						#endif
-						errCode |= SCH_ERR_BAD_TEARDOWN;
-					}
-					continue;
-				}
-				if (repeatIndex > task.lastIndex) {
-					task.lastIndex++;
-					task.run();
-				}
+		const bool limited = budget > 0 && budgetClock != nullptr;
+		const unsigned long updateStart = limited ? budgetClock() : 0;
+		bool overrun = false;
+		for(unsigned int d = 0; d < dueCount; d++) {
+			const unsigned int i = dueList[d];
+			Task& task = taskList[i];
+			// the task was killed or replaced by a previously run task
+			if (!task.isSet() || queue.contains(i)) continue;
+
+			if(overrun) {
+				// still due, so it is taken from the queue again on the next update
+				queue.push(i, task.nextDeadline());
 				continue;
 			}
-			
-			// if the task type is not recognized, return an error
-			errCode |= SCH_ERR_UNRECOGNIZED_TASK_TYPE;
-			continue;
-
+			errCode |= runDueTask(i, time);
+			if(limited && budgetClock() - updateStart >= budget) {
+				overrun = true;
+			}
+		}
+		if(overrun) {
+			#ifdef NATIVE_TEST
+				printf("Scheduler update exceeded its time budget\n");
+			#endif
+			errCode |= SCH_ERR_BUDGET_OVERRUN;
 		}
 		return errCode;
 	}
 
+	/// @brief Returned by nextDeadline when there are no tasks.
+	static const unsigned long long NO_DEADLINE = ~0ULL;
+
+	/// @brief The earliest time at which update has something to do.
+	/// Calling update before this time does nothing, so the caller can sleep until then.
+	/// @return The deadline, or NO_DEADLINE if there are no tasks.
+	unsigned long long nextDeadline() const {
+		if(queue.isEmpty()) return NO_DEADLINE;
+		return queue.topDeadline();
+	}
+
 	/// @brief Fetches the task hash for the task at the specified index.
 	/// @param i index of the task.
 	/// @return The task hash.
@@ -123,151 +389,102 @@ public:
 	}
 
 	/// @brief Schedules a task to be run once.
-	int schedule(void (*func)(void), unsigned long startTimestamp) {
-		//Serial.println("schedule");
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask(func, startTimestamp);
-				return getTaskHash(i);
-			}
-		}
-		// since there wasn't any space for the task, return an error
-		return -1;
-	}
-
-	/// @brief Schedules a task to be run once with data.
-	template <typename T>
-	int schedule(void (*func)(DataBuffer&), unsigned long startTimestamp, typename std::remove_reference<T>::type&& data) {
-		//Serial.println("schedule with moved data");
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask<T>(func, startTimestamp, std::move(data));
-				return getTaskHash(i);
-			}
-		}
+	/// @param func Any callable taking a DataBuffer& or nothing, e.g. a function pointer or a lambda with captures
+	/// that fit into TASK_FUNCTION_SIZE.
+	/// @return The task hash, or -1 if there is no space.
+	template <typename F>
+	int schedule(F&& func, unsigned long long startTimestamp) {
+		const int i = allocate();
 		// since there wasn't any space for the task, return an error
-		return -1;
+		if (i < 0) return -1;
+		taskList[i].updateTask(std::forward<F>(func), TaskType::Once, startTimestamp);
+		return enqueue(i);
 	}
 
-	/// @brief Schedules a task to be run once with data.
-	template <typename T>
-	int schedule(void (*func)(DataBuffer&), unsigned long startTimestamp, const typename std::remove_reference<T>::type& data) {
-		//Serial.println("schedule with copied data");
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask<T>(func, startTimestamp, data);
-				return getTaskHash(i);
-			}
-		}
-		// since there wasn't any space for the task, return an error
-		return -1;
+	/// @brief Schedules a task to be run once with data, copied or moved into the task's DataBuffer.
+	/// @tparam T The type of the data, given explicitly.
+	template <typename T, typename F, typename D>
+	int schedule(F&& func, unsigned long long startTimestamp, D&& data) {
+		const int i = allocateWithData<T>();
+		// since there wasn't any space for the task or its data, return an error
+		if (i < 0) return -1;
+		taskList[i].updateTask<T>(std::forward<F>(func), TaskType::Once, startTimestamp, 0, 0, std::forward<D>(data));
+		return enqueueWithData(i);
 	}
 	
 	/// @brief Clears all tasks, clearing the data and calling the teardown function in the process.
 	void clearTasks() {
 		for(unsigned int i = 0; i< SCHEDULER_SIZE; i++) {
 			taskList[i].clear();
+			taskList[i].data = nullptr;
 		}
+		smallData.reset();
+		largeData.reset();
+		queue.clear();
+		resetFreeList();
 	}
 
-	int scheduleRepeat(void (*func)(void), unsigned long period, unsigned long startTimestamp) {
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask(func, startTimestamp, period);
-				return getTaskHash(i);
-			}
-		}
+	/// @brief Schedules a task to be run every period, starting at startTimestamp.
+	template <typename F>
+	int scheduleRepeat(F&& func, unsigned long long period, unsigned long long startTimestamp) {
+		const int i = allocate();
 		// since there wasn't any space for the task, return an error
-		return -1;
+		if (i < 0) return -1;
+		taskList[i].updateTask(std::forward<F>(func), TaskType::Repeat, startTimestamp, period);
+		return enqueue(i);
 	}
 
-	template <typename T>
-	int scheduleRepeat(void (*func)(DataBuffer&), unsigned long period, unsigned long startTimestamp, typename std::remove_reference<T>::type&& data) {
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask<T>(func, startTimestamp, period, std::move(data));
-				return getTaskHash(i);
-			}
-		}
-		// since there wasn't any space for the task, return an error
-		return -1;
+	/// @brief Schedules a task to be run every period with data, copied or moved into the task's DataBuffer.
+	/// @tparam T The type of the data, given explicitly.
+	template <typename T, typename F, typename D>
+	int scheduleRepeat(F&& func, unsigned long long period, unsigned long long startTimestamp, D&& data) {
+		const int i = allocateWithData<T>();
+		// since there wasn't any space for the task or its data, return an error
+		if (i < 0) return -1;
+		taskList[i].updateTask<T>(std::forward<F>(func), TaskType::Repeat, startTimestamp, period, 0, std::forward<D>(data));
+		return enqueueWithData(i);
 	}
 
-	
-	// overwrites a repeat task
-	template <typename T>
-	int scheduleRepeat(void (*func)(DataBuffer&), unsigned long period, unsigned long startTimestamp, const typename std::remove_reference<T>::type& data) {
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask(func, startTimestamp, period, data);
-				return getTaskHash(i);
-			}
-		}
-		// since there wasn't any space for the task, return an error
-		return SCH_ERR_NO_SPACE;
-	}
-	
-	int scheduleRepeatUntil(void (*func)(void), unsigned long period, unsigned long startTimestamp, unsigned long endTimestamp) {
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask(func, startTimestamp, period, endTimestamp);
-				return getTaskHash(i);
-			}
-		}
+	/// @brief Schedules a task to be run every period, until endTimestamp.
+	template <typename F>
+	int scheduleRepeatUntil(F&& func, unsigned long long period, unsigned long long startTimestamp, unsigned long long endTimestamp) {
+		const int i = allocate();
 		// since there wasn't any space for the task, return an error
-		return -1;
+		if (i < 0) return -1;
+		taskList[i].updateTask(std::forward<F>(func), TaskType::RepeatUntil, startTimestamp, period, endTimestamp);
+		return enqueue(i);
 	}
 
-	template <typename T>
-	int scheduleRepeatUntil(void (*func)(DataBuffer&), unsigned long period, unsigned long startTimestamp, unsigned long endTimestamp, typename std::remove_reference<T>::type&& data) {
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask<T>(func, startTimestamp, period, endTimestamp, std::move(data));
-				return getTaskHash(i);
-			}
-		}
-		// since there wasn't any space for the task, return an error
-		return -1;
+	/// @brief Schedules a task to be run every period until endTimestamp with data,
+	/// copied or moved into the task's DataBuffer.
+	/// @tparam T The type of the data, given explicitly.
+	template <typename T, typename F, typename D>
+	int scheduleRepeatUntil(F&& func, unsigned long long period, unsigned long long startTimestamp, unsigned long long endTimestamp, D&& data) {
+		const int i = allocateWithData<T>();
+		// since there wasn't any space for the task or its data, return an error
+		if (i < 0) return -1;
+		taskList[i].updateTask<T>(std::forward<F>(func), TaskType::RepeatUntil, startTimestamp, period, endTimestamp, std::forward<D>(data));
+		return enqueueWithData(i);
 	}
 
-	
-	template <typename T>
-	int scheduleRepeatUntil(void (*func)(DataBuffer&), unsigned long period, unsigned long startTimestamp, unsigned long endTimestamp, const typename std::remove_reference<T>::type& data) {
-		for(unsigned int i = 0; i< SCHEDULER_SIZE;i++) {
-			if (!taskList[i].isSet()) {
-				taskList[i].updateTask(func, startTimestamp, period, endTimestamp, data);
-				return getTaskHash(i);
-			}
-		}
-		// since there wasn't any space for the task, return an error
-		return SCH_ERR_NO_SPACE;
-	}
-	
-
 	const Task* getTasks() const {
 		return taskList;
 	}
 
 	unsigned int getTaskCount() const {
-		unsigned int count = 0;
-		for(unsigned int i = 0; i< SCHEDULER_SIZE; i++) {
-			if (taskList[i].functionWithBuffer != nullptr || taskList[i].function != nullptr) {
-				count++;
-			}
-		}
-		return count;
+		return taskCount;
+	}
+
+	/// @brief The number of data buffers taken by tasks, from both pools.
+	unsigned int getDataBufferCount() const {
+		return smallData.getUsed() + largeData.getUsed();
 	}
 
 	int killTask(int taskHash) {
+		const int err = checkTaskHash(taskHash);
+		if(err != 0) return err;
 		const int index = taskHash % SCHEDULER_SIZE;
-		if (taskList[index].functionWithBuffer == nullptr && taskList[index].function == nullptr) {
-			return SCH_ERR_TASK_ALREADY_KILLED;
-		}
-		// check if the task hash is correct, if not, the task was already killed
-		if(getTaskHash(index) != taskHash) {
-			return SCH_ERR_BAD_TASK_HASH;
-		}
-		if(!taskList[index].clear()) {
+		if(!release(index)) {
 			// if the data is not cleared, the teardown function was not formed correctly
 			#ifdef NATIVE_TEST
 				printf("Tear down function was not formed correctly\n");
@@ -276,4 +493,27 @@ public:
 		}
 		return 0;
 	}
+
+	/// @brief Sets what a repeating task does when update was not called for one or more of its periods.
+	/// Tasks start with CatchUp::RunAll.
+	/// @param taskHash The task hash returned when scheduling the task.
+	/// @param catchUp The catch-up policy.
+	/// @return 0 on success, error code otherwise.
+	int setCatchUp(int taskHash, CatchUp catchUp) {
+		const int err = checkTaskHash(taskHash);
+		if(err != 0) return err;
+		taskList[taskHash % SCHEDULER_SIZE].catchUp = catchUp;
+		return 0;
+	}
+
+	/// @brief Sets the priority of a task. Tasks start with Priority::Normal.
+	/// @param taskHash The task hash returned when scheduling the task.
+	/// @param priority The priority.
+	/// @return 0 on success, error code otherwise.
+	int setPriority(int taskHash, Priority priority) {
+		const int err = checkTaskHash(taskHash);
+		if(err != 0) return err;
+		taskList[taskHash % SCHEDULER_SIZE].priority = priority;
+		return 0;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,118 @@
+/**
+ * @file scpiBatch.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains functions for sending several SCPI commands in one serial round trip.
+ *
+ * The commands are joined into one program message, separated by ';' as defined by SCPI,
+ * and the responses of the queries come back as one line, also separated by ';'.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <string.h>
+#include <stddef.h>
+
+namespace scpi {
+
+	/// @brief Checks if the command is a query, i.e. its header ends with '?'.
+	inline bool isQuery(const char* command) {
+		for(; *command != '\0' && *command != ' '; command++) {
+			if(*command == '?') return true;
+		}
+		return false;
+	}
+
+	/**
+	 * @brief Checks if every command of a program message is a query, so sending it changes nothing on the instrument.
+	 * The message is split at ';' outside of quoted strings.
+	 * @param message The program message, e.g. "*IDN?;:SYST:ERR?".
+	 * @return false if any of the commands is not a query, or the message is empty.
+	 */
+	inline bool isQueryOnly(const char* message) {
+		bool query = false;
+		bool start = true;
+		char quote = '\0';
+		for(const char* c = message; *c != '\0'; c++) {
+			if(quote != '\0') {
+				if(*c == quote) quote = '\0';
+				continue;
+			}
+			if(start) {
+				if(*c == ' ') continue;
+				// the header of the next command ends at a space or at the separator
+				const char* header = c;
+				while(*header != '\0' && *header != ' ' && *header != ';' && *header != '?') header++;
+				if(*header != '?') return false;
+				start = false;
+				query = true;
+			}
+			if(*c == '"' || *c == '\'') {
+				quote = *c;
+			} else if(*c == ';') {
+				start = true;
+			}
+		}
+		return query && !start;
+	}
+
+	/**
+	 * @brief Joins commands into one SCPI program message.
+	 * Commands after the first one are prefixed with ':', unless they are common commands (starting with '*')
+	 * or already start with ':', so every command is resolved from the root of the command tree.
+	 * Trailing EOL characters of the commands are dropped.
+	 * @param out The buffer to write the message to.
+	 * @param size The size of the buffer.
+	 * @param commands The commands to join.
+	 * @param count The number of commands.
+	 * @return The length of the message, or 0 if it does not fit into the buffer.
+	 */
+	inline size_t joinCommands(char* out, size_t size, const char* const* commands, size_t count) {
+		size_t length = 0;
+		for(size_t i = 0; i < count; i++) {
+			const char* command = commands[i];
+			size_t commandLength = strlen(command);
+			while(commandLength > 0 && (command[commandLength - 1] == '\r' || command[commandLength - 1] == '\n')) {
+				commandLength--;
+			}
+			const bool prefix = i > 0 && command[0] != ':' && command[0] != '*';
+			const size_t needed = (i > 0 ? 1 : 0) + (prefix ? 1 : 0) + commandLength;
+			if(length + needed + 1 > size) return 0;
+			if(i > 0) out[length++] = ';';
+			if(prefix) out[length++] = ':';
+			memcpy(out + length, command, commandLength);
+			length += commandLength;
+		}
+		out[length] = '\0';
+		return length;
+	}
+
+	/**
+	 * @brief Splits a response line into the responses of the individual queries, in place.
+	 * The separators are replaced with null terminators. Separators inside quoted strings are ignored.
+	 * @param response The response line, modified in place.
+	 * @param parts Filled with pointers to the individual responses.
+	 * @param maxParts The size of the parts array.
+	 * @return The number of responses. Responses past maxParts are left joined in the last part.
+	 */
+	inline size_t splitResponses(char* response, const char** parts, size_t maxParts) {
+		if(maxParts == 0) return 0;
+		size_t count = 0;
+		parts[count++] = response;
+		char quote = '\0';
+		for(char* c = response; *c != '\0'; c++) {
+			if(quote != '\0') {
+				if(*c == quote) quote = '\0';
+				continue;
+			}
+			if(*c == '"' || *c == '\'') {
+				quote = *c;
+				continue;
+			}
+			if(*c == ';' && count < maxParts) {
+				*c = '\0';
+				parts[count++] = c + 1;
+			}
+		}
+		return count;
+	}
+}
@@ -0,0 +1,478 @@
+/**
+ * @file serialTransport.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the SerialTransport class, a non-blocking transport for SCPI traffic.
+ *
+ * Commands are queued as transactions. Their bytes are buffered in a TX ring buffer,
+ * which is drained into the serial port from the main loop as the port can take them.
+ * Received bytes are moved from the port into an RX ring buffer on every update, whether or not
+ * a transaction is reading yet, so the small UART FIFO does not overrun. From there they are split
+ * into lines by a LineFramer, and the first line after a command is its response. The caller gets a handle to poll, or a completion callback.
+ * Binary block responses are read by a BlockParser instead, and their payload is handed
+ * to a sink as it arrives, without being buffered.
+ * Identical queries submitted while one is in flight can share its transaction and response.
+ *
+ * The port is a template parameter with the Arduino Stream interface
+ * (available, read, availableForWrite, write), so a mock UART can be used in a native environment.
+ * This file is microcontroller independent, so it can be used in a native environment for testing.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "ringBuffer.h"
+#include "blockParser.h"
+
+// Size of the buffer for bytes waiting to be sent, has to be a power of two.
+#ifndef TRANSPORT_TX_SIZE
+#define TRANSPORT_TX_SIZE 256
+#endif
+
+// Size of the buffer for received bytes not read by a transaction yet, has to be a power of two.
+#ifndef TRANSPORT_RX_SIZE
+#define TRANSPORT_RX_SIZE 256
+#endif
+
+// Maximum number of transactions in flight, has to be a power of two.
+#ifndef TRANSPORT_QUEUE_SIZE
+#define TRANSPORT_QUEUE_SIZE 4
+#endif
+
+// Maximum length of a response line, including the null terminator.
+// Longer responses are truncated.
+#ifndef TRANSPORT_RESPONSE_SIZE
+#define TRANSPORT_RESPONSE_SIZE 128
+#endif
+
+// Maximum number of block payload bytes read from the port and handed to the sink at once.
+#ifndef TRANSPORT_BLOCK_CHUNK
+#define TRANSPORT_BLOCK_CHUNK 64
+#endif
+
+// Maximum length of a shared command with its terminator, including the null terminator.
+// Longer commands always get their own transaction.
+#ifndef TRANSPORT_SHARE_SIZE
+#define TRANSPORT_SHARE_SIZE 32
+#endif
+
+namespace transport {
+
+	/// @brief Detects the end of a line in a stream of bytes.
+	/// The EOL is a sequence of up to 2 characters, as in cfg::PresetFile::Serial::EOL.
+	struct LineFramer {
+		/// @brief The EOL sequence, null terminated.
+		char EOL[3] = "\n";
+
+		/// @brief The last two bytes fed.
+		char tail[2] = {0, 0};
+
+		LineFramer() {}
+
+		/// @param EOL The EOL sequence, e.g. cfg::PresetFile::Serial::EOL. Defaults to "\n" if empty.
+		explicit LineFramer(const char* EOL) {
+			if(EOL == nullptr || EOL[0] == '\0') return;
+			strncpy(this->EOL, EOL, sizeof(this->EOL) - 1);
+			this->EOL[sizeof(this->EOL) - 1] = '\0';
+		}
+
+		/// @brief The length of the EOL sequence.
+		unsigned int length() const {
+			return EOL[1] == '\0' ? 1 : 2;
+		}
+
+		/// @brief Forgets the previously fed bytes.
+		void reset() {
+			tail[0] = 0;
+			tail[1] = 0;
+		}
+
+		/// @brief Feeds one byte.
+		/// @return true if the byte completes the EOL sequence.
+		bool feed(char c) {
+			tail[0] = tail[1];
+			tail[1] = c;
+			if(EOL[1] == '\0') return c == EOL[0];
+			return tail[0] == EOL[0] && tail[1] == EOL[1];
+		}
+	};
+
+	/// @brief State of a transaction.
+	enum class Status : uint8_t {
+		/// @brief The transaction slot is not used.
+		Free,
+		/// @brief The command is being sent, or the response is being received.
+		Pending,
+		/// @brief The command was sent, and the response, if expected, received.
+		Done,
+		/// @brief No response was received in time.
+		TimedOut,
+		/// @brief The block response is malformed.
+		Malformed
+	};
+
+	/// @brief A command and its response.
+	struct Transaction {
+		Status status = Status::Free;
+		bool expectResponse = false;
+		/// @brief All bytes of the command have been written to the port.
+		bool sent = false;
+		/// @brief The last received byte was stored in the response.
+		bool lastStored = false;
+		/// @brief Incremented every time the slot is reused, to make handles unique.
+		uint8_t generation = 0;
+		/// @brief The number of callers holding the handle, each one releases it once.
+		uint8_t owners = 0;
+		/// @brief The bytes sent, command and terminator, if the transaction can be shared, else empty.
+		char shareKey[TRANSPORT_SHARE_SIZE];
+		/// @brief The number of bytes ever written to the port after the last byte of the command.
+		uint32_t txEnd = 0;
+		/// @brief Response timeout in milliseconds, counted from when the command has been sent.
+		unsigned long timeout = 0;
+		/// @brief The time at which the command has been sent.
+		/// For block responses, the time at which the last byte has been received.
+		unsigned long long sentAt = 0;
+		LineFramer framer;
+		/// @brief The response is a binary block, read by the parser and handed to the sink.
+		bool block = false;
+		BlockParser parser;
+		/// @brief Receives the block payload, together with the context.
+		BlockSink sink = nullptr;
+		/// @brief Length of the response, without the EOL.
+		uint16_t length = 0;
+		/// @brief The response, null terminated, without the EOL.
+		char response[TRANSPORT_RESPONSE_SIZE];
+		/// @brief Called when the transaction is finished. The transaction is freed after the call.
+		void (*onComplete)(const Transaction& transaction, void* context) = nullptr;
+		void* context = nullptr;
+	};
+
+	/// @brief The longest command that fits into the TX buffer of an idle transport together with the terminator.
+	/// @param terminator The terminator sent after the command, can be nullptr.
+	inline size_t maxCommandLength(const char* terminator) {
+		return TRANSPORT_TX_SIZE - (terminator == nullptr ? 0 : strlen(terminator));
+	}
+
+	/**
+	 * @brief Non-blocking command/response transport over a serial port.
+	 * @tparam Port Type with the Arduino Stream interface:
+	 * `int available()`, `int read()`, `int availableForWrite()` and `size_t write(uint8_t)`.
+	 */
+	template <typename Port>
+	class SerialTransport {
+		/// @brief The serial port.
+		Port& port;
+
+		/// @brief Bytes waiting to be written to the port.
+		RingBuffer<uint8_t, TRANSPORT_TX_SIZE> tx;
+
+		/// @brief The number of bytes ever written to the port, modulo 2^32.
+		uint32_t txWritten = 0;
+
+		/// @brief The most space the port ever reported for writing, the size of its TX FIFO.
+		int fifoSize = 0;
+
+		/// @brief Bytes received from the port and not read by a transaction yet.
+		RingBuffer<uint8_t, TRANSPORT_RX_SIZE> rx;
+
+		/// @brief The transaction slots.
+		Transaction transactions[TRANSPORT_QUEUE_SIZE];
+
+		/// @brief Pending transactions in the order they were submitted.
+		/// The first one is the one receiving a response.
+		RingBuffer<uint8_t, TRANSPORT_QUEUE_SIZE> pending;
+
+		/// @brief The number of submissions that joined a transaction in flight.
+		unsigned long joined = 0;
+
+		int getHandle(unsigned int i) const {
+			return transactions[i].generation * TRANSPORT_QUEUE_SIZE + i;
+		}
+
+		void free(Transaction& transaction) {
+			transaction.status = Status::Free;
+			transaction.generation++;
+		}
+
+		/// @brief Finishes the first pending transaction.
+		void complete(Status status) {
+			Transaction& transaction = transactions[pending.pop()];
+			transaction.status = status;
+			transaction.response[transaction.length] = '\0';
+			if(transaction.onComplete != nullptr) {
+				transaction.onComplete(transaction, transaction.context);
+				free(transaction);
+			}
+		}
+
+		/// @brief Moves the bytes received by the port into the RX buffer, as many as fit.
+		/// @return true if the RX buffer holds any bytes.
+		bool drainPort() {
+			while(!rx.isFull() && port.available() > 0) {
+				rx.push((uint8_t)port.read());
+			}
+			return !rx.isEmpty();
+		}
+
+		/// @brief Moves received bytes of a block response to the sink of the transaction.
+		/// @return true if the block is finished.
+		bool receiveBlock(Transaction& transaction, unsigned long long now) {
+			uint8_t chunk[TRANSPORT_BLOCK_CHUNK];
+			while(!transaction.parser.isFinished() && drainPort()) {
+				size_t count = transaction.parser.wants();
+				if(count > sizeof(chunk)) count = sizeof(chunk);
+				if(count > rx.size()) count = rx.size();
+				for(size_t i = 0; i < count; i++) chunk[i] = rx.pop();
+				transaction.parser.feed(chunk, count, transaction.sink, transaction.context);
+				transaction.sentAt = now;
+			}
+			return transaction.parser.isFinished();
+		}
+
+		/// @brief Stores a received byte in the response of the transaction.
+		/// @return true if the byte completed the response.
+		bool receive(Transaction& transaction, char c) {
+			if(transaction.framer.feed(c)) {
+				// the first EOL character has been stored as part of the response
+				if(transaction.framer.length() == 2 && transaction.lastStored) transaction.length--;
+				return true;
+			}
+			transaction.lastStored = transaction.length < TRANSPORT_RESPONSE_SIZE - 1;
+			if(transaction.lastStored) transaction.response[transaction.length++] = c;
+			return false;
+		}
+	public:
+		/// @param port The serial port to use.
+		explicit SerialTransport(Port& port) : port(port) {}
+
+		/**
+		 * @brief Queues a command.
+		 * Bytes that arrived while nothing was pending are kept for an empty command and dropped for any other.
+		 * @param command The command to send.
+		 * @param terminator Sent after the command, e.g. cfg::PresetFile::Serial::EOL. Can be nullptr.
+		 * @param framer Detects the end of the response.
+		 * @param expectResponse Whether to wait for a response line.
+		 * @param timeout Response timeout in milliseconds.
+		 * @param onComplete Called when the transaction is finished, the handle is not valid after that.
+		 * Without a callback, the transaction has to be polled with getStatus and freed with release.
+		 * @param context Passed to onComplete.
+		 * @return The transaction handle, or -1 if there is no space for the transaction.
+		 */
+		int submit(const char* command, const char* terminator, const LineFramer& framer, bool expectResponse,
+				unsigned long timeout,
+				void (*onComplete)(const Transaction&, void*) = nullptr, void* context = nullptr) {
+			const size_t commandLength = strlen(command);
+			const size_t terminatorLength = terminator == nullptr ? 0 : strlen(terminator);
+			if(pending.isFull() || tx.space() < commandLength + terminatorLength) return -1;
+			unsigned int i;
+			for(i = 0; i < TRANSPORT_QUEUE_SIZE && transactions[i].status != Status::Free; i++);
+			if(i == TRANSPORT_QUEUE_SIZE) return -1;
+
+			// the reply to a command sent without expecting one stays for an empty command to read
+			if(pending.isEmpty() && commandLength + terminatorLength > 0) {
+				rx.clear();
+				while(port.available() > 0) port.read();
+			}
+			tx.push((const uint8_t*)command, commandLength);
+			tx.push((const uint8_t*)terminator, terminatorLength);
+			Transaction& transaction = transactions[i];
+			transaction.status = Status::Pending;
+			transaction.owners = 1;
+			transaction.shareKey[0] = '\0';
+			transaction.expectResponse = expectResponse;
+			transaction.sent = false;
+			transaction.lastStored = false;
+			transaction.txEnd = txWritten + tx.size();
+			transaction.timeout = timeout;
+			transaction.framer = framer;
+			transaction.framer.reset();
+			transaction.length = 0;
+			transaction.response[0] = '\0';
+			transaction.block = false;
+			transaction.sink = nullptr;
+			transaction.onComplete = onComplete;
+			transaction.context = context;
+			pending.push(i);
+			return getHandle(i);
+		}
+
+		/**
+		 * @brief Queues a command with an IEEE 488.2 binary block response.
+		 * The payload is handed to the sink as it arrives, the response field stays empty.
+		 * The timeout is counted from the last received byte, so long transfers do not time out.
+		 * @param command The command to send.
+		 * @param terminator Sent after the command, e.g. cfg::PresetFile::Serial::EOL. Can be nullptr.
+		 * @param parser Parser with the response EOL.
+		 * @param sink Receives the payload, can be nullptr to discard it.
+		 * @param timeout Response timeout in milliseconds.
+		 * @param onComplete Called when the transaction is finished, the handle is not valid after that.
+		 * @param context Passed to the sink and to onComplete.
+		 * @return The transaction handle, or -1 if there is no space for the transaction.
+		 */
+		int submitBlock(const char* command, const char* terminator, const BlockParser& parser, BlockSink sink,
+				unsigned long timeout,
+				void (*onComplete)(const Transaction&, void*) = nullptr, void* context = nullptr) {
+			const int handle = submit(command, terminator, LineFramer(), true, timeout, onComplete, context);
+			if(handle < 0) return -1;
+			Transaction& transaction = transactions[handle % TRANSPORT_QUEUE_SIZE];
+			transaction.block = true;
+			transaction.parser = parser;
+			transaction.parser.reset();
+			transaction.sink = sink;
+			return handle;
+		}
+
+		/**
+		 * @brief Queues a query, or joins the transaction of the same query if one is still pending,
+		 * so several callers asking the same thing cost one round trip and get the same response.
+		 * Only for commands without side effects, the caller has to check, e.g. with scpi::isQueryOnly.
+		 * Every caller gets the same handle, polls it and releases it once; the transaction is freed
+		 * with the last release.
+		 * @param command The query to send.
+		 * @param terminator Sent after the command, e.g. cfg::PresetFile::Serial::EOL. Can be nullptr.
+		 * @param framer Detects the end of the response, has to match to share the transaction.
+		 * @param timeout Response timeout in milliseconds, of the transaction that is joined.
+		 * @return The transaction handle, or -1 if there is no space for a new transaction.
+		 */
+		int submitShared(const char* command, const char* terminator, const LineFramer& framer, unsigned long timeout) {
+			char key[TRANSPORT_SHARE_SIZE];
+			const size_t commandLength = strlen(command);
+			const size_t terminatorLength = terminator == nullptr ? 0 : strlen(terminator);
+			const bool shareable = commandLength + terminatorLength < sizeof(key);
+			if(shareable) {
+				memcpy(key, command, commandLength);
+				if(terminatorLength > 0) memcpy(key + commandLength, terminator, terminatorLength);
+				key[commandLength + terminatorLength] = '\0';
+				for(unsigned int i = 0; i < TRANSPORT_QUEUE_SIZE; i++) {
+					Transaction& transaction = transactions[i];
+					// an abandoned transaction has a callback, and a finished one would give a stale response
+					if(transaction.status != Status::Pending || transaction.onComplete != nullptr) continue;
+					if(transaction.owners == UINT8_MAX || strcmp(transaction.shareKey, key) != 0) continue;
+					if(strcmp(transaction.framer.EOL, framer.EOL) != 0) continue;
+					transaction.owners++;
+					joined++;
+					return getHandle(i);
+				}
+			}
+			const int handle = submit(command, terminator, framer, true, timeout);
+			if(handle >= 0 && shareable) strcpy(transactions[handle % TRANSPORT_QUEUE_SIZE].shareKey, key);
+			return handle;
+		}
+
+		/// @brief Moves bytes between the buffers and the port, and finishes transactions.
+		/// Called from the main loop, never blocks.
+		/// @param now The current time in milliseconds.
+		void update(unsigned long long now) {
+			int space = port.availableForWrite();
+			if(space > fifoSize) fifoSize = space;
+			while(!tx.isEmpty() && space > 0) {
+				port.write(tx.pop());
+				txWritten++;
+				space--;
+			}
+			// the bytes written to the port that are still waiting in its FIFO
+			space = port.availableForWrite();
+			const uint32_t onTheWire = txWritten - (uint32_t)(fifoSize > space ? fifoSize - space : 0);
+			drainPort();
+
+			while(!pending.isEmpty()) {
+				Transaction& transaction = transactions[pending.peek()];
+				if(!transaction.sent) {
+					// the timeout starts once the last byte has left the FIFO, at 300 baud a byte takes 33 ms
+					if((int32_t)(onTheWire - transaction.txEnd) < 0) break;
+					transaction.sent = true;
+					transaction.sentAt = now;
+				}
+				if(!transaction.expectResponse) {
+					complete(Status::Done);
+					continue;
+				}
+				bool received = false;
+				if(transaction.block) {
+					received = receiveBlock(transaction, now);
+				} else {
+					while(!received && drainPort()) {
+						received = receive(transaction, (char)rx.pop());
+					}
+				}
+				if(received) {
+					const bool malformed = transaction.block && transaction.parser.getState() == BlockParser::State::Error;
+					complete(malformed ? Status::Malformed : Status::Done);
+					continue;
+				}
+				if(now - transaction.sentAt >= transaction.timeout) {
+					complete(Status::TimedOut);
+					continue;
+				}
+				break;
+			}
+		}
+
+		/// @brief Checks if all transactions are finished and all bytes are sent.
+		bool isIdle() const {
+			return pending.isEmpty() && tx.isEmpty();
+		}
+
+		/// @brief Checks if a transaction can be submitted. Finished transactions hold their slot until they are released,
+		/// so an idle transport can still be full.
+		bool hasFreeSlot() const {
+			for(unsigned int i = 0; i < TRANSPORT_QUEUE_SIZE; i++) {
+				if(transactions[i].status == Status::Free) return true;
+			}
+			return false;
+		}
+
+		/// @brief Fetches the transaction for a handle.
+		/// @return The transaction, or nullptr if the handle is no longer valid.
+		const Transaction* get(int handle) const {
+			if(handle < 0) return nullptr;
+			const Transaction& transaction = transactions[handle % TRANSPORT_QUEUE_SIZE];
+			if(transaction.status == Status::Free || getHandle(handle % TRANSPORT_QUEUE_SIZE) != handle) return nullptr;
+			return &transaction;
+		}
+
+		/// @brief Fetches the status of a transaction.
+		/// @return The status, Status::Free if the handle is no longer valid.
+		Status getStatus(int handle) const {
+			const Transaction* transaction = get(handle);
+			return transaction == nullptr ? Status::Free : transaction->status;
+		}
+
+		/// @brief Gives up on a transaction. A pending transaction is still sent and received,
+		/// so the following responses stay in order, but is freed as soon as it finishes.
+		void abandon(int handle) {
+			if(get(handle) == nullptr) return;
+			Transaction& transaction = transactions[handle % TRANSPORT_QUEUE_SIZE];
+			if(transaction.owners > 1) {
+				// the other owners still wait for it
+				transaction.owners--;
+				return;
+			}
+			if(transaction.status != Status::Pending) {
+				free(transaction);
+				return;
+			}
+			transaction.onComplete = [](const Transaction&, void*) {};
+			// the context may be gone, the rest of the block is discarded
+			transaction.sink = nullptr;
+		}
+
+		/// @brief Frees a finished transaction.
+		/// @return false if the handle is not valid, or the transaction is still pending.
+		bool release(int handle) {
+			const Transaction* transaction = get(handle);
+			if(transaction == nullptr || transaction->status == Status::Pending) return false;
+			Transaction& owned = transactions[handle % TRANSPORT_QUEUE_SIZE];
+			if(owned.owners > 1) {
+				owned.owners--;
+			} else {
+				free(owned);
+			}
+			return true;
+		}
+
+		/// @brief The number of submitShared calls that joined a transaction in flight instead of sending the query.
+		unsigned long getJoined() const {
+			return joined;
+		}
+	};
+}
@@ -4,7 +4,16 @@
 #include <ESP8266WebServerSecure.h>
 #include <ESP8266mDNS.h>
 #include <time.h>
+#include <sys/time.h>
 #include "scheduler.h"
+#include "serialTransport.h"
+#include "scpiBatch.h"
+#include "responseCache.h"
+#include "eventStream.h"
+#include "sampleBuffer.h"
+#include "sampleLog.h"
+#include <LittleFS.h>
+#include "timeBase.h"
 #pragma once
 
 template <typename WSBase>
@@ -16,8 +25,18 @@ void handleNotFound(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server);
 template <typename WSBase>
 void handleExec(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server);
 
+template <typename WSBase>
+void handleExecBatch(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server);
+
 void serverSetup();
 
+void publishResponse(uint8_t preset, const char* source, const char* response);
+
 extern ESP8266WebServer server;
 extern ESP8266WebServerSecure serverSecure;
+extern SampleBuffer<> samples;
+extern cache::ResponseCache<> responseCache;
+extern SampleLog<fs::FS> sampleLog;
 extern Scheduler scheduler;
+extern TimeBase schedulerTime;
+extern transport::SerialTransport<HardwareSerial> serialTransport;
@@ -0,0 +1,258 @@
+/**
+ * @file slotFile.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains functions for writing configuration files so that a reset cannot corrupt them.
+ *
+ * A file is kept in two slots, <path>.a and <path>.b. A save goes into the slot not holding the newest
+ * valid copy, so a reset in the middle of it can only damage the older copy, and the newest one is loaded.
+ * Every slot ends with a trailer: the magic "RSCS", the u32 length of the contents, a u32 sequence number,
+ * incremented with every save, and the u32 CRC-32 of the contents, the length and the sequence number.
+ * A load picks the valid slot with the highest sequence number. If no slot is valid,
+ * the plain file at <path> is loaded, as written before slots were used, or uploaded by hand.
+ * The plain file is removed by the first successful save.
+ *
+ * The filesystem is a template parameter with the interface of LittleFS
+ * (open, remove), so a fake filesystem can be used in a native environment.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "crc32.h"
+
+namespace loc {
+
+	/// @brief The last bytes of a slot.
+	struct SlotTrailer {
+		/// @brief Size of a trailer in a slot file.
+		static const size_t SIZE = 16;
+
+		uint32_t length = 0;
+		uint32_t sequence = 0;
+		uint32_t crc = 0;
+
+		void encode(uint8_t* out) const {
+			const uint32_t values[3] = {length, sequence, crc};
+			memcpy(out, "RSCS", 4);
+			for(int v = 0; v < 3; v++) {
+				for(int i = 0; i < 4; i++) out[4 + 4 * v + i] = values[v] >> (8 * i);
+			}
+		}
+
+		bool decode(const uint8_t* in) {
+			if(memcmp(in, "RSCS", 4) != 0) return false;
+			uint32_t* values[3] = {&length, &sequence, &crc};
+			for(int v = 0; v < 3; v++) {
+				*values[v] = 0;
+				for(int i = 3; i >= 0; i--) *values[v] = *values[v] << 8 | in[4 + 4 * v + i];
+			}
+			return true;
+		}
+
+		/// @brief Adds the length and the sequence number to the CRC of the contents.
+		uint32_t finish(uint32_t contentCrc) const {
+			uint8_t bytes[SIZE];
+			encode(bytes);
+			return cfg::crc32(contentCrc, bytes + 4, 8);
+		}
+	};
+
+	/**
+	 * @brief Passes the contents of a slot to the file, counting the bytes and updating the CRC.
+	 * Has the writer interface of ArduinoJson, so serializeJson can write into it.
+	 */
+	template <typename File>
+	class SlotWriter {
+		File& file;
+	public:
+		uint32_t length = 0;
+		uint32_t crc = 0;
+		bool failed = false;
+
+		explicit SlotWriter(File& file) : file(file) {}
+
+		size_t write(const uint8_t* data, size_t count) {
+			const size_t written = file.write(data, count);
+			if(written != count) failed = true;
+			crc = cfg::crc32(crc, data, written);
+			length += written;
+			return written;
+		}
+
+		size_t write(uint8_t c) {
+			return write(&c, 1);
+		}
+	};
+
+	/**
+	 * @brief Reads the contents of a slot, without the trailer.
+	 * Has the reader interface of ArduinoJson, so deserializeJson can read from it.
+	 */
+	template <typename File>
+	class SlotReader {
+		File& file;
+	public:
+		/// @brief The number of content bytes left.
+		uint32_t remaining;
+
+		SlotReader(File& file, uint32_t length) : file(file), remaining(length) {}
+
+		size_t read(uint8_t* out, size_t count) {
+			if(count > remaining) count = remaining;
+			const size_t read = file.read(out, count);
+			remaining -= read;
+			return read;
+		}
+
+		int read() {
+			uint8_t c;
+			return read(&c, 1) == 1 ? c : -1;
+		}
+
+		size_t readBytes(char* out, size_t count) {
+			return read((uint8_t*)out, count);
+		}
+	};
+
+	/// @brief Writes the path of a slot, 0 for <path>.a and 1 for <path>.b. @return false if it does not fit.
+	inline bool slotPath(char* out, size_t size, const char* path, int slot) {
+		return (size_t)snprintf(out, size, "%s.%c", path, slot == 0 ? 'a' : 'b') < size;
+	}
+
+	/**
+	 * @brief Checks a slot: its trailer, its length and the CRC of its contents.
+	 * @param trailer Set to the trailer of the slot.
+	 * @return Whether the slot is valid.
+	 */
+	template <typename FS>
+	bool checkSlot(FS& fs, const char* path, int slot, SlotTrailer& trailer) {
+		char name[64];
+		if(!slotPath(name, sizeof(name), path, slot)) return false;
+		auto file = fs.open(name, "r");
+		if(!file) return false;
+		const size_t size = file.size();
+		uint8_t bytes[SlotTrailer::SIZE];
+		bool valid = size >= SlotTrailer::SIZE && file.seek(size - SlotTrailer::SIZE)
+			&& file.read(bytes, sizeof(bytes)) == sizeof(bytes) && trailer.decode(bytes)
+			&& trailer.length == size - SlotTrailer::SIZE && file.seek(0);
+		uint32_t crc = 0;
+		for(uint32_t done = 0; valid && done < trailer.length; ) {
+			uint8_t chunk[64];
+			const size_t count = trailer.length - done < sizeof(chunk) ? trailer.length - done : sizeof(chunk);
+			if(file.read(chunk, count) != count) valid = false;
+			crc = cfg::crc32(crc, chunk, count);
+			done += count;
+		}
+		file.close();
+		return valid && trailer.finish(crc) == trailer.crc;
+	}
+
+	/**
+	 * @brief Finds the valid slots, newest first.
+	 * @param order Set to the valid slots, newest first.
+	 * @param newest Set to the trailer of the newest valid slot.
+	 * @return The number of valid slots.
+	 */
+	template <typename FS>
+	int findSlots(FS& fs, const char* path, int order[2], SlotTrailer& newest) {
+		SlotTrailer trailers[2];
+		const bool valid[2] = {checkSlot(fs, path, 0, trailers[0]), checkSlot(fs, path, 1, trailers[1])};
+		int count = 0;
+		if(valid[0] && valid[1]) {
+			// the sequence numbers wrap around, so the newer one is ahead by less than half the range
+			const int first = (int32_t)(trailers[1].sequence - trailers[0].sequence) > 0 ? 1 : 0;
+			order[count++] = first;
+			order[count++] = 1 - first;
+		} else if(valid[0] || valid[1]) {
+			order[count++] = valid[0] ? 0 : 1;
+		}
+		if(count > 0) newest = trailers[order[0]];
+		return count;
+	}
+
+	/// @brief Checks if a file kept in slots has any copy, valid or not, to tell a missing file from a corrupt one.
+	template <typename FS>
+	bool hasCopy(FS& fs, const char* path) {
+		for(int slot = -1; slot < 2; slot++) {
+			char name[64];
+			if(slot >= 0 && !slotPath(name, sizeof(name), path, slot)) continue;
+			auto file = fs.open(slot < 0 ? path : name, "r");
+			if(file) {
+				file.close();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * @brief Loads a file kept in slots, from the newest valid slot that read accepts,
+	 * or else from the plain file at path.
+	 * @param fs The filesystem, with the LittleFS interface.
+	 * @param path The path of the file.
+	 * @param read Called with a SlotReader of the contents, returns 0 if it accepts them.
+	 * It is called again with an older copy if it does not.
+	 * @return 0 on success, -1 if there is no copy that read accepts.
+	 */
+	template <typename FS, typename Read>
+	int loadSlots(FS& fs, const char* path, Read read) {
+		int order[2];
+		SlotTrailer newest;
+		const int count = findSlots(fs, path, order, newest);
+		for(int i = 0; i < count; i++) {
+			char name[64];
+			slotPath(name, sizeof(name), path, order[i]);
+			auto file = fs.open(name, "r");
+			if(!file) continue;
+			SlotReader<decltype(file)> reader(file, file.size() - SlotTrailer::SIZE);
+			const int result = read(reader);
+			file.close();
+			if(result == 0) return 0;
+		}
+		auto file = fs.open(path, "r");
+		if(!file) return -1;
+		SlotReader<decltype(file)> reader(file, file.size());
+		const int result = read(reader);
+		file.close();
+		return result == 0 ? 0 : -1;
+	}
+
+	/**
+	 * @brief Saves a file into the slot not holding its newest valid copy.
+	 * @param fs The filesystem, with the LittleFS interface.
+	 * @param path The path of the file.
+	 * @param write Called with a SlotWriter to write the contents into.
+	 * @return 0 on success, -1 on failure, the newest copy before the save stays valid then.
+	 */
+	template <typename FS, typename Write>
+	int saveSlots(FS& fs, const char* path, Write write) {
+		int order[2];
+		SlotTrailer trailer;
+		const int count = findSlots(fs, path, order, trailer);
+		const int slot = count > 0 ? 1 - order[0] : 0;
+		trailer.sequence = count > 0 ? trailer.sequence + 1 : 1;
+		char name[64];
+		if(!slotPath(name, sizeof(name), path, slot)) return -1;
+		auto file = fs.open(name, "w");
+		if(!file) return -1;
+		SlotWriter<decltype(file)> writer(file);
+		write(writer);
+		trailer.length = writer.length;
+		trailer.crc = trailer.finish(writer.crc);
+		uint8_t bytes[SlotTrailer::SIZE];
+		trailer.encode(bytes);
+		const bool complete = !writer.failed && file.write(bytes, sizeof(bytes)) == sizeof(bytes);
+		file.close();
+		if(!complete) return -1;
+		// the plain file of before the slots is out of date now
+		auto plain = fs.open(path, "r");
+		if(plain) {
+			plain.close();
+			fs.remove(path);
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,155 @@
+/**
+ * @file smallFunction.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the SmallFunction class, a move-only callable stored inline, without the heap.
+ *
+ * A SmallFunction holds any callable, e.g. a function pointer or a lambda with captures,
+ * as long as it fits into its inline capacity, which is checked at compile time.
+ * Calling it is a single indirect call. Callables that are trivially copyable are moved with a plain copy,
+ * others through a generated move function, which also destroys them.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t CAPACITY>
+class SmallFunction;
+
+/**
+ * @brief A move-only callable with inline storage.
+ * @tparam R The return type.
+ * @tparam Args The argument types.
+ * @tparam CAPACITY The bytes available for the callable and its captures.
+ */
+template <typename R, typename... Args, size_t CAPACITY>
+class SmallFunction<R(Args...), CAPACITY> {
+public:
+	/// @brief The alignment of the inline storage, enough for pointers, 64-bit integers and doubles.
+	static const size_t ALIGNMENT = alignof(double);
+
+	/// @brief Whether a callable of type F can be stored.
+	template <typename F>
+	static constexpr bool fits() {
+		return sizeof(F) <= CAPACITY && alignof(F) <= ALIGNMENT;
+	}
+private:
+	alignas(ALIGNMENT) uint8_t storage[CAPACITY];
+
+	/// @brief Calls the stored callable, nullptr if there is none.
+	R (*invoker)(void* callable, Args... args) = nullptr;
+
+	/// @brief Moves the callable from source into target and destroys it in source,
+	/// or only destroys target if source is nullptr. nullptr for trivially copyable callables.
+	void (*manager)(void* target, void* source) = nullptr;
+
+	template <typename F>
+	static R invoke(void* callable, Args... args) {
+		return (*static_cast<F*>(callable))(std::forward<Args>(args)...);
+	}
+
+	template <typename F>
+	static void manage(void* target, void* source) {
+		if(source != nullptr) {
+			new (target) F(std::move(*static_cast<F*>(source)));
+			static_cast<F*>(source)->~F();
+			return;
+		}
+		static_cast<F*>(target)->~F();
+	}
+
+	/// @brief Takes the callable of other, leaving it empty. This one has to be empty.
+	void take(SmallFunction& other) {
+		if(other.invoker == nullptr) return;
+		if(other.manager != nullptr) other.manager(storage, other.storage);
+		else memcpy(storage, other.storage, CAPACITY);
+		invoker = other.invoker;
+		manager = other.manager;
+		other.invoker = nullptr;
+		other.manager = nullptr;
+	}
+
+	template <typename F>
+	void store(F&& function) {
+		typedef typename std::decay<F>::type Callable;
+		static_assert(fits<Callable>(), "The callable does not fit into the SmallFunction, increase its capacity");
+		if constexpr (std::is_pointer<Callable>::value) {
+			// a null function pointer leaves the function empty, instead of being called
+			const Callable pointer = function;
+			if(pointer == nullptr) return;
+		}
+		new (storage) Callable(std::forward<F>(function));
+		invoker = &invoke<Callable>;
+		const bool trivial = std::is_trivially_copyable<Callable>::value && std::is_trivially_destructible<Callable>::value;
+		manager = trivial ? nullptr : &manage<Callable>;
+	}
+
+	/// @brief SmallFunctions and null pointers are not stored as callables.
+	template <typename F>
+	using IfCallable = typename std::enable_if<!std::is_same<typename std::decay<F>::type, SmallFunction>::value
+		&& !std::is_same<typename std::decay<F>::type, std::nullptr_t>::value>::type;
+public:
+	SmallFunction() {}
+
+	SmallFunction(std::nullptr_t) {}
+
+	template <typename F, typename = IfCallable<F>>
+	SmallFunction(F&& function) {
+		store(std::forward<F>(function));
+	}
+
+	SmallFunction(SmallFunction&& other) {
+		take(other);
+	}
+
+	SmallFunction(const SmallFunction&) = delete;
+	SmallFunction& operator=(const SmallFunction&) = delete;
+
+	~SmallFunction() {
+		reset();
+	}
+
+	SmallFunction& operator=(SmallFunction&& other) {
+		if(this != &other) {
+			reset();
+			take(other);
+		}
+		return *this;
+	}
+
+	SmallFunction& operator=(std::nullptr_t) {
+		reset();
+		return *this;
+	}
+
+	template <typename F, typename = IfCallable<F>>
+	SmallFunction& operator=(F&& function) {
+		reset();
+		store(std::forward<F>(function));
+		return *this;
+	}
+
+	/// @brief Destroys the stored callable, if any.
+	void reset() {
+		if(invoker == nullptr) return;
+		if(manager != nullptr) manager(storage, nullptr);
+		invoker = nullptr;
+		manager = nullptr;
+	}
+
+	/// @brief Checks if a callable is stored.
+	explicit operator bool() const {
+		return invoker != nullptr;
+	}
+
+	/// @brief Calls the stored callable.
+	/// @warning A callable has to be stored.
+	R operator()(Args... args) {
+		return invoker(storage, std::forward<Args>(args)...);
+	}
+};
@@ -1,7 +1,9 @@
 
 #pragma once
 #include <utility>
+#include <type_traits>
 #include "dataBuffer.h"
+#include "smallFunction.h"
 
 // hashes will reach TASK_RUN_COUNT_LOOPOVER*SCHEDULER_SIZE
 // before they start to repeat
@@ -10,6 +12,12 @@
 #define TASK_RUN_COUNT_LOOPOVER 200
 #endif
 
+// The bytes a task function can capture, e.g. a function pointer and one more pointer.
+// Increase this value to capture more state in scheduled lambdas.
+#ifndef TASK_FUNCTION_SIZE
+#define TASK_FUNCTION_SIZE (2 * sizeof(void*))
+#endif
+
 
 enum class TaskType {
 	Once,
@@ -17,175 +25,142 @@ enum class TaskType {
 	RepeatUntil
 };
 
+/// @brief The order in which due tasks are run within one update.
+/// Tasks that do not fit into the update time budget are deferred in this order as well.
+enum class Priority : uint8_t {
+	Low,
+	Normal,
+	High
+};
+
+/// @brief What a repeating task does when update was not called for one or more of its periods.
+/// Runs always stay on the start + n*period grid, so a late run does not shift the following ones.
+enum class CatchUp {
+	/// @brief Every missed period is run, one per update, until the task is back on schedule.
+	RunAll,
+	/// @brief The missed periods are run once, then the task continues at the next period.
+	Coalesce,
+	/// @brief The missed periods are dropped, the task only runs within its own period.
+	Skip
+};
+
+/// @brief The function of a task. It gets the task's DataBuffer, which is empty and has no storage if the task has no data.
+typedef SmallFunction<void(DataBuffer&), TASK_FUNCTION_SIZE> TaskFunction;
+
 struct Task {
-	void (*functionWithBuffer)(DataBuffer& data);
-	void (*function)(void);
+	/// @brief The buffer holding the data of the task, taken from a pool of the scheduler, nullptr if it has no data.
+	DataBuffer* data = nullptr;
+	TaskFunction function;
 	TaskType type;
-	unsigned long startTimestamp;
-	unsigned long period;
-	unsigned long endTimestamp;
-	long lastIndex;
-	DataBuffer data;
+	unsigned long long startTimestamp;
+	unsigned long long period;
+	unsigned long long endTimestamp;
+	long long lastIndex;
+	CatchUp catchUp = CatchUp::RunAll;
+	Priority priority = Priority::Normal;
+	bool inProgress = false;
 	long runCount = 0;
 
 	void run() {
-		if (functionWithBuffer != nullptr) {
-			functionWithBuffer(data);
-		}
-		if (function != nullptr) {
-			function();
-		}
+		function(data != nullptr ? *data : noData);
 	}
 	bool clear() {
-		
-		functionWithBuffer = nullptr;
 		function = nullptr;
-		if(data.isDataSet()) data.clear();
-		return !data.isDataSet();
-	}
-
-	bool isSet() const {
-		return functionWithBuffer != nullptr || function != nullptr;
+		catchUp = CatchUp::RunAll;
+		priority = Priority::Normal;
+		inProgress = false;
+		if(data == nullptr) return true;
+		if(data->isDataSet()) data->clear();
+		return !data->isDataSet();
 	}
 
-	void updateTask(void (*function)(void), 
-			unsigned long startTimestamp, 
-			unsigned long period, 
-			unsigned long endTimestamp) {
-		//Serial.println("updateTask with endTimestamp");
-		this->functionWithBuffer = nullptr;
-		this->function = function;
-		this->startTimestamp = startTimestamp;
-		this->period = period;
-		this->endTimestamp = endTimestamp;
-		this->lastIndex = -1;
-		this->type = TaskType::RepeatUntil;
-		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
-	}
-
-	void updateTask(void (*function)(void), 
-			unsigned long startTimestamp, 
-			unsigned long period) {
-		//Serial.println("updateTask repeat");
-		this->function = function;
-		this->functionWithBuffer = nullptr;
-		this->startTimestamp = startTimestamp;
-		this->period = period;
-		this->endTimestamp = 0;
-		this->lastIndex = -1;
-		this->type = TaskType::Repeat;
-		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
-	}
-
-	void updateTask(void (*function)(void), 
-			unsigned long startTimestamp) {
-		//Serial.println("updateTask once");
-		this->function = function;
-		this->functionWithBuffer = nullptr;
-		this->startTimestamp = startTimestamp;
-		this->period = 0;
-		this->endTimestamp = 0;
-		this->lastIndex = -1;
-		this->type = TaskType::Once;
-		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
-	}
+	/// @brief The buffer passed to tasks without data.
+	static inline DataBuffer noData;
 
-	template <typename T>
-	void updateTask(void (*function)(DataBuffer&), 
-			unsigned long startTimestamp, 
-			unsigned long period, 
-			unsigned long endTimestamp, 
-			const typename std::remove_reference<T>& data) {
-		//Serial.println("updateTask with endTimestamp and copied data");
-		this->functionWithBuffer = function;
-		this->function = nullptr;
-		this->startTimestamp = startTimestamp;
-		this->period = period;
-		this->endTimestamp = endTimestamp;
-		this->lastIndex = -1;
-		this->type = TaskType::RepeatUntil;
-		this->data.set<T>(data);
-		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
-	}
-	
-
-	template <typename T>
-	void updateTask(void (*function)(DataBuffer&), 
-			unsigned long startTimestamp, 
-			unsigned long period, 
-			unsigned long endTimestamp, 
-			typename std::remove_reference<T>::type&& data) {
-		//Serial.println("updateTask with endTimestamp and moved data");
-		this->functionWithBuffer = function;
-		this->function = nullptr;
-		this->startTimestamp = startTimestamp;
-		this->period = period;
-		this->endTimestamp = endTimestamp;
-		this->lastIndex = -1;
-		this->type = TaskType::RepeatUntil;
-		this->data.set<T>(data);
-		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
+	bool isSet() const {
+		return (bool)function;
 	}
 
-	template <typename T>
-	void updateTask(void (*function)(DataBuffer&), 
-			unsigned long startTimestamp, 
-			unsigned long period, 
-			const typename std::remove_reference<T>::type& data) {
-		//Serial.println("updateTask repeat with copied data");
-		this->functionWithBuffer = function;
-		this->function = nullptr;
-		this->startTimestamp = startTimestamp;
-		this->period = period;
-		this->lastIndex = -1;
-		this->type = TaskType::Repeat;
-		this->data.set<T>(data);
-		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
+	/// @brief The earliest time at which the scheduler has to look at this task again.
+	/// A task that yielded in the middle of a run is due immediately,
+	/// Once tasks are due strictly after their start timestamp,
+	/// repeating tasks are due at the start of their next period,
+	/// and RepeatUntil tasks also have to be looked at right after their end timestamp,
+	/// so they can be removed.
+	unsigned long long nextDeadline() const {
+		if(inProgress) {
+			return 0;
+		}
+		if(type == TaskType::Once) {
+			return startTimestamp + period + 1;
+		}
+		const unsigned long long next = startTimestamp + (unsigned long long)(lastIndex + 1) * period;
+		if(type == TaskType::RepeatUntil && endTimestamp + 1 < next) {
+			return endTimestamp + 1;
+		}
+		return next;
 	}
 
-	template <typename T>
-	void updateTask(void (*function)(DataBuffer&), 
-			unsigned long startTimestamp, 
-			unsigned long period,
-			typename std::remove_reference<T>::type&& data) {
-		//Serial.println("updateTask repeat with moved data");
-		this->functionWithBuffer = function;
-		this->function = nullptr;
-		this->startTimestamp = startTimestamp;
-		this->period = period;
-		this->lastIndex = -1;
-		this->type = TaskType::Repeat;
-		this->data.set<T>(data);
-		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
+	/// @brief Advances lastIndex of a repeating task whose next period has started,
+	/// according to the catch-up policy.
+	/// @param time The current time, not earlier than the start of the next period.
+	/// @return true if the task should be run.
+	bool advance(unsigned long long time) {
+		const long long next = lastIndex + 1;
+		if(catchUp == CatchUp::RunAll || period == 0) {
+			lastIndex = next;
+			return true;
+		}
+		const long long current = (time - startTimestamp) / period;
+		lastIndex = current;
+		if(catchUp == CatchUp::Coalesce) return true;
+		// CatchUp::Skip
+		return current == next;
 	}
 
-
-	template <typename T>
-	void updateTask(void (*function)(DataBuffer&), 
-			unsigned long startTimestamp, 
-			const typename std::remove_reference<T>::type& data) {
-		//Serial.println("updateTask once with copied data");
-		this->functionWithBuffer = function;
-		this->function = nullptr;
+	/// @brief Sets the function and the timing of the task.
+	/// @param function Any callable taking a DataBuffer& or nothing, e.g. a function pointer or a lambda with captures
+	/// that fit into TASK_FUNCTION_SIZE.
+	/// @param type The type of the task. The period is ignored for Once tasks, the end timestamp for all but RepeatUntil.
+	template <typename F>
+	void updateTask(F&& function, 
+			TaskType type, 
+			unsigned long long startTimestamp, 
+			unsigned long long period = 0, 
+			unsigned long long endTimestamp = 0) {
+		typedef typename std::decay<F>::type Callable;
+		bool empty = false;
+		if constexpr (std::is_pointer<Callable>::value) {
+			const Callable pointer = function;
+			empty = pointer == nullptr;
+		}
+		if(empty) {
+			// a null function pointer leaves the task unset, instead of wrapping it
+			this->function = nullptr;
+		} else if constexpr (std::is_invocable<F&, DataBuffer&>::value) {
+			this->function = std::forward<F>(function);
+		} else {
+			this->function = [function = std::forward<F>(function)](DataBuffer&) mutable { function(); };
+		}
+		this->type = type;
 		this->startTimestamp = startTimestamp;
+		this->period = type == TaskType::Once ? 0 : period;
+		this->endTimestamp = type == TaskType::RepeatUntil ? endTimestamp : 0;
 		this->lastIndex = -1;
-		this->type = TaskType::Once;
-		this->data.set<T>(std::move(data));
 		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
 	}
 
-	template <typename T>
-	void updateTask(void (*function)(DataBuffer&), 
-			unsigned long startTimestamp,
-			typename std::remove_reference<T>::type&& data) {
-		//Serial.println("updateTask once with moved data");
-		this->functionWithBuffer = function;
-		this->function = nullptr;
-		this->startTimestamp = startTimestamp;
-		this->lastIndex = -1;
-		this->type = TaskType::Once;
-		this->data.set<T>(std::move(data));
-		runCount = (runCount + 1) % TASK_RUN_COUNT_LOOPOVER;
-		//Serial.println("updateTask once with moved data end");
+	/// @brief Sets the function, the timing and the data of the task.
+	/// @tparam T The type of the data, given explicitly.
+	/// @param data The data, copied or moved into the task's DataBuffer, which has to be assigned already.
+	template <typename T, typename F, typename D>
+	void updateTask(F&& function, 
+			TaskType type, 
+			unsigned long long startTimestamp, 
+			unsigned long long period, 
+			unsigned long long endTimestamp, 
+			D&& data) {
+		updateTask(std::forward<F>(function), type, startTimestamp, period, endTimestamp);
+		this->data->set<T>(std::forward<D>(data));
 	}
 };
\ No newline at end of file
@@ -0,0 +1,142 @@
+/**
+ * @file taskQueue.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the TaskQueue class, a deadline-ordered queue of task slots.
+ *
+ * The queue is a binary min-heap of slot indices keyed on the time the slot should next be looked at.
+ * It lets the Scheduler find due tasks without walking the whole task list.
+ * This file is microcontroller independent, so it can be used in a native environment for testing.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Deadline-ordered min-heap of task slot indices.
+ * Every slot can be queued at most once. The position of each slot inside the heap is tracked,
+ * so a slot can be removed or re-keyed in O(log n) without searching for it.
+ * @tparam SIZE The number of slots the queue can hold.
+ */
+template <unsigned int SIZE>
+class TaskQueue {
+	static_assert(SIZE < 0xFFFF, "TaskQueue supports at most 65534 slots");
+public:
+	/// @brief Position value of a slot that is not in the queue.
+	static const uint16_t NOT_QUEUED = 0xFFFF;
+private:
+	/// @brief The heap of slot indices, ordered by deadline.
+	uint16_t heap[SIZE];
+
+	/// @brief The deadline of every queued slot, indexed by slot.
+	unsigned long long deadline[SIZE];
+
+	/// @brief The position of every slot in the heap, or NOT_QUEUED.
+	uint16_t position[SIZE];
+
+	/// @brief The number of queued slots.
+	unsigned int count = 0;
+
+	void place(unsigned int pos, uint16_t slot) {
+		heap[pos] = slot;
+		position[slot] = pos;
+	}
+
+	void siftUp(unsigned int pos) {
+		const uint16_t slot = heap[pos];
+		while(pos > 0) {
+			const unsigned int parent = (pos - 1) / 2;
+			if(deadline[heap[parent]] <= deadline[slot]) break;
+			place(pos, heap[parent]);
+			pos = parent;
+		}
+		place(pos, slot);
+	}
+
+	void siftDown(unsigned int pos) {
+		const uint16_t slot = heap[pos];
+		while(true) {
+			unsigned int child = 2 * pos + 1;
+			if(child >= count) break;
+			if(child + 1 < count && deadline[heap[child + 1]] < deadline[heap[child]]) child++;
+			if(deadline[slot] <= deadline[heap[child]]) break;
+			place(pos, heap[child]);
+			pos = child;
+		}
+		place(pos, slot);
+	}
+public:
+	TaskQueue() {
+		clear();
+	}
+
+	/// @brief Removes every slot from the queue.
+	void clear() {
+		count = 0;
+		for(unsigned int i = 0; i < SIZE; i++) {
+			position[i] = NOT_QUEUED;
+		}
+	}
+
+	/// @brief Checks if the queue is empty.
+	bool isEmpty() const {
+		return count == 0;
+	}
+
+	/// @brief The number of queued slots.
+	unsigned int size() const {
+		return count;
+	}
+
+	/// @brief Checks if the slot is in the queue.
+	bool contains(unsigned int slot) const {
+		return position[slot] != NOT_QUEUED;
+	}
+
+	/// @brief The slot with the earliest deadline.
+	/// @warning The queue must not be empty.
+	unsigned int top() const {
+		return heap[0];
+	}
+
+	/// @brief The earliest deadline in the queue.
+	/// @warning The queue must not be empty.
+	unsigned long long topDeadline() const {
+		return deadline[heap[0]];
+	}
+
+	/// @brief Adds the slot to the queue, or moves it if it is already queued.
+	/// @param slot The slot index.
+	/// @param time The deadline of the slot.
+	void push(unsigned int slot, unsigned long long time) {
+		if(contains(slot)) {
+			const unsigned long long old = deadline[slot];
+			deadline[slot] = time;
+			if(time < old) siftUp(position[slot]);
+			else siftDown(position[slot]);
+			return;
+		}
+		deadline[slot] = time;
+		place(count, slot);
+		count++;
+		siftUp(count - 1);
+	}
+
+	/// @brief Removes the slot with the earliest deadline.
+	/// @warning The queue must not be empty.
+	void pop() {
+		remove(heap[0]);
+	}
+
+	/// @brief Removes the slot from the queue, if it is queued.
+	void remove(unsigned int slot) {
+		if(!contains(slot)) return;
+		const unsigned int pos = position[slot];
+		position[slot] = NOT_QUEUED;
+		count--;
+		if(pos == count) return;
+		// move the last element into the hole and restore the heap order
+		place(pos, heap[count]);
+		if(pos > 0 && deadline[heap[pos]] < deadline[heap[(pos - 1) / 2]]) siftUp(pos);
+		else siftDown(pos);
+	}
+};
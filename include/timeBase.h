@@ -0,0 +1,34 @@
+/**
+ * @file timeBase.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the TimeBase class, a monotonic 64-bit time source for the scheduler.
+ *
+ * millis() and micros() are 32-bit counters that wrap around after about 49 days and 71 minutes.
+ * The TimeBase extends them to 64 bits, so scheduler deadlines never wrap.
+ * This file is microcontroller independent, so it can be used in a native environment for testing.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Extends a wrapping 32-bit counter to a monotonic 64-bit one.
+ * The counter has to be read at least once per wrap-around period,
+ * which the main loop easily does.
+ */
+class TimeBase {
+	/// @brief The last raw counter value.
+	uint32_t last = 0;
+
+	/// @brief The upper 32 bits of the extended counter.
+	uint64_t wraps = 0;
+public:
+	/// @brief Updates the time base with the current counter value.
+	/// @param raw The current value of the 32-bit counter, e.g. millis().
+	/// @return The monotonic 64-bit time.
+	unsigned long long update(uint32_t raw) {
+		if(raw < last) wraps += 1ULL << 32;
+		last = raw;
+		return wraps | raw;
+	}
+};
@@ -0,0 +1,345 @@
+/**
+ * @file uploader.h
+ * @author Oskars Putans (o.putaans@gmail.com)
+ * @brief This file contains the Uploader class, which posts the samples of the sample log to an HTTP server in batches.
+ *
+ * The samples are read from the flash log, so nothing is lost while the server or the network is down.
+ * A post does not block the main loop: every update does one step of it, connecting, writing a slice of the body
+ * or checking for the status line, and a post that takes longer than UPLOAD_TIMEOUT_MS is dropped.
+ * A failed post is retried with exponential backoff. The position of the next sample to upload
+ * is saved to a file after every accepted batch, so a reboot does not send the same samples again.
+ * The batches are JSON, or delta encoded binary (see sampleCodec.h) for servers that accept it.
+ *
+ * The filesystem and the HTTP client are template parameters, so fakes can be used in a native environment.
+ * This header file is microcontroller independent, so it can be used in a native environment.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "sampleLog.h"
+#include "eventStream.h"
+#include "sampleCodec.h"
+
+// Maximum number of samples in one post.
+#ifndef UPLOAD_BATCH_SIZE
+#define UPLOAD_BATCH_SIZE 50
+#endif
+
+// Size of the buffer for the body of a post.
+#ifndef UPLOAD_BODY_SIZE
+#define UPLOAD_BODY_SIZE 2048
+#endif
+
+// Time in milliseconds between checks for new samples once everything is uploaded.
+#ifndef UPLOAD_INTERVAL_MS
+#define UPLOAD_INTERVAL_MS 10000
+#endif
+
+// The first and the longest wait in milliseconds before retrying a failed post.
+#ifndef UPLOAD_BACKOFF_MIN_MS
+#define UPLOAD_BACKOFF_MIN_MS 1000
+#endif
+#ifndef UPLOAD_BACKOFF_MAX_MS
+#define UPLOAD_BACKOFF_MAX_MS 300000
+#endif
+
+// Time in milliseconds a post may take from connecting to the status line before it counts as failed.
+#ifndef UPLOAD_TIMEOUT_MS
+#define UPLOAD_TIMEOUT_MS 10000
+#endif
+
+// Maximum number of body bytes written by one update.
+#ifndef UPLOAD_SLICE_SIZE
+#define UPLOAD_SLICE_SIZE 256
+#endif
+
+// The result of a post that timed out, the same as HTTPC_ERROR_READ_TIMEOUT.
+#define UPLOAD_ERROR_TIMEOUT -11
+
+// Version byte at the start of a binary batch.
+#define UPLOAD_BINARY_VERSION 1
+
+// File with the position of the next sample to upload.
+#ifndef UPLOAD_CURSOR_PATH
+#define UPLOAD_CURSOR_PATH LOG_DIR "/upload.bin"
+#endif
+
+/**
+ * @brief Posts the samples of a SampleLog in batches.
+ * The body of a post is a JSON object:
+ * {"experiment_id": "...", "samples": [[<sequence>, <time>, <preset>, "<response>"], ...]}.
+ * A binary body, with the content type application/octet-stream, is the version byte UPLOAD_BINARY_VERSION,
+ * the varint length of the experiment id and the id, followed by the samples encoded by a codec::DeltaEncoder,
+ * which starts over with every batch.
+ * @tparam FS The filesystem type, as in SampleLog.
+ * @tparam Http Type of the HTTP client, which must not block for long in any of its methods:
+ * - `int connect(const char* url, const char* authorization, const char* contentType, size_t length)` opens
+ *   the connection and sends the headers, returning 1 when done, 0 to be called again, negative on an error.
+ * - `size_t write(const uint8_t* data, size_t length)` sends what fits into the send buffer and returns its length.
+ * - `int poll()` returns the HTTP status code once the status line arrived, 0 until then, negative on an error.
+ * - `void stop()` closes the connection.
+ */
+template <typename FS, typename Http>
+class Uploader {
+	SampleLog<FS>& sampleLog;
+	FS& fs;
+	Http& http;
+
+	/// @brief The target, copied from cfg::PresetFile::HttpClient. Nothing is uploaded while the url is empty.
+	char url[128] = "";
+	char experimentId[32] = "";
+	/// @brief The Authorization header, "Bearer <access token>", empty if there is no token.
+	char authorization[48] = "";
+	/// @brief Send binary batches instead of JSON.
+	bool binary = false;
+
+	/// @brief Position of the next sample to upload.
+	LogCursor cursor;
+
+	/// @brief The current wait before retrying a failed post, 0 after a successful one.
+	unsigned long backoff = 0;
+	/// @brief The time before which update does nothing.
+	unsigned long long waitUntil = 0;
+
+	/// @brief The number of samples accepted by the server since begin.
+	unsigned long uploaded = 0;
+
+	/// @brief The step of the post in progress.
+	enum class PostState : uint8_t {
+		IDLE,
+		CONNECTING,
+		SENDING,
+		RECEIVING
+	} state = PostState::IDLE;
+	/// @brief The time the post in progress started.
+	unsigned long long postStart = 0;
+	/// @brief The position after the samples of the post in progress, the cursor once the server accepts them.
+	LogCursor next;
+	/// @brief The number of samples in the post in progress.
+	int count = 0;
+	/// @brief Whether the body of the post in progress had no space for more samples.
+	bool full = false;
+	/// @brief The length of the body and the number of bytes of it already written.
+	size_t length = 0;
+	size_t sent = 0;
+
+	char body[UPLOAD_BODY_SIZE];
+
+	/// @brief Saves the cursor into slots, so a reset leaves either the old or the new one.
+	/// @return 0 on success, -1 on failure.
+	int saveCursor() {
+		uint8_t data[8];
+		for(int i = 0; i < 4; i++) {
+			data[i] = cursor.segment >> (8 * i);
+			data[4 + i] = cursor.offset >> (8 * i);
+		}
+		return loc::saveSlots(fs, UPLOAD_CURSOR_PATH, [&](auto& writer) {
+			writer.write(data, sizeof(data));
+		});
+	}
+
+	/// @brief Closes the post in progress and moves the cursor past its samples if the server accepted them.
+	/// @param now The current time in milliseconds.
+	/// @param status The HTTP status code, or a negative error.
+	/// @return The status.
+	int finish(unsigned long long now, int status) {
+		http.stop();
+		state = PostState::IDLE;
+		if(status < 200 || status >= 300) {
+			backoff = backoff == 0 ? UPLOAD_BACKOFF_MIN_MS : backoff * 2;
+			if(backoff > UPLOAD_BACKOFF_MAX_MS) backoff = UPLOAD_BACKOFF_MAX_MS;
+			waitUntil = now + backoff;
+			return status;
+		}
+		cursor = next;
+		uploaded += count;
+		backoff = 0;
+		saveCursor();
+		// a full batch means there may be more, otherwise wait for new samples
+		waitUntil = full || count == UPLOAD_BATCH_SIZE ? now : now + UPLOAD_INTERVAL_MS;
+		return status;
+	}
+
+	/// @brief Formats the samples after the cursor into the body as JSON.
+	/// @param next Set to the position after the last formatted sample.
+	/// @param length Set to the length of the body.
+	/// @param full Set if the body had no space for the next sample.
+	/// @return The number of samples in the body, -1 on a read error.
+	int formatJson(LogCursor& next, size_t& length, bool& full) {
+		int written = snprintf(body, sizeof(body), "{\"experiment_id\":\"");
+		length = events::appendEscaped(body, sizeof(body), written, experimentId);
+		written = snprintf(body + length, sizeof(body) - length, "\",\"samples\":[");
+		length += written;
+		bool first = true;
+		full = false;
+		next = cursor;
+		const int count = sampleLog.read(next, UPLOAD_BATCH_SIZE, [&](const LogRecord& record, const char* text) {
+			char item[600];
+			size_t itemLength = snprintf(item, sizeof(item), "%s[%u,%llu,%u,\"", first ? "" : ",",
+				(unsigned int)record.sequence, (unsigned long long)record.time, record.preset);
+			itemLength = events::appendEscaped(item, sizeof(item) - 2, itemLength, text);
+			item[itemLength++] = '"';
+			item[itemLength++] = ']';
+			// leave space for the closing brackets
+			if(length + itemLength + 2 > sizeof(body)) {
+				full = true;
+				return false;
+			}
+			memcpy(body + length, item, itemLength);
+			length += itemLength;
+			first = false;
+			return true;
+		});
+		body[length++] = ']';
+		body[length++] = '}';
+		return count;
+	}
+
+	/// @brief Formats the samples after the cursor into the body as a binary batch, see formatJson.
+	int formatBinary(LogCursor& next, size_t& length, bool& full) {
+		const size_t idLength = strlen(experimentId);
+		length = 0;
+		body[length++] = UPLOAD_BINARY_VERSION;
+		length += codec::putVarint((uint8_t*)body + length, sizeof(body) - length, idLength);
+		if(length + idLength > sizeof(body)) return -1;
+		memcpy(body + length, experimentId, idLength);
+		length += idLength;
+		codec::DeltaEncoder encoder;
+		full = false;
+		next = cursor;
+		return sampleLog.read(next, UPLOAD_BATCH_SIZE, [&](const LogRecord& record, const char* text) {
+			const size_t written = encoder.encode(record.time, record.sequence, record.preset, text,
+				(uint8_t*)body + length, sizeof(body) - length);
+			if(written == 0) {
+				full = true;
+				return false;
+			}
+			length += written;
+			return true;
+		});
+	}
+public:
+	/// @param sampleLog The log to upload.
+	/// @param fs The filesystem of the log, for the cursor file.
+	/// @param http The HTTP client.
+	Uploader(SampleLog<FS>& sampleLog, FS& fs, Http& http) : sampleLog(sampleLog), fs(fs), http(http) {}
+
+	/// @brief Sets the target of the posts, e.g. from cfg::PresetFile::HttpClient.
+	/// The strings are copied, longer ones are truncated.
+	/// @param url The url to post to, empty to stop uploading.
+	/// @param experimentId Sent with every batch.
+	/// @param accessToken Sent as a bearer token, can be empty.
+	/// @param binary Send delta encoded binary batches instead of JSON.
+	void setTarget(const char* url, const char* experimentId, const char* accessToken, bool binary = false) {
+		// a post in progress went to the old target
+		if(state != PostState::IDLE) {
+			http.stop();
+			state = PostState::IDLE;
+		}
+		snprintf(this->url, sizeof(this->url), "%s", url);
+		snprintf(this->experimentId, sizeof(this->experimentId), "%s", experimentId);
+		this->binary = binary;
+		if(accessToken[0] == '\0') {
+			authorization[0] = '\0';
+		} else {
+			snprintf(authorization, sizeof(authorization), "Bearer %s", accessToken);
+		}
+		backoff = 0;
+		waitUntil = 0;
+	}
+
+	/**
+	 * @brief Loads the saved cursor. Without one, the upload starts from the oldest sample of the log.
+	 * A cursor that does not fit the log any more is moved to the oldest sample and saved.
+	 * @param logRestarted Whether SampleLog::begin found the index corrupt and started the log over,
+	 * the saved cursor then points into segments that were written again.
+	 * @return 0 on success, -1 if the cursor file is corrupt.
+	 */
+	int begin(bool logRestarted = false) {
+		cursor = sampleLog.first();
+		LogCursor saved;
+		const int loaded = loc::loadSlots(fs, UPLOAD_CURSOR_PATH, [&](auto& reader) {
+			uint8_t data[8];
+			if(reader.remaining != sizeof(data) || reader.read(data, sizeof(data)) != sizeof(data)) return -1;
+			for(int i = 3; i >= 0; i--) {
+				saved.segment = saved.segment << 8 | data[i];
+				saved.offset = saved.offset << 8 | data[4 + i];
+			}
+			return 0;
+		});
+		if(loaded != 0) return loc::hasCopy(fs, UPLOAD_CURSOR_PATH) ? -1 : 0;
+		cursor = saved;
+		if(logRestarted || sampleLog.isPastEnd(cursor)) {
+			cursor = sampleLog.first();
+			saveCursor();
+		}
+		return 0;
+	}
+
+	/**
+	 * @brief Does the next step of the post in progress, or starts posting the next batch,
+	 * unless waiting after a failure or for new samples. Called from the main loop.
+	 * @param now The current time in milliseconds.
+	 * @return The HTTP status code when a post completes, 0 while one is in progress or nothing is posted,
+	 * negative on a connection or read error, UPLOAD_ERROR_TIMEOUT if the post took too long.
+	 */
+	int update(unsigned long long now) {
+		switch(state) {
+		case PostState::IDLE: {
+			if(url[0] == '\0' || now < waitUntil) return 0;
+			count = binary ? formatBinary(next, length, full) : formatJson(next, length, full);
+			if(count <= 0) {
+				waitUntil = now + UPLOAD_INTERVAL_MS;
+				return count;
+			}
+			postStart = now;
+			sent = 0;
+			state = PostState::CONNECTING;
+			return 0;
+		}
+		case PostState::CONNECTING: {
+			const char* contentType = binary ? "application/octet-stream" : "application/json";
+			const int result = http.connect(url, authorization, contentType, length);
+			if(result < 0) return finish(now, result);
+			if(result > 0) state = PostState::SENDING;
+			break;
+		}
+		case PostState::SENDING: {
+			const size_t slice = length - sent < UPLOAD_SLICE_SIZE ? length - sent : UPLOAD_SLICE_SIZE;
+			sent += http.write((const uint8_t*)body + sent, slice);
+			if(sent == length) state = PostState::RECEIVING;
+			break;
+		}
+		case PostState::RECEIVING: {
+			const int status = http.poll();
+			if(status != 0) return finish(now, status);
+			break;
+		}
+		}
+		if(now - postStart >= UPLOAD_TIMEOUT_MS) return finish(now, UPLOAD_ERROR_TIMEOUT);
+		return 0;
+	}
+
+	/// @brief Whether a post is in progress, so the main loop should not sleep.
+	bool isBusy() const {
+		return state != PostState::IDLE;
+	}
+
+	/// @brief Position of the next sample to upload.
+	const LogCursor& getCursor() const {
+		return cursor;
+	}
+
+	/// @brief The current wait before retrying a failed post, 0 if the last post succeeded.
+	unsigned long getBackoff() const {
+		return backoff;
+	}
+
+	/// @brief The number of samples accepted by the server since begin.
+	unsigned long getUploaded() const {
+		return uploaded;
+	}
+};
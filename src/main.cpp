@@ -7,14 +7,48 @@
 #include <sntp.h>
 #include "certificates.h"
 #include "scheduler.h"
+#include "idleSleep.h"
+#include "timeBase.h"
+#include "serialTransport.h"
+#include "sampleLog.h"
+#include "uploader.h"
+#include "httpPoster.h"
+#include "presetLoader.h"
 #include "battery.h"
 #include <ArduinoJson.h>
 #include "serverHandlers.h"
 #include <LTC2942.h>
+#include <LittleFS.h>
 
 
 Scheduler scheduler;
 
+/// @brief Monotonic millisecond time base of the scheduler.
+TimeBase schedulerTime;
+
+/// @brief Non-blocking transport for the instrument on the serial port.
+transport::SerialTransport<HardwareSerial> serialTransport(Serial);
+
+/// @brief Flash log of the samples, so they survive network outages.
+SampleLog<fs::FS> sampleLog(LittleFS);
+
+/// @brief Posts the logged samples to the server of the preset, see cfg::PresetFile::HttpClient.
+HttpPoster httpPoster;
+Uploader<fs::FS, HttpPoster> uploader(sampleLog, LittleFS, httpPoster);
+
+/// @brief Clock used for sleeping between scheduler deadlines.
+struct SystemClock {
+  static const unsigned long msPerTick = 1;
+  unsigned long long now() { return schedulerTime.update(millis()); }
+  // with WiFi light sleep enabled the SDK sleeps the CPU during delay
+  void sleep(unsigned long ms) { delay(ms); }
+} systemClock;
+
+// Name of the preset run from boot, loaded from the presets directory, see loadPreset.
+#ifndef STARTUP_PRESET
+#define STARTUP_PRESET "default"
+#endif
+
 const unsigned int fullCapacity = 240; // Maximum value is 5500 mAh
 
 LTC2942 gauge(50); // Takes R_SENSE value (in milliohms) as constructor argument, can be omitted if using LTC2942-1
@@ -28,6 +62,9 @@ void setup() {
   Serial.printf("SNTP update interval: %d\n", SNTP_UPDATE_DELAY);
   
   WiFi.mode(WIFI_STA);
+#if IDLE_SLEEP_MAX_MS > 0
+  WiFi.setSleepMode(WIFI_LIGHT_SLEEP);
+#endif
   WiFi.begin("NanoLab", "********");
   while (WiFi.status() != WL_CONNECTED) {
     delay(1000);
@@ -47,7 +84,23 @@ void setup() {
   // Set timezone to Eastern Standard Time
   setenv("TZ", "EET-2EEST,M3.5.0/3,M10.5.0/4", 1);
   tzset();
+  const bool logRestarted = !LittleFS.begin() || sampleLog.begin() != 0;
+  if (logRestarted) {
+    Serial.println("Failed to open the sample log");
+  }
+  if (uploader.begin(logRestarted) != 0) {
+    Serial.println("Failed to load the upload cursor");
+  }
   serverSetup();
+  scheduler.setBudget(SCHEDULER_BUDGET_US, micros);
+  // the preset tasks feed the samples to /events, /samples, the sample log and the uploader
+  cfg::PresetHandle preset = cfg::PresetHandle::create();
+  if (preset && loadPreset(STARTUP_PRESET, *preset) == 0) {
+    setUpPresetCommands(scheduler, preset);
+    Serial.println("Preset " STARTUP_PRESET " started");
+  } else {
+    Serial.println("No preset " STARTUP_PRESET ", only serving requests");
+  }
 
   Serial.println("HTTP server started");
   if (!MDNS.begin("rscpi")) {             // Start the mDNS responder for rscpi.local
@@ -89,8 +142,14 @@ void loop() {
   digitalWrite(D7, (millis()/1000)%2);
   digitalWrite(D8, (1+millis()/1000)%2);
   MDNS.update();
-  time_t now = time(nullptr);
-  scheduler.update(now);
+  serialTransport.update(systemClock.now());
+  scheduler.update(systemClock.now());
+  sampleLog.update(systemClock.now());
+  uploader.update(systemClock.now());
+#if IDLE_SLEEP_MAX_MS > 0
+  // a post in progress is stepped by every loop
+  if(!uploader.isBusy()) idle::sleepUntilNextTask(scheduler, systemClock, IDLE_SLEEP_MAX_MS);
+#endif
   
   // unsigned int raw = gauge.getRawAccumulatedCharge();
   // Serial.print(F("Raw Accumulated Charge: "));
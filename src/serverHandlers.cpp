@@ -8,10 +8,72 @@
 ESP8266WebServer server(80);
 ESP8266WebServerSecure serverSecure(443);
 
+/// @brief Clients subscribed to the /events path of each server.
+events::EventStream<WiFiClient> eventClients;
+events::EventStream<WiFiClientSecure> eventClientsSecure;
+
+/// @brief Results of the scheduled commands, fetched through the /samples path.
+SampleBuffer<> samples;
+
+/// @brief Responses of the queries sent through /exec with a "cache_ttl".
+cache::ResponseCache<> responseCache;
+
 extern Scheduler scheduler; // defined in ./main.cpp
+extern TimeBase schedulerTime; // defined in ./main.cpp
+extern transport::SerialTransport<HardwareSerial> serialTransport; // defined in ./main.cpp
+extern SampleLog<fs::FS> sampleLog; // defined in ./main.cpp
 
 String acc="";
 
+// Maximum number of commands in one /exec_batch request.
+#ifndef BATCH_MAX_COMMANDS
+#define BATCH_MAX_COMMANDS 16
+#endif
+
+/// @brief Waits for a serial transaction to finish.
+/// The transport is kept running while waiting, and the WiFi stack gets to run in between.
+/// @param handle The transaction handle.
+/// @return The finished transaction.
+static const transport::Transaction* waitForTransaction(int handle) {
+	while(serialTransport.getStatus(handle) == transport::Status::Pending) {
+		serialTransport.update(schedulerTime.update(millis()));
+		yield();
+	}
+	return serialTransport.get(handle);
+}
+
+/// @brief Block sink writing the bytes to the client of a server as one HTTP chunk.
+/// @param context Pointer to the server.
+template <typename WSBase>
+static void sendChunk(const uint8_t* data, size_t length, void* context) {
+	((esp8266webserver::ESP8266WebServerTemplate<WSBase>*)context)->sendContent((const char*)data, length);
+}
+
+/// @brief Sends a command and streams its response to the client with chunked transfer, as the bytes arrive.
+/// The response is never buffered as a whole, so it can be of any length.
+/// @param server reference to the server.
+/// @param command The command to send.
+/// @param EOL The response EOL.
+/// @param block Whether the response is an IEEE 488.2 binary block, of which only the payload is sent.
+/// @param timeout Response timeout in milliseconds, counted from the last received byte.
+template <typename WSBase>
+static void streamResponse(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server,
+		const char* command, const char* EOL, bool block, unsigned long timeout) {
+	const transport::BlockParser parser = block ? transport::BlockParser(EOL) : transport::BlockParser::forLine(EOL);
+	responseCache.observe(command);
+	const int handle = serialTransport.submitBlock(command, nullptr, parser, sendChunk<WSBase>, timeout, nullptr, &server);
+	if(handle < 0) {
+		server.send(503, "text/plain", "Serial transport is busy");
+		return;
+	}
+	server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+	server.send(200, block ? "application/octet-stream" : "text/plain", "");
+	waitForTransaction(handle);
+	serialTransport.release(handle);
+	// the empty chunk ends the response
+	server.sendContent("");
+}
+
 /// @brief Function for handling the root path.
 /// @param server reference to the server.
 template <typename WSBase>
@@ -35,11 +97,15 @@ void handleNotFound(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server)
 /// @param server reference to the server.
 /// @details The /exec path is used to execute commands on the microcontroller.
 /// The command is sent to the microcontroller as a JSON object.
+/// With "stream": true the response is forwarded with chunked transfer as it arrives,
+/// and with "block": true it is read as an IEEE 488.2 binary block.
+/// With "cache_ttl": <ms> the response of a query may come from the response cache,
+/// and a fresh one is kept there for that long. Any command that is not a query empties the cache.
 template <typename WSBase>
 void handleExec(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server) {
 	//Serial.println("Handle exec");
 	String input = server.arg("plain");
-	StaticJsonDocument<200> doc;
+	StaticJsonDocument<256> doc;
 	deserializeJson(doc, input);
 	if(doc.isNull()) {
 		//Serial.println("Failed to parse JSON");
@@ -66,45 +132,330 @@ void handleExec(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server) {
 		server.send(400, "text/plain", "expect_response is not a boolean");
 		return;
 	}
-	String cmd = String(doc["command"].as<const char*>());
-	Serial.print(cmd);
-	Serial.flush();
-	if(doc["expect_response"].as<bool>()) {
-		auto currentTimeout = Serial.getTimeout();
-		if(doc.containsKey("response_timeout")){
-			if(doc["response_timeout"].is<unsigned int>()) {
-				Serial.setTimeout(doc["response_timeout"].as<unsigned int>());
-			} else {
-				server.send(400, "text/plain", "response_timeout is not an unsigned integer");
+	const bool expectResponse = doc["expect_response"].as<bool>();
+	unsigned long timeout = Serial.getTimeout();
+	if(doc.containsKey("response_timeout")){
+		if(doc["response_timeout"].is<unsigned int>()) {
+			timeout = doc["response_timeout"].as<unsigned int>();
+		} else {
+			server.send(400, "text/plain", "response_timeout is not an unsigned integer");
+			return;
+		}
+	}
+
+	char EOL[2] = "\n";
+	if(doc.containsKey("response_EOL")) {
+		if(doc["response_EOL"].is<const char*>()) {
+			if(strlen(doc["response_EOL"].as<const char*>()) != 1) {
+				server.send(400, "text/plain", "response_EOL is not a single character");
 				return;
 			}
+			EOL[0] = doc["response_EOL"].as<const char*>()[0];
+		} else {
+			server.send(400, "text/plain", "response_EOL is not a single character");
+			return;
+		}
+	}
+
+	bool stream = false;
+	if(doc.containsKey("stream")) {
+		if(!doc["stream"].is<bool>()) {
+			server.send(400, "text/plain", "stream is not a boolean");
+			return;
+		}
+		stream = doc["stream"].as<bool>();
+	}
+	bool block = false;
+	if(doc.containsKey("block")) {
+		if(!doc["block"].is<bool>()) {
+			server.send(400, "text/plain", "block is not a boolean");
+			return;
+		}
+		block = doc["block"].as<bool>();
+	}
+	if(block && !stream) {
+		server.send(400, "text/plain", "block requires stream");
+		return;
+	}
+	unsigned long cacheTtl = 0;
+	if(doc.containsKey("cache_ttl")) {
+		if(!doc["cache_ttl"].is<unsigned int>()) {
+			server.send(400, "text/plain", "cache_ttl is not an unsigned integer");
+			return;
 		}
+		if(stream) {
+			server.send(400, "text/plain", "cache_ttl can not be used with stream");
+			return;
+		}
+		cacheTtl = doc["cache_ttl"].as<unsigned int>();
+	}
+	if(stream) {
+		streamResponse(server, doc["command"].as<const char*>(), EOL, block, timeout);
+		return;
+	}
 
+	const char* command = doc["command"].as<const char*>();
+	if(cacheTtl > 0) {
+		const char* cached = responseCache.get(command, schedulerTime.update(millis()));
+		if(cached != nullptr) {
+			server.send(200, "text/plain", cached);
+			return;
+		}
+	}
+	responseCache.observe(command);
+	// the same query from another client, or from a preset task, may already be in flight
+	const int handle = expectResponse && scpi::isQueryOnly(command)
+		? serialTransport.submitShared(command, nullptr, transport::LineFramer(EOL), timeout)
+		: serialTransport.submit(command, nullptr, transport::LineFramer(EOL), expectResponse, timeout);
+	if(handle < 0) {
+		server.send(503, "text/plain", "Serial transport is busy");
+		return;
+	}
+	const transport::Transaction* transaction = waitForTransaction(handle);
+	if(expectResponse && transaction->length == 0) {
+		serialTransport.release(handle);
+		server.send(400, "text/plain", "No response");
+		return;
+	}
+	if(cacheTtl > 0 && transaction->status == transport::Status::Done) {
+		responseCache.put(command, transaction->response, cacheTtl, schedulerTime.update(millis()));
+	}
+	server.send(200, "text/plain", transaction->response);
+	serialTransport.release(handle);
+}
 
-		char EOL = '\n';
-		if(doc.containsKey("response_EOL")) {
-			if(doc["response_EOL"].is<const char*>()) {
-				if(strlen(doc["response_EOL"].as<const char*>()) != 1) {
-					server.send(400, "text/plain", "response_EOL is not a single character");
+/// @brief Function for handling the /exec_batch path.
+/// @param server reference to the server.
+/// @details The /exec_batch path sends several commands in one request, as a JSON object:
+/// {"commands": [...], "mode": "join" or "pipeline", "terminator": "\n", "response_EOL": "\n", "response_timeout": 1000}.
+/// In "join" mode the commands are joined with ';' into one SCPI message, so the queries are answered in one line.
+/// In "pipeline" mode the commands are sent back to back, without waiting for the previous response.
+/// The response is a JSON object {"responses": [...]}, with "" for commands that are not queries.
+template <typename WSBase>
+void handleExecBatch(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server) {
+	DynamicJsonDocument doc(1024);
+	if(deserializeJson(doc, server.arg("plain")) || doc.isNull()) {
+		server.send(400, "text/plain", "Failed to parse JSON");
+		return;
+	}
+	if(!doc["commands"].is<JsonArray>()) {
+		server.send(400, "text/plain", "commands is not an array");
+		return;
+	}
+	JsonArray commandArray = doc["commands"].as<JsonArray>();
+	const size_t count = commandArray.size();
+	if(count == 0 || count > BATCH_MAX_COMMANDS) {
+		server.send(400, "text/plain", "Wrong number of commands");
+		return;
+	}
+	const char* commands[BATCH_MAX_COMMANDS];
+	for(size_t i = 0; i < count; i++) {
+		if(!commandArray[i].is<const char*>()) {
+			server.send(400, "text/plain", "Command is not a string");
+			return;
+		}
+		commands[i] = commandArray[i].as<const char*>();
+	}
+
+	bool pipeline = false;
+	if(doc.containsKey("mode")) {
+		const char* mode = doc["mode"].is<const char*>() ? doc["mode"].as<const char*>() : "";
+		if(strcmp(mode, "pipeline") == 0) {
+			pipeline = true;
+		} else if(strcmp(mode, "join") != 0) {
+			server.send(400, "text/plain", "mode is not join or pipeline");
+			return;
+		}
+	}
+
+	unsigned long timeout = Serial.getTimeout();
+	if(doc.containsKey("response_timeout")){
+		if(doc["response_timeout"].is<unsigned int>()) {
+			timeout = doc["response_timeout"].as<unsigned int>();
+		} else {
+			server.send(400, "text/plain", "response_timeout is not an unsigned integer");
+			return;
+		}
+	}
+
+	char EOL[2] = "\n";
+	if(doc.containsKey("response_EOL")) {
+		if(!doc["response_EOL"].is<const char*>() || strlen(doc["response_EOL"].as<const char*>()) != 1) {
+			server.send(400, "text/plain", "response_EOL is not a single character");
+			return;
+		}
+		EOL[0] = doc["response_EOL"].as<const char*>()[0];
+	}
+
+	char terminator[3] = "\n";
+	if(doc.containsKey("terminator")) {
+		if(!doc["terminator"].is<const char*>() || strlen(doc["terminator"].as<const char*>()) > 2) {
+			server.send(400, "text/plain", "terminator is longer than 2 characters");
+			return;
+		}
+		strcpy(terminator, doc["terminator"].as<const char*>());
+	}
+
+	DynamicJsonDocument reply(JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(BATCH_MAX_COMMANDS)
+		+ BATCH_MAX_COMMANDS * TRANSPORT_RESPONSE_SIZE);
+	JsonArray responses = reply.createNestedArray("responses");
+
+	if(pipeline) {
+		int handles[BATCH_MAX_COMMANDS];
+		size_t submitted = 0;
+		size_t done = 0;
+		// the last time a command of ours was submitted or answered
+		unsigned long progressAt = millis();
+		while(done < count) {
+			// keep the transport queue full, so the commands go out back to back
+			while(submitted < count) {
+				const char* command = commands[submitted];
+				responseCache.observe(command);
+				const int handle = scpi::isQueryOnly(command)
+					? serialTransport.submitShared(command, terminator, transport::LineFramer(EOL), timeout)
+					: serialTransport.submit(command, terminator, transport::LineFramer(EOL), scpi::isQuery(command), timeout);
+				if(handle < 0) break;
+				handles[submitted++] = handle;
+				progressAt = millis();
+			}
+			if(submitted == done) {
+				// nothing of ours is in flight, so the command does not fit even into an idle transport with a free slot
+				if(serialTransport.isIdle() && serialTransport.hasFreeSlot()) {
+					server.send(400, "text/plain", "Command is too long");
 					return;
 				}
-				EOL = doc["response_EOL"].as<const char*>()[0];
-			} else {
-				server.send(400, "text/plain", "response_EOL is not a single character");
-				return;
+				// the slots are held by transactions of others that have not been released yet
+				if(millis() - progressAt >= timeout) {
+					server.send(503, "text/plain", "Serial transport is busy");
+					return;
+				}
+				serialTransport.update(schedulerTime.update(millis()));
+				yield();
+				continue;
 			}
+			// responses are copied, as the transaction is released right away
+			responses.add((char*)waitForTransaction(handles[done])->response);
+			serialTransport.release(handles[done]);
+			done++;
+			progressAt = millis();
 		}
-		String response = Serial.readStringUntil(EOL);
-		Serial.setTimeout(currentTimeout);
-		if(response.length() == 0) {
-			server.send(400, "text/plain", "No response");
+	} else {
+		char message[TRANSPORT_TX_SIZE + 1];
+		if(scpi::joinCommands(message, transport::maxCommandLength(terminator) + 1, commands, count) == 0) {
+			server.send(400, "text/plain", "Commands are too long to join");
 			return;
 		}
-		server.send(200, "text/plain", response);
-	} else {
-		server.send(200, "text/plain", "");
+		size_t queries = 0;
+		for(size_t i = 0; i < count; i++) {
+			if(scpi::isQuery(commands[i])) queries++;
+		}
+		responseCache.observe(message);
+		const int handle = scpi::isQueryOnly(message)
+			? serialTransport.submitShared(message, terminator, transport::LineFramer(EOL), timeout)
+			: serialTransport.submit(message, terminator, transport::LineFramer(EOL), queries > 0, timeout);
+		if(handle < 0) {
+			server.send(503, "text/plain", "Serial transport is busy");
+			return;
+		}
+		char response[TRANSPORT_RESPONSE_SIZE];
+		strcpy(response, waitForTransaction(handle)->response);
+		serialTransport.release(handle);
+
+		const char* parts[BATCH_MAX_COMMANDS];
+		const size_t partCount = scpi::splitResponses(response, parts, queries);
+		size_t query = 0;
+		for(size_t i = 0; i < count; i++) {
+			if(!scpi::isQuery(commands[i])) {
+				responses.add("");
+				continue;
+			}
+			responses.add(query < partCount ? (char*)parts[query] : (char*)"");
+			query++;
+		}
+	}
+
+	String output;
+	serializeJson(reply, output);
+	server.send(200, "application/json", output);
+}
+
+/// @brief Function for handling the /events path.
+/// @param server reference to the server.
+/// @param stream The event stream of the server.
+/// @details The connection is kept open, and the results of the scheduled commands
+/// are pushed to it as Server-Sent Events.
+template <typename WSBase, typename Client>
+void handleEvents(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server, events::EventStream<Client> &stream) {
+	server.client().setNoDelay(true);
+	if(!stream.subscribe(server.client())) {
+		server.send(503, "text/plain", "Too many event clients");
 	}
-	
+}
+
+/// @brief Function for handling the /samples path.
+/// @param server reference to the server.
+/// @details Responds with all samples newer than the "since" sequence number, streamed with chunked transfer:
+/// {"oldest": <sequence>, "newest": <sequence>, "samples": [[<sequence>, <time>, <preset>, "<response>"], ...]}.
+/// A client passes the newest sequence number it has seen, and can tell from "oldest" if it has missed samples.
+template <typename WSBase>
+void handleSamples(esp8266webserver::ESP8266WebServerTemplate<WSBase> &server) {
+	uint32_t since = 0;
+	if(server.hasArg("since")) {
+		const String& arg = server.arg("since");
+		char* end;
+		since = strtoul(arg.c_str(), &end, 10);
+		if(arg.length() == 0 || *end != '\0') {
+			server.send(400, "text/plain", "since is not an unsigned integer");
+			return;
+		}
+	}
+	server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+	server.send(200, "application/json", "");
+
+	char chunk[512];
+	size_t length = snprintf(chunk, sizeof(chunk), "{\"oldest\":%u,\"newest\":%u,\"samples\":[",
+		(unsigned int)samples.oldest(), (unsigned int)samples.newest());
+	uint32_t sequence = since < samples.oldest() ? samples.oldest() : since + 1;
+	for(bool firstRecord = true; samples.get(sequence) != nullptr; sequence++, firstRecord = false) {
+		const Sample& sample = *samples.get(sequence);
+		char response[TRANSPORT_RESPONSE_SIZE];
+		samples.copyText(sample, response, sizeof(response));
+		char record[EVENT_SIZE];
+		size_t recordLength = snprintf(record, sizeof(record), "%s[%u,%llu,%u,\"",
+			firstRecord ? "" : ",", (unsigned int)sample.sequence, (unsigned long long)sample.time, sample.preset);
+		recordLength = events::appendEscaped(record, sizeof(record) - 2, recordLength, response);
+		record[recordLength++] = '"';
+		record[recordLength++] = ']';
+		if(length + recordLength > sizeof(chunk)) {
+			server.sendContent(chunk, length);
+			length = 0;
+		}
+		memcpy(chunk + length, record, recordLength);
+		length += recordLength;
+	}
+	server.sendContent(chunk, length);
+	server.sendContent("]}");
+	// the empty chunk ends the response
+	server.sendContent("");
+}
+
+/// @brief Stores the response of a scheduled command in RAM and in the flash log, and pushes it to all event clients.
+/// The event is formatted once and the same buffer is written to every client.
+/// @param preset Id of the preset that produced the response.
+/// @param source The source of the response, e.g. the experiment id of the preset.
+/// @param response The response of the instrument.
+void publishResponse(uint8_t preset, const char* source, const char* response) {
+	struct timeval now;
+	gettimeofday(&now, nullptr);
+	const unsigned long long time = now.tv_sec * 1000ULL + now.tv_usec / 1000;
+	const uint32_t sequence = samples.add(time, preset, response);
+	sampleLog.append(time, sequence, preset, response);
+	if(eventClients.count() == 0 && eventClientsSecure.count() == 0) return;
+	char event[EVENT_SIZE];
+	const size_t length = events::formatSample(event, sizeof(event), time, source, response);
+	if(length == 0) return;
+	eventClients.publish(event, length);
+	eventClientsSecure.publish(event, length);
 }
 
 /// @brief Function for setting up the webserver.
@@ -128,13 +479,43 @@ void serverSetup() {
 		handleExec(serverSecure);
 	});
 
+	server.on("/exec_batch", [](){
+		//Serial.println("Handling exec_batch from server");
+		handleExecBatch(server);
+	});
+	serverSecure.on("/exec_batch", [](){
+		//Serial.println("Handling exec_batch from serverSecure");
+		handleExecBatch(serverSecure);
+	});
+
+	server.on("/events", [](){
+		//Serial.println("Handling events from server");
+		handleEvents(server, eventClients);
+	});
+	serverSecure.on("/events", [](){
+		//Serial.println("Handling events from serverSecure");
+		handleEvents(serverSecure, eventClientsSecure);
+	});
+
+	server.on("/samples", [](){
+		//Serial.println("Handling samples from server");
+		handleSamples(server);
+	});
+	serverSecure.on("/samples", [](){
+		//Serial.println("Handling samples from serverSecure");
+		handleSamples(serverSecure);
+	});
+
 	server.on("/read", [](){
 		//Serial.println("Handling read from server");
-		auto currentTimeout = Serial.getTimeout();
-		Serial.setTimeout(1000);
-		String response = Serial.readStringUntil('\n');
-		server.send(200, "text/plain", response);
-		Serial.setTimeout(currentTimeout);
+		// an empty command reads the next line, also one that arrived before the request
+		const int handle = serialTransport.submit("", nullptr, transport::LineFramer("\n"), true, 1000);
+		if(handle < 0) {
+			server.send(503, "text/plain", "Serial transport is busy");
+			return;
+		}
+		server.send(200, "text/plain", waitForTransaction(handle)->response);
+		serialTransport.release(handle);
 	});
 
 	server.onNotFound([](){
@@ -0,0 +1,143 @@
+#include <unity.h>
+#include <string>
+#include "blockParser.h"
+
+using transport::BlockParser;
+
+std::string payload;
+int chunks = 0;
+
+void sink(const uint8_t* data, size_t length, void* context) {
+	payload.append((const char*)data, length);
+	chunks++;
+	(*(int*)context)++;
+}
+
+int calls = 0;
+
+void setUp() {
+	payload.clear();
+	chunks = 0;
+	calls = 0;
+}
+
+void tearDown() {}
+
+/// @brief Feeds a string, optionally one byte at a time.
+size_t feed(BlockParser& parser, const std::string& input, bool byteByByte = false) {
+	if(!byteByByte) return parser.feed((const uint8_t*)input.data(), input.size(), sink, &calls);
+	size_t consumed = 0;
+	for(size_t i = 0; i < input.size() && !parser.isFinished(); i++) {
+		consumed += parser.feed((const uint8_t*)input.data() + i, 1, sink, &calls);
+	}
+	return consumed;
+}
+
+void test_definite() {
+	BlockParser parser("\n");
+	const std::string block = std::string("#15") + std::string("a\0b\nc", 5) + "\n";
+	TEST_ASSERT_EQUAL(block.size(), feed(parser, block + "next"));
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Done);
+	TEST_ASSERT_EQUAL(5, parser.getReceived());
+	TEST_ASSERT_TRUE(payload == std::string("a\0b\nc", 5));
+	// the whole payload in one call
+	TEST_ASSERT_EQUAL(1, chunks);
+	TEST_ASSERT_EQUAL(1, calls);
+}
+
+void test_definite_byte_by_byte() {
+	BlockParser parser("\r\n");
+	std::string data(1000, 'x');
+	data[500] = '#';
+	const std::string block = "#41000" + data + "\r\n";
+	TEST_ASSERT_EQUAL(block.size(), feed(parser, block, true));
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Done);
+	TEST_ASSERT_TRUE(payload == data);
+}
+
+void test_wants() {
+	BlockParser parser("\n");
+	TEST_ASSERT_EQUAL(1, parser.wants());
+	feed(parser, "#3120");
+	TEST_ASSERT_EQUAL(120, parser.wants());
+	feed(parser, std::string(100, 'y'));
+	TEST_ASSERT_EQUAL(20, parser.wants());
+	feed(parser, std::string(20, 'y') + "\n");
+	TEST_ASSERT_EQUAL(0, parser.wants());
+}
+
+void test_skips_header() {
+	BlockParser parser("\n");
+	feed(parser, ":CURV #13abc\n");
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Done);
+	TEST_ASSERT_EQUAL_STRING("abc", payload.c_str());
+}
+
+void test_no_trailer() {
+	BlockParser parser("");
+	TEST_ASSERT_EQUAL(5, feed(parser, "#12ab\n"));
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Done);
+	TEST_ASSERT_EQUAL_STRING("ab", payload.c_str());
+}
+
+void test_empty_block() {
+	BlockParser parser("\n");
+	feed(parser, "#10\n");
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Done);
+	TEST_ASSERT_EQUAL(0, parser.getReceived());
+	TEST_ASSERT_EQUAL(0, calls);
+}
+
+void test_indefinite() {
+	BlockParser parser("\r\n");
+	const std::string block = "#0ab\rc\r\r\n";
+	TEST_ASSERT_EQUAL(block.size(), feed(parser, block + "rest"));
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Done);
+	TEST_ASSERT_EQUAL_STRING("ab\rc\r", payload.c_str());
+
+	setUp();
+	parser.reset();
+	TEST_ASSERT_EQUAL(block.size(), feed(parser, block + "rest", true));
+	TEST_ASSERT_EQUAL_STRING("ab\rc\r", payload.c_str());
+}
+
+void test_line() {
+	BlockParser parser = BlockParser::forLine("\r\n");
+	TEST_ASSERT_EQUAL(13, feed(parser, "#1 +1.0E+00\r\n+2", true));
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Done);
+	TEST_ASSERT_EQUAL_STRING("#1 +1.0E+00", payload.c_str());
+
+	setUp();
+	parser.reset();
+	feed(parser, "abc\r\n");
+	TEST_ASSERT_EQUAL_STRING("abc", payload.c_str());
+}
+
+void test_malformed() {
+	BlockParser parser("\n");
+	feed(parser, "#x");
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Error);
+
+	parser.reset();
+	feed(parser, "#21a");
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Error);
+
+	parser.reset();
+	feed(parser, "#12abX");
+	TEST_ASSERT_TRUE(parser.getState() == BlockParser::State::Error);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_definite);
+	RUN_TEST(test_definite_byte_by_byte);
+	RUN_TEST(test_wants);
+	RUN_TEST(test_skips_header);
+	RUN_TEST(test_no_trailer);
+	RUN_TEST(test_empty_block);
+	RUN_TEST(test_indefinite);
+	RUN_TEST(test_line);
+	RUN_TEST(test_malformed);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include <unity.h>
+#define BLOCK_POOL_SMALL_SIZE 20
+#define BLOCK_POOL_SMALL_COUNT 2
+#define BLOCK_POOL_MEDIUM_SIZE 100
+#define BLOCK_POOL_MEDIUM_COUNT 2
+#define BLOCK_POOL_LARGE_SIZE 1000
+#define BLOCK_POOL_LARGE_COUNT 1
+#include "blockPool.h"
+
+BlockAllocator allocator;
+
+void setUp() {
+	allocator.reset();
+}
+
+void tearDown() {
+}
+
+void test_pool() {
+	BlockPool<10, 3> pool;
+	// rounded up to the alignment
+	TEST_ASSERT_EQUAL(16, (BlockPool<10, 3>::SIZE));
+	void* blocks[3];
+	for(int i = 0; i < 3; i++) {
+		blocks[i] = pool.allocate();
+		TEST_ASSERT_NOT_NULL(blocks[i]);
+		TEST_ASSERT_EQUAL(0, (uintptr_t)blocks[i] % BLOCK_POOL_ALIGN);
+		TEST_ASSERT_TRUE(pool.owns(blocks[i]));
+	}
+	TEST_ASSERT_NULL(pool.allocate());
+	TEST_ASSERT_FALSE(pool.owns((uint8_t*)blocks[1] + 1));
+	TEST_ASSERT_FALSE(pool.free((uint8_t*)blocks[1] + 1));
+	TEST_ASSERT_TRUE(pool.free(blocks[1]));
+	// the block freed last is handed out first
+	TEST_ASSERT_TRUE(blocks[1] == pool.allocate());
+
+	BlockPoolStats stats = pool.getStats();
+	TEST_ASSERT_EQUAL(3, stats.count);
+	TEST_ASSERT_EQUAL(3, stats.used);
+	TEST_ASSERT_EQUAL(3, stats.highWater);
+	TEST_ASSERT_EQUAL(1, stats.failures);
+
+	// a disabled pool takes no memory for blocks and never has one
+	BlockPool<10, 0> disabled;
+	TEST_ASSERT_NULL(disabled.allocate());
+	TEST_ASSERT_EQUAL(0, disabled.getStats().count);
+	TEST_ASSERT_EQUAL(1, disabled.getStats().failures);
+	TEST_ASSERT_TRUE(sizeof(disabled) < (BlockPool<10, 0>::SIZE));
+}
+
+void test_size_classes() {
+	// 20 bytes are rounded up to 24
+	void* small = allocator.allocate(24);
+	void* medium = allocator.allocate(25);
+	void* large = allocator.allocate(1000);
+	TEST_ASSERT_NOT_NULL(small);
+	TEST_ASSERT_NOT_NULL(medium);
+	TEST_ASSERT_NOT_NULL(large);
+	TEST_ASSERT_EQUAL(1, allocator.getStats(0).used);
+	TEST_ASSERT_EQUAL(1, allocator.getStats(1).used);
+	TEST_ASSERT_EQUAL(1, allocator.getStats(2).used);
+	TEST_ASSERT_NULL(allocator.allocate(1001));
+
+	// a full class spills into the next larger one
+	void* second = allocator.allocate(8);
+	void* third = allocator.allocate(8);
+	TEST_ASSERT_NOT_NULL(third);
+	TEST_ASSERT_EQUAL(2, allocator.getStats(0).used);
+	TEST_ASSERT_EQUAL(2, allocator.getStats(1).used);
+	// served by a larger class, so it is no failure
+	TEST_ASSERT_EQUAL(0, allocator.getStats(0).failures);
+	TEST_ASSERT_NULL(allocator.allocate(8));
+	// a failure counts once, for the class the request belongs to
+	TEST_ASSERT_EQUAL(1, allocator.getStats(0).failures);
+	TEST_ASSERT_EQUAL(0, allocator.getStats(1).failures);
+	TEST_ASSERT_EQUAL(0, allocator.getStats(2).failures);
+
+	TEST_ASSERT_TRUE(allocator.free(third));
+	TEST_ASSERT_TRUE(allocator.free(second));
+	TEST_ASSERT_TRUE(allocator.free(small));
+	TEST_ASSERT_TRUE(allocator.free(medium));
+	TEST_ASSERT_TRUE(allocator.free(large));
+	int local;
+	TEST_ASSERT_FALSE(allocator.free(&local));
+	for(unsigned int c = 0; c < BlockAllocator::SIZE_CLASSES; c++) {
+		TEST_ASSERT_EQUAL(0, allocator.getStats(c).used);
+	}
+	// the high-water marks stay until a reset
+	TEST_ASSERT_EQUAL(2, allocator.getStats(0).highWater);
+	TEST_ASSERT_EQUAL(2, allocator.getStats(1).highWater);
+	TEST_ASSERT_EQUAL(1, allocator.getStats(2).highWater);
+}
+
+void test_churn() {
+	// blocks of a fixed size never fragment, however they are freed
+	void* blocks[5];
+	const size_t sizes[5] = {16, 24, 100, 400, 8};
+	for(int round = 0; round < 1000; round++) {
+		for(int i = 0; i < 5; i++) {
+			blocks[i] = allocator.allocate(sizes[(i + round) % 5]);
+			TEST_ASSERT_NOT_NULL(blocks[i]);
+		}
+		for(int i = 0; i < 5; i++) {
+			TEST_ASSERT_TRUE(allocator.free(blocks[(i * 3 + round) % 5]));
+		}
+	}
+	TEST_ASSERT_EQUAL(0, allocator.getStats(0).used + allocator.getStats(1).used + allocator.getStats(2).used);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_pool);
+	RUN_TEST(test_size_classes);
+	RUN_TEST(test_churn);
+	UNITY_END();
+	return 0;
+}
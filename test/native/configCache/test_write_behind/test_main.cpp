@@ -0,0 +1,146 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "../../fakeFS.h"
+#include "configCache.h"
+using namespace cfg;
+
+/// @brief The contents of a slot file, without its trailer.
+std::string text(FakeFS& fs, const char* path) {
+	return std::string(fs.files[path]->begin(), fs.files[path]->end() - loc::SlotTrailer::SIZE);
+}
+
+FakeFS fs;
+const char* PATH = "/battery.json";
+
+BatterySettings defaults() {
+	BatterySettings battery;
+	battery.voltage_high = 4.2f;
+	battery.voltage_low = 3.0f;
+	battery.capacity = 2000;
+	battery.charge = 100;
+	battery.temperature_high = 60;
+	battery.temperature_low = -10;
+	return battery;
+}
+
+void setUp() {
+	fs = FakeFS();
+}
+
+void tearDown() {
+}
+
+void test_missing_file() {
+	loc::ConfigCache<BatterySettings, FakeFS> cache(fs, PATH, batteryFields, defaults());
+	TEST_ASSERT_EQUAL(-1, cache.load());
+	TEST_ASSERT_EQUAL(2000, cache.get().capacity);
+	TEST_ASSERT_EQUAL(0, cache.getDirty());
+	// nothing changed, nothing to write
+	TEST_ASSERT_EQUAL(0, cache.flush());
+	TEST_ASSERT_EQUAL(0, fs.opens);
+}
+
+void test_dirty_fields() {
+	loc::ConfigCache<BatterySettings, FakeFS> cache(fs, PATH, batteryFields, defaults());
+	BatterySettings battery = cache.get();
+	TEST_ASSERT_EQUAL(0, cache.set(battery));
+	battery.charge = 101;
+	TEST_ASSERT_EQUAL_HEX32(1 << 3, cache.set(battery));
+	battery.voltage_low = 3.1f;
+	TEST_ASSERT_EQUAL_HEX32(1 << 1, cache.set(battery));
+	TEST_ASSERT_EQUAL_HEX32(1 << 1 | 1 << 3, cache.getDirty());
+	TEST_ASSERT_EQUAL(2, cache.getChanges());
+	TEST_ASSERT_EQUAL(101, cache.get().charge);
+
+	// strings are compared up to the terminator, so leftovers after it do not count
+	loc::ConfigCache<UserConfigFile, FakeFS> users(fs, "/user.json", userFields);
+	UserConfigFile user;
+	strcpy(user.username, "admin");
+	TEST_ASSERT_EQUAL_HEX32(1 << 0, users.set(user));
+	user.username[10] = 'x';
+	TEST_ASSERT_EQUAL(0, users.set(user));
+}
+
+void test_write_behind() {
+	loc::ConfigCache<BatterySettings, FakeFS> cache(fs, PATH, batteryFields, defaults());
+	unsigned long long now = 1000;
+	// the charge changes on every update, as with Battery::setCharge
+	for(int i = 0; i < 1000; i++) {
+		BatterySettings battery = cache.get();
+		battery.charge = 200 + i;
+		cache.set(battery);
+		TEST_ASSERT_EQUAL(0, cache.update(now));
+		now += 20;
+	}
+	TEST_ASSERT_EQUAL(0, fs.opens);
+	now += CONFIG_FLUSH_MS;
+	TEST_ASSERT_EQUAL(0, cache.update(now));
+	// 1000 changes, one write
+	TEST_ASSERT_EQUAL(1, fs.opens);
+	TEST_ASSERT_EQUAL(1, cache.getWrites());
+	TEST_ASSERT_EQUAL(0, cache.getDirty());
+	TEST_ASSERT_EQUAL(0, cache.update(now + 2 * CONFIG_FLUSH_MS));
+	TEST_ASSERT_EQUAL(1, fs.opens);
+
+	loc::ConfigCache<BatterySettings, FakeFS> loaded(fs, PATH, batteryFields);
+	TEST_ASSERT_EQUAL(0, loaded.load());
+	TEST_ASSERT_EQUAL(1199, loaded.get().charge);
+	TEST_ASSERT_EQUAL_FLOAT(4.2f, loaded.get().voltage_high);
+	TEST_ASSERT_EQUAL_FLOAT(-10, loaded.get().temperature_low);
+}
+
+void test_flush_now() {
+	loc::ConfigCache<NetworkConfigFile, FakeFS> cache(fs, "/network.json", networkFields);
+	NetworkConfigFile network;
+	strcpy(network.mdns, "rscpi");
+	network.type = NetworkType::STATIC;
+	strcpy(network.static_config.ip, "192.168.0.5");
+	strcpy(network.static_config.sntp[1], "a \"quoted\" name");
+	cache.set(network);
+	TEST_ASSERT_EQUAL(0, cache.flush());
+	TEST_ASSERT_EQUAL(1, fs.opens);
+	TEST_MESSAGE(text(fs, "/network.json.a").c_str());
+
+	// the written file is read back by the JsonDocument loader as well
+	StaticJsonDocument<1000> jsonDocument;
+	TEST_ASSERT_FALSE(deserializeJson(jsonDocument, text(fs, "/network.json.a").c_str()));
+	NetworkConfigFile network2;
+	TEST_ASSERT_EQUAL(0, loadNetworkConfigFileFromJSON(network2, jsonDocument));
+	TEST_ASSERT_EQUAL(NetworkType::STATIC, network2.type);
+	TEST_ASSERT_EQUAL_STRING("a \"quoted\" name", network2.static_config.sntp[1]);
+
+	loc::ConfigCache<NetworkConfigFile, FakeFS> loaded(fs, "/network.json", networkFields);
+	TEST_ASSERT_EQUAL(0, loaded.load());
+	TEST_ASSERT_EQUAL_STRING("192.168.0.5", loaded.get().static_config.ip);
+	TEST_ASSERT_EQUAL_STRING("a \"quoted\" name", loaded.get().static_config.sntp[1]);
+}
+
+void test_write_failure() {
+	loc::ConfigCache<BatterySettings, FakeFS> cache(fs, PATH, batteryFields, defaults());
+	BatterySettings battery = cache.get();
+	battery.charge = 5;
+	cache.set(battery);
+	fs.failWrites = true;
+	TEST_ASSERT_EQUAL(0, cache.update(1));
+	TEST_ASSERT_EQUAL(-1, cache.update(1 + CONFIG_FLUSH_MS));
+	TEST_ASSERT_EQUAL_HEX32(1 << 3, cache.getDirty());
+	// not tried again right away
+	TEST_ASSERT_EQUAL(0, cache.update(2 + CONFIG_FLUSH_MS));
+	TEST_ASSERT_EQUAL(1, fs.opens);
+	fs.failWrites = false;
+	TEST_ASSERT_EQUAL(0, cache.update(1 + 2 * CONFIG_FLUSH_MS));
+	TEST_ASSERT_EQUAL(0, cache.getDirty());
+	TEST_ASSERT_EQUAL(1, cache.getWrites());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_missing_file);
+	RUN_TEST(test_dirty_fields);
+	RUN_TEST(test_write_behind);
+	RUN_TEST(test_flush_now);
+	RUN_TEST(test_write_failure);
+	UNITY_END();
+	return 0;
+}
@@ -20,20 +20,19 @@ void test_save_load_preset() {
 	strcpy(preset_file.http_client.experiment_id, "experiment_id");
 	strcpy(preset_file.http_client.experiment_description, "experiment_description");
 	preset_file.http_client.check_certs = true;
+	preset_file.http_client.binary = true;
 
-	preset_file.run_once_count = 2;
-	preset_file.run_once[0] = Command{"command1", true};
-	preset_file.run_once[1] = Command{"command2", false};
-	TEST_ASSERT_EQUAL_STRING("command1", preset_file.run_once[0].command);
-	TEST_ASSERT_EQUAL(true, preset_file.run_once[0].expect_response);
-	TEST_ASSERT_EQUAL_STRING("command2", preset_file.run_once[1].command);
-	TEST_ASSERT_EQUAL(false, preset_file.run_once[1].expect_response);
+	TEST_ASSERT_EQUAL(0, preset_file.addCommand("command1", true, false));
+	TEST_ASSERT_EQUAL(0, preset_file.addCommand("command2", false, false));
+	TEST_ASSERT_EQUAL_STRING("command1", preset_file.text(preset_file.run_once()[0]));
+	TEST_ASSERT_EQUAL(true, preset_file.run_once()[0].expect_response);
+	TEST_ASSERT_EQUAL_STRING("command2", preset_file.text(preset_file.run_once()[1]));
+	TEST_ASSERT_EQUAL(false, preset_file.run_once()[1].expect_response);
 
-	preset_file.run_scheduled_count = 2;
-	preset_file.run_scheduled[0] = Command{"command3", true};
-	preset_file.run_scheduled[1] = Command{"command4", false};
-	TEST_ASSERT_EQUAL_STRING("command3", preset_file.run_scheduled[0].command);
-	TEST_ASSERT_EQUAL(true, preset_file.run_scheduled[0].expect_response);
+	TEST_ASSERT_EQUAL(0, preset_file.addCommand("command3", true, true));
+	TEST_ASSERT_EQUAL(0, preset_file.addCommand("command4", false, true));
+	TEST_ASSERT_EQUAL_STRING("command3", preset_file.text(preset_file.run_scheduled()[0]));
+	TEST_ASSERT_EQUAL(true, preset_file.run_scheduled()[0].expect_response);
 
 	preset_file.serial.baud_rate = 9600;
 	preset_file.serial.byte_size = 8;
@@ -43,6 +42,7 @@ void test_save_load_preset() {
 
 	preset_file.task_schedule.period = 5;
 	preset_file.task_schedule.offset = 1699867392;
+	preset_file.batch_scheduled = true;
 
 	TEST_ASSERT_EQUAL(0, savePresetFileToJSON(preset_file, jsonDocument));
 	PresetFile preset_file2;
@@ -53,14 +53,15 @@ void test_save_load_preset() {
 	TEST_ASSERT_EQUAL_STRING(preset_file.http_client.experiment_id, preset_file2.http_client.experiment_id);
 	TEST_ASSERT_EQUAL_STRING(preset_file.http_client.experiment_description, preset_file2.http_client.experiment_description);
 	TEST_ASSERT_EQUAL(preset_file.http_client.check_certs, preset_file2.http_client.check_certs);
-	TEST_ASSERT_EQUAL_STRING(preset_file.run_once[0].command, preset_file2.run_once[0].command);
-	TEST_ASSERT_EQUAL(preset_file.run_once[0].expect_response, preset_file2.run_once[0].expect_response);
-	TEST_ASSERT_EQUAL_STRING(preset_file.run_once[1].command, preset_file2.run_once[1].command);
-	TEST_ASSERT_EQUAL(preset_file.run_once[1].expect_response, preset_file2.run_once[1].expect_response);
-	TEST_ASSERT_EQUAL_STRING(preset_file.run_scheduled[0].command, preset_file2.run_scheduled[0].command);
-	TEST_ASSERT_EQUAL(preset_file.run_scheduled[0].expect_response, preset_file2.run_scheduled[0].expect_response);
-	TEST_ASSERT_EQUAL_STRING(preset_file.run_scheduled[1].command, preset_file2.run_scheduled[1].command);
-	TEST_ASSERT_EQUAL(preset_file.run_scheduled[1].expect_response, preset_file2.run_scheduled[1].expect_response);
+	TEST_ASSERT_EQUAL(preset_file.http_client.binary, preset_file2.http_client.binary);
+	TEST_ASSERT_EQUAL_STRING(preset_file.text(preset_file.run_once()[0]), preset_file2.text(preset_file2.run_once()[0]));
+	TEST_ASSERT_EQUAL(preset_file.run_once()[0].expect_response, preset_file2.run_once()[0].expect_response);
+	TEST_ASSERT_EQUAL_STRING(preset_file.text(preset_file.run_once()[1]), preset_file2.text(preset_file2.run_once()[1]));
+	TEST_ASSERT_EQUAL(preset_file.run_once()[1].expect_response, preset_file2.run_once()[1].expect_response);
+	TEST_ASSERT_EQUAL_STRING(preset_file.text(preset_file.run_scheduled()[0]), preset_file2.text(preset_file2.run_scheduled()[0]));
+	TEST_ASSERT_EQUAL(preset_file.run_scheduled()[0].expect_response, preset_file2.run_scheduled()[0].expect_response);
+	TEST_ASSERT_EQUAL_STRING(preset_file.text(preset_file.run_scheduled()[1]), preset_file2.text(preset_file2.run_scheduled()[1]));
+	TEST_ASSERT_EQUAL(preset_file.run_scheduled()[1].expect_response, preset_file2.run_scheduled()[1].expect_response);
 	TEST_ASSERT_EQUAL(preset_file.serial.baud_rate, preset_file2.serial.baud_rate);
 	TEST_ASSERT_EQUAL(preset_file.serial.byte_size, preset_file2.serial.byte_size);
 	TEST_ASSERT_EQUAL(preset_file.serial.parity, preset_file2.serial.parity);
@@ -68,6 +69,8 @@ void test_save_load_preset() {
 	TEST_ASSERT_EQUAL_STRING(preset_file.serial.EOL, preset_file2.serial.EOL);
 	TEST_ASSERT_EQUAL(preset_file.task_schedule.period, preset_file2.task_schedule.period);
 	TEST_ASSERT_EQUAL(preset_file.task_schedule.offset, preset_file2.task_schedule.offset);
+	TEST_ASSERT_EQUAL(false, preset_file2.batch_once);
+	TEST_ASSERT_EQUAL(true, preset_file2.batch_scheduled);
 }
 
 
@@ -86,6 +89,7 @@ void test_deserialize_to_preset() {
 	TEST_ASSERT_EQUAL_STRING("dsga", preset_file.http_client.experiment_id);
 	TEST_ASSERT_EQUAL_STRING("something_lol", preset_file.http_client.experiment_description);
 	TEST_ASSERT_EQUAL(true, preset_file.http_client.check_certs);
+	TEST_ASSERT_EQUAL(false, preset_file.http_client.binary);
 	
 	TEST_ASSERT_EQUAL_MESSAGE( 10000, preset_file.serial.baud_rate, "Baud error");
 	TEST_ASSERT_EQUAL(8, preset_file.serial.byte_size);
@@ -95,18 +99,83 @@ void test_deserialize_to_preset() {
 	TEST_ASSERT_EQUAL(9600, preset_file.task_schedule.period);
 	TEST_ASSERT_EQUAL(8, preset_file.task_schedule.offset);
 
-	TEST_ASSERT_EQUAL_STRING("TST1", preset_file.run_once[0].command);
-	TEST_ASSERT_EQUAL(true, preset_file.run_once[0].expect_response);
-	TEST_ASSERT_EQUAL_STRING("TST2", preset_file.run_once[1].command);
-	TEST_ASSERT_EQUAL(false, preset_file.run_once[1].expect_response);
-	TEST_ASSERT_EQUAL_STRING("TST3", preset_file.run_once[2].command);
-	TEST_ASSERT_EQUAL(true, preset_file.run_once[2].expect_response);
-	TEST_ASSERT_EQUAL_STRING("TSE1", preset_file.run_scheduled[0].command);
-	TEST_ASSERT_EQUAL(true, preset_file.run_scheduled[0].expect_response);
-	TEST_ASSERT_EQUAL_STRING("TSE2", preset_file.run_scheduled[1].command);
-	TEST_ASSERT_EQUAL(false, preset_file.run_scheduled[1].expect_response);
-	TEST_ASSERT_EQUAL_STRING("TSE3", preset_file.run_scheduled[2].command);
-	TEST_ASSERT_EQUAL(true, preset_file.run_scheduled[2].expect_response);
+	TEST_ASSERT_EQUAL_STRING("TST1", preset_file.text(preset_file.run_once()[0]));
+	TEST_ASSERT_EQUAL(true, preset_file.run_once()[0].expect_response);
+	TEST_ASSERT_EQUAL_STRING("TST2", preset_file.text(preset_file.run_once()[1]));
+	TEST_ASSERT_EQUAL(false, preset_file.run_once()[1].expect_response);
+	TEST_ASSERT_EQUAL_STRING("TST3", preset_file.text(preset_file.run_once()[2]));
+	TEST_ASSERT_EQUAL(true, preset_file.run_once()[2].expect_response);
+	TEST_ASSERT_EQUAL_STRING("TSE1", preset_file.text(preset_file.run_scheduled()[0]));
+	TEST_ASSERT_EQUAL(true, preset_file.run_scheduled()[0].expect_response);
+	TEST_ASSERT_EQUAL_STRING("TSE2", preset_file.text(preset_file.run_scheduled()[1]));
+	TEST_ASSERT_EQUAL(false, preset_file.run_scheduled()[1].expect_response);
+	TEST_ASSERT_EQUAL_STRING("TSE3", preset_file.text(preset_file.run_scheduled()[2]));
+	TEST_ASSERT_EQUAL(true, preset_file.run_scheduled()[2].expect_response);
+	TEST_ASSERT_EQUAL(false, preset_file.batch_once);
+	TEST_ASSERT_EQUAL(false, preset_file.batch_scheduled);
+}
+
+void test_command_arena() {
+	PresetFile preset_file;
+	// a run_once command added later goes before the run_scheduled ones
+	TEST_ASSERT_EQUAL(0, preset_file.addCommand("READ?", true, true));
+	TEST_ASSERT_EQUAL(0, preset_file.addCommand("*RST", false, false));
+	TEST_ASSERT_EQUAL(1, preset_file.run_once_count);
+	TEST_ASSERT_EQUAL(1, preset_file.run_scheduled_count);
+	TEST_ASSERT_EQUAL_STRING("*RST", preset_file.text(preset_file.run_once()[0]));
+	TEST_ASSERT_EQUAL_STRING("READ?", preset_file.text(preset_file.run_scheduled()[0]));
+	TEST_ASSERT_EQUAL(5, preset_file.run_scheduled()[0].length);
+	TEST_ASSERT_EQUAL(11, preset_file.arena_used);
+
+	// short commands share the arena, many more than fixed 80 byte slots would fit
+	preset_file.clearCommands();
+	int added = 0;
+	while(preset_file.addCommand("MEAS?", true, added % 2) == 0) added++;
+	TEST_ASSERT_EQUAL(PRESET_COMMAND_COUNT, added);
+	TEST_ASSERT_TRUE(PRESET_COMMAND_COUNT * 6 <= preset_file.arena_used);
+
+	// long commands fill the arena, and are truncated to COMMAND_LENGTH - 1 chars
+	preset_file.clearCommands();
+	char long_command[COMMAND_LENGTH + 10];
+	memset(long_command, 'A', sizeof(long_command) - 1);
+	long_command[sizeof(long_command) - 1] = '\0';
+	added = 0;
+	while(preset_file.addCommand(long_command, false, false) == 0) added++;
+	TEST_ASSERT_EQUAL(PRESET_ARENA_SIZE / COMMAND_LENGTH, added);
+	TEST_ASSERT_EQUAL(COMMAND_LENGTH - 1, strlen(preset_file.text(preset_file.run_once()[added - 1])));
+
+	// a JSON preset whose commands do not fit is rejected, not cut short
+	PresetFile preset_file2;
+	TEST_ASSERT_EQUAL(0, savePresetFileToJSON(preset_file, jsonDocument));
+	jsonDocument["run_scheduled"].add()["command"] = long_command;
+	jsonDocument["run_scheduled"][0]["expect_response"] = true;
+	TEST_ASSERT_EQUAL(-1, loadPresetFileFromJSON(preset_file2, jsonDocument));
+}
+
+void test_preset_handle() {
+	PresetHandle empty;
+	TEST_ASSERT_FALSE(empty);
+	TEST_ASSERT_EQUAL(0, empty.references());
+
+	PresetHandle handle = PresetHandle::create();
+	TEST_ASSERT_TRUE(handle);
+	TEST_ASSERT_EQUAL(1, handle.references());
+	handle->addCommand("*IDN?", true, false);
+	{
+		PresetHandle copy = handle;
+		TEST_ASSERT_EQUAL(2, handle.references());
+		TEST_ASSERT_EQUAL_STRING("*IDN?", copy->text(copy->run_once()[0]));
+		PresetHandle moved = static_cast<PresetHandle&&>(copy);
+		TEST_ASSERT_FALSE(copy);
+		TEST_ASSERT_EQUAL(2, moved.references());
+		empty = moved;
+		TEST_ASSERT_EQUAL(3, handle.references());
+	}
+	TEST_ASSERT_EQUAL(2, handle.references());
+	empty = PresetHandle();
+	TEST_ASSERT_EQUAL(1, handle.references());
+	// a handle is small enough for a task's DataBuffer
+	TEST_ASSERT_TRUE(sizeof(PresetHandle) <= sizeof(void*));
 }
 
 
@@ -114,6 +183,8 @@ int main() {
 	UNITY_BEGIN();
 	RUN_TEST(test_save_load_preset);
 	RUN_TEST(test_deserialize_to_preset);
+	RUN_TEST(test_command_arena);
+	RUN_TEST(test_preset_handle);
 	UNITY_END();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "presetBinary.h"
+#include "../../fakeFS.h"
+using namespace cfg;
+
+/// @brief Stand-in for a File, reading and writing a byte vector.
+struct Buffer {
+	std::vector<uint8_t> data;
+	size_t position = 0;
+	size_t writeLimit = SIZE_MAX;
+
+	size_t write(const uint8_t* in, size_t length) {
+		if(data.size() + length > writeLimit) return 0;
+		data.insert(data.end(), in, in + length);
+		return length;
+	}
+	size_t read(uint8_t* out, size_t length) {
+		const size_t count = std::min(length, data.size() - position);
+		std::copy(data.begin() + position, data.begin() + position + count, out);
+		position += count;
+		return count;
+	}
+};
+
+/// @brief The output of helper_scripts/preset_to_bin.py for the preset of makeSmallPreset.
+const uint8_t GOLDEN[] = {
+	0x52, 0x53, 0x50, 0x42, 0x01, 0x28, 0x00, 0x80, 0x25, 0x00, 0x00, 0x08, 0x00, 0x01, 0x01, 0x0A, 0x05, 0x00,
+	0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x06, 0x01, 0x75, 0x01, 0x65, 0x00, 0x00, 0x01, 0x01, 0x05, 0x2A, 0x49,
+	0x44, 0x4E, 0x3F, 0x01, 0x01, 0x05, 0x52, 0x45, 0x41, 0x44, 0x3F, 0xDA, 0x87, 0x8F, 0xD7
+};
+
+PresetFile* makeSmallPreset() {
+	PresetFile* preset = new PresetFile();
+	preset->serial.baud_rate = 9600;
+	preset->serial.byte_size = 8;
+	preset->serial.parity = 0;
+	preset->serial.stop_bits = 1;
+	strcpy(preset->serial.EOL, "\n");
+	preset->task_schedule.period = 5;
+	preset->task_schedule.offset = 7;
+	strcpy(preset->http_client.url, "u");
+	strcpy(preset->http_client.experiment_id, "e");
+	preset->http_client.check_certs = true;
+	preset->batch_scheduled = true;
+	preset->addCommand("*IDN?", true, false);
+	preset->addCommand("READ?", true, true);
+	return preset;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_crc32() {
+	// the check value of CRC-32
+	TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32(0, (const uint8_t*)"123456789", 9));
+	TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32(crc32(0, (const uint8_t*)"1234", 4), (const uint8_t*)"56789", 5));
+}
+
+void test_matches_converter() {
+	PresetFile* preset = makeSmallPreset();
+	Buffer buffer;
+	TEST_ASSERT_EQUAL(sizeof(GOLDEN), writePresetBinary(buffer, *preset));
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(GOLDEN, buffer.data.data(), sizeof(GOLDEN));
+	delete preset;
+}
+
+void test_round_trip() {
+	PresetFile* preset = makeSmallPreset();
+	strcpy(preset->http_client.experiment_description, "something");
+	strcpy(preset->http_client.access_token, "secret");
+	preset->http_client.binary = true;
+	preset->batch_once = true;
+	for(int i = 1; i < 10; i++) {
+		char command[COMMAND_LENGTH];
+		snprintf(command, sizeof(command), "CONF:VOLT %d", i);
+		preset->addCommand(command, i % 2, false);
+	}
+	Buffer buffer;
+	const size_t length = writePresetBinary(buffer, *preset);
+	TEST_ASSERT_TRUE(length > 0);
+	// the fixed size fields of the struct are mostly empty
+	TEST_ASSERT_TRUE(length * 8 < sizeof(PresetFile));
+
+	PresetFile* loaded = new PresetFile();
+	TEST_ASSERT_EQUAL(0, readPresetBinary(buffer, *loaded));
+	TEST_ASSERT_EQUAL(9600, loaded->serial.baud_rate);
+	TEST_ASSERT_EQUAL(1, loaded->serial.stop_bits);
+	TEST_ASSERT_EQUAL_STRING("\n", loaded->serial.EOL);
+	TEST_ASSERT_EQUAL(5, loaded->task_schedule.period);
+	TEST_ASSERT_EQUAL(7, loaded->task_schedule.offset);
+	TEST_ASSERT_TRUE(loaded->batch_once);
+	TEST_ASSERT_TRUE(loaded->batch_scheduled);
+	TEST_ASSERT_TRUE(loaded->http_client.check_certs);
+	TEST_ASSERT_TRUE(loaded->http_client.binary);
+	TEST_ASSERT_EQUAL_STRING("u", loaded->http_client.url);
+	TEST_ASSERT_EQUAL_STRING("something", loaded->http_client.experiment_description);
+	TEST_ASSERT_EQUAL_STRING("secret", loaded->http_client.access_token);
+	TEST_ASSERT_EQUAL(10, loaded->run_once_count);
+	TEST_ASSERT_EQUAL_STRING("*IDN?", loaded->text(loaded->run_once()[0]));
+	TEST_ASSERT_EQUAL_STRING("CONF:VOLT 9", loaded->text(loaded->run_once()[9]));
+	TEST_ASSERT_TRUE(loaded->run_once()[9].expect_response);
+	TEST_ASSERT_FALSE(loaded->run_once()[8].expect_response);
+	TEST_ASSERT_EQUAL(1, loaded->run_scheduled_count);
+	TEST_ASSERT_EQUAL_STRING("READ?", loaded->text(loaded->run_scheduled()[0]));
+	TEST_ASSERT_EQUAL(preset->arena_used, loaded->arena_used);
+	delete loaded;
+	delete preset;
+}
+
+void test_rejects_corrupt_data() {
+	PresetFile* preset = new PresetFile();
+	Buffer buffer;
+	buffer.data.assign(GOLDEN, GOLDEN + sizeof(GOLDEN));
+	TEST_ASSERT_EQUAL(0, readPresetBinary(buffer, *preset));
+
+	// every flipped bit is caught by the CRC, or by the checks before it
+	for(size_t i = 0; i < sizeof(GOLDEN); i++) {
+		buffer.data.assign(GOLDEN, GOLDEN + sizeof(GOLDEN));
+		buffer.data[i] ^= 0x10;
+		buffer.position = 0;
+		TEST_ASSERT_EQUAL_MESSAGE(-1, readPresetBinary(buffer, *preset), std::to_string(i).c_str());
+	}
+
+	// truncated
+	buffer.data.assign(GOLDEN, GOLDEN + sizeof(GOLDEN) - 1);
+	buffer.position = 0;
+	TEST_ASSERT_EQUAL(-1, readPresetBinary(buffer, *preset));
+
+	// another version, with a valid CRC
+	buffer.data.assign(GOLDEN, GOLDEN + sizeof(GOLDEN) - 4);
+	buffer.data[4] = PRESET_BINARY_VERSION + 1;
+	const uint32_t crc = crc32(0, buffer.data.data(), buffer.data.size());
+	for(int i = 0; i < 4; i++) buffer.data.push_back(crc >> (8 * i));
+	buffer.position = 0;
+	TEST_ASSERT_EQUAL(-1, readPresetBinary(buffer, *preset));
+	delete preset;
+}
+
+void test_write_error() {
+	PresetFile* preset = makeSmallPreset();
+	Buffer buffer;
+	buffer.writeLimit = 20;
+	TEST_ASSERT_EQUAL(0, writePresetBinary(buffer, *preset));
+	delete preset;
+}
+
+void test_save_and_load() {
+	FakeFS fs;
+	PresetFile* preset = new PresetFile();
+	// the output of the converter, uploaded by hand
+	fs.files["/presets/small.bin"] = std::make_shared<Data>(GOLDEN, GOLDEN + sizeof(GOLDEN));
+	TEST_ASSERT_EQUAL(0, loadPresetBinary(fs, "/presets/small.bin", *preset));
+	TEST_ASSERT_EQUAL_STRING("READ?", preset->text(preset->run_scheduled()[0]));
+
+	preset->task_schedule.period = 9;
+	TEST_ASSERT_EQUAL(0, savePresetBinary(fs, "/presets/small.bin", *preset));
+	TEST_ASSERT_EQUAL(0, fs.files.count("/presets/small.bin"));
+	// power lost while saving again, the saved copy stays
+	preset->task_schedule.period = 11;
+	fs.budget = 20;
+	TEST_ASSERT_EQUAL(-1, savePresetBinary(fs, "/presets/small.bin", *preset));
+	FakeFS rebooted = fs.reboot();
+	PresetFile* loaded = new PresetFile();
+	TEST_ASSERT_EQUAL(0, loadPresetBinary(rebooted, "/presets/small.bin", *loaded));
+	TEST_ASSERT_EQUAL(9, loaded->task_schedule.period);
+	TEST_ASSERT_EQUAL(-1, loadPresetBinary(rebooted, "/presets/other.bin", *loaded));
+	delete loaded;
+	delete preset;
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_crc32);
+	RUN_TEST(test_matches_converter);
+	RUN_TEST(test_round_trip);
+	RUN_TEST(test_rejects_corrupt_data);
+	RUN_TEST(test_write_error);
+	RUN_TEST(test_save_and_load);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,200 @@
+#include <unity.h>
+#include <chrono>
+#include <string>
+#include "configSchema.h"
+using namespace cfg;
+StaticJsonDocument<8000> jsonDocument;
+
+/// @brief Stand-in for a File, reading a string in small pieces.
+struct StringSource {
+	const char* text;
+	size_t position = 0;
+	size_t length;
+
+	explicit StringSource(const char* text) : text(text), length(strlen(text)) {}
+
+	size_t read(uint8_t* out, size_t size) {
+		size_t count = length - position < size ? length - position : size;
+		memcpy(out, text + position, count);
+		position += count;
+		return count;
+	}
+};
+
+const char* NETWORK_STATIC = "{ \"mdns\": \"rscpi\", \"type\": \"static\", \"static\": { \"ip\": \"192.168.0.5\", \"mask\": \"255.255.255.0\", \"gateway\": \"192.168.0.1\", \"sntp\": [ \"1.1.1.1\", \"sntp.local\" ] } }";
+const char* BATTERY = "{\"voltage_high\":4.2,\"voltage_low\":3.1,\"capacity\":2000,\"charge\":1234,\"temperature_high\":60,\"temperature_low\":-10.5}";
+
+/// @brief Loads a configuration from a string, returning the error.
+template <typename T, size_t N>
+ConfigError load(const char* json, const Field (&fields)[N], T& target) {
+	StringSource source(json);
+	ConfigError error;
+	readConfig(source, fields, target, &error);
+	return error;
+}
+
+void setUp() {
+	jsonDocument.clear();
+}
+
+void tearDown() {
+}
+
+void test_network() {
+	NetworkConfigFile network;
+	StringSource source(NETWORK_STATIC);
+	ConfigError error;
+	TEST_ASSERT_EQUAL(0, readNetworkConfig(source, network, &error));
+	TEST_ASSERT_EQUAL_STRING("rscpi", network.mdns);
+	TEST_ASSERT_EQUAL(NetworkType::STATIC, network.type);
+	TEST_ASSERT_EQUAL_STRING("192.168.0.5", network.static_config.ip);
+	TEST_ASSERT_EQUAL_STRING("255.255.255.0", network.static_config.mask);
+	TEST_ASSERT_EQUAL_STRING("192.168.0.1", network.static_config.gateway);
+	TEST_ASSERT_EQUAL_STRING("1.1.1.1", network.static_config.sntp[0]);
+	TEST_ASSERT_EQUAL_STRING("sntp.local", network.static_config.sntp[1]);
+	TEST_ASSERT_EQUAL_STRING("", network.static_config.sntp[2]);
+
+	// the static addresses are only needed with the static type
+	NetworkConfigFile dhcp;
+	StringSource dhcpSource("{\"mdns\":\"a\",\"type\":\"DHCP\"}");
+	TEST_ASSERT_EQUAL(0, readNetworkConfig(dhcpSource, dhcp, &error));
+	TEST_ASSERT_EQUAL(NetworkType::DHCP, dhcp.type);
+	StringSource staticSource("{\"mdns\":\"a\",\"type\":\"static\"}");
+	TEST_ASSERT_EQUAL(-1, readNetworkConfig(staticSource, dhcp, &error));
+	TEST_ASSERT_EQUAL(ConfigError::MISSING_FIELD, error.code);
+	TEST_ASSERT_EQUAL_STRING("static", error.key);
+	TEST_ASSERT_EQUAL(NetworkType::DHCP, dhcp.type);
+}
+
+void test_matches_json_loaders() {
+	// files written by the JsonDocument savers load the same
+	ServerConfigFile server;
+	strcpy(server.username, "admin");
+	strcpy(server.pass, "p\"a\\ssé");
+	server.https_enabled = true;
+	saveServerConfigFileToJSON(server, jsonDocument);
+	std::string json;
+	serializeJson(jsonDocument, json);
+	ServerConfigFile server2;
+	TEST_ASSERT_EQUAL(ConfigError::NONE, load(json.c_str(), serverFields, server2).code);
+	TEST_ASSERT_EQUAL_STRING(server.username, server2.username);
+	TEST_ASSERT_EQUAL_STRING(server.pass, server2.pass);
+	TEST_ASSERT_TRUE(server2.https_enabled);
+
+	UserConfigFile user;
+	TEST_ASSERT_EQUAL(ConfigError::NONE, load("{\"pass\":\"\\u0041\\/b\",\"username\":\"root\",\"extra\":[{\"a\":[1,2.5e3,null]},true]}", userFields, user).code);
+	TEST_ASSERT_EQUAL_STRING("A/b", user.pass);
+	TEST_ASSERT_EQUAL_STRING("root", user.username);
+
+	BatterySettings battery;
+	TEST_ASSERT_EQUAL(ConfigError::NONE, load(BATTERY, batteryFields, battery).code);
+	BatterySettings battery2;
+	deserializeJson(jsonDocument, BATTERY);
+	TEST_ASSERT_EQUAL(0, loadBatterySettingsFromJSON(battery2, jsonDocument));
+	TEST_ASSERT_EQUAL_FLOAT(battery2.voltage_high, battery.voltage_high);
+	TEST_ASSERT_EQUAL_FLOAT(battery2.voltage_low, battery.voltage_low);
+	TEST_ASSERT_EQUAL(battery2.capacity, battery.capacity);
+	TEST_ASSERT_EQUAL(battery2.charge, battery.charge);
+	TEST_ASSERT_EQUAL_FLOAT(battery2.temperature_high, battery.temperature_high);
+	TEST_ASSERT_EQUAL_FLOAT(-10.5f, battery.temperature_low);
+}
+
+void test_errors() {
+	UserConfigFile user;
+	strcpy(user.username, "kept");
+	ConfigError error = load("{\"username\":\"x\"}", userFields, user);
+	TEST_ASSERT_EQUAL(ConfigError::MISSING_FIELD, error.code);
+	TEST_ASSERT_EQUAL_STRING("pass", error.key);
+	// a failed load leaves the struct as it was
+	TEST_ASSERT_EQUAL_STRING("kept", user.username);
+
+	ServerConfigFile server;
+	error = load("{\"https_enabled\":1,\"username\":\"a\",\"pass\":\"b\"}", serverFields, server);
+	TEST_ASSERT_EQUAL(ConfigError::WRONG_TYPE, error.code);
+	TEST_ASSERT_EQUAL(17, error.position);
+	TEST_ASSERT_EQUAL_STRING("https_enabled", error.key);
+
+	BatterySettings battery;
+	error = load("{\"voltage_high\":4,\"capacity\":70000}", batteryFields, battery);
+	TEST_ASSERT_EQUAL(ConfigError::OUT_OF_RANGE, error.code);
+	TEST_ASSERT_EQUAL_STRING("capacity", error.key);
+	error = load("{\"capacity\":-1}", batteryFields, battery);
+	TEST_ASSERT_EQUAL(ConfigError::OUT_OF_RANGE, error.code);
+	error = load("{\"capacity\":1.5}", batteryFields, battery);
+	TEST_ASSERT_EQUAL(ConfigError::WRONG_TYPE, error.code);
+
+	NetworkConfigFile network;
+	error = load("{\"mdns\":\"a\",\"type\":\"wifi\"}", networkFields, network);
+	TEST_ASSERT_EQUAL(ConfigError::UNKNOWN_VALUE, error.code);
+	TEST_ASSERT_EQUAL_STRING("type", error.key);
+	error = load("{\"mdns\":\"a\",\"static\":{\"ip\":5}}", networkFields, network);
+	TEST_ASSERT_EQUAL(ConfigError::WRONG_TYPE, error.code);
+	TEST_ASSERT_EQUAL_STRING("ip", error.key);
+
+	error = load("{\"username\":\"a\" \"pass\":\"b\"}", userFields, user);
+	TEST_ASSERT_EQUAL(ConfigError::SYNTAX, error.code);
+	TEST_ASSERT_EQUAL(16, error.position);
+	TEST_ASSERT_NULL(error.key);
+	error = load("{\"username\":\"a\",\"pass\":\"b", userFields, user);
+	TEST_ASSERT_EQUAL(ConfigError::INCOMPLETE, error.code);
+	TEST_ASSERT_EQUAL(25, error.position);
+	error = load("{\"x\":[[[[[[[[[[[[1]]]]]]]]]]]}", userFields, user);
+	TEST_ASSERT_EQUAL(ConfigError::TOO_DEEP, error.code);
+	TEST_ASSERT_EQUAL_STRING("TooDeep", error.c_str());
+
+	// long strings are truncated to fit, as by the JsonDocument loaders
+	error = load("{\"username\":\"0123456789012345678901234567890123456789\",\"pass\":\"\"}", userFields, user);
+	TEST_ASSERT_EQUAL(ConfigError::NONE, error.code);
+	TEST_ASSERT_EQUAL_STRING("0123456789012345678901234567890", user.username);
+}
+
+/// @brief Runs a loader many times, returning the nanoseconds per run.
+template <typename Load>
+double measure(Load load) {
+	const int RUNS = 2000;
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < RUNS; i++) {
+		TEST_ASSERT_EQUAL(0, load());
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	return (double)elapsed / RUNS;
+}
+
+void test_benchmark() {
+	NetworkConfigFile network;
+	const double networkDocument = measure([&]() {
+		StaticJsonDocument<1000> document;
+		if(deserializeJson(document, NETWORK_STATIC)) return -1;
+		return loadNetworkConfigFileFromJSON(network, document);
+	});
+	const double networkStream = measure([&]() {
+		StringSource source(NETWORK_STATIC);
+		return readNetworkConfig(source, network);
+	});
+	BatterySettings battery;
+	const double batteryDocument = measure([&]() {
+		StaticJsonDocument<1000> document;
+		if(deserializeJson(document, BATTERY)) return -1;
+		return loadBatterySettingsFromJSON(battery, document);
+	});
+	const double batteryStream = measure([&]() {
+		StringSource source(BATTERY);
+		return readConfig(source, batteryFields, battery);
+	});
+	char message[200];
+	snprintf(message, sizeof(message), "network: %.0f ns with a JsonDocument, %.0f ns streamed; battery: %.0f ns, %.0f ns; reader state %zu bytes",
+		networkDocument, networkStream, batteryDocument, batteryStream, sizeof(ConfigReader<StringSource>));
+	TEST_MESSAGE(message);
+	// the reader replaces a StaticJsonDocument<1000> on the stack
+	TEST_ASSERT_TRUE(sizeof(ConfigReader<StringSource>) < 100);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_network);
+	RUN_TEST(test_matches_json_loaders);
+	RUN_TEST(test_errors);
+	RUN_TEST(test_benchmark);
+	UNITY_END();
+	return 0;
+}
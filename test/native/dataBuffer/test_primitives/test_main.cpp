@@ -9,10 +9,9 @@
 	needing to worry about memory leaks.
 */
 
-DataBuffer db;
+StaticDataBuffer<> db;
 
 void setUp(void) {
-	db = DataBuffer();
 }
 
 void tearDown(void) {
@@ -60,7 +59,7 @@ void test_destructor_without_clear(void) {
 	// The local scope ensures that the destructor is called
 	// before the last assert.
 	{
-		DataBuffer local = DataBuffer();
+		StaticDataBuffer<> local;
 		local.set<int>(123);
 		TEST_ASSERT_TRUE(local.isDataSet());
 	}
@@ -1,11 +1,12 @@
 
 #define DATA_BUFFER_SIZE 2000
+#define BLOCK_POOL_MEDIUM_COUNT 4
+#define BLOCK_POOL_LARGE_COUNT 1
 #include "dataBuffer.h"
 #include <unity.h>
-DataBuffer db;
+StaticDataBuffer<> db;
 
 void setUp(void) {
-	db = DataBuffer();
 }
 
 void tearDown(void) {
@@ -32,12 +33,12 @@ struct DestructorWatchdog {
 };
 
 void test_empty_buffer(void) {
-	DataBuffer db;
+	StaticDataBuffer<> db;
 	TEST_ASSERT_FALSE(db.isDataSet());
 }
 
 void test_dataBuffer_set_get(void) {
-	DataBuffer db;
+	StaticDataBuffer<> db;
 	db.set<DestructorWatchdog>(DestructorWatchdog());
 	TEST_ASSERT_TRUE(db.isDataSet());
 	TEST_ASSERT_EQUAL_INT(0x69, db.get<DestructorWatchdog>().alive_flag);
@@ -50,10 +51,131 @@ void test_dataBuffer_set_get(void) {
 	TEST_ASSERT_FALSE(db.isDataSet());
 }
 
+void test_sized_buffers(void) {
+	struct alignas(16) Wide {
+		long long a;
+		long long b;
+	};
+	StaticDataBuffer<8> small;
+	static_assert(StaticDataBuffer<8>::fits<long long>(), "8 bytes fit");
+	static_assert(!StaticDataBuffer<8>::fits<Wide>(), "16 bytes do not");
+	// a larger alignment than the storage's needs room for the padding
+	static_assert(!StaticDataBuffer<16, 8>::fits<Wide>(), "16 bytes with padding do not fit into 16");
+	static_assert(StaticDataBuffer<24, 8>::fits<Wide>(), "but into 24");
+	StaticDataBuffer<24, 8> padded;
+	padded.set<Wide>(Wide{1, 2});
+	TEST_ASSERT_EQUAL(0, (uintptr_t)&padded.get<Wide>() % 16);
+	TEST_ASSERT_EQUAL(2, padded.get<Wide>().b);
+	padded.clear();
+
+	// through a DataBuffer& the size is only known at run time
+	DataBuffer& any = small;
+	TEST_ASSERT_EQUAL(8, any.getCapacity());
+	any.set<Wide>(Wide{1, 2});
+	TEST_ASSERT_FALSE(any.isDataSet());
+	TEST_ASSERT_TRUE(DataBuffer::getErrFlags() & DataBuffer::SIZE_ERR);
+	DataBuffer::clearErrFlags();
+	DataBuffer none;
+	none.set<int>(1);
+	TEST_ASSERT_FALSE(none.isDataSet());
+	DataBuffer::clearErrFlags();
+
+	// a buffer owns its data, a copy would share its block or miss its bytes
+	static_assert(!std::is_copy_constructible<StaticDataBuffer<8>>::value, "buffers cannot be copied");
+	static_assert(!std::is_copy_assignable<StaticDataBuffer<8>>::value, "buffers cannot be assigned");
+	static_assert(!std::is_copy_assignable<DataBuffer>::value, "not even through the base");
+	StaticDataBuffer<8> copy;
+	small.set<int>(5);
+	copy.set<int>(small.get<int>());
+	small.get<int>() = 6;
+	TEST_ASSERT_EQUAL(5, copy.get<int>());
+	small.clear();
+	copy.clear();
+}
+
+void test_pool(void) {
+	DataBufferPool<sizeof(DestructorWatchdog), 3> pool;
+	DataBuffer* buffers[3];
+	for(int i = 0; i < 3; i++) {
+		buffers[i] = pool.take();
+		TEST_ASSERT_NOT_NULL(buffers[i]);
+		TEST_ASSERT_TRUE(pool.owns(buffers[i]));
+	}
+	TEST_ASSERT_NULL(pool.take());
+	TEST_ASSERT_EQUAL(3, pool.getUsed());
+	buffers[1]->set<DestructorWatchdog>(DestructorWatchdog());
+	TEST_ASSERT_EQUAL_INT(0x69, buffers[1]->get<DestructorWatchdog>().alive_flag);
+	buffers[1]->clear();
+	TEST_ASSERT_TRUE(pool.give(buffers[1]));
+	TEST_ASSERT_FALSE(pool.give(&db));
+	TEST_ASSERT_EQUAL(2, pool.getUsed());
+	TEST_ASSERT_TRUE(buffers[1] == pool.take());
+}
+
+void test_spill_into_block(void) {
+	BlockAllocator& blocks = DataBuffer::getBlocks();
+	blocks.reset();
+	// too large for 16 bytes, so it goes into a block and the buffer holds the pointer
+	StaticDataBuffer<16> small;
+	static_assert(!StaticDataBuffer<16>::fits<DestructorWatchdog>(), "the watchdog is larger than 16 bytes");
+	small.set<DestructorWatchdog>(DestructorWatchdog());
+	TEST_ASSERT_TRUE(small.isDataSet());
+	TEST_ASSERT_TRUE(small.isSpilled());
+	TEST_ASSERT_EQUAL_INT(0x69, small.get<DestructorWatchdog>().alive_flag);
+	small.get<DestructorWatchdog>().data[9] = 42;
+	TEST_ASSERT_EQUAL(42, small.get<DestructorWatchdog>().data[9]);
+	TEST_ASSERT_EQUAL(1, blocks.getStats(1).used);
+	small.clear();
+	TEST_ASSERT_FALSE(small.isSpilled());
+	TEST_ASSERT_EQUAL(0, blocks.getStats(1).used);
+	TEST_ASSERT_EQUAL(1, blocks.getStats(1).highWater);
+
+	// a buffer torn down without clear frees its block as well
+	{
+		StaticDataBuffer<16> local;
+		local.set<DestructorWatchdog>(DestructorWatchdog());
+	}
+	TEST_ASSERT_EQUAL(0, blocks.getStats(1).used);
+	TEST_ASSERT_TRUE(DataBuffer::getErrFlags() & DataBuffer::DESTRUCTOR_WITHOUT_CLEAR_ERR);
+	DataBuffer::clearErrFlags();
+
+	// data that fits stays in the storage
+	small.set<int>(5);
+	TEST_ASSERT_FALSE(small.isSpilled());
+	small.clear();
+}
+
+void test_spill_without_blocks(void) {
+	struct Huge {
+		char text[BLOCK_POOL_LARGE_SIZE];
+	};
+	BlockAllocator& blocks = DataBuffer::getBlocks();
+	blocks.reset();
+	StaticDataBuffer<16> buffers[BLOCK_POOL_LARGE_COUNT + 1];
+	for(int i = 0; i < BLOCK_POOL_LARGE_COUNT; i++) {
+		buffers[i].set<Huge>(Huge());
+		TEST_ASSERT_TRUE(buffers[i].isSpilled());
+	}
+	// every large block is taken, so the buffer stays empty
+	buffers[BLOCK_POOL_LARGE_COUNT].set<Huge>(Huge());
+	TEST_ASSERT_FALSE(buffers[BLOCK_POOL_LARGE_COUNT].isDataSet());
+	TEST_ASSERT_TRUE(DataBuffer::getErrFlags() & DataBuffer::POOL_ERR);
+	DataBuffer::clearErrFlags();
+	TEST_ASSERT_EQUAL(1, blocks.getStats(2).failures);
+	for(int i = 0; i < BLOCK_POOL_LARGE_COUNT; i++) {
+		buffers[i].clear();
+	}
+	TEST_ASSERT_EQUAL(0, blocks.getStats(2).used);
+}
+
 int main(int argc, char **argv) {
 	UNITY_BEGIN();
 	RUN_TEST(test_empty_buffer);
 	RUN_TEST(test_dataBuffer_set_get);
+	RUN_TEST(test_sized_buffers);
+	RUN_TEST(test_pool);
+	RUN_TEST(test_spill_into_block);
+	RUN_TEST(test_spill_without_blocks);
 	UNITY_END();
 	return 0;
 }
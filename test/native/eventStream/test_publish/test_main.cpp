@@ -0,0 +1,106 @@
+#include <unity.h>
+#include <memory>
+#include <string>
+#include "eventStream.h"
+
+/// @brief The connection behind a mock client, shared by its copies like a WiFiClient's.
+struct Connection {
+	bool open = true;
+	int window = 1000;
+	std::string sent;
+};
+
+/// @brief Stand-in for a WiFiClient.
+struct MockClient {
+	std::shared_ptr<Connection> connection;
+
+	uint8_t connected() { return connection && connection->open; }
+	int availableForWrite() { return connection ? connection->window : 0; }
+	size_t write(const uint8_t* data, size_t length) {
+		connection->sent.append((const char*)data, length);
+		return length;
+	}
+	void stop() { connection->open = false; }
+};
+
+MockClient connect() {
+	MockClient client;
+	client.connection = std::make_shared<Connection>();
+	return client;
+}
+
+events::EventStream<MockClient, 2>* stream;
+
+void setUp() {
+	stream = new events::EventStream<MockClient, 2>();
+}
+
+void tearDown() {
+	delete stream;
+}
+
+std::string body(const MockClient& client) {
+	return client.connection->sent.substr(sizeof(events::HEADERS) - 1);
+}
+
+void test_format() {
+	char event[EVENT_SIZE];
+	const size_t length = events::formatSample(event, sizeof(event), 1700000000123ULL, "exp\"1", "+1.0E+00;\"ON\"\r");
+	TEST_ASSERT_EQUAL_STRING(
+		"event: sample\ndata: {\"time\":1700000000123,\"source\":\"exp\\\"1\",\"response\":\"+1.0E+00;\\\"ON\\\"\"}\n\n", event);
+	TEST_ASSERT_EQUAL(strlen(event), length);
+
+	char small[40];
+	TEST_ASSERT_EQUAL(0, events::formatSample(small, sizeof(small), 1, "source", "a long response that does not fit"));
+}
+
+void test_fan_out() {
+	MockClient a = connect();
+	MockClient b = connect();
+	TEST_ASSERT_TRUE(stream->subscribe(a));
+	TEST_ASSERT_TRUE(stream->subscribe(b));
+	TEST_ASSERT_EQUAL_STRING(events::HEADERS, a.connection->sent.c_str());
+	MockClient c = connect();
+	TEST_ASSERT_FALSE(stream->subscribe(c));
+	TEST_ASSERT_EQUAL(2, stream->count());
+
+	TEST_ASSERT_EQUAL(2, stream->publish("data: 1\n\n", 9));
+	TEST_ASSERT_EQUAL_STRING("data: 1\n\n", body(a).c_str());
+	TEST_ASSERT_EQUAL_STRING("data: 1\n\n", body(b).c_str());
+}
+
+void test_disconnected_slot_is_reused() {
+	MockClient a = connect();
+	MockClient b = connect();
+	stream->subscribe(a);
+	stream->subscribe(b);
+	a.connection->open = false;
+	TEST_ASSERT_EQUAL(1, stream->publish("data: 1\n\n", 9));
+	MockClient c = connect();
+	TEST_ASSERT_TRUE(stream->subscribe(c));
+	TEST_ASSERT_EQUAL(2, stream->publish("data: 2\n\n", 9));
+	TEST_ASSERT_EQUAL_STRING("data: 2\n\n", body(c).c_str());
+}
+
+void test_slow_client_misses_event() {
+	MockClient a = connect();
+	MockClient b = connect();
+	stream->subscribe(a);
+	stream->subscribe(b);
+	b.connection->window = 4;
+	TEST_ASSERT_EQUAL(1, stream->publish("data: 1\n\n", 9));
+	TEST_ASSERT_EQUAL(1, stream->getDropped());
+	TEST_ASSERT_EQUAL_STRING("", body(b).c_str());
+	stream->clear();
+	TEST_ASSERT_EQUAL(0, stream->count());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_format);
+	RUN_TEST(test_fan_out);
+	RUN_TEST(test_disconnected_slot_is_reused);
+	RUN_TEST(test_slow_client_misses_event);
+	UNITY_END();
+	return 0;
+}
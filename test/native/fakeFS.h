@@ -0,0 +1,104 @@
+// Stand-in for LittleFS shared by the native tests, keeping the files in memory.
+// Included by the tests as "../../fakeFS.h".
+
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> Data;
+
+struct FakeFS;
+
+/// @brief Stand-in for a LittleFS file, writing through its filesystem so writes can fail or power can be cut.
+struct FakeFile {
+	std::shared_ptr<Data> data;
+	FakeFS* fs = nullptr;
+	size_t position = 0;
+
+	explicit operator bool() const { return data != nullptr; }
+	size_t size() { return data->size(); }
+	bool seek(uint32_t position) {
+		this->position = position;
+		return position <= data->size();
+	}
+	size_t read(uint8_t* out, size_t length) {
+		const size_t start = std::min(position, data->size());
+		const size_t count = std::min(length, data->size() - start);
+		std::copy(data->begin() + start, data->begin() + start + count, out);
+		position = start + count;
+		return count;
+	}
+	size_t write(const uint8_t* in, size_t length);
+	bool truncate(uint32_t size) {
+		data->resize(size);
+		return true;
+	}
+	void close() {}
+};
+
+/// @brief Stand-in for LittleFS, keeping the files in memory.
+/// After budget bytes have been written the power is gone: nothing more reaches the files.
+struct FakeFS {
+	std::map<std::string, std::shared_ptr<Data>> files;
+	/// @brief The number of writes to any file.
+	int writes = 0;
+	/// @brief The number of files opened for writing or appending.
+	int opens = 0;
+	/// @brief Every write fails, as on a full filesystem.
+	bool failWrites = false;
+	/// @brief The bytes that can still be written, -1 for no limit.
+	long budget = -1;
+
+	bool dead() const { return budget == 0; }
+
+	FakeFile open(const char* path, const char* mode) {
+		FakeFile file;
+		file.fs = this;
+		auto it = files.find(path);
+		if(mode[0] == 'r') {
+			if(it != files.end()) file.data = it->second;
+			return file;
+		}
+		if(dead()) return file;
+		opens++;
+		// opening for writing truncates right away, as on flash
+		if(it == files.end() || mode[0] == 'w') files[path] = std::make_shared<Data>();
+		file.data = files[path];
+		if(mode[0] == 'a') file.position = file.data->size();
+		return file;
+	}
+	bool remove(const char* path) {
+		if(dead()) return false;
+		return files.erase(path) > 0;
+	}
+	bool rename(const char* from, const char* to) {
+		if(dead()) return false;
+		auto it = files.find(from);
+		if(it == files.end()) return false;
+		files[to] = it->second;
+		files.erase(it);
+		return true;
+	}
+	/// @brief A copy of the files as they are after a reset.
+	FakeFS reboot() const {
+		FakeFS copy;
+		for(const auto& file : files) copy.files[file.first] = std::make_shared<Data>(*file.second);
+		return copy;
+	}
+};
+
+inline size_t FakeFile::write(const uint8_t* in, size_t length) {
+	fs->writes++;
+	if(fs->failWrites) return 0;
+	if(fs->budget >= 0 && (long)length > fs->budget) length = fs->budget;
+	if(fs->budget >= 0) fs->budget -= length;
+	if(position > data->size()) position = data->size();
+	data->resize(std::max(data->size(), position + length));
+	std::copy(in, in + length, data->begin() + position);
+	position += length;
+	return length;
+}
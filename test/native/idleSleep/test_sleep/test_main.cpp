@@ -0,0 +1,119 @@
+#include <unity.h>
+#include "idleSleep.h"
+
+Scheduler scheduler;
+
+int callCounter = 0;
+
+/// @brief Stand-in for the system clock, which advances the time when sleeping.
+struct FakeClock {
+	static const unsigned long msPerTick = 1000;
+	unsigned long long ms = 0;
+	unsigned long long slept = 0;
+	unsigned long long now() { return ms / msPerTick; }
+	void sleep(unsigned long duration) {
+		ms += duration;
+		slept += duration;
+	}
+} fakeClock;
+
+void setUp() {
+	scheduler.clearTasks();
+	callCounter = 0;
+	fakeClock = FakeClock();
+}
+
+void tearDown() {
+	scheduler.clearTasks();
+	uint8_t errFlags = DataBuffer::getErrFlags();
+	DataBuffer::clearErrFlags();
+	TEST_ASSERT_EQUAL(0, errFlags);
+}
+
+auto function = [](void){callCounter++;};
+
+/// @brief Simulates the main loop for the given time.
+/// @param duration The simulated time in milliseconds.
+/// @param maxSleep The longest sleep, 0 to busy-poll.
+/// @return The number of loop iterations.
+unsigned long runLoop(unsigned long long duration, unsigned long maxSleep) {
+	unsigned long iterations = 0;
+	while(fakeClock.ms < duration) {
+		scheduler.update(fakeClock.now());
+		iterations++;
+		// every iteration costs some time, even when nothing is run
+		if(idle::sleepUntilNextTask(scheduler, fakeClock, maxSleep) == 0) fakeClock.ms++;
+	}
+	return iterations;
+}
+
+void test_no_deadline() {
+	TEST_ASSERT_TRUE(scheduler.nextDeadline() == Scheduler::NO_DEADLINE);
+	TEST_ASSERT_EQUAL(100, idle::sleepTime(scheduler.nextDeadline(), 5, 1000, 100));
+}
+
+void test_next_deadline() {
+	scheduler.scheduleRepeat(function, 10, 100);
+	scheduler.schedule(function, 50);
+	TEST_ASSERT_EQUAL(51, scheduler.nextDeadline());
+	scheduler.update(51);
+	TEST_ASSERT_EQUAL(100, scheduler.nextDeadline());
+	scheduler.update(100);
+	TEST_ASSERT_EQUAL(110, scheduler.nextDeadline());
+	scheduler.clearTasks();
+	TEST_ASSERT_TRUE(scheduler.nextDeadline() == Scheduler::NO_DEADLINE);
+}
+
+void test_repeat_until_deadline() {
+	scheduler.scheduleRepeatUntil(function, 10, 100, 105);
+	scheduler.update(100);
+	// the task has to be removed after its end timestamp, before its next period
+	TEST_ASSERT_EQUAL(106, scheduler.nextDeadline());
+	scheduler.update(106);
+	TEST_ASSERT_EQUAL(0, scheduler.getTaskCount());
+}
+
+void test_sleep_time() {
+	TEST_ASSERT_EQUAL(0, idle::sleepTime(10, 10, 1000, 100));
+	TEST_ASSERT_EQUAL(0, idle::sleepTime(10, 20, 1000, 100));
+	TEST_ASSERT_EQUAL(100, idle::sleepTime(11, 10, 1000, 100));
+	TEST_ASSERT_EQUAL(40, idle::sleepTime(50, 10, 1, 100));
+	TEST_ASSERT_EQUAL(5000, idle::sleepTime(15, 10, 1000, 60000));
+	TEST_ASSERT_EQUAL(0, idle::sleepTime(15, 10, 1000, 0));
+}
+
+void test_sleep_runs_all_tasks() {
+	scheduler.scheduleRepeat(function, 5, 0);
+	runLoop(3600000, 0);
+	const int busyCalls = callCounter;
+	setUp();
+	scheduler.scheduleRepeat(function, 5, 0);
+	runLoop(3600000, 1000);
+	TEST_ASSERT_EQUAL(busyCalls, callCounter);
+}
+
+void test_sleep_reduces_wakeups() {
+	scheduler.scheduleRepeat(function, 5, 0);
+	const unsigned long busy = runLoop(3600000, 0);
+	setUp();
+	scheduler.scheduleRepeat(function, 5, 0);
+	const unsigned long sleeping = runLoop(3600000, 100);
+	char message[100];
+	snprintf(message, sizeof(message), "loop iterations busy: %lu, sleeping: %lu, slept %llu ms", busy, sleeping, fakeClock.slept);
+	TEST_MESSAGE(message);
+	// one wake-up per 100 ms slice, and at most one extra per task run
+	TEST_ASSERT_TRUE(sleeping <= 36000 + 720 + 1);
+	TEST_ASSERT_TRUE(fakeClock.slept >= 3600000 - 720);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_no_deadline);
+	RUN_TEST(test_next_deadline);
+	RUN_TEST(test_repeat_until_deadline);
+	RUN_TEST(test_sleep_time);
+	RUN_TEST(test_sleep_runs_all_tasks);
+	RUN_TEST(test_sleep_reduces_wakeups);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,107 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "responseCache.h"
+
+cache::ResponseCache<4>* responseCache;
+
+void setUp() {
+	responseCache = new cache::ResponseCache<4>();
+}
+
+void tearDown() {
+	delete responseCache;
+}
+
+void test_hit_until_stale() {
+	TEST_ASSERT_NULL(responseCache->get("*IDN?", 0));
+	TEST_ASSERT_TRUE(responseCache->put("*IDN?", "ACME,DMM1,123,1.0", 1000, 0));
+	TEST_ASSERT_EQUAL_STRING("ACME,DMM1,123,1.0", responseCache->get("*IDN?", 999));
+	TEST_ASSERT_NULL(responseCache->get("*IDN?", 1000));
+	TEST_ASSERT_NULL(responseCache->get("*idn?", 0));
+	TEST_ASSERT_EQUAL(1, responseCache->getHits());
+	TEST_ASSERT_EQUAL(3, responseCache->getMisses());
+}
+
+void test_per_command_ttl() {
+	responseCache->put("*IDN?", "ACME", 60000, 0);
+	responseCache->put("SYST:ERR?", "+0,\"No error\"", 100, 0);
+	TEST_ASSERT_NULL(responseCache->get("SYST:ERR?", 100));
+	TEST_ASSERT_EQUAL_STRING("ACME", responseCache->get("*IDN?", 100));
+	// a new response replaces the old one
+	responseCache->put("*IDN?", "ACME2", 60000, 200);
+	TEST_ASSERT_EQUAL_STRING("ACME2", responseCache->get("*IDN?", 300));
+}
+
+void test_only_queries_are_cached() {
+	TEST_ASSERT_FALSE(responseCache->put("*RST", "", 1000, 0));
+	TEST_ASSERT_FALSE(responseCache->put("*IDN?", "ACME", 0, 0));
+	char longResponse[CACHE_RESPONSE_SIZE + 1];
+	memset(longResponse, 'x', CACHE_RESPONSE_SIZE);
+	longResponse[CACHE_RESPONSE_SIZE] = '\0';
+	TEST_ASSERT_FALSE(responseCache->put("*IDN?", longResponse, 1000, 0));
+}
+
+void test_writes_invalidate() {
+	responseCache->put("*IDN?", "ACME", 60000, 0);
+	responseCache->put("CONF?", "\"VOLT +1.0E+01\"", 60000, 0);
+	responseCache->observe("*IDN?;:SYST:ERR?");
+	responseCache->observe("");
+	TEST_ASSERT_NOT_NULL(responseCache->get("CONF?", 1));
+	responseCache->observe("CONF:CURR 1");
+	TEST_ASSERT_NULL(responseCache->get("CONF?", 1));
+	TEST_ASSERT_NULL(responseCache->get("*IDN?", 1));
+	TEST_ASSERT_EQUAL(1, responseCache->getInvalidations());
+	// a write joined with a query
+	responseCache->put("*IDN?", "ACME", 60000, 0);
+	responseCache->observe("*RST;*IDN?");
+	TEST_ASSERT_NULL(responseCache->get("*IDN?", 1));
+}
+
+void test_replaces_first_stale() {
+	char command[8];
+	for(int i = 0; i < 4; i++) {
+		snprintf(command, sizeof(command), "Q%d?", i);
+		responseCache->put(command, "1", 1000 * (i + 1), 0);
+	}
+	// full, so the entry going stale first is replaced
+	responseCache->put("Q4?", "1", 1000, 0);
+	TEST_ASSERT_NULL(responseCache->get("Q0?", 1));
+	TEST_ASSERT_NOT_NULL(responseCache->get("Q1?", 1));
+	TEST_ASSERT_NOT_NULL(responseCache->get("Q4?", 1));
+	// a stale entry is free
+	responseCache->put("Q5?", "1", 1000, 1500);
+	TEST_ASSERT_NULL(responseCache->get("Q4?", 1500));
+	TEST_ASSERT_NOT_NULL(responseCache->get("Q1?", 1500));
+	TEST_ASSERT_NOT_NULL(responseCache->get("Q5?", 1500));
+}
+
+void test_lookup_time() {
+	for(int i = 0; i < 4; i++) {
+		char command[8];
+		snprintf(command, sizeof(command), "Q%d?", i);
+		responseCache->put(command, "+1.0E+00", 60000, 0);
+	}
+	const int lookups = 100000;
+	const char* queries[] = {"Q3?", "*IDN?"};
+	unsigned long found = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < lookups; i++) {
+		if(responseCache->get(queries[i & 1], 1) != nullptr) found++;
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	TEST_ASSERT_EQUAL(lookups / 2, found);
+	printf("%.1f ns per lookup\n", std::chrono::duration<double, std::nano>(elapsed).count() / lookups);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_hit_until_stale);
+	RUN_TEST(test_per_command_ttl);
+	RUN_TEST(test_only_queries_are_cached);
+	RUN_TEST(test_writes_invalidate);
+	RUN_TEST(test_replaces_first_stale);
+	RUN_TEST(test_lookup_time);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,63 @@
+#include <unity.h>
+#include "ringBuffer.h"
+
+RingBuffer<int, 8> buffer;
+
+void setUp() {
+	buffer.clear();
+}
+
+void tearDown() {
+}
+
+void test_empty() {
+	TEST_ASSERT_TRUE(buffer.isEmpty());
+	TEST_ASSERT_EQUAL(0, buffer.size());
+	TEST_ASSERT_EQUAL(8, buffer.space());
+}
+
+void test_fifo_order() {
+	for(int i = 0; i < 8; i++) TEST_ASSERT_TRUE(buffer.push(i));
+	TEST_ASSERT_TRUE(buffer.isFull());
+	TEST_ASSERT_FALSE(buffer.push(8));
+	for(int i = 0; i < 8; i++) {
+		TEST_ASSERT_EQUAL(i, buffer.peek());
+		TEST_ASSERT_EQUAL(i, buffer.pop());
+	}
+	TEST_ASSERT_TRUE(buffer.isEmpty());
+}
+
+void test_wrap_around() {
+	// run the counters past 2^16 to check the wrap-around
+	for(int i = 0; i < 70000; i++) {
+		TEST_ASSERT_TRUE(buffer.push(i));
+		TEST_ASSERT_TRUE(buffer.push(i + 1));
+		TEST_ASSERT_EQUAL(i, buffer.pop());
+		TEST_ASSERT_EQUAL(i + 1, buffer.pop());
+	}
+	TEST_ASSERT_TRUE(buffer.isEmpty());
+}
+
+void test_push_many() {
+	const int values[6] = {1, 2, 3, 4, 5, 6};
+	TEST_ASSERT_TRUE(buffer.push(values, 6));
+	TEST_ASSERT_FALSE(buffer.push(values, 3));
+	TEST_ASSERT_EQUAL(6, buffer.size());
+	TEST_ASSERT_EQUAL(1, buffer.pop());
+	TEST_ASSERT_EQUAL(2, buffer.pop());
+	TEST_ASSERT_EQUAL(3, buffer.pop());
+	TEST_ASSERT_TRUE(buffer.push(values, 5));
+	TEST_ASSERT_EQUAL(8, buffer.size());
+	const int expected[8] = {4, 5, 6, 1, 2, 3, 4, 5};
+	for(int i = 0; i < 8; i++) TEST_ASSERT_EQUAL(expected[i], buffer.pop());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_empty);
+	RUN_TEST(test_fifo_order);
+	RUN_TEST(test_wrap_around);
+	RUN_TEST(test_push_many);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,102 @@
+#include <unity.h>
+#include <stdio.h>
+#include "sampleBuffer.h"
+
+SampleBuffer<8, 64>* buffer;
+
+void setUp() {
+	buffer = new SampleBuffer<8, 64>();
+}
+
+void tearDown() {
+	delete buffer;
+}
+
+void test_empty() {
+	TEST_ASSERT_EQUAL(0, buffer->size());
+	TEST_ASSERT_EQUAL(0, buffer->newest());
+	TEST_ASSERT_EQUAL(1, buffer->oldest());
+	TEST_ASSERT_TRUE(buffer->get(0) == nullptr);
+	TEST_ASSERT_TRUE(buffer->get(1) == nullptr);
+}
+
+void test_add_and_get() {
+	TEST_ASSERT_EQUAL(1, buffer->add(1000, 2, "+1.0E+00"));
+	TEST_ASSERT_EQUAL(2, buffer->add(2000, 3, "+2.0E+00"));
+	const Sample* sample = buffer->get(2);
+	TEST_ASSERT_NOT_NULL(sample);
+	TEST_ASSERT_EQUAL(2000, sample->time);
+	TEST_ASSERT_EQUAL(3, sample->preset);
+	char text[16];
+	TEST_ASSERT_EQUAL(8, buffer->copyText(*sample, text, sizeof(text)));
+	TEST_ASSERT_EQUAL_STRING("+2.0E+00", text);
+	TEST_ASSERT_TRUE(buffer->get(3) == nullptr);
+	// a packed number is not truncated
+	TEST_ASSERT_EQUAL(0, buffer->copyText(*sample, text, 4));
+	TEST_ASSERT_EQUAL_STRING("", text);
+	// truncated copy of a text
+	buffer->add(3000, 3, "\"OVLD\"");
+	TEST_ASSERT_EQUAL(3, buffer->copyText(*buffer->get(3), text, 4));
+	TEST_ASSERT_EQUAL_STRING("\"OV", text);
+}
+
+void test_packs_numbers() {
+	// 4 bytes packed instead of 12, so 16 fit into the 64 byte text ring, but only 8 records are kept
+	for(int i = 1; i <= 8; i++) {
+		buffer->add(i, 0, "+1.23456E+00");
+	}
+	TEST_ASSERT_EQUAL(8, buffer->size());
+	TEST_ASSERT_TRUE(buffer->get(1)->packed);
+	TEST_ASSERT_EQUAL(4, buffer->get(1)->length);
+	char text[16];
+	TEST_ASSERT_EQUAL(12, buffer->copyText(*buffer->get(1), text, sizeof(text)));
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", text);
+}
+
+void test_overwrites_oldest_record() {
+	char response[8];
+	for(int i = 1; i <= 20; i++) {
+		snprintf(response, sizeof(response), "%d", i);
+		buffer->add(i, 0, response);
+	}
+	TEST_ASSERT_EQUAL(8, buffer->size());
+	TEST_ASSERT_EQUAL(13, buffer->oldest());
+	TEST_ASSERT_EQUAL(20, buffer->newest());
+	TEST_ASSERT_TRUE(buffer->get(12) == nullptr);
+	char text[8];
+	buffer->copyText(*buffer->get(13), text, sizeof(text));
+	TEST_ASSERT_EQUAL_STRING("13", text);
+}
+
+void test_overwrites_oldest_text() {
+	// 20 bytes each, only 3 fit into the 64 byte text ring
+	for(int i = 1; i <= 5; i++) {
+		buffer->add(i, 0, "abcdefghijklmnopqrs0");
+	}
+	TEST_ASSERT_EQUAL(3, buffer->size());
+	TEST_ASSERT_EQUAL(3, buffer->oldest());
+	char text[32];
+	// the text wraps around the end of the ring
+	buffer->copyText(*buffer->get(4), text, sizeof(text));
+	TEST_ASSERT_EQUAL_STRING("abcdefghijklmnopqrs0", text);
+}
+
+void test_clear() {
+	buffer->add(1, 0, "a");
+	buffer->clear();
+	TEST_ASSERT_EQUAL(0, buffer->size());
+	TEST_ASSERT_EQUAL(2, buffer->add(2, 0, "b"));
+	TEST_ASSERT_EQUAL(2, buffer->oldest());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_empty);
+	RUN_TEST(test_add_and_get);
+	RUN_TEST(test_packs_numbers);
+	RUN_TEST(test_overwrites_oldest_record);
+	RUN_TEST(test_overwrites_oldest_text);
+	RUN_TEST(test_clear);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,186 @@
+#include <unity.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "sampleCodec.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_varint() {
+	uint8_t buffer[10];
+	uint64_t value;
+	TEST_ASSERT_EQUAL(1, codec::putVarint(buffer, sizeof(buffer), 127));
+	TEST_ASSERT_EQUAL(2, codec::putVarint(buffer, sizeof(buffer), 128));
+	TEST_ASSERT_EQUAL(2, codec::getVarint(buffer, 2, value));
+	TEST_ASSERT_EQUAL(128, value);
+	TEST_ASSERT_EQUAL(0, codec::getVarint(buffer, 1, value));
+	TEST_ASSERT_EQUAL(10, codec::putVarint(buffer, sizeof(buffer), ~0ULL));
+	TEST_ASSERT_EQUAL(10, codec::getVarint(buffer, 10, value));
+	TEST_ASSERT_TRUE(value == ~0ULL);
+	TEST_ASSERT_EQUAL(0, codec::putVarint(buffer, 1, 128));
+
+	TEST_ASSERT_EQUAL(0, codec::zigzag(0));
+	TEST_ASSERT_EQUAL(1, codec::zigzag(-1));
+	TEST_ASSERT_EQUAL(2, codec::zigzag(1));
+	TEST_ASSERT_EQUAL(-5, codec::unzigzag(codec::zigzag(-5)));
+	TEST_ASSERT_TRUE(INT64_MIN == codec::unzigzag(codec::zigzag(INT64_MIN)));
+}
+
+void test_parse_and_format() {
+	codec::Number number;
+	TEST_ASSERT_TRUE(codec::parse("+1.23456E+00", number));
+	TEST_ASSERT_EQUAL(123456, number.mantissa);
+	TEST_ASSERT_EQUAL(-5, number.exponent);
+	TEST_ASSERT_TRUE(codec::parse("-12.5", number));
+	TEST_ASSERT_EQUAL(-125, number.mantissa);
+	TEST_ASSERT_EQUAL(-1, number.exponent);
+	TEST_ASSERT_TRUE(codec::parse("42", number));
+	TEST_ASSERT_FALSE(codec::parse("", number));
+	TEST_ASSERT_FALSE(codec::parse("+", number));
+	TEST_ASSERT_FALSE(codec::parse("1.2.3", number));
+	TEST_ASSERT_FALSE(codec::parse("1E", number));
+	TEST_ASSERT_FALSE(codec::parse("ON", number));
+	TEST_ASSERT_FALSE(codec::parse("1234567890123456789", number));
+
+	const char* exact[] = {"+1.23456E+00", "-9.99999E-03", "+1.00000E+37", "+9.9E+37", "+5E+00", "-1.234567890E+123"};
+	for(const char* text : exact) {
+		char formatted[32];
+		TEST_ASSERT_TRUE(codec::parseExact(text, number));
+		codec::format(number, formatted, sizeof(formatted));
+		TEST_ASSERT_EQUAL_STRING(text, formatted);
+	}
+	const char* inexact[] = {"1.23456E+00", "+1.23456e+00", "42", "+0.00000E+00", "+1.5E+0", "ON"};
+	for(const char* text : inexact) {
+		TEST_ASSERT_FALSE(codec::parseExact(text, number));
+	}
+}
+
+void test_pack() {
+	uint8_t packed[codec::PACKED_SIZE];
+	char text[32];
+	const size_t length = codec::pack("+1.23456E+00", packed);
+	TEST_ASSERT_EQUAL(4, length);
+	TEST_ASSERT_EQUAL(12, codec::unpack(packed, length, text, sizeof(text)));
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", text);
+	TEST_ASSERT_EQUAL(0, codec::pack("1.5", packed));
+	TEST_ASSERT_EQUAL(0, codec::unpack(packed, 1, text, sizeof(text)));
+}
+
+/// @brief A DMM reading drifting around 1.2 V every second, with an occasional text reply.
+std::vector<std::string> readings(int count) {
+	std::vector<std::string> texts;
+	unsigned int state = 1;
+	for(int i = 0; i < count; i++) {
+		state = state * 1103515245 + 12345;
+		char text[32];
+		if(i % 100 == 99) {
+			snprintf(text, sizeof(text), "\"OVLD\"");
+		} else {
+			snprintf(text, sizeof(text), "+1.%05uE+00", 23000 + (state >> 16) % 1000);
+		}
+		texts.push_back(text);
+	}
+	return texts;
+}
+
+void test_delta_round_trip() {
+	const std::vector<std::string> texts = readings(1000);
+	std::vector<uint8_t> stream(64 * texts.size());
+	codec::DeltaEncoder encoder;
+	size_t length = 0;
+	size_t textBytes = 0;
+	for(size_t i = 0; i < texts.size(); i++) {
+		// a gap in the sequence and a preset change now and then
+		const uint32_t sequence = i < 500 ? i + 1 : i + 10;
+		const size_t written = encoder.encode(1700000000000ULL + i * 1000, sequence, i % 250 == 0 ? 1 : 0,
+			texts[i].c_str(), stream.data() + length, stream.size() - length);
+		TEST_ASSERT_NOT_EQUAL(0, written);
+		length += written;
+		// time (8), sequence (4), preset (1) and the text, as in a plain record
+		textBytes += 13 + texts[i].size();
+	}
+
+	codec::DeltaDecoder decoder;
+	size_t offset = 0;
+	for(size_t i = 0; i < texts.size(); i++) {
+		uint64_t time;
+		uint32_t sequence;
+		uint8_t preset;
+		char text[32];
+		const size_t read = decoder.decode(stream.data() + offset, length - offset, time, sequence, preset, text, sizeof(text));
+		TEST_ASSERT_NOT_EQUAL(0, read);
+		offset += read;
+		TEST_ASSERT_TRUE(time == 1700000000000ULL + i * 1000);
+		TEST_ASSERT_EQUAL(i < 500 ? i + 1 : i + 10, sequence);
+		TEST_ASSERT_EQUAL(i % 250 == 0 ? 1 : 0, preset);
+		TEST_ASSERT_EQUAL_STRING(texts[i].c_str(), text);
+	}
+	TEST_ASSERT_EQUAL(length, offset);
+
+	char message[100];
+	snprintf(message, sizeof(message), "%zu samples: %zu bytes plain, %zu bytes delta encoded (%.1fx)",
+		texts.size(), textBytes, length, (double)textBytes / length);
+	TEST_MESSAGE(message);
+	TEST_ASSERT_TRUE(textBytes > 5 * length);
+}
+
+void test_truncated_stream() {
+	uint8_t stream[64];
+	codec::DeltaEncoder encoder;
+	const size_t length = encoder.encode(1000, 1, 0, "+1.23456E+00", stream, sizeof(stream));
+	// does not fit, and leaves the state alone
+	uint8_t small[3];
+	TEST_ASSERT_EQUAL(0, encoder.encode(2000, 2, 0, "some text", small, sizeof(small)));
+	codec::DeltaDecoder decoder;
+	uint64_t time;
+	uint32_t sequence;
+	uint8_t preset;
+	char text[32];
+	for(size_t i = 0; i < length; i++) {
+		TEST_ASSERT_EQUAL(0, decoder.decode(stream, i, time, sequence, preset, text, sizeof(text)));
+	}
+	TEST_ASSERT_EQUAL(length, decoder.decode(stream, length, time, sequence, preset, text, sizeof(text)));
+}
+
+void test_throughput() {
+	const std::vector<std::string> texts = readings(100000);
+	std::vector<uint8_t> stream(32 * texts.size());
+	codec::DeltaEncoder encoder;
+	size_t length = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < texts.size(); i++) {
+		length += encoder.encode(i * 1000, i + 1, 0, texts[i].c_str(), stream.data() + length, stream.size() - length);
+	}
+	auto encoded = std::chrono::steady_clock::now();
+	codec::DeltaDecoder decoder;
+	size_t offset = 0;
+	for(size_t i = 0; i < texts.size(); i++) {
+		uint64_t time;
+		uint32_t sequence;
+		uint8_t preset;
+		char text[32];
+		offset += decoder.decode(stream.data() + offset, length - offset, time, sequence, preset, text, sizeof(text));
+	}
+	auto decoded = std::chrono::steady_clock::now();
+	TEST_ASSERT_EQUAL(length, offset);
+	char message[120];
+	snprintf(message, sizeof(message), "encode %.0f ns per sample, decode %.0f ns per sample",
+		std::chrono::duration<double, std::nano>(encoded - start).count() / texts.size(),
+		std::chrono::duration<double, std::nano>(decoded - encoded).count() / texts.size());
+	TEST_MESSAGE(message);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_varint);
+	RUN_TEST(test_parse_and_format);
+	RUN_TEST(test_pack);
+	RUN_TEST(test_delta_round_trip);
+	RUN_TEST(test_truncated_stream);
+	RUN_TEST(test_throughput);
+	UNITY_END();
+	return 0;
+}
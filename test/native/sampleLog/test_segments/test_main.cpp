@@ -0,0 +1,200 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "../../fakeFS.h"
+
+#define LOG_SEGMENT_SIZE 256
+#define LOG_MAX_SEGMENTS 3
+#define LOG_BUFFER_SIZE 64
+#define LOG_FLUSH_MS 1000
+#include "sampleLog.h"
+
+FakeFS fs;
+SampleLog<FakeFS>* sampleLog;
+
+void setUp() {
+	fs = FakeFS();
+	sampleLog = new SampleLog<FakeFS>(fs);
+	sampleLog->begin();
+}
+
+void tearDown() {
+	delete sampleLog;
+}
+
+/// @brief The text of a sample, the last digit, so every record is 16 bytes.
+std::string textOf(uint32_t sequence) {
+	return std::string(1, '0' + sequence % 10);
+}
+
+/// @brief Appends samples with time = 1000 * sequence.
+void appendSamples(uint32_t from, uint32_t to) {
+	for(uint32_t sequence = from; sequence <= to; sequence++) {
+		TEST_ASSERT_EQUAL(0, sampleLog->append(1000ULL * sequence, sequence, 1, textOf(sequence).c_str()));
+	}
+}
+
+/// @brief Reads all records from the cursor and returns their sequence numbers.
+std::vector<uint32_t> readAll(LogCursor& cursor) {
+	std::vector<uint32_t> sequences;
+	sampleLog->read(cursor, 1000, [&](const LogRecord& record, const char* text) {
+		TEST_ASSERT_EQUAL_STRING(textOf(record.sequence).c_str(), text);
+		TEST_ASSERT_EQUAL(1000ULL * record.sequence, record.time);
+		sequences.push_back(record.sequence);
+		return true;
+	});
+	return sequences;
+}
+
+void test_batched_appends() {
+	// 16 bytes per record, 4 fit into the buffer
+	appendSamples(1, 4);
+	TEST_ASSERT_EQUAL(0, fs.writes);
+	TEST_ASSERT_EQUAL(64, sampleLog->getBuffered());
+	appendSamples(5, 5);
+	TEST_ASSERT_EQUAL(1, fs.writes);
+	TEST_ASSERT_EQUAL(64, fs.files[LOG_DIR "/0.bin"]->size());
+
+	// flushed once old enough
+	TEST_ASSERT_EQUAL(0, sampleLog->update(5000));
+	TEST_ASSERT_EQUAL(0, sampleLog->update(5999));
+	TEST_ASSERT_EQUAL(1, fs.writes);
+	TEST_ASSERT_EQUAL(0, sampleLog->update(6000));
+	TEST_ASSERT_EQUAL(2, fs.writes);
+	TEST_ASSERT_EQUAL(0, sampleLog->getBuffered());
+
+	LogCursor cursor = sampleLog->first();
+	std::vector<uint32_t> sequences = readAll(cursor);
+	TEST_ASSERT_EQUAL(5, sequences.size());
+	TEST_ASSERT_EQUAL(5, sequences.back());
+	// nothing new
+	TEST_ASSERT_EQUAL(0, readAll(cursor).size());
+}
+
+void test_rotation_and_retention() {
+	// 16 records of 16 bytes fill a segment
+	appendSamples(1, 99);
+	sampleLog->flush();
+	TEST_ASSERT_EQUAL(LOG_MAX_SEGMENTS + 1, sampleLog->getSegmentCount());
+	// segments 0 to 2 have been removed
+	TEST_ASSERT_EQUAL(3, sampleLog->getSegment(0).number);
+	TEST_ASSERT_EQUAL(0, fs.files.count(LOG_DIR "/2.bin"));
+	TEST_ASSERT_EQUAL(49, sampleLog->getSegment(0).firstSequence);
+	TEST_ASSERT_EQUAL(64, sampleLog->getSegment(0).lastSequence);
+	TEST_ASSERT_EQUAL(6, sampleLog->getSegment(3).number);
+	TEST_ASSERT_EQUAL(99, sampleLog->getSegment(3).lastSequence);
+
+	// a cursor in a removed segment continues from the oldest one
+	LogCursor cursor;
+	std::vector<uint32_t> sequences = readAll(cursor);
+	TEST_ASSERT_EQUAL(51, sequences.size());
+	TEST_ASSERT_EQUAL(49, sequences.front());
+	TEST_ASSERT_EQUAL(99, sequences.back());
+}
+
+void test_find() {
+	appendSamples(1, 40);
+	sampleLog->flush();
+	LogCursor cursor = sampleLog->find(20000);
+	TEST_ASSERT_EQUAL(1, cursor.segment);
+	TEST_ASSERT_EQUAL(17, readAll(cursor).front());
+	cursor = sampleLog->find(39000);
+	TEST_ASSERT_EQUAL(2, cursor.segment);
+}
+
+void test_read_in_batches() {
+	appendSamples(1, 40);
+	sampleLog->flush();
+	LogCursor cursor = sampleLog->first();
+	int read = 0;
+	uint32_t last = 0;
+	while(true) {
+		const int count = sampleLog->read(cursor, 7, [&](const LogRecord& record, const char*) {
+			TEST_ASSERT_EQUAL(last + 1, record.sequence);
+			last = record.sequence;
+			return true;
+		});
+		if(count == 0) break;
+		read += count;
+	}
+	TEST_ASSERT_EQUAL(40, read);
+
+	// stopping keeps the cursor at the record
+	cursor = sampleLog->first();
+	sampleLog->read(cursor, 10, [](const LogRecord& record, const char*) { return record.sequence < 3; });
+	TEST_ASSERT_EQUAL(3, readAll(cursor).front());
+}
+
+void test_reopen() {
+	appendSamples(1, 40);
+	sampleLog->flush();
+	// a torn record at the end of the current segment
+	fs.files[LOG_DIR "/2.bin"]->resize(fs.files[LOG_DIR "/2.bin"]->size() - 3);
+
+	SampleLog<FakeFS> reopened(fs);
+	TEST_ASSERT_EQUAL(0, reopened.begin());
+	TEST_ASSERT_EQUAL(3, reopened.getSegmentCount());
+	TEST_ASSERT_EQUAL(39, reopened.getSegment(2).lastSequence);
+	TEST_ASSERT_EQUAL(0, reopened.append(41000, 41, 1, "1"));
+	TEST_ASSERT_EQUAL(0, reopened.flush());
+
+	delete sampleLog;
+	sampleLog = new SampleLog<FakeFS>(fs);
+	sampleLog->begin();
+	LogCursor cursor = sampleLog->find(38000);
+	std::vector<uint32_t> sequences = readAll(cursor);
+	TEST_ASSERT_EQUAL(41, sequences.back());
+	TEST_ASSERT_EQUAL(39, sequences[sequences.size() - 2]);
+}
+
+void test_packed_numbers() {
+	TEST_ASSERT_EQUAL(0, sampleLog->append(1000, 1, 1, "+1.23456E+00"));
+	TEST_ASSERT_EQUAL(0, sampleLog->append(2000, 2, 1, "+1.234560E+00"));
+	TEST_ASSERT_EQUAL(0, sampleLog->append(3000, 3, 1, "\"OVLD\""));
+	// a 4 byte packed number, the rest is stored as text
+	TEST_ASSERT_EQUAL(3 * LogRecord::HEADER_SIZE + 4 + 5 + 6, sampleLog->getBuffered());
+	sampleLog->flush();
+	LogCursor cursor = sampleLog->first();
+	std::vector<std::string> texts;
+	sampleLog->read(cursor, 10, [&](const LogRecord&, const char* text) {
+		texts.push_back(text);
+		return true;
+	});
+	TEST_ASSERT_EQUAL(3, texts.size());
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", texts[0].c_str());
+	TEST_ASSERT_EQUAL_STRING("+1.234560E+00", texts[1].c_str());
+	TEST_ASSERT_EQUAL_STRING("\"OVLD\"", texts[2].c_str());
+}
+
+void test_corrupt_index() {
+	appendSamples(1, 40);
+	sampleLog->flush();
+	// a torn write of the newest index leaves the one before
+	int order[2];
+	loc::SlotTrailer newest;
+	TEST_ASSERT_EQUAL(2, loc::findSlots(fs, LOG_DIR "/index.bin", order, newest));
+	const char* slots[2] = {LOG_DIR "/index.bin.a", LOG_DIR "/index.bin.b"};
+	SampleLog<FakeFS> reopened(fs);
+	TEST_ASSERT_EQUAL(0, reopened.begin());
+	const uint32_t last = reopened.getSegment(reopened.getSegmentCount() - 1).number;
+	fs.files[slots[order[0]]]->resize(5);
+	TEST_ASSERT_EQUAL(0, reopened.begin());
+	TEST_ASSERT_EQUAL(last - 1, reopened.getSegment(reopened.getSegmentCount() - 1).number);
+
+	fs.files[slots[order[1]]]->resize(5);
+	TEST_ASSERT_EQUAL(-1, reopened.begin());
+	TEST_ASSERT_EQUAL(1, reopened.getSegmentCount());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_batched_appends);
+	RUN_TEST(test_rotation_and_retention);
+	RUN_TEST(test_find);
+	RUN_TEST(test_read_in_batches);
+	RUN_TEST(test_reopen);
+	RUN_TEST(test_packed_numbers);
+	RUN_TEST(test_corrupt_index);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include <unity.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+Scheduler scheduler;
+
+int callCounter = 0;
+
+/// @brief The simulated time in microseconds.
+unsigned long long now = 0;
+
+/// @brief The times at which the task was run.
+const int MAX_RUNS = 2000;
+unsigned long long runTimes[MAX_RUNS];
+
+void setUp() {
+	scheduler.clearTasks();
+	callCounter = 0;
+	now = 0;
+}
+
+void tearDown() {
+	scheduler.clearTasks();
+	uint8_t errFlags = DataBuffer::getErrFlags();
+	DataBuffer::clearErrFlags();
+	TEST_ASSERT_EQUAL(0, errFlags);
+}
+
+auto function = [](void){
+	if(callCounter < MAX_RUNS) runTimes[callCounter] = now;
+	callCounter++;
+};
+
+void test_run_all() {
+	int id = scheduler.scheduleRepeat(function, 100, 1000);
+	TEST_ASSERT_EQUAL(0, scheduler.setCatchUp(id, CatchUp::RunAll));
+	scheduler.update(1000);
+	TEST_ASSERT_EQUAL(1, callCounter);
+	// stall for 5 periods, every missed period is run on the following updates
+	for(int i = 0; i < 10; i++) scheduler.update(1550);
+	TEST_ASSERT_EQUAL(6, callCounter);
+	scheduler.update(1599);
+	TEST_ASSERT_EQUAL(6, callCounter);
+	scheduler.update(1600);
+	TEST_ASSERT_EQUAL(7, callCounter);
+}
+
+void test_coalesce() {
+	int id = scheduler.scheduleRepeat(function, 100, 1000);
+	TEST_ASSERT_EQUAL(0, scheduler.setCatchUp(id, CatchUp::Coalesce));
+	scheduler.update(1000);
+	TEST_ASSERT_EQUAL(1, callCounter);
+	for(int i = 0; i < 10; i++) scheduler.update(1550);
+	TEST_ASSERT_EQUAL(2, callCounter);
+	// the late run does not shift the following periods
+	scheduler.update(1599);
+	TEST_ASSERT_EQUAL(2, callCounter);
+	scheduler.update(1600);
+	TEST_ASSERT_EQUAL(3, callCounter);
+}
+
+void test_skip() {
+	int id = scheduler.scheduleRepeat(function, 100, 1000);
+	TEST_ASSERT_EQUAL(0, scheduler.setCatchUp(id, CatchUp::Skip));
+	scheduler.update(1000);
+	TEST_ASSERT_EQUAL(1, callCounter);
+	// late, but still within its own period
+	scheduler.update(1150);
+	TEST_ASSERT_EQUAL(2, callCounter);
+	for(int i = 0; i < 10; i++) scheduler.update(1550);
+	TEST_ASSERT_EQUAL(2, callCounter);
+	scheduler.update(1600);
+	TEST_ASSERT_EQUAL(3, callCounter);
+}
+
+void test_policy_reset() {
+	int id = scheduler.scheduleRepeat(function, 100, 1000);
+	TEST_ASSERT_EQUAL(0, scheduler.setCatchUp(id, CatchUp::Skip));
+	TEST_ASSERT_EQUAL(0, scheduler.killTask(id));
+	TEST_ASSERT_EQUAL(SCH_ERR_TASK_ALREADY_KILLED, scheduler.setCatchUp(id, CatchUp::Skip));
+	scheduler.scheduleRepeat(function, 100, 1000);
+	TEST_ASSERT_TRUE(scheduler.getTasks()[0].catchUp == CatchUp::RunAll);
+}
+
+/// @brief Runs a 100 Hz task for 10 s with a random loop iteration time.
+/// @param maxLoop The longest loop iteration in microseconds.
+/// @return The largest delay between a period start and its run, in microseconds.
+unsigned long long measureJitter(CatchUp catchUp, unsigned long long maxLoop) {
+	const unsigned long long period = 10000;
+	int id = scheduler.scheduleRepeat(function, period, 0);
+	scheduler.setCatchUp(id, catchUp);
+	srand(1);
+	while(now < 10000000) {
+		scheduler.update(now);
+		now += 1 + rand() % maxLoop;
+	}
+	unsigned long long maxJitter = 0;
+	for(int i = 0; i < callCounter && i < MAX_RUNS; i++) {
+		const unsigned long long periodStart = runTimes[i] / period * period;
+		const unsigned long long jitter = runTimes[i] - periodStart;
+		if(jitter > maxJitter) maxJitter = jitter;
+	}
+	char message[100];
+	snprintf(message, sizeof(message), "max loop %llu us: %d runs, max jitter %llu us", maxLoop, callCounter, maxJitter);
+	TEST_MESSAGE(message);
+	return maxJitter;
+}
+
+void test_jitter_bounded_by_loop_time() {
+	// the jitter never exceeds one loop iteration, and no periods are lost or drift
+	TEST_ASSERT_TRUE(measureJitter(CatchUp::RunAll, 500) < 500);
+	TEST_ASSERT_EQUAL(1000, callCounter);
+	for(int i = 0; i < callCounter; i++) {
+		TEST_ASSERT_EQUAL(i, runTimes[i] / 10000);
+	}
+}
+
+void test_jitter_slow_loop() {
+	// loop iterations longer than the period, coalescing keeps the runs on the grid
+	const unsigned long long jitter = measureJitter(CatchUp::Coalesce, 15000);
+	TEST_ASSERT_TRUE(jitter < 15000);
+	TEST_ASSERT_TRUE(callCounter < 1000);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_run_all);
+	RUN_TEST(test_coalesce);
+	RUN_TEST(test_skip);
+	RUN_TEST(test_policy_reset);
+	RUN_TEST(test_jitter_bounded_by_loop_time);
+	RUN_TEST(test_jitter_slow_loop);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,153 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#define SCHEDULER_SIZE 10
+#define SCHEDULER_SMALL_DATA_COUNT 3
+#define SCHEDULER_LARGE_DATA_COUNT 2
+#define BLOCK_POOL_MEDIUM_COUNT 4
+#define BLOCK_POOL_LARGE_COUNT 1
+#include "scheduler.h"
+
+Scheduler scheduler;
+
+int callCounter = 0;
+
+/// @brief Data that fits into the small buffers.
+struct Small {
+	int a;
+	int b;
+};
+
+/// @brief Data larger than the old fixed 40 byte buffer.
+struct Large {
+	int values[24];
+};
+
+void setUp() {
+	scheduler.clearTasks();
+	callCounter = 0;
+}
+
+void tearDown() {
+	scheduler.clearTasks();
+	uint8_t errFlags = DataBuffer::getErrFlags();
+	DataBuffer::clearErrFlags();
+	TEST_ASSERT_EQUAL(0, errFlags);
+}
+
+void test_no_data_takes_no_buffer() {
+	for(int i = 0; i < SCHEDULER_SIZE; i++) {
+		TEST_ASSERT_NOT_EQUAL(-1, scheduler.schedule([](void){callCounter++;}, 10));
+	}
+	TEST_ASSERT_EQUAL(0, scheduler.getDataBufferCount());
+	scheduler.update(11);
+	TEST_ASSERT_EQUAL(SCHEDULER_SIZE, callCounter);
+}
+
+void test_large_data() {
+	Large large;
+	for(int i = 0; i < 24; i++) large.values[i] = i;
+	int id = scheduler.schedule<Large>([](DataBuffer& data){
+		TEST_ASSERT_TRUE(data.getCapacity() >= sizeof(Large));
+		TEST_ASSERT_EQUAL(23, data.get<Large>().values[23]);
+		callCounter++;
+	}, 10, large);
+	TEST_ASSERT_NOT_EQUAL(-1, id);
+	TEST_ASSERT_EQUAL(1, scheduler.getDataBufferCount());
+	scheduler.update(11);
+	TEST_ASSERT_EQUAL(1, callCounter);
+	TEST_ASSERT_EQUAL(0, scheduler.getDataBufferCount());
+}
+
+void test_small_data_spills_into_large_buffers() {
+	// 3 small buffers, then the 2 large ones, then no more data tasks
+	for(int i = 0; i < SCHEDULER_SMALL_DATA_COUNT + SCHEDULER_LARGE_DATA_COUNT; i++) {
+		TEST_ASSERT_NOT_EQUAL(-1, scheduler.schedule<Small>([](DataBuffer& data){
+			callCounter += data.get<Small>().a;
+		}, 10, Small{1, 2}));
+	}
+	TEST_ASSERT_EQUAL(-1, scheduler.schedule<Small>([](DataBuffer&){}, 10, Small{1, 2}));
+	TEST_ASSERT_EQUAL(-1, scheduler.schedule<Large>([](DataBuffer&){}, 10, Large()));
+	TEST_ASSERT_EQUAL(5, scheduler.getTaskCount());
+	// tasks without data still fit
+	TEST_ASSERT_NOT_EQUAL(-1, scheduler.schedule([](void){callCounter++;}, 10));
+	scheduler.update(11);
+	TEST_ASSERT_EQUAL(6, callCounter);
+	TEST_ASSERT_EQUAL(0, scheduler.getDataBufferCount());
+}
+
+void test_large_data_spills_into_blocks() {
+	// 2 large buffers, then small ones holding a pointer to a block
+	Large large;
+	large.values[23] = 7;
+	for(int i = 0; i < SCHEDULER_LARGE_DATA_COUNT + 1; i++) {
+		TEST_ASSERT_NOT_EQUAL(-1, scheduler.schedule<Large>([](DataBuffer& data){
+			callCounter += data.get<Large>().values[23];
+		}, 10, large));
+	}
+	TEST_ASSERT_EQUAL(3, scheduler.getDataBufferCount());
+	TEST_ASSERT_EQUAL(1, DataBuffer::getBlocks().getStats(1).used);
+	scheduler.update(11);
+	TEST_ASSERT_EQUAL(21, callCounter);
+	TEST_ASSERT_EQUAL(0, DataBuffer::getBlocks().getStats(1).used);
+	TEST_ASSERT_EQUAL(0, scheduler.getDataBufferCount());
+}
+
+void test_kill_returns_buffer() {
+	int id = scheduler.scheduleRepeat<Large>([](DataBuffer&){callCounter++;}, 10, 0, Large());
+	TEST_ASSERT_EQUAL(1, scheduler.getDataBufferCount());
+	scheduler.update(0);
+	TEST_ASSERT_EQUAL(0, scheduler.killTask(id));
+	TEST_ASSERT_EQUAL(0, scheduler.getDataBufferCount());
+	TEST_ASSERT_EQUAL(1, callCounter);
+}
+
+void test_oversize_data() {
+	// as large as a preset file, kept in a block, the task's buffer only holds the pointer to it
+	struct Huge {
+		char text[1500];
+	};
+	BlockAllocator& blocks = DataBuffer::getBlocks();
+	blocks.reset();
+	Huge huge;
+	strcpy(huge.text, "*IDN?");
+	int id = scheduler.schedule<Huge>([](DataBuffer& data){
+		TEST_ASSERT_TRUE(data.isSpilled());
+		TEST_ASSERT_EQUAL_STRING("*IDN?", data.get<Huge>().text);
+		callCounter++;
+	}, 10, huge);
+	TEST_ASSERT_NOT_EQUAL(-1, id);
+	TEST_ASSERT_EQUAL(1, blocks.getStats(2).used);
+	// there is only one block that large
+	TEST_ASSERT_EQUAL(-1, scheduler.schedule<Huge>([](DataBuffer&){}, 10, huge));
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+	TEST_ASSERT_EQUAL(1, scheduler.getDataBufferCount());
+	TEST_ASSERT_TRUE(DataBuffer::getErrFlags() & DataBuffer::POOL_ERR);
+	DataBuffer::clearErrFlags();
+	scheduler.update(11);
+	TEST_ASSERT_EQUAL(1, callCounter);
+	TEST_ASSERT_EQUAL(0, blocks.getStats(2).used);
+	TEST_ASSERT_EQUAL(0, scheduler.getDataBufferCount());
+}
+
+void test_size() {
+	char message[120];
+	snprintf(message, sizeof(message), "Task: %zu bytes, Scheduler: %zu bytes for %d tasks",
+		sizeof(Task), sizeof(Scheduler), SCHEDULER_SIZE);
+	TEST_MESSAGE(message);
+	// a task no longer carries a data buffer of its own
+	TEST_ASSERT_TRUE(sizeof(Task) < sizeof(StaticDataBuffer<DATA_BUFFER_SIZE>) + sizeof(TaskFunction) + 48);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_no_data_takes_no_buffer);
+	RUN_TEST(test_large_data);
+	RUN_TEST(test_small_data_spills_into_large_buffers);
+	RUN_TEST(test_large_data_spills_into_blocks);
+	RUN_TEST(test_kill_returns_buffer);
+	RUN_TEST(test_oversize_data);
+	RUN_TEST(test_size);
+	UNITY_END();
+	return 0;
+}
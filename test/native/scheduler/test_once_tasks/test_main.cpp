@@ -263,6 +263,60 @@ void test_once_fill_mov_repeatedly() {
 
 }
 
+void test_once_kill_frees_slot() {
+	auto func = [](void){callCounter++;};
+	int ids[SCHEDULER_SIZE];
+	for(int i = 0; i< SCHEDULER_SIZE; i++) {
+		ids[i] = scheduler.schedule(func, 100);
+		TEST_ASSERT_NOT_EQUAL(-1, ids[i]);
+	}
+	TEST_ASSERT_EQUAL(-1, scheduler.schedule(func, 100));
+	TEST_ASSERT_EQUAL(0, scheduler.killTask(ids[3]));
+	TEST_ASSERT_EQUAL(SCH_ERR_TASK_ALREADY_KILLED, scheduler.killTask(ids[3]));
+	TEST_ASSERT_EQUAL(SCHEDULER_SIZE-1, scheduler.getTaskCount());
+	int id = scheduler.schedule(func, 100);
+	TEST_ASSERT_NOT_EQUAL(-1, id);
+	TEST_ASSERT_NOT_EQUAL(ids[3], id);
+	TEST_ASSERT_EQUAL(SCH_ERR_BAD_TASK_HASH, scheduler.killTask(ids[3]));
+	TEST_ASSERT_EQUAL(SCHEDULER_SIZE, scheduler.getTaskCount());
+	scheduler.update(101);
+	TEST_ASSERT_EQUAL(SCHEDULER_SIZE, callCounter);
+	TEST_ASSERT_EQUAL(0, scheduler.getTaskCount());
+}
+
+void test_once_capture() {
+	struct Counter {
+		int* target;
+		int step;
+	};
+	int total = 0;
+	Counter counter {&total, 3};
+	// lambdas can carry their state instead of a DataBuffer
+	int id = scheduler.schedule([counter]() { *counter.target += counter.step; }, 53);
+	TEST_ASSERT_NOT_EQUAL(-1, id);
+	scheduler.scheduleRepeatUntil([&total](DataBuffer& data) {
+		TEST_ASSERT_FALSE(data.isDataSet());
+		total += 100;
+	}, 10, 0, 1000);
+	scheduler.update(54);
+	TEST_ASSERT_EQUAL(103, total);
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+	scheduler.update(60);
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+	TEST_ASSERT_EQUAL(203, total);
+}
+
+void test_once_null_function() {
+	void (*none)(void) = nullptr;
+	void (*noneWithData)(DataBuffer&) = nullptr;
+	// nothing to run, so nothing is scheduled and no slot is lost
+	TEST_ASSERT_EQUAL(-1, scheduler.schedule(none, 10));
+	TEST_ASSERT_EQUAL(-1, scheduler.schedule<int>(noneWithData, 10, 5));
+	TEST_ASSERT_EQUAL(0, scheduler.getTaskCount());
+	TEST_ASSERT_EQUAL(0, scheduler.getDataBufferCount());
+	scheduler.update(11);
+}
+
 int main() {
 	UNITY_BEGIN();
 	RUN_TEST(test_once_no_data);
@@ -274,6 +328,9 @@ int main() {
 	RUN_TEST(test_once_fill_ref_repeatedly);
 	RUN_TEST(test_once_fill_mov_multiple);
 	RUN_TEST(test_once_fill_mov_repeatedly);
+	RUN_TEST(test_once_kill_frees_slot);
+	RUN_TEST(test_once_capture);
+	RUN_TEST(test_once_null_function);
 	UNITY_END();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include <unity.h>
+#include "scheduler.h"
+
+Scheduler scheduler;
+
+/// @brief The order in which the tasks were run, one digit per task.
+int runOrder = 0;
+
+/// @brief The simulated microsecond clock.
+unsigned long fakeMicros = 0;
+
+unsigned long fakeClock() {
+	return fakeMicros;
+}
+
+void setUp() {
+	scheduler.clearTasks();
+	scheduler.setBudget(0, nullptr);
+	runOrder = 0;
+	fakeMicros = 0;
+}
+
+void tearDown() {
+	scheduler.clearTasks();
+	uint8_t errFlags = DataBuffer::getErrFlags();
+	DataBuffer::clearErrFlags();
+	TEST_ASSERT_EQUAL(0, errFlags);
+}
+
+// every task takes 10 ms
+auto task1 = [](void){runOrder = runOrder*10 + 1; fakeMicros += 10000;};
+auto task2 = [](void){runOrder = runOrder*10 + 2; fakeMicros += 10000;};
+auto task3 = [](void){runOrder = runOrder*10 + 3; fakeMicros += 10000;};
+
+void test_deadline_order() {
+	scheduler.schedule(task3, 30);
+	scheduler.schedule(task1, 10);
+	scheduler.schedule(task2, 20);
+	TEST_ASSERT_EQUAL(0, scheduler.update(100));
+	TEST_ASSERT_EQUAL(123, runOrder);
+}
+
+void test_priority_order() {
+	int low = scheduler.schedule(task1, 10);
+	scheduler.schedule(task2, 20);
+	int high = scheduler.schedule(task3, 30);
+	TEST_ASSERT_EQUAL(0, scheduler.setPriority(low, Priority::Low));
+	TEST_ASSERT_EQUAL(0, scheduler.setPriority(high, Priority::High));
+	TEST_ASSERT_EQUAL(0, scheduler.update(100));
+	TEST_ASSERT_EQUAL(321, runOrder);
+}
+
+void test_budget_defers() {
+	scheduler.setBudget(15000, fakeClock);
+	int low = scheduler.schedule(task1, 10);
+	scheduler.schedule(task2, 20);
+	int high = scheduler.schedule(task3, 30);
+	scheduler.setPriority(low, Priority::Low);
+	scheduler.setPriority(high, Priority::High);
+	// a task is started as long as there is budget left
+	TEST_ASSERT_EQUAL(SCH_ERR_BUDGET_OVERRUN, scheduler.update(100));
+	TEST_ASSERT_EQUAL(32, runOrder);
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+	TEST_ASSERT_EQUAL(11, scheduler.nextDeadline());
+	TEST_ASSERT_EQUAL(0, scheduler.update(100));
+	TEST_ASSERT_EQUAL(321, runOrder);
+	TEST_ASSERT_EQUAL(0, scheduler.getTaskCount());
+}
+
+void test_budget_fits() {
+	scheduler.setBudget(35000, fakeClock);
+	scheduler.schedule(task1, 10);
+	scheduler.schedule(task2, 20);
+	scheduler.schedule(task3, 30);
+	TEST_ASSERT_EQUAL(0, scheduler.update(100));
+	TEST_ASSERT_EQUAL(123, runOrder);
+}
+
+void test_deferred_repeat_task() {
+	scheduler.setBudget(5000, fakeClock);
+	int high = scheduler.scheduleRepeat(task1, 100, 0);
+	scheduler.scheduleRepeat(task2, 100, 0);
+	scheduler.setPriority(high, Priority::High);
+	scheduler.update(0);
+	TEST_ASSERT_EQUAL(1, runOrder);
+	// the deferred task runs before the next period of the high priority task
+	scheduler.update(50);
+	TEST_ASSERT_EQUAL(12, runOrder);
+	scheduler.update(100);
+	TEST_ASSERT_EQUAL(121, runOrder);
+	scheduler.update(100);
+	TEST_ASSERT_EQUAL(1212, runOrder);
+}
+
+void test_priority_reset() {
+	int id = scheduler.schedule(task1, 10);
+	scheduler.setPriority(id, Priority::High);
+	scheduler.update(100);
+	TEST_ASSERT_EQUAL(SCH_ERR_TASK_ALREADY_KILLED, scheduler.setPriority(id, Priority::Low));
+	scheduler.schedule(task1, 10);
+	TEST_ASSERT_TRUE(scheduler.getTasks()[0].priority == Priority::Normal);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_deadline_order);
+	RUN_TEST(test_priority_order);
+	RUN_TEST(test_budget_defers);
+	RUN_TEST(test_budget_fits);
+	RUN_TEST(test_deferred_repeat_task);
+	RUN_TEST(test_priority_reset);
+	UNITY_END();
+	return 0;
+}
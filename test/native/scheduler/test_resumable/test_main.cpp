@@ -0,0 +1,151 @@
+#include <unity.h>
+#include "scheduler.h"
+
+Scheduler scheduler;
+
+int callCounter = 0;
+
+/// @brief Simulated number of bytes waiting in the serial buffer.
+int available = 0;
+
+void setUp() {
+	scheduler.clearTasks();
+	callCounter = 0;
+	available = 0;
+}
+
+void tearDown() {
+	scheduler.clearTasks();
+	uint8_t errFlags = DataBuffer::getErrFlags();
+	DataBuffer::clearErrFlags();
+	TEST_ASSERT_EQUAL(0, errFlags);
+}
+
+/// @brief State of a transaction that waits for 3 bytes.
+struct Transaction {
+	int received = 0;
+	int finished = 0;
+};
+
+auto transaction = [](DataBuffer& data){
+	Transaction& t = data.get<Transaction>();
+	callCounter++;
+	while(available > 0 && t.received < 3) {
+		available--;
+		t.received++;
+	}
+	if(t.received < 3) {
+		Scheduler::yield();
+		return;
+	}
+	t.received = 0;
+	t.finished++;
+};
+
+void test_once_resumes() {
+	scheduler.schedule<Transaction>(transaction, 10, Transaction());
+	scheduler.update(11);
+	TEST_ASSERT_EQUAL(1, callCounter);
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+	// a task waiting for data is due immediately
+	TEST_ASSERT_EQUAL(0, scheduler.nextDeadline());
+	scheduler.update(12);
+	TEST_ASSERT_EQUAL(2, callCounter);
+	available = 2;
+	scheduler.update(13);
+	TEST_ASSERT_EQUAL(3, callCounter);
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+	available = 1;
+	scheduler.update(14);
+	TEST_ASSERT_EQUAL(4, callCounter);
+	TEST_ASSERT_EQUAL(0, scheduler.getTaskCount());
+}
+
+void test_repeat_keeps_period() {
+	scheduler.scheduleRepeat<Transaction>(transaction, 100, 0, Transaction());
+	scheduler.update(0);
+	scheduler.update(30);
+	available = 3;
+	scheduler.update(60);
+	TEST_ASSERT_EQUAL(3, callCounter);
+	TEST_ASSERT_EQUAL(0, scheduler.getTasks()[0].lastIndex);
+	TEST_ASSERT_TRUE(scheduler.getTasks()[0].data->isDataSet());
+	// the finished run does not shift the period
+	TEST_ASSERT_EQUAL(100, scheduler.nextDeadline());
+	available = 3;
+	scheduler.update(100);
+	TEST_ASSERT_EQUAL(4, callCounter);
+	TEST_ASSERT_EQUAL(200, scheduler.nextDeadline());
+}
+
+void test_repeat_until_finishes_run() {
+	scheduler.scheduleRepeatUntil<Transaction>(transaction, 100, 0, 50, Transaction());
+	scheduler.update(0);
+	scheduler.update(80);
+	TEST_ASSERT_EQUAL(2, callCounter);
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+	available = 3;
+	scheduler.update(90);
+	TEST_ASSERT_EQUAL(3, callCounter);
+	scheduler.update(91);
+	TEST_ASSERT_EQUAL(3, callCounter);
+	TEST_ASSERT_EQUAL(0, scheduler.getTaskCount());
+}
+
+void test_interleaved() {
+	scheduler.schedule<Transaction>(transaction, 0, Transaction());
+	scheduler.update(1);
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+	// other tasks keep running while the transaction waits
+	scheduler.scheduleRepeat([](void){callCounter += 100;}, 10, 10);
+	scheduler.update(10);
+	scheduler.update(20);
+	TEST_ASSERT_EQUAL(203, callCounter);
+	TEST_ASSERT_EQUAL(2, scheduler.getTaskCount());
+}
+
+/// @brief Order in which the setup and the repeated steps ran, 'S' for setup and 'R' for repeated.
+char order[16];
+int orderLength = 0;
+
+void test_follow_up_after_resumable() {
+	// as a preset: the setup commands have to reach the instrument before any repeated query
+	orderLength = 0;
+	scheduler.schedule<Transaction>([](DataBuffer& data){
+		Transaction& t = data.get<Transaction>();
+		order[orderLength++] = 'S';
+		if(++t.received < 3) {
+			Scheduler::yield();
+			return;
+		}
+		TEST_ASSERT_NOT_EQUAL(-1, scheduler.scheduleRepeat([](void){
+			order[orderLength++] = 'R';
+		}, 10, Scheduler::getUpdateTime()));
+	}, 0, Transaction());
+	for(unsigned long long now = 1; now <= 25; now++) {
+		scheduler.update(now);
+	}
+	order[orderLength] = '\0';
+	// the repeated task starts with the update after the setup finished at 3, then every 10
+	TEST_ASSERT_EQUAL_STRING("SSSRRR", order);
+	TEST_ASSERT_EQUAL(1, scheduler.getTaskCount());
+}
+
+void test_yield_outside_task() {
+	Scheduler::yield();
+	scheduler.schedule([](void){callCounter++;}, 0);
+	scheduler.update(1);
+	TEST_ASSERT_EQUAL(0, scheduler.getTaskCount());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_once_resumes);
+	RUN_TEST(test_repeat_keeps_period);
+	RUN_TEST(test_repeat_until_finishes_run);
+	RUN_TEST(test_interleaved);
+	RUN_TEST(test_follow_up_after_resumable);
+	RUN_TEST(test_yield_outside_task);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include <unity.h>
+#include "scpiBatch.h"
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_is_query() {
+	TEST_ASSERT_TRUE(scpi::isQuery("*IDN?"));
+	TEST_ASSERT_TRUE(scpi::isQuery("MEAS:VOLT? 10,0.001"));
+	TEST_ASSERT_FALSE(scpi::isQuery("*RST"));
+	TEST_ASSERT_FALSE(scpi::isQuery("DISP:TEXT 'WHY?'"));
+}
+
+void test_is_query_only() {
+	TEST_ASSERT_TRUE(scpi::isQueryOnly("*IDN?"));
+	TEST_ASSERT_TRUE(scpi::isQueryOnly("*IDN?; :SYST:ERR?"));
+	TEST_ASSERT_FALSE(scpi::isQueryOnly("*IDN?;*RST"));
+	TEST_ASSERT_FALSE(scpi::isQueryOnly("*RST;*IDN?"));
+	TEST_ASSERT_FALSE(scpi::isQueryOnly("DISP:TEXT 'A;B?'"));
+	TEST_ASSERT_TRUE(scpi::isQueryOnly("DISP:TEXT? 'A;*RST'"));
+	TEST_ASSERT_FALSE(scpi::isQueryOnly("*IDN?;"));
+	TEST_ASSERT_FALSE(scpi::isQueryOnly(""));
+}
+
+void test_join() {
+	const char* commands[] = {"MEAS:VOLT?\r", "*IDN?", ":MEAS:CURR?", "SYST:BEEP"};
+	char out[64];
+	TEST_ASSERT_EQUAL(strlen("MEAS:VOLT?;*IDN?;:MEAS:CURR?;:SYST:BEEP"), scpi::joinCommands(out, sizeof(out), commands, 4));
+	TEST_ASSERT_EQUAL_STRING("MEAS:VOLT?;*IDN?;:MEAS:CURR?;:SYST:BEEP", out);
+}
+
+void test_join_overflow() {
+	const char* commands[] = {"MEAS:VOLT?", "MEAS:CURR?"};
+	char out[22];
+	TEST_ASSERT_EQUAL(0, scpi::joinCommands(out, sizeof(out), commands, 2));
+	char exact[23];
+	TEST_ASSERT_EQUAL(22, scpi::joinCommands(exact, sizeof(exact), commands, 2));
+}
+
+void test_split() {
+	char response[] = "+1.23E+00;\"A;B\";-4.5E-03";
+	const char* parts[4];
+	TEST_ASSERT_EQUAL(3, scpi::splitResponses(response, parts, 4));
+	TEST_ASSERT_EQUAL_STRING("+1.23E+00", parts[0]);
+	TEST_ASSERT_EQUAL_STRING("\"A;B\"", parts[1]);
+	TEST_ASSERT_EQUAL_STRING("-4.5E-03", parts[2]);
+}
+
+void test_split_limit() {
+	char response[] = "1;2;3";
+	const char* parts[2];
+	TEST_ASSERT_EQUAL(2, scpi::splitResponses(response, parts, 2));
+	TEST_ASSERT_EQUAL_STRING("1", parts[0]);
+	TEST_ASSERT_EQUAL_STRING("2;3", parts[1]);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_is_query);
+	RUN_TEST(test_is_query_only);
+	RUN_TEST(test_join);
+	RUN_TEST(test_join_overflow);
+	RUN_TEST(test_split);
+	RUN_TEST(test_split_limit);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,414 @@
+#include <unity.h>
+#include <chrono>
+#include <string>
+#define TRANSPORT_RESPONSE_SIZE 256
+#include "serialTransport.h"
+#include "scpiBatch.h"
+
+/// @brief Simulated time in milliseconds.
+unsigned long long now = 0;
+
+/**
+ * @brief Stand-in for a UART connected to an instrument.
+ * The hardware FIFOs hold 128 bytes, the TX FIFO is drained at the baud rate,
+ * and bytes arriving while the RX FIFO is full are lost.
+ * The instrument answers every line ending in '\n' that holds a '?' with "+1.23456E+00\r\n".
+ */
+struct MockUart {
+	static const int FIFO_SIZE = 128;
+	unsigned long baud = 115200;
+	bool respond = true;
+	std::string txFifo;
+	std::string line;
+	std::string rx;
+	std::string received;
+	unsigned long long lastDrain = 0;
+	int overruns = 0;
+
+	/// @brief Receives bytes sent by the instrument outside of its answers.
+	void arrive(const std::string& bytes) {
+		for(char c : bytes) {
+			if(rx.size() < FIFO_SIZE) rx += c;
+			else overruns++;
+		}
+	}
+
+	int available() { return rx.size(); }
+	int read() {
+		if(rx.empty()) return -1;
+		const char c = rx[0];
+		rx.erase(0, 1);
+		return (uint8_t)c;
+	}
+	int availableForWrite() { return FIFO_SIZE - txFifo.size(); }
+	size_t write(uint8_t c) {
+		txFifo += (char)c;
+		return 1;
+	}
+
+	/// @brief Moves the bytes that could be sent since the last call to the instrument.
+	void tick() {
+		// 10 bits per byte with the start and stop bits
+		const unsigned long long bytes = (now - lastDrain) * baud / 10000;
+		if(bytes == 0) return;
+		lastDrain = now;
+		for(unsigned long long i = 0; i < bytes && !txFifo.empty(); i++) {
+			const char c = txFifo[0];
+			txFifo.erase(0, 1);
+			received += c;
+			if(c == '\n') {
+				if(respond && line.find('?') != std::string::npos) rx += "+1.23456E+00\r\n";
+				line.clear();
+			} else {
+				line += c;
+			}
+		}
+	}
+} uart;
+
+transport::SerialTransport<MockUart>* serialTransport;
+const transport::LineFramer crlf("\r\n");
+
+int completed = 0;
+
+void setUp() {
+	now = 0;
+	uart = MockUart();
+	serialTransport = new transport::SerialTransport<MockUart>(uart);
+	completed = 0;
+}
+
+void tearDown() {
+	delete serialTransport;
+}
+
+/// @brief Advances the simulated time until the transport is idle.
+void runUntilIdle(unsigned long long limit) {
+	while(!serialTransport->isIdle() && now < limit) {
+		now++;
+		uart.tick();
+		serialTransport->update(now);
+	}
+}
+
+void test_framer() {
+	transport::LineFramer lf;
+	TEST_ASSERT_FALSE(lf.feed('a'));
+	TEST_ASSERT_TRUE(lf.feed('\n'));
+	transport::LineFramer framer("\r\n");
+	TEST_ASSERT_EQUAL(2, framer.length());
+	TEST_ASSERT_FALSE(framer.feed('\r'));
+	TEST_ASSERT_FALSE(framer.feed('a'));
+	TEST_ASSERT_FALSE(framer.feed('\r'));
+	TEST_ASSERT_TRUE(framer.feed('\n'));
+}
+
+void test_query() {
+	int handle = serialTransport->submit("READ?", "\n", crlf, true, 1000);
+	TEST_ASSERT_NOT_EQUAL(-1, handle);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::Pending);
+	runUntilIdle(1000);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::Done);
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", serialTransport->get(handle)->response);
+	TEST_ASSERT_EQUAL_STRING("READ?\n", uart.received.c_str());
+	TEST_ASSERT_TRUE(serialTransport->release(handle));
+	TEST_ASSERT_TRUE(serialTransport->get(handle) == nullptr);
+	TEST_ASSERT_FALSE(serialTransport->release(handle));
+}
+
+void test_write_only() {
+	int handle = serialTransport->submit("*RST", "\n", crlf, false, 1000);
+	runUntilIdle(1000);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::Done);
+	TEST_ASSERT_EQUAL_STRING("", serialTransport->get(handle)->response);
+	serialTransport->release(handle);
+}
+
+void test_read_earlier_reply() {
+	int handle = serialTransport->submit("READ?", "\n", crlf, false, 1000);
+	runUntilIdle(1000);
+	serialTransport->release(handle);
+	// the reply arrives while nothing is pending
+	for(int i = 0; i < 10; i++) {
+		now++;
+		uart.tick();
+		serialTransport->update(now);
+	}
+	handle = serialTransport->submit("", nullptr, crlf, true, 1000);
+	runUntilIdle(now + 1000);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::Done);
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", serialTransport->get(handle)->response);
+	serialTransport->release(handle);
+
+	// a new command does not take an earlier reply as its response
+	uart.arrive("stale\r\n");
+	serialTransport->update(now);
+	handle = serialTransport->submit("READ?", "\n", crlf, true, 1000);
+	runUntilIdle(now + 1000);
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", serialTransport->get(handle)->response);
+	serialTransport->release(handle);
+}
+
+void test_timeout() {
+	uart.respond = false;
+	int handle = serialTransport->submit("READ?", "\n", crlf, true, 200);
+	runUntilIdle(10000);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::TimedOut);
+	TEST_ASSERT_TRUE(now >= 200 && now < 250);
+	serialTransport->release(handle);
+}
+
+void test_slow_port() {
+	// the firmware runs the port at 300 baud, where sending this command takes about 970 ms
+	uart.baud = 300;
+	int handle = serialTransport->submit("MEASURE:VOLTAGE:DC? 10,0.001", "\n", crlf, true, 500);
+	runUntilIdle(5000);
+	// the timeout only starts once the command has left the FIFO
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::Done);
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", serialTransport->get(handle)->response);
+	TEST_ASSERT_TRUE(now > 900);
+	serialTransport->release(handle);
+
+	uart.respond = false;
+	const unsigned long long start = now;
+	handle = serialTransport->submit("MEASURE:VOLTAGE:DC? 10,0.001", "\n", crlf, true, 500);
+	runUntilIdle(start + 5000);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::TimedOut);
+	TEST_ASSERT_TRUE(now - start > 1400 && now - start < 1600);
+	serialTransport->release(handle);
+}
+
+void test_pipelined_callbacks() {
+	auto onComplete = [](const transport::Transaction& transaction, void* context) {
+		TEST_ASSERT_TRUE(transaction.status == transport::Status::Done);
+		TEST_ASSERT_EQUAL_STRING("+1.23456E+00", transaction.response);
+		(*(int*)context)++;
+	};
+	for(int i = 0; i < TRANSPORT_QUEUE_SIZE; i++) {
+		TEST_ASSERT_NOT_EQUAL(-1, serialTransport->submit("MEAS:VOLT?", "\n", crlf, true, 1000, onComplete, &completed));
+	}
+	// all slots are in flight
+	TEST_ASSERT_EQUAL(-1, serialTransport->submit("MEAS:VOLT?", "\n", crlf, true, 1000));
+	runUntilIdle(1000);
+	TEST_ASSERT_EQUAL(TRANSPORT_QUEUE_SIZE, completed);
+	TEST_ASSERT_NOT_EQUAL(-1, serialTransport->submit("MEAS:VOLT?", "\n", crlf, true, 1000, onComplete, &completed));
+	runUntilIdle(2000);
+	TEST_ASSERT_EQUAL(TRANSPORT_QUEUE_SIZE + 1, completed);
+}
+
+void test_full_when_idle() {
+	int handles[TRANSPORT_QUEUE_SIZE];
+	for(int i = 0; i < TRANSPORT_QUEUE_SIZE; i++) {
+		handles[i] = serialTransport->submit("*RST", "\n", crlf, false, 1000);
+		TEST_ASSERT_NOT_EQUAL(-1, handles[i]);
+	}
+	runUntilIdle(1000);
+	// every slot holds a finished transaction that was not released yet
+	TEST_ASSERT_TRUE(serialTransport->isIdle());
+	TEST_ASSERT_FALSE(serialTransport->hasFreeSlot());
+	TEST_ASSERT_EQUAL(-1, serialTransport->submit("*RST", "\n", crlf, false, 1000));
+	serialTransport->release(handles[0]);
+	TEST_ASSERT_TRUE(serialTransport->hasFreeSlot());
+	for(int i = 1; i < TRANSPORT_QUEUE_SIZE; i++) serialTransport->release(handles[i]);
+}
+
+void test_longest_joined_message() {
+	// two commands joined with ";:", filling the TX buffer exactly together with the terminator
+	const std::string first(100, 'A');
+	std::string second(TRANSPORT_TX_SIZE - 1 - first.size() - 2, 'B');
+	const char* commands[] = {first.c_str(), second.c_str()};
+	char message[TRANSPORT_TX_SIZE + 1];
+	const size_t size = transport::maxCommandLength("\n") + 1;
+	TEST_ASSERT_EQUAL(TRANSPORT_TX_SIZE - 1, scpi::joinCommands(message, size, commands, 2));
+	int handle = serialTransport->submit(message, "\n", crlf, false, 1000);
+	TEST_ASSERT_NOT_EQUAL(-1, handle);
+	runUntilIdle(1000);
+	serialTransport->release(handle);
+
+	// one more character is rejected by the join, as the transport could never take it
+	second += 'B';
+	commands[1] = second.c_str();
+	TEST_ASSERT_EQUAL(0, scpi::joinCommands(message, size, commands, 2));
+	TEST_ASSERT_EQUAL(0, scpi::joinCommands(message, transport::maxCommandLength("\r\n") + 1, commands, 2));
+	TEST_ASSERT_EQUAL(TRANSPORT_TX_SIZE, scpi::joinCommands(message, sizeof(message), commands, 2));
+	TEST_ASSERT_EQUAL(-1, serialTransport->submit(message, "\n", crlf, false, 1000));
+}
+
+void test_rx_buffer() {
+	// the instrument talks while a long command is still being sent, at 1 byte per millisecond
+	uart.baud = 9600;
+	uart.respond = false;
+	const std::string command(200, 'C');
+	int handle = serialTransport->submit(command.c_str(), "\n", crlf, true, 1000);
+	const std::string response = std::string(200, 'r') + "\r\n";
+	while(!serialTransport->isIdle() && now < 1000) {
+		now++;
+		if(now <= 20) uart.arrive(response.substr((now - 1) * 10, now < 20 ? 10 : 12));
+		uart.tick();
+		serialTransport->update(now);
+	}
+	// the bytes waited in the RX buffer, as nothing reads them before the command is sent
+	TEST_ASSERT_EQUAL(0, uart.overruns);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::Done);
+	TEST_ASSERT_EQUAL_STRING(std::string(200, 'r').c_str(), serialTransport->get(handle)->response);
+	serialTransport->release(handle);
+}
+
+void test_truncated_response() {
+	int handle = serialTransport->submit("", nullptr, crlf, true, 1000);
+	std::string longLine(300, 'x');
+	uart.rx = longLine + "\r\n";
+	runUntilIdle(1000);
+	TEST_ASSERT_EQUAL(TRANSPORT_RESPONSE_SIZE - 1, serialTransport->get(handle)->length);
+	TEST_ASSERT_EQUAL_STRING(longLine.substr(0, TRANSPORT_RESPONSE_SIZE - 1).c_str(), serialTransport->get(handle)->response);
+	serialTransport->release(handle);
+}
+
+void test_abandon() {
+	int first = serialTransport->submit("READ?", "\n", crlf, true, 1000);
+	int second = serialTransport->submit("READ?", "\n", crlf, true, 1000);
+	serialTransport->abandon(first);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(first) == transport::Status::Pending);
+	runUntilIdle(1000);
+	TEST_ASSERT_TRUE(serialTransport->get(first) == nullptr);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(second) == transport::Status::Done);
+	TEST_ASSERT_EQUAL_STRING("READ?\nREAD?\n", uart.received.c_str());
+	serialTransport->abandon(second);
+	TEST_ASSERT_TRUE(serialTransport->get(second) == nullptr);
+}
+
+void test_shared_query() {
+	int first = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	int second = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	// a different terminator or framer is a different transaction
+	int other = serialTransport->submitShared("MEAS:VOLT?", "\r\n", crlf, 1000);
+	int otherFramer = serialTransport->submitShared("MEAS:VOLT?", "\n", transport::LineFramer("\n"), 1000);
+	TEST_ASSERT_EQUAL(first, second);
+	TEST_ASSERT_NOT_EQUAL(first, other);
+	TEST_ASSERT_NOT_EQUAL(first, otherFramer);
+	TEST_ASSERT_NOT_EQUAL(other, otherFramer);
+	TEST_ASSERT_EQUAL(1, serialTransport->getJoined());
+	// the mock does not answer the "\r\n" terminated query, so it times out
+	runUntilIdle(2000);
+	TEST_ASSERT_EQUAL_STRING("MEAS:VOLT?\nMEAS:VOLT?\r\nMEAS:VOLT?\n", uart.received.c_str());
+	serialTransport->release(other);
+	serialTransport->release(otherFramer);
+
+	// every owner gets the response and releases it once
+	TEST_ASSERT_TRUE(serialTransport->release(first));
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", serialTransport->get(second)->response);
+	TEST_ASSERT_TRUE(serialTransport->release(second));
+	TEST_ASSERT_TRUE(serialTransport->get(second) == nullptr);
+
+	// a finished transaction is not joined
+	first = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	runUntilIdle(now + 1000);
+	second = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	TEST_ASSERT_NOT_EQUAL(first, second);
+	serialTransport->release(first);
+	runUntilIdle(now + 1000);
+	serialTransport->release(second);
+	TEST_ASSERT_EQUAL(1, serialTransport->getJoined());
+}
+
+void test_shared_abandon() {
+	int first = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	int second = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	serialTransport->abandon(first);
+	// an abandoned transaction is not joined
+	serialTransport->abandon(second);
+	int third = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	TEST_ASSERT_NOT_EQUAL(first, third);
+	runUntilIdle(1000);
+	TEST_ASSERT_TRUE(serialTransport->get(first) == nullptr);
+	TEST_ASSERT_EQUAL_STRING("+1.23456E+00", serialTransport->get(third)->response);
+	serialTransport->release(third);
+
+	// the other owner keeps the transaction
+	first = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	second = serialTransport->submitShared("MEAS:VOLT?", "\n", crlf, 1000);
+	serialTransport->abandon(first);
+	runUntilIdle(2000);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(second) == transport::Status::Done);
+	TEST_ASSERT_TRUE(serialTransport->release(second));
+	TEST_ASSERT_TRUE(serialTransport->isIdle());
+	TEST_ASSERT_NOT_EQUAL(-1, serialTransport->submit("*RST", "\n", crlf, false, 1000));
+}
+
+void test_block_response() {
+	std::string data(2000, '\0');
+	for(size_t i = 0; i < data.size(); i++) data[i] = (char)(i * 7);
+	std::string payload;
+	auto sink = [](const uint8_t* bytes, size_t length, void* context) {
+		((std::string*)context)->append((const char*)bytes, length);
+	};
+	int handle = serialTransport->submitBlock("CURV?", "\n", transport::BlockParser("\n"), sink, 100,
+		nullptr, &payload);
+	// a response queued behind the block must not be eaten by it
+	int next = serialTransport->submit("READ?", "\n", crlf, true, 1000);
+	uart.respond = false;
+	uart.rx = "#42000" + data + "\n" + "+1.0\r\n";
+	runUntilIdle(1000);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::Done);
+	TEST_ASSERT_EQUAL(2000, serialTransport->get(handle)->parser.getReceived());
+	TEST_ASSERT_TRUE(payload == data);
+	TEST_ASSERT_EQUAL_STRING("+1.0", serialTransport->get(next)->response);
+	serialTransport->release(handle);
+	serialTransport->release(next);
+
+	handle = serialTransport->submitBlock("CURV?", "\n", transport::BlockParser("\n"), nullptr, 100);
+	uart.rx = "#x";
+	runUntilIdle(1000);
+	TEST_ASSERT_TRUE(serialTransport->getStatus(handle) == transport::Status::Malformed);
+	serialTransport->release(handle);
+}
+
+void test_throughput() {
+	const int TRANSACTIONS = 2000;
+	auto onComplete = [](const transport::Transaction&, void* context) {
+		(*(int*)context)++;
+	};
+	int submitted = 0;
+	unsigned long updates = 0;
+	auto start = std::chrono::steady_clock::now();
+	while(completed < TRANSACTIONS && now < 1000000) {
+		while(submitted < TRANSACTIONS
+			&& serialTransport->submit("MEAS:VOLT?", "\n", crlf, true, 1000, onComplete, &completed) != -1) {
+			submitted++;
+		}
+		now++;
+		uart.tick();
+		serialTransport->update(now);
+		updates++;
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	TEST_ASSERT_EQUAL(TRANSACTIONS, completed);
+	char message[160];
+	snprintf(message, sizeof(message), "%d transactions at %lu baud in %llu simulated ms (%.0f/s), %.0f ns per update",
+		TRANSACTIONS, uart.baud, now, TRANSACTIONS * 1000.0 / now, (double)elapsed / updates);
+	TEST_MESSAGE(message);
+	// 11 bytes out and 14 bytes back per transaction, the link is the limit, not the transport
+	TEST_ASSERT_TRUE(now < TRANSACTIONS * 14 * 10 * 1000ULL / uart.baud * 2);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_framer);
+	RUN_TEST(test_query);
+	RUN_TEST(test_write_only);
+	RUN_TEST(test_read_earlier_reply);
+	RUN_TEST(test_timeout);
+	RUN_TEST(test_slow_port);
+	RUN_TEST(test_pipelined_callbacks);
+	RUN_TEST(test_full_when_idle);
+	RUN_TEST(test_longest_joined_message);
+	RUN_TEST(test_rx_buffer);
+	RUN_TEST(test_truncated_response);
+	RUN_TEST(test_abandon);
+	RUN_TEST(test_shared_query);
+	RUN_TEST(test_shared_abandon);
+	RUN_TEST(test_block_response);
+	RUN_TEST(test_throughput);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "../../fakeFS.h"
+#include "slotFile.h"
+using namespace loc;
+
+FakeFS fs;
+const char* PATH = "/battery.json";
+
+int save(FakeFS& fs, const std::string& text) {
+	return saveSlots(fs, PATH, [&](SlotWriter<FakeFile>& writer) {
+		writer.write((const uint8_t*)text.data(), text.size());
+	});
+}
+
+/// @brief Loads the newest copy, "" if there is none.
+std::string load(FakeFS& fs) {
+	std::string text;
+	const int result = loadSlots(fs, PATH, [&](SlotReader<FakeFile>& reader) {
+		text.clear();
+		int c;
+		while((c = reader.read()) >= 0) text += (char)c;
+		return 0;
+	});
+	return result == 0 ? text : "";
+}
+
+void setUp() {
+	fs = FakeFS();
+}
+
+void tearDown() {
+}
+
+void test_alternating_slots() {
+	TEST_ASSERT_EQUAL_STRING("", load(fs).c_str());
+	TEST_ASSERT_EQUAL(0, save(fs, "first"));
+	TEST_ASSERT_EQUAL(1, fs.files.count("/battery.json.a"));
+	TEST_ASSERT_EQUAL(0, fs.files.count("/battery.json.b"));
+	TEST_ASSERT_EQUAL(0, save(fs, "second"));
+	TEST_ASSERT_EQUAL(0, save(fs, "third"));
+	TEST_ASSERT_EQUAL_STRING("third", load(fs).c_str());
+
+	int order[2];
+	SlotTrailer newest;
+	TEST_ASSERT_EQUAL(2, findSlots(fs, PATH, order, newest));
+	TEST_ASSERT_EQUAL(0, order[0]);
+	TEST_ASSERT_EQUAL(3, newest.sequence);
+	TEST_ASSERT_EQUAL(5, newest.length);
+	TEST_ASSERT_EQUAL(5 + SlotTrailer::SIZE, fs.files["/battery.json.a"]->size());
+}
+
+void test_power_loss() {
+	save(fs, "{\"charge\":1}");
+	save(fs, "{\"charge\":2}");
+	const std::string next = "{\"charge\":3,\"capacity\":2000}";
+	const long total = next.size() + SlotTrailer::SIZE;
+	// cut the power after every possible number of written bytes
+	for(long cut = 0; cut <= total; cut++) {
+		FakeFS device = fs.reboot();
+		device.budget = cut;
+		const int result = save(device, next);
+		TEST_ASSERT_EQUAL(cut == total ? 0 : -1, result);
+		FakeFS rebooted = device.reboot();
+		TEST_ASSERT_EQUAL_STRING(cut == total ? next.c_str() : "{\"charge\":2}", load(rebooted).c_str());
+		// the next save goes on from whichever copy survived
+		TEST_ASSERT_EQUAL(0, save(rebooted, "{\"charge\":4}"));
+		TEST_ASSERT_EQUAL_STRING("{\"charge\":4}", load(rebooted).c_str());
+	}
+}
+
+void test_corruption() {
+	save(fs, "older");
+	save(fs, "newer");
+	const size_t size = fs.files["/battery.json.b"]->size();
+	// a flipped bit anywhere in the newest slot, trailer included, falls back to the older one
+	for(size_t i = 0; i < size; i++) {
+		FakeFS device = fs.reboot();
+		(*device.files["/battery.json.b"])[i] ^= 0x10;
+		TEST_ASSERT_EQUAL_STRING("older", load(device).c_str());
+		// and the damaged slot is the one written over
+		save(device, "newest");
+		TEST_ASSERT_EQUAL_STRING("newest", load(device).c_str());
+		TEST_ASSERT_EQUAL(6 + SlotTrailer::SIZE, device.files["/battery.json.b"]->size());
+	}
+	// a truncated slot is not valid either
+	fs.files["/battery.json.b"]->pop_back();
+	TEST_ASSERT_EQUAL_STRING("older", load(fs).c_str());
+	fs.files["/battery.json.a"]->clear();
+	TEST_ASSERT_EQUAL_STRING("", load(fs).c_str());
+}
+
+void test_rejected_copy() {
+	save(fs, "good");
+	save(fs, "bad");
+	// a copy with a valid CRC that does not parse, e.g. written by an older firmware, falls back as well
+	std::string loaded;
+	const int result = loadSlots(fs, PATH, [&](SlotReader<FakeFile>& reader) {
+		char text[16] = {};
+		reader.readBytes(text, sizeof(text) - 1);
+		loaded = text;
+		return loaded == "bad" ? -1 : 0;
+	});
+	TEST_ASSERT_EQUAL(0, result);
+	TEST_ASSERT_EQUAL_STRING("good", loaded.c_str());
+}
+
+void test_sequence_wraparound() {
+	save(fs, "a");
+	save(fs, "b");
+	// rewrite the trailers with sequence numbers on both sides of the wrap
+	const uint32_t sequences[2] = {0xFFFFFFFF, 0};
+	for(int slot = 0; slot < 2; slot++) {
+		char name[64];
+		slotPath(name, sizeof(name), PATH, slot);
+		Data& data = *fs.files[name];
+		SlotTrailer trailer;
+		trailer.decode(data.data() + data.size() - SlotTrailer::SIZE);
+		trailer.sequence = sequences[slot];
+		trailer.crc = trailer.finish(cfg::crc32(0, data.data(), trailer.length));
+		trailer.encode(data.data() + data.size() - SlotTrailer::SIZE);
+	}
+	TEST_ASSERT_EQUAL_STRING("b", load(fs).c_str());
+	save(fs, "c");
+	TEST_ASSERT_EQUAL_STRING("c", load(fs).c_str());
+	int order[2];
+	SlotTrailer newest;
+	findSlots(fs, PATH, order, newest);
+	TEST_ASSERT_EQUAL(0, order[0]);
+	TEST_ASSERT_EQUAL(1, newest.sequence);
+}
+
+void test_plain_file() {
+	const std::string plain = "{\"charge\":7}";
+	fs.files[PATH] = std::make_shared<Data>(plain.begin(), plain.end());
+	TEST_ASSERT_EQUAL_STRING(plain.c_str(), load(fs).c_str());
+
+	// a save cut short keeps the plain file
+	FakeFS device = fs.reboot();
+	device.budget = 3;
+	TEST_ASSERT_EQUAL(-1, save(device, "{\"charge\":8}"));
+	device = device.reboot();
+	TEST_ASSERT_EQUAL_STRING(plain.c_str(), load(device).c_str());
+
+	TEST_ASSERT_EQUAL(0, save(fs, "{\"charge\":8}"));
+	TEST_ASSERT_EQUAL(0, fs.files.count(PATH));
+	TEST_ASSERT_EQUAL_STRING("{\"charge\":8}", load(fs).c_str());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_alternating_slots);
+	RUN_TEST(test_power_loss);
+	RUN_TEST(test_corruption);
+	RUN_TEST(test_rejected_copy);
+	RUN_TEST(test_sequence_wraparound);
+	RUN_TEST(test_plain_file);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include <unity.h>
+#include <memory>
+#include <stdio.h>
+#include "smallFunction.h"
+
+typedef SmallFunction<int(int), 16> Function;
+
+int callCounter = 0;
+
+/// @brief Counts its live instances, to check that every stored callable is destroyed exactly once.
+struct Counted {
+	static int alive;
+	int value;
+	explicit Counted(int value) : value(value) { alive++; }
+	Counted(Counted&& other) : value(other.value) { alive++; }
+	Counted(const Counted& other) : value(other.value) { alive++; }
+	~Counted() { alive--; }
+	int operator()(int x) { return x + value; }
+};
+int Counted::alive = 0;
+
+int twice(int x) {
+	return 2 * x;
+}
+
+void setUp() {
+	callCounter = 0;
+	Counted::alive = 0;
+}
+
+void tearDown() {
+	TEST_ASSERT_EQUAL(0, Counted::alive);
+}
+
+void test_callables() {
+	Function empty;
+	TEST_ASSERT_FALSE(empty);
+	Function pointer(twice);
+	TEST_ASSERT_TRUE(pointer);
+	TEST_ASSERT_EQUAL(6, pointer(3));
+
+	// captured state lives inside the function and is kept between calls
+	int offset = 10;
+	Function lambda([offset, calls = 0](int x) mutable { return x + offset + calls++; });
+	TEST_ASSERT_EQUAL(11, lambda(1));
+	TEST_ASSERT_EQUAL(12, lambda(1));
+
+	Function reference([&offset](int x) { return x + offset; });
+	offset = 20;
+	TEST_ASSERT_EQUAL(21, reference(1));
+
+	lambda = nullptr;
+	TEST_ASSERT_FALSE(lambda);
+	lambda = twice;
+	TEST_ASSERT_EQUAL(8, lambda(4));
+}
+
+void test_null_pointer() {
+	int (*none)(int) = nullptr;
+	Function function(none);
+	TEST_ASSERT_FALSE(function);
+	function = twice;
+	TEST_ASSERT_TRUE(function);
+	// assigning a null pointer empties it
+	function = none;
+	TEST_ASSERT_FALSE(function);
+	Function moved(std::move(function));
+	TEST_ASSERT_FALSE(moved);
+}
+
+void test_move_only() {
+	Function owner([value = std::unique_ptr<int>(new int(5))](int x) { return x * *value; });
+	TEST_ASSERT_EQUAL(15, owner(3));
+	Function moved(std::move(owner));
+	TEST_ASSERT_FALSE(owner);
+	TEST_ASSERT_EQUAL(20, moved(4));
+	owner = std::move(moved);
+	TEST_ASSERT_FALSE(moved);
+	TEST_ASSERT_EQUAL(10, owner(2));
+}
+
+void test_destruction() {
+	{
+		Function function(Counted(3));
+		TEST_ASSERT_EQUAL(1, Counted::alive);
+		TEST_ASSERT_EQUAL(4, function(1));
+		Function moved(std::move(function));
+		TEST_ASSERT_EQUAL(1, Counted::alive);
+		// assigning over a stored callable destroys it
+		moved = Counted(4);
+		TEST_ASSERT_EQUAL(1, Counted::alive);
+		TEST_ASSERT_EQUAL(5, moved(1));
+		function = std::move(moved);
+		function = std::move(function);
+		TEST_ASSERT_EQUAL(1, Counted::alive);
+		TEST_ASSERT_EQUAL(5, function(1));
+	}
+	TEST_ASSERT_EQUAL(0, Counted::alive);
+	Function reset(Counted(1));
+	reset.reset();
+	TEST_ASSERT_EQUAL(0, Counted::alive);
+	TEST_ASSERT_FALSE(reset);
+}
+
+void test_size() {
+	static_assert(Function::fits<int (*)(int)>(), "A function pointer fits");
+	static_assert(!Function::fits<char[17]>(), "A capture larger than the capacity does not fit");
+	char message[100];
+	snprintf(message, sizeof(message), "SmallFunction<int(int), 16>: %zu bytes", sizeof(Function));
+	TEST_MESSAGE(message);
+	// the storage and two function pointers
+	TEST_ASSERT_EQUAL(16 + 2 * sizeof(void*), sizeof(Function));
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_callables);
+	RUN_TEST(test_null_pointer);
+	RUN_TEST(test_move_only);
+	RUN_TEST(test_destruction);
+	RUN_TEST(test_size);
+	UNITY_END();
+	return 0;
+}
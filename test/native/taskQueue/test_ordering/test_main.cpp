@@ -0,0 +1,99 @@
+#include <unity.h>
+#include <stdlib.h>
+#include "taskQueue.h"
+
+const unsigned int QUEUE_SIZE = 300;
+TaskQueue<QUEUE_SIZE> queue;
+
+void setUp() {
+	queue.clear();
+}
+
+void tearDown() {
+	queue.clear();
+}
+
+void test_empty() {
+	TEST_ASSERT_TRUE(queue.isEmpty());
+	TEST_ASSERT_EQUAL(0, queue.size());
+	for(unsigned int i = 0; i < QUEUE_SIZE; i++) {
+		TEST_ASSERT_FALSE(queue.contains(i));
+	}
+}
+
+void test_pop_in_order() {
+	queue.push(3, 500);
+	queue.push(7, 100);
+	queue.push(1, 300);
+	queue.push(0, 200);
+	TEST_ASSERT_EQUAL(4, queue.size());
+	TEST_ASSERT_EQUAL(7, queue.top());
+	TEST_ASSERT_EQUAL(100, queue.topDeadline());
+	queue.pop();
+	TEST_ASSERT_EQUAL(0, queue.top());
+	queue.pop();
+	TEST_ASSERT_EQUAL(1, queue.top());
+	queue.pop();
+	TEST_ASSERT_EQUAL(3, queue.top());
+	queue.pop();
+	TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+void test_push_moves_queued_slot() {
+	queue.push(1, 100);
+	queue.push(2, 200);
+	queue.push(3, 300);
+	queue.push(3, 50);
+	TEST_ASSERT_EQUAL(3, queue.size());
+	TEST_ASSERT_EQUAL(3, queue.top());
+	queue.push(3, 400);
+	TEST_ASSERT_EQUAL(1, queue.top());
+	queue.pop();
+	queue.pop();
+	TEST_ASSERT_EQUAL(3, queue.top());
+	TEST_ASSERT_EQUAL(400, queue.topDeadline());
+}
+
+void test_remove() {
+	queue.push(1, 100);
+	queue.push(2, 200);
+	queue.push(3, 300);
+	queue.remove(1);
+	TEST_ASSERT_FALSE(queue.contains(1));
+	TEST_ASSERT_EQUAL(2, queue.top());
+	queue.remove(1);
+	TEST_ASSERT_EQUAL(2, queue.size());
+	queue.remove(3);
+	TEST_ASSERT_EQUAL(2, queue.top());
+	TEST_ASSERT_EQUAL(1, queue.size());
+}
+
+void test_random_fill() {
+	srand(42);
+	for(unsigned int i = 0; i < QUEUE_SIZE; i++) {
+		queue.push(i, rand() % 1000);
+	}
+	// remove every third slot from the middle of the heap
+	for(unsigned int i = 0; i < QUEUE_SIZE; i += 3) {
+		queue.remove(i);
+	}
+	TEST_ASSERT_EQUAL(QUEUE_SIZE - QUEUE_SIZE / 3, queue.size());
+	unsigned long long last = 0;
+	while(!queue.isEmpty()) {
+		TEST_ASSERT_TRUE(queue.topDeadline() >= last);
+		TEST_ASSERT_NOT_EQUAL(0, queue.top() % 3);
+		last = queue.topDeadline();
+		queue.pop();
+	}
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_empty);
+	RUN_TEST(test_pop_in_order);
+	RUN_TEST(test_push_moves_queued_slot);
+	RUN_TEST(test_remove);
+	RUN_TEST(test_random_fill);
+	UNITY_END();
+	return 0;
+}
@@ -0,0 +1,33 @@
+#include <unity.h>
+#include "timeBase.h"
+
+TimeBase timeBase;
+
+void setUp() {
+	timeBase = TimeBase();
+}
+
+void tearDown() {
+}
+
+void test_no_wrap() {
+	TEST_ASSERT_EQUAL(0, timeBase.update(0));
+	TEST_ASSERT_EQUAL(1000, timeBase.update(1000));
+	TEST_ASSERT_EQUAL(1000, timeBase.update(1000));
+	TEST_ASSERT_EQUAL(0xFFFFFFFFULL, timeBase.update(0xFFFFFFFF));
+}
+
+void test_wrap() {
+	timeBase.update(0xFFFFFF00);
+	TEST_ASSERT_TRUE(timeBase.update(0x10) == 0x100000010ULL);
+	TEST_ASSERT_TRUE(timeBase.update(0xFFFFFF00) == 0x1FFFFFF00ULL);
+	TEST_ASSERT_TRUE(timeBase.update(0x5) == 0x200000005ULL);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_no_wrap);
+	RUN_TEST(test_wrap);
+	UNITY_END();
+	return 0;
+}
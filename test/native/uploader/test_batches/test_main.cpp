@@ -0,0 +1,327 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "../../fakeFS.h"
+
+#define LOG_SEGMENT_SIZE 256
+#define LOG_BUFFER_SIZE 128
+#define UPLOAD_BATCH_SIZE 4
+#define UPLOAD_BODY_SIZE 256
+#include "uploader.h"
+
+/// @brief Stand-in for the HTTP server, answering with the scripted status codes.
+struct FakeHttp {
+	std::vector<std::string> bodies;
+	std::string authorization;
+	std::string contentType;
+	std::vector<int> statuses;
+	/// @brief The body length announced by connect.
+	size_t expected = 0;
+	/// @brief The most bytes a write accepts.
+	size_t sendBuffer = 1024;
+	/// @brief Never answer.
+	bool silent = false;
+	int writes = 0;
+	bool connected = false;
+
+	int connect(const char* url, const char* authorization, const char* contentType, size_t length) {
+		TEST_ASSERT_FALSE(connected);
+		TEST_ASSERT_EQUAL_STRING("http://collector/samples", url);
+		this->authorization = authorization;
+		this->contentType = contentType;
+		bodies.push_back(std::string());
+		expected = length;
+		connected = true;
+		return 1;
+	}
+	size_t write(const uint8_t* data, size_t length) {
+		TEST_ASSERT_TRUE(connected);
+		writes++;
+		const size_t accepted = std::min(length, sendBuffer);
+		bodies.back().append((const char*)data, accepted);
+		return accepted;
+	}
+	int poll() {
+		TEST_ASSERT_EQUAL(expected, bodies.back().size());
+		if(silent) return 0;
+		if(statuses.empty()) return 200;
+		const int status = statuses.front();
+		statuses.erase(statuses.begin());
+		return status;
+	}
+	void stop() {
+		connected = false;
+	}
+};
+
+FakeFS fs;
+FakeHttp http;
+SampleLog<FakeFS>* sampleLog;
+Uploader<FakeFS, FakeHttp>* uploader;
+
+void setUp() {
+	fs = FakeFS();
+	http = FakeHttp();
+	sampleLog = new SampleLog<FakeFS>(fs);
+	sampleLog->begin();
+	uploader = new Uploader<FakeFS, FakeHttp>(*sampleLog, fs, http);
+	uploader->begin();
+	uploader->setTarget("http://collector/samples", "exp1", "secret");
+}
+
+void tearDown() {
+	delete uploader;
+	delete sampleLog;
+}
+
+/// @brief Updates the uploader until a post completes, or it has nothing to do.
+/// @return The result of the last update.
+int post(unsigned long long now, Uploader<FakeFS, FakeHttp>* target = nullptr) {
+	if(target == nullptr) target = uploader;
+	int result = 0;
+	for(int i = 0; i < 100 && result == 0; i++) {
+		result = target->update(now);
+	}
+	return result;
+}
+
+void appendSamples(uint32_t from, uint32_t to) {
+	for(uint32_t sequence = from; sequence <= to; sequence++) {
+		sampleLog->append(1000ULL * sequence, sequence, 2, "+1.0E+00");
+	}
+	sampleLog->flush();
+}
+
+void test_batches() {
+	appendSamples(1, 6);
+	TEST_ASSERT_EQUAL(200, post(0));
+	TEST_ASSERT_EQUAL(1, http.bodies.size());
+	TEST_ASSERT_EQUAL_STRING("Bearer secret", http.authorization.c_str());
+	TEST_ASSERT_EQUAL_STRING("application/json", http.contentType.c_str());
+	TEST_ASSERT_EQUAL_STRING("{\"experiment_id\":\"exp1\",\"samples\":["
+		"[1,1000,2,\"+1.0E+00\"],[2,2000,2,\"+1.0E+00\"],[3,3000,2,\"+1.0E+00\"],[4,4000,2,\"+1.0E+00\"]]}",
+		http.bodies[0].c_str());
+	// the batch was full, so the rest goes right away
+	TEST_ASSERT_EQUAL(200, post(1));
+	TEST_ASSERT_EQUAL(6, uploader->getUploaded());
+	// nothing left, wait for new samples
+	TEST_ASSERT_EQUAL(0, post(2));
+	appendSamples(7, 7);
+	TEST_ASSERT_EQUAL(0, post(3));
+	TEST_ASSERT_EQUAL(200, post(2 + UPLOAD_INTERVAL_MS));
+	TEST_ASSERT_EQUAL(7, uploader->getUploaded());
+	TEST_ASSERT_EQUAL(3, http.bodies.size());
+}
+
+void test_binary_batches() {
+	uploader->setTarget("http://collector/samples", "exp1", "secret", true);
+	appendSamples(1, 3);
+	sampleLog->append(4000, 4, 2, "\"OVLD\"");
+	sampleLog->append(5000, 5, 2, "+1.5E+00");
+	sampleLog->flush();
+	TEST_ASSERT_EQUAL(200, post(0));
+	TEST_ASSERT_EQUAL(200, post(1));
+	TEST_ASSERT_EQUAL(5, uploader->getUploaded());
+	TEST_ASSERT_EQUAL_STRING("application/octet-stream", http.contentType.c_str());
+
+	const char* expected[] = {"+1.0E+00", "+1.0E+00", "+1.0E+00", "\"OVLD\"", "+1.5E+00"};
+	uint32_t sequence = 1;
+	for(const std::string& body : http.bodies) {
+		const uint8_t* in = (const uint8_t*)body.data();
+		TEST_ASSERT_EQUAL(UPLOAD_BINARY_VERSION, in[0]);
+		TEST_ASSERT_EQUAL(4, in[1]);
+		TEST_ASSERT_EQUAL(0, body.compare(2, 4, "exp1"));
+		size_t offset = 6;
+		codec::DeltaDecoder decoder;
+		while(offset < body.size()) {
+			uint64_t time;
+			uint32_t decodedSequence;
+			uint8_t preset;
+			char text[32];
+			const size_t read = decoder.decode(in + offset, body.size() - offset, time, decodedSequence, preset, text, sizeof(text));
+			TEST_ASSERT_NOT_EQUAL(0, read);
+			TEST_ASSERT_EQUAL(sequence, decodedSequence);
+			TEST_ASSERT_EQUAL(1000ULL * sequence, time);
+			TEST_ASSERT_EQUAL(2, preset);
+			TEST_ASSERT_EQUAL_STRING(expected[sequence - 1], text);
+			offset += read;
+			sequence++;
+		}
+	}
+	TEST_ASSERT_EQUAL(6, sequence);
+	// the JSON of the first batch is more than 4 times larger
+	TEST_ASSERT_TRUE(http.bodies[0].size() * 4 < strlen("{\"experiment_id\":\"exp1\",\"samples\":["
+		"[1,1000,2,\"+1.0E+00\"],[2,2000,2,\"+1.0E+00\"],[3,3000,2,\"+1.0E+00\"],[4,4000,2,\"\\\"OVLD\\\"\"]]}"));
+}
+
+void test_body_size_limit() {
+	char text[101];
+	memset(text, 'x', 100);
+	text[100] = '\0';
+	sampleLog->append(1000, 1, 0, text);
+	sampleLog->append(2000, 2, 0, text);
+	sampleLog->append(3000, 3, 0, text);
+	sampleLog->flush();
+	TEST_ASSERT_EQUAL(200, post(0));
+	TEST_ASSERT_TRUE(http.bodies[0].size() <= UPLOAD_BODY_SIZE);
+	// only one sample fits
+	TEST_ASSERT_EQUAL(1, uploader->getUploaded());
+	// the rest goes right away
+	TEST_ASSERT_EQUAL(200, post(1));
+	TEST_ASSERT_EQUAL(200, post(2));
+	TEST_ASSERT_EQUAL(3, uploader->getUploaded());
+}
+
+void test_backoff() {
+	appendSamples(1, 2);
+	http.statuses = {500, -1, 503};
+	TEST_ASSERT_EQUAL(500, post(0));
+	TEST_ASSERT_EQUAL(UPLOAD_BACKOFF_MIN_MS, uploader->getBackoff());
+	TEST_ASSERT_EQUAL(0, post(UPLOAD_BACKOFF_MIN_MS - 1));
+	TEST_ASSERT_EQUAL(-1, post(UPLOAD_BACKOFF_MIN_MS));
+	TEST_ASSERT_EQUAL(2 * UPLOAD_BACKOFF_MIN_MS, uploader->getBackoff());
+	TEST_ASSERT_EQUAL(503, post(3 * UPLOAD_BACKOFF_MIN_MS));
+	TEST_ASSERT_EQUAL(4 * UPLOAD_BACKOFF_MIN_MS, uploader->getBackoff());
+	TEST_ASSERT_EQUAL(0, uploader->getUploaded());
+	TEST_ASSERT_EQUAL(200, post(7 * UPLOAD_BACKOFF_MIN_MS));
+	TEST_ASSERT_EQUAL(0, uploader->getBackoff());
+	TEST_ASSERT_EQUAL(2, uploader->getUploaded());
+	// the same batch was sent every time
+	TEST_ASSERT_TRUE(http.bodies[0] == http.bodies[3]);
+
+	unsigned long long now = 8 * UPLOAD_BACKOFF_MIN_MS;
+	appendSamples(3, 3);
+	http.statuses = std::vector<int>(20, 500);
+	for(int i = 0; i < 20; i++) {
+		now += UPLOAD_BACKOFF_MAX_MS;
+		post(now);
+	}
+	TEST_ASSERT_EQUAL(UPLOAD_BACKOFF_MAX_MS, uploader->getBackoff());
+}
+
+void test_cursor_survives_reboot() {
+	appendSamples(1, 6);
+	post(0);
+	TEST_ASSERT_EQUAL(4, uploader->getUploaded());
+
+	Uploader<FakeFS, FakeHttp> rebooted(*sampleLog, fs, http);
+	TEST_ASSERT_EQUAL(0, rebooted.begin());
+	rebooted.setTarget("http://collector/samples", "exp1", "");
+	TEST_ASSERT_EQUAL(200, post(0, &rebooted));
+	TEST_ASSERT_EQUAL(2, rebooted.getUploaded());
+	TEST_ASSERT_EQUAL_STRING("", http.authorization.c_str());
+	TEST_ASSERT_EQUAL(0, http.bodies[1].find("{\"experiment_id\":\"exp1\",\"samples\":[[5,"));
+}
+
+/// @brief Saves a plain cursor file, as written before the slots, which is loaded when there are no slots.
+void writeCursor(uint32_t segment, uint32_t offset) {
+	uint8_t data[8];
+	for(int i = 0; i < 4; i++) {
+		data[i] = segment >> (8 * i);
+		data[4 + i] = offset >> (8 * i);
+	}
+	auto file = fs.open(UPLOAD_CURSOR_PATH, "w");
+	file.write(data, sizeof(data));
+}
+
+void test_cursor_past_end() {
+	appendSamples(1, 2);
+	// saved before the log lost its segments
+	writeCursor(5, 60);
+	Uploader<FakeFS, FakeHttp> rebooted(*sampleLog, fs, http);
+	TEST_ASSERT_EQUAL(0, rebooted.begin());
+	TEST_ASSERT_EQUAL(0, rebooted.getCursor().segment);
+	TEST_ASSERT_EQUAL(0, rebooted.getCursor().offset);
+	rebooted.setTarget("http://collector/samples", "exp1", "");
+	TEST_ASSERT_EQUAL(200, post(0, &rebooted));
+	TEST_ASSERT_EQUAL(2, rebooted.getUploaded());
+}
+
+void test_cursor_after_log_restart() {
+	appendSamples(1, 6);
+	// a cursor in the middle of a record of the new log, which started over at segment 0
+	writeCursor(0, 30);
+	fs.files[LOG_DIR "/index.bin"] = std::make_shared<Data>(3, 0);
+	TEST_ASSERT_EQUAL(-1, sampleLog->begin());
+	Uploader<FakeFS, FakeHttp> rebooted(*sampleLog, fs, http);
+	TEST_ASSERT_EQUAL(0, rebooted.begin(true));
+	TEST_ASSERT_EQUAL(0, rebooted.getCursor().offset);
+	rebooted.setTarget("http://collector/samples", "exp1", "");
+	TEST_ASSERT_EQUAL(200, post(0, &rebooted));
+	TEST_ASSERT_EQUAL(0, http.bodies[0].find("{\"experiment_id\":\"exp1\",\"samples\":[[1,"));
+
+	// the reset cursor was saved
+	Uploader<FakeFS, FakeHttp> again(*sampleLog, fs, http);
+	again.begin();
+	TEST_ASSERT_EQUAL(rebooted.getCursor().offset, again.getCursor().offset);
+}
+
+void test_target_is_copied() {
+	// the target usually comes from a preset, which can be released while the uploader keeps running
+	char url[] = "http://collector/samples";
+	char experimentId[] = "exp2";
+	uploader->setTarget(url, experimentId, "");
+	memset(url, 'x', sizeof(url) - 1);
+	memset(experimentId, 'y', sizeof(experimentId) - 1);
+	appendSamples(1, 1);
+	TEST_ASSERT_EQUAL(200, post(0));
+	TEST_ASSERT_EQUAL(0, http.bodies[0].find("{\"experiment_id\":\"exp2\""));
+}
+
+void test_sliced_post() {
+	appendSamples(1, 4);
+	http.sendBuffer = 40;
+	TEST_ASSERT_EQUAL(0, uploader->update(0));
+	TEST_ASSERT_TRUE(uploader->isBusy());
+	// connect, then one write per update
+	TEST_ASSERT_EQUAL(0, uploader->update(1));
+	TEST_ASSERT_TRUE(http.connected);
+	TEST_ASSERT_EQUAL(0, uploader->update(2));
+	TEST_ASSERT_EQUAL(1, http.writes);
+	TEST_ASSERT_EQUAL(40, http.bodies[0].size());
+	TEST_ASSERT_EQUAL(200, post(3));
+	TEST_ASSERT_FALSE(uploader->isBusy());
+	TEST_ASSERT_FALSE(http.connected);
+	TEST_ASSERT_EQUAL((http.bodies[0].size() + 39) / 40, http.writes);
+	TEST_ASSERT_EQUAL(4, uploader->getUploaded());
+}
+
+void test_timeout() {
+	appendSamples(1, 2);
+	http.silent = true;
+	TEST_ASSERT_EQUAL(0, post(0));
+	TEST_ASSERT_TRUE(uploader->isBusy());
+	TEST_ASSERT_EQUAL(0, uploader->update(UPLOAD_TIMEOUT_MS - 1));
+	TEST_ASSERT_EQUAL(UPLOAD_ERROR_TIMEOUT, uploader->update(UPLOAD_TIMEOUT_MS));
+	TEST_ASSERT_FALSE(uploader->isBusy());
+	TEST_ASSERT_FALSE(http.connected);
+	TEST_ASSERT_EQUAL(UPLOAD_BACKOFF_MIN_MS, uploader->getBackoff());
+	TEST_ASSERT_EQUAL(0, uploader->getUploaded());
+	http.silent = false;
+	TEST_ASSERT_EQUAL(200, post(UPLOAD_TIMEOUT_MS + UPLOAD_BACKOFF_MIN_MS));
+	TEST_ASSERT_EQUAL(2, uploader->getUploaded());
+}
+
+void test_no_url() {
+	appendSamples(1, 2);
+	uploader->setTarget("", "", "");
+	TEST_ASSERT_EQUAL(0, post(0));
+	TEST_ASSERT_EQUAL(0, http.bodies.size());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_batches);
+	RUN_TEST(test_binary_batches);
+	RUN_TEST(test_body_size_limit);
+	RUN_TEST(test_backoff);
+	RUN_TEST(test_cursor_survives_reboot);
+	RUN_TEST(test_sliced_post);
+	RUN_TEST(test_timeout);
+	RUN_TEST(test_cursor_past_end);
+	RUN_TEST(test_cursor_after_log_restart);
+	RUN_TEST(test_target_is_copied);
+	RUN_TEST(test_no_url);
+	UNITY_END();
+	return 0;
+}